@@ -1,60 +1,221 @@
 #include "db.h"
 
+#include <algorithm>
+#include <sstream>
+
 hsql::SQLParserResult SimpleSQL::ParseSQL(std::string &query) {
   hsql::SQLParserResult result;
   hsql::SQLParser::parse(query, &result);
   return result;
 }
 
+void SimpleSQL::Recover(bool instant) {
+  auto start = std::chrono::steady_clock::now();
+  log_recovery_ = new LogRecovery(db_->disk_manager_, db_->buffer_pool_manager_, db_->log_manager_);
+  if (instant) {
+    log_recovery_->Analyze();
+    spdlog::info("log analysis done, {0} pages pending redo", log_recovery_->GetPendingPageNum());
+  } else {
+    log_recovery_->Redo();
+  }
+  // 撤销经过索引，先加载目录
+  OpenCatalog();
+  log_recovery_->Undo();
+  StartLogging();
+  // 撤销掉的表和索引从目录中去掉
+  OpenCatalog();
+  if (instant) {
+    log_recovery_->StartBackgroundRedo();
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  spdlog::info("recovery ready to serve in {0} ms", ms);
+}
+
+void SimpleSQL::OpenCatalog() {
+  // standby 上读快照，未完成的事务建的表和索引不加载
+  auto *txn = db_->transaction_manager_->BeginReadOnly();
+  catalog_->Open(txn);
+  CommitTransaction(txn);
+  if (log_recovery_ == nullptr) {
+    return;
+  }
+  // 按名字找索引，Open 可能去掉了索引
+  for (auto *index_info : catalog_->GetIndexes()) {
+    auto name = index_info->name_;
+    auto table_name = index_info->table_name_;
+    log_recovery_->RegisterIndex(name, [this, name, table_name](bool is_insert, const char *key, const char *value) {
+      catalog_->GetIndex(name, table_name)->index_->UndoEntry(is_insert, key, value);
+    });
+  }
+}
+
+void SimpleSQL::StartLogging() {
+  if (enable_logging) {
+    return;
+  }
+  db_->log_manager_->RunFlushThread();
+  db_->checkpoint_manager_->StartScheduler(checkpoint_policy_);
+}
+
+std::string SimpleSQL::CheckpointStatus() {
+  auto stats = db_->checkpoint_manager_->GetStats();
+  std::stringstream ss;
+  ss << "checkpoints: " << stats.checkpoint_num_ << ", last_duration_ms: " << stats.last_duration_ms_
+     << ", last_block_ms: " << stats.last_block_ms_ << ", last_pages_written: " << stats.last_pages_written_
+     << ", total_pages_written: " << stats.total_pages_written_ << ", log_bytes: " << stats.log_bytes_
+     << ", dirty_ratio: " << stats.dirty_ratio_ << ", estimated_recovery_ms: " << stats.estimated_recovery_ms_
+     << "\n";
+  return ss.str();
+}
+
+std::string SimpleSQL::ContentionStatus(size_t top_n) { return ContentionStats::Collect(top_n).ToString(); }
+
+void SimpleSQL::StartReplication(int port) {
+  StartLogging();
+  shipper_ = new LogShipper(db_->disk_manager_, db_->log_manager_);
+  shipper_->Start(port);
+}
+
+void SimpleSQL::StartStandby(const std::string &host, int port) {
+  log_recovery_ = new LogRecovery(db_->disk_manager_, db_->buffer_pool_manager_, db_->log_manager_);
+  // 只读查询读快照，看不到主库未提交的修改
+  log_recovery_->SetVersionStore(db_->transaction_manager_->GetVersionStore());
+  log_recovery_->Redo();
+  OpenCatalog();
+  receiver_ = new LogReceiver(db_->disk_manager_, db_->log_manager_, log_recovery_);
+  receiver_->Start(host, port);
+  catalog_lsn_ = log_recovery_->GetMaxLSN();
+  standby_ = true;
+}
+
+void SimpleSQL::RefreshCatalog() {
+  catalog_latch_.WLock();
+  lsn_t replayed_lsn = receiver_->GetStats().replayed_lsn_;
+  if (standby_ && replayed_lsn != catalog_lsn_) {
+    OpenCatalog();
+    catalog_lsn_ = replayed_lsn;
+  }
+  catalog_latch_.WUnlock();
+}
+
+void SimpleSQL::Promote() {
+  if (!standby_) {
+    throw Exception("not a standby");
+  }
+  catalog_latch_.WLock();
+  auto stats = receiver_->GetStats();
+  receiver_->Stop();
+  OpenCatalog();
+  log_recovery_->Undo();
+  StartLogging();
+  OpenCatalog();
+  standby_ = false;
+  catalog_latch_.WUnlock();
+  spdlog::info("promoted to primary at lsn {0}, {1} lsn behind the old primary", stats.replayed_lsn_, stats.lag_lsn_);
+}
+
+std::string SimpleSQL::ReplicationStatus() {
+  std::stringstream ss;
+  if (standby_) {
+    auto stats = receiver_->GetStats();
+    ss << "role: standby, connected: " << stats.connected_ << ", received_offset: " << stats.received_offset_
+       << ", replayed_offset: " << stats.replayed_offset_ << ", replayed_lsn: " << stats.replayed_lsn_
+       << ", primary_lsn: " << stats.primary_lsn_ << ", lag_lsn: " << stats.lag_lsn_
+       << ", replay_lag_ms: " << stats.replay_lag_ms_ << "\n";
+  } else if (shipper_ != nullptr) {
+    ss << "role: primary, persistent_lsn: " << db_->log_manager_->GetPersistentLSN() << "\n";
+    for (const auto &stats : shipper_->GetStats()) {
+      ss << "standby shipped_offset: " << stats.shipped_offset_ << ", replayed_offset: " << stats.replayed_offset_
+         << ", replayed_lsn: " << stats.replayed_lsn_ << ", lag_bytes: " << stats.lag_bytes_ << "\n";
+    }
+  } else {
+    ss << "role: standalone\n";
+  }
+  return ss.str();
+}
+
+BackupManifest SimpleSQL::Backup(const std::string &backup_dir, const std::string &base_dir, size_t bytes_per_sec) {
+  std::lock_guard<std::mutex> guard(backup_latch_);
+  if (backup_manager_ == nullptr) {
+    backup_manager_ = new BackupManager(db_->disk_manager_, db_->buffer_pool_manager_, db_->log_manager_);
+  }
+  backup_manager_->SetThrottle(bytes_per_sec);
+  if (base_dir.empty()) {
+    return backup_manager_->Backup(backup_dir);
+  }
+  auto base = BackupManager::ReadManifest(base_dir);
+  return backup_manager_->Backup(backup_dir, &base);
+}
+
 void SimpleSQL::Execute(hsql::SQLParserResult &result) {
-  auto txn = this->BeginTransaction();  // start
-  for (const auto &stmt : result.getStatements()) {
-    switch (stmt->type()) {
-      case hsql::kStmtSelect: {
-        this->executeSelectStmt(txn, stmt);
-        break;
-      }
-      case hsql::kStmtInsert: {
-        this->executeInsertStmt(txn, stmt);
-        break;
-      }
-      case hsql::kStmtUpdate: {
-        this->executeUpdateStmt(txn, stmt);
-        break;
-      }
-      case hsql::kStmtDelete: {
-        this->executeDeleteStmt(txn, stmt);
-        break;
-      }
-      case hsql::kStmtCreate: {
-        this->executeCreateStmt(txn, stmt);
-        break;
-      }
-      case hsql::kStmtDrop: {
-        // auto *drop_stmt = dynamic_cast<hsql::DropStatement *>(stmt);
-        throw NotImplementedException("drop statement not implemented");
+  bool read_only = std::all_of(result.getStatements().begin(), result.getStatements().end(),
+                               [](const hsql::SQLStatement *stmt) { return stmt->type() == hsql::kStmtSelect; });
+  // standby 只读，写操作在故障切换后才能执行
+  if (standby_ && !read_only) {
+    throw Exception("standby is read-only, promote it first");
+  }
+  if (standby_) {
+    RefreshCatalog();
+  }
+  catalog_latch_.RLock();
+  // 只有 select 的请求走只读事务，读快照，不加锁也不写日志；select 只生成顺序扫描，索引没有多版本，
+  // 用索引的计划要走加锁的事务，执行引擎在快照里会拒绝它们
+  auto txn = read_only ? db_->transaction_manager_->BeginReadOnly() : this->BeginTransaction();  // start
+  try {
+    for (const auto &stmt : result.getStatements()) {
+      switch (stmt->type()) {
+        case hsql::kStmtSelect: {
+          this->executeSelectStmt(txn, stmt);
+          break;
+        }
+        case hsql::kStmtInsert: {
+          this->executeInsertStmt(txn, stmt);
+          break;
+        }
+        case hsql::kStmtUpdate: {
+          this->executeUpdateStmt(txn, stmt);
+          break;
+        }
+        case hsql::kStmtDelete: {
+          this->executeDeleteStmt(txn, stmt);
+          break;
+        }
+        case hsql::kStmtCreate: {
+          this->executeCreateStmt(txn, stmt);
+          break;
+        }
+        case hsql::kStmtDrop: {
+          // auto *drop_stmt = dynamic_cast<hsql::DropStatement *>(stmt);
+          throw NotImplementedException("drop statement not implemented");
+        }
+        case hsql::kStmtPrepare:
+          throw NotImplementedException("prepare statement not implemented");
+        case hsql::kStmtExecute:
+          throw NotImplementedException("execute statement not implemented");
+        case hsql::kStmtExport:
+          throw NotImplementedException("export statement not implemented");
+        case hsql::kStmtRename:
+          throw NotImplementedException("rename statement not implemented");
+        case hsql::kStmtAlter:
+          throw NotImplementedException("alter statement not implemented");
+        case hsql::kStmtShow:
+          throw NotImplementedException("show statement not implemented");
+        case hsql::kStmtTransaction:
+          throw NotImplementedException("transaction statement not implemented");
+        case hsql::kStmtImport:
+          throw NotImplementedException("import statement not implemented");
+        case hsql::kStmtError:
+          throw Exception(ExceptionType::SQL_STATEMENT_PARSE, "SQL statement parse error");
       }
-      case hsql::kStmtPrepare:
-        throw NotImplementedException("prepare statement not implemented");
-      case hsql::kStmtExecute:
-        throw NotImplementedException("execute statement not implemented");
-      case hsql::kStmtExport:
-        throw NotImplementedException("export statement not implemented");
-      case hsql::kStmtRename:
-        throw NotImplementedException("rename statement not implemented");
-      case hsql::kStmtAlter:
-        throw NotImplementedException("alter statement not implemented");
-      case hsql::kStmtShow:
-        throw NotImplementedException("show statement not implemented");
-      case hsql::kStmtTransaction:
-        throw NotImplementedException("transaction statement not implemented");
-      case hsql::kStmtImport:
-        throw NotImplementedException("import statement not implemented");
-      case hsql::kStmtError:
-        throw Exception(ExceptionType::SQL_STATEMENT_PARSE, "SQL statement parse error");
     }
+  } catch (...) {
+    // 语句失败时回滚整个事务，释放它的锁
+    this->AbortTransaction(txn);
+    catalog_latch_.RUnlock();
+    throw;
   }
   this->CommitTransaction(txn);  // commit
+  catalog_latch_.RUnlock();
 }
 
 void SimpleSQL::executeSelectStmt(Transaction *txn, hsql::SQLStatement *stmt) {
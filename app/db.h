@@ -5,8 +5,10 @@
 #include "SQLParser.h"
 #include "catalog/catalog.h"
 #include "common/bustub_instance.h"
+#include "common/contention_stats.h"
 #include "common/config.h"
 #include "common/exception.h"
+#include "common/rwlatch.h"
 #include "common/logger.h"
 #include "execution/execution_engine.h"
 #include "execution/executor_context.h"
@@ -18,6 +20,10 @@
 #include "execution/plans/insert_plan.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "execution/plans/update_plan.h"
+#include "recovery/backup_manager.h"
+#include "recovery/checkpoint_manager.h"
+#include "recovery/log_recovery.h"
+#include "recovery/log_replication.h"
 #include "spdlog/spdlog.h"
 #include "tuple_util.h"
 #include "util/sqlhelper.h"
@@ -37,10 +43,58 @@ class SimpleSQL {
   }
 
   ~SimpleSQL() {
+    delete backup_manager_;
+    delete shipper_;
+    delete receiver_;
+    delete log_recovery_;
     delete catalog_;
     delete db_;
   }
 
+  /**
+   * Recover from the log and turn logging on. With instant, only the analysis pass and undo run here,
+   * pages are redone when first fetched and by a background thread while requests are served.
+   */
+  void Recover(bool instant);
+
+  /**
+   * Load the tables and indexes kept in the database file, without recovery. Recover and StartStandby load them
+   * themselves, tables and indexes created afterwards are kept in the database file too. A standby reloads them
+   * before a statement once more of the log was replayed, with a snapshot, so it doesn't see unfinished ones.
+   */
+  void OpenCatalog();
+
+  /**
+   * Primary: ship the log to hot standbys connecting on port, turns logging on if it is off.
+   */
+  void StartReplication(int port);
+  /**
+   * Hot standby: redo the local log, then keep replaying the log of the primary at host:port.
+   * Only select statements are served until Promote.
+   */
+  void StartStandby(const std::string &host, int port);
+  /** Failover: stop replaying, undo the transactions the primary didn't finish, and accept writes. */
+  void Promote();
+  bool IsStandby() const { return standby_; }
+  /** @return replication metrics, one line per standby on a primary */
+  std::string ReplicationStatus();
+
+  /** Once logging is on, a scheduler thread takes checkpoints when any target of the policy is reached. */
+  void SetCheckpointPolicy(const CheckpointPolicy &policy) { checkpoint_policy_ = policy; }
+  /** @return checkpoint metrics */
+  std::string CheckpointStatus();
+
+  /** @return lock and latch wait metrics since the start or the last reset, with the top_n most waited for objects */
+  std::string ContentionStatus(size_t top_n);
+  /** Zero the lock and latch wait metrics. */
+  void ResetContentionStats() { ContentionStats::Reset(); }
+
+  /**
+   * Online backup while requests are served, throttled to bytes_per_sec (0: no limit).
+   * @param base_dir the previous backup for an incremental one, empty for a full backup
+   */
+  BackupManifest Backup(const std::string &backup_dir, const std::string &base_dir, size_t bytes_per_sec);
+
   hsql::SQLParserResult ParseSQL(std::string &query);
   void Execute(hsql::SQLParserResult &result);
   void executeSelectStmt(Transaction *txn, hsql::SQLStatement *stmt);
@@ -51,13 +105,37 @@ class SimpleSQL {
 
   Transaction *BeginTransaction() { return db_->transaction_manager_->Begin(); }
 
-  void CommitTransaction(Transaction *txn) { db_->transaction_manager_->Commit(txn); }
+  // 结束的事务交还给事务管理器复用
+  void CommitTransaction(Transaction *txn) {
+    db_->transaction_manager_->Commit(txn);
+    db_->transaction_manager_->Recycle(txn);
+  }
+
+  void AbortTransaction(Transaction *txn) {
+    db_->transaction_manager_->Abort(txn);
+    db_->transaction_manager_->Recycle(txn);
+  }
 
   BustubInstance *GetDB() { return db_; }
 
   Catalog *GetCatalog() { return catalog_; }
 
  private:
+  /** Turn logging and the checkpoint scheduler on. */
+  void StartLogging();
+  /** Standby: reload the catalog if the log replayed since it was loaded, catalog_latch_ must not be held. */
+  void RefreshCatalog();
+
   BustubInstance *db_;
   Catalog *catalog_;
+  LogRecovery *log_recovery_{nullptr};
+  LogShipper *shipper_{nullptr};
+  LogReceiver *receiver_{nullptr};
+  BackupManager *backup_manager_{nullptr};
+  std::mutex backup_latch_;  // 同一时间只有一个备份
+  CheckpointPolicy checkpoint_policy_;
+  bool standby_{false};
+  // 语句执行时读锁，重新加载目录和故障切换时写锁
+  ReaderWriterLatch catalog_latch_;
+  lsn_t catalog_lsn_{INVALID_LSN};  // standby 加载目录时重放到的 lsn
 };
\ No newline at end of file
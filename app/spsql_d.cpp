@@ -5,24 +5,130 @@
 #include "db.h"
 #include "workflow/WFHttpServer.h"
 
+/** Number of the most waited for rows and pages shown by /contention. */
+static const size_t CONTENTION_TOP_N = 10;
+
+static void Usage() {
+  std::cerr << "Usage: ./spsql_d [PATH] [--recover|--instant-recover] [--replicate PORT] [--standby HOST:PORT] "
+               "[--port PORT] [--backup-rate BYTES_PER_SEC] [--checkpoint-log-bytes BYTES] "
+               "[--checkpoint-dirty-ratio RATIO] [--checkpoint-recovery-ms MS]"
+            << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   if (argc <= 1) {
-    std::cerr << "Usage: ./spsql_d [PATH]" << std::endl;
+    Usage();
     return -1;
   }
   spdlog::set_level(spdlog::level::debug);
   std::string path = argv[1];
+  std::string recover_mode;
+  std::string standby;
+  int replicate_port = -1;
+  int port = 8888;
+  size_t backup_rate = 0;
+  CheckpointPolicy checkpoint_policy;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--recover" || arg == "--instant-recover") {
+      recover_mode = arg;
+    } else if (arg == "--replicate" && i + 1 < argc) {
+      replicate_port = std::stoi(argv[++i]);
+    } else if (arg == "--standby" && i + 1 < argc) {
+      standby = argv[++i];
+    } else if (arg == "--port" && i + 1 < argc) {
+      port = std::stoi(argv[++i]);
+    } else if (arg == "--backup-rate" && i + 1 < argc) {
+      backup_rate = std::stoul(argv[++i]);
+    } else if (arg == "--checkpoint-log-bytes" && i + 1 < argc) {
+      checkpoint_policy.max_log_bytes_ = std::stoul(argv[++i]);
+    } else if (arg == "--checkpoint-dirty-ratio" && i + 1 < argc) {
+      checkpoint_policy.max_dirty_ratio_ = std::stod(argv[++i]);
+    } else if (arg == "--checkpoint-recovery-ms" && i + 1 < argc) {
+      checkpoint_policy.max_recovery_time_ = std::chrono::milliseconds(std::stol(argv[++i]));
+    } else {
+      Usage();
+      return -1;
+    }
+  }
+  auto colon = standby.find(':');
+  if (!standby.empty() && (colon == std::string::npos || !recover_mode.empty())) {
+    // standby 自己重做本地日志，不能再指定 --recover
+    Usage();
+    return -1;
+  }
+
   spdlog::debug("init sql db at {0}", path);
   SimpleSQL db_instance(std::move(path));
+  db_instance.SetCheckpointPolicy(checkpoint_policy);
+  if (!recover_mode.empty()) {
+    db_instance.Recover(recover_mode == "--instant-recover");
+  } else if (standby.empty()) {
+    db_instance.OpenCatalog();
+  }
+  if (!standby.empty()) {
+    db_instance.StartStandby(standby.substr(0, colon), std::stoi(standby.substr(colon + 1)));
+  }
+  if (replicate_port >= 0) {
+    db_instance.StartReplication(replicate_port);
+  }
 
-  WFHttpServer server([&db_instance](WFHttpTask *task) {
+  WFHttpServer server([&db_instance, backup_rate](WFHttpTask *task) {
     auto req = task->get_req();
+    std::string uri = req->get_request_uri();
+    // GET /replication: 复制状态；POST /promote: standby 故障切换为主库
+    if (uri == "/replication") {
+      task->get_resp()->append_output_body(db_instance.ReplicationStatus());
+      return;
+    }
+    // GET /checkpoint: 检查点状态
+    if (uri == "/checkpoint") {
+      task->get_resp()->append_output_body(db_instance.CheckpointStatus());
+      return;
+    }
+    // GET /contention: 锁和 latch 的等待统计，以及等待最多的行和页；POST /contention/reset: 清零
+    if (uri == "/contention") {
+      task->get_resp()->append_output_body(db_instance.ContentionStatus(CONTENTION_TOP_N));
+      return;
+    }
+    if (uri == "/contention/reset") {
+      db_instance.ResetContentionStats();
+      task->get_resp()->append_output_body("reset!");
+      return;
+    }
+    if (uri == "/promote") {
+      try {
+        db_instance.Promote();
+        task->get_resp()->append_output_body("promoted!");
+      } catch (Exception &e) {
+        task->get_resp()->append_output_body(e.what());
+      }
+      return;
+    }
     const void *body;
     size_t len;
     req->get_parsed_body(&body, &len);
     spdlog::info("req body size : {}", len);
     std::string query{static_cast<const char *>(body), len};
 
+    // POST /backup, body: "BACKUP_DIR [BASE_BACKUP_DIR]"，有 BASE_BACKUP_DIR 时为增量备份
+    if (uri == "/backup") {
+      std::stringstream args(query);
+      std::string backup_dir;
+      std::string base_dir;
+      args >> backup_dir >> base_dir;
+      try {
+        auto manifest = db_instance.Backup(backup_dir, base_dir, backup_rate);
+        std::stringstream ss;
+        ss << "backup " << backup_dir << ": " << manifest.page_num_ << " pages, up to lsn " << manifest.end_lsn_
+           << "\n";
+        task->get_resp()->append_output_body(ss.str());
+      } catch (Exception &e) {
+        task->get_resp()->append_output_body(e.what());
+      }
+      return;
+    }
+
     // std::string query{""};
     auto result = db_instance.ParseSQL(query);
 
@@ -33,14 +139,19 @@ int main(int argc, char *argv[]) {
       return;
     }
 
-    db_instance.Execute(result);
+    try {
+      db_instance.Execute(result);
+    } catch (Exception &e) {
+      task->get_resp()->append_output_body(e.what());
+      return;
+    }
     task->get_resp()->append_output_body("execute successful!");
   });
 
-  if (server.start(8888) == 0) {  // start server on port 8888
+  if (server.start(port) == 0) {  // start server on port 8888 by default
     getchar();                    // press "Enter" to end.
     server.stop();
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/exception.h"
+#include "recovery/backup_manager.h"
+
+using namespace bustub;
+
+/*
+ * rebuild a database from a full backup and its incrementals:
+ *   ./spsql_restore restore.db [--lsn LSN] backup_full backup_inc1 backup_inc2 ...
+ * then start it with ./spsql_d restore.db --recover
+ */
+int main(int argc, char *argv[]) {
+  if (argc <= 2) {
+    std::cerr << "Usage: ./spsql_restore [PATH] [--lsn LSN] [FULL_BACKUP_DIR] [INCREMENTAL_BACKUP_DIR]..." << std::endl;
+    return -1;
+  }
+  std::string path = argv[1];
+  lsn_t target_lsn = INVALID_LSN;
+  std::vector<std::string> backup_dirs;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--lsn" && i + 1 < argc) {
+      target_lsn = std::stoi(argv[++i]);
+    } else {
+      backup_dirs.push_back(arg);
+    }
+  }
+  try {
+    lsn_t lsn = BackupManager::Restore(backup_dirs, path, target_lsn);
+    std::cout << "restored " << path << " up to lsn " << lsn << ", start it with ./spsql_d " << path << " --recover"
+              << std::endl;
+  } catch (Exception &e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
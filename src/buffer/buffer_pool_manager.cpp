@@ -11,7 +11,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager.h"
+
+#include <cstring>
+
+#include "common/contention_stats.h"
 #include "common/logger.h"
+#include "recovery/log_recovery.h"
+#include "storage/page/header_page.h"
 
 namespace bustub {
 
@@ -40,7 +46,7 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  std::lock_guard<std::mutex> lock(latch_);
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
   auto p = page_table_.find(page_id);
   if (p != page_table_.end()) {
     // 找到了 page
@@ -48,6 +54,9 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
     replacer_->Pin(frame_id);
     auto page = &pages_[frame_id];
     page->pin_count_++;
+    if (log_recovery_ != nullptr && log_recovery_->RecoverPage(page)) {
+      page->is_dirty_ = true;
+    }
     return page;
   }
   // 未找到 Page，则从 free list 和 replacer 中查找 R
@@ -67,7 +76,7 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   // 注意：刷的是 free_frame_id 关联的 page_id
   if (page->IsDirty()) {
     // 写日志
-    if (enable_logging && log_manager_->GetPersistentLSN() < page->GetLSN()) {
+    if (NeedFlushLog(page)) {
       log_manager_->Flush(true);
     }
     disk_manager_->WritePage(page->GetPageId(), page->GetData());
@@ -83,11 +92,15 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   page->ResetMemory();  // 重置内存
   // LOG_ERROR("fetch page: %d, frame_id: %d .", page_id, free_frame_id);
   disk_manager_->ReadPage(page_id, page->GetData());  // 重新从磁盘中读取数据
+  // 即时恢复，页第一次被访问时重做
+  if (log_recovery_ != nullptr && log_recovery_->RecoverPage(page)) {
+    page->is_dirty_ = true;
+  }
   return page;
 }
 
 bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) {
-  std::lock_guard<std::mutex> lock(latch_);
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
   auto p = page_table_.find(page_id);
   if (p == page_table_.end()) {
     return false;
@@ -111,7 +124,7 @@ bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) {
 
 bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
-  std::lock_guard<std::mutex> lock(latch_);
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
   auto p = page_table_.find(page_id);
   if (p == page_table_.end()) {
     return false;
@@ -120,7 +133,7 @@ bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
   auto page = &pages_[frame_id];
   if (page->IsDirty()) {
     // 写日志
-    if (enable_logging && log_manager_->GetPersistentLSN() < page->GetLSN()) {
+    if (NeedFlushLog(page)) {
       log_manager_->Flush(true);
     }
     disk_manager_->WritePage(page_id, page->GetData());
@@ -135,7 +148,7 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
   // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
   // 3.   Update P's metadata, zero out memory and add P to the page table.
   // 4.   Set the page ID output parameter. Return a pointer to P.
-  std::lock_guard<std::mutex> lock(latch_);
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
   *page_id = disk_manager_->AllocatePage();
   // 寻找新的 frame_id
   frame_id_t free_frame_id;
@@ -153,7 +166,7 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
   // 如果 free_frame_id 的页是脏的，则刷至磁盘
   if (page->IsDirty()) {
     // 写日志
-    if (enable_logging && log_manager_->GetPersistentLSN() < page->GetLSN()) {
+    if (NeedFlushLog(page)) {
       log_manager_->Flush(true);
     }
     // 写到 page
@@ -166,7 +179,8 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
   // 更新 P 的元数据
   page->ResetMemory();  // 重置内存
   page->page_id_ = *page_id;
-  page->pin_count_ = 0;
+  // 新页由调用者 pin 住，它可能在调用者 Unpin 之前就被别的线程 Fetch 和 Unpin（例如 B+ 树分裂出的右兄弟）
+  page->pin_count_ = 1;
   page->is_dirty_ = false;
   return &pages_[free_frame_id];
 }
@@ -177,7 +191,7 @@ bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
   // 1.   If P does not exist, return true.
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
-  std::lock_guard<std::mutex> lock(latch_);
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
   // LOG_DEBUG("attempt to delete page: %d .", page_id);
   auto p = page_table_.find(page_id);
   if (p == page_table_.end()) {
@@ -191,7 +205,7 @@ bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
   }
   if (page->IsDirty()) {
     // 写日志
-    if (enable_logging && log_manager_->GetPersistentLSN() < page->GetLSN()) {
+    if (NeedFlushLog(page)) {
       log_manager_->Flush(true);
     }
     disk_manager_->WritePage(page->GetPageId(), page->GetData());
@@ -211,14 +225,12 @@ bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
 
 void BufferPoolManager::FlushAllPagesImpl() {
   // You can do it!
-  std::lock_guard<std::mutex> lock(latch_);
-  for (size_t i = 0; i < pool_size_; i++) {
-    auto page_id = static_cast<page_id_t>(i);
-    auto frame_id = page_table_[page_id];
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  for (const auto &[page_id, frame_id] : page_table_) {
     auto page = &pages_[frame_id];
     if (page->IsDirty()) {
       // 写日志
-      if (enable_logging && log_manager_->GetPersistentLSN() < page->GetLSN()) {
+      if (NeedFlushLog(page)) {
         log_manager_->Flush(true);
       }
       disk_manager_->WritePage(page_id, page->GetData());
@@ -227,4 +239,101 @@ void BufferPoolManager::FlushAllPagesImpl() {
   }
 }
 
+bool BufferPoolManager::NeedFlushLog(Page *page) {
+  if (log_manager_ == nullptr) {
+    return false;
+  }
+  // 不知道 0 号页是不是 header page，两个位置都检查，多刷一次日志无害
+  return log_manager_->NeedFlush(page->GetLSN()) ||
+         (page->GetPageId() == HEADER_PAGE_ID && log_manager_->NeedFlush(static_cast<HeaderPage *>(page)->GetLSN()));
+}
+
+std::vector<page_id_t> BufferPoolManager::GetDirtyPages() {
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  std::vector<page_id_t> page_ids;
+  for (const auto &[page_id, frame_id] : page_table_) {
+    if (pages_[frame_id].IsDirty()) {
+      page_ids.push_back(page_id);
+    }
+  }
+  return page_ids;
+}
+
+bool BufferPoolManager::FlushDirtyPage(page_id_t page_id) {
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  auto p = page_table_.find(page_id);
+  if (p == page_table_.end() || !pages_[p->second].IsDirty()) {
+    return false;
+  }
+  // pin 住再放开 latch_，与修改页的线程一样先拿页的锁再拿 latch_
+  auto page = &pages_[p->second];
+  replacer_->Pin(p->second);
+  page->pin_count_++;
+  lock.unlock();
+  page->RLatch();
+  // 写日志
+  if (NeedFlushLog(page)) {
+    log_manager_->Flush(true);
+  }
+  lock.lock();
+  disk_manager_->WritePage(page_id, page->GetData());
+  page->is_dirty_ = false;
+  lock.unlock();
+  page->RUnlatch();
+  UnpinPageImpl(page_id, false);
+  return true;
+}
+
+bool BufferPoolManager::PrefetchPage(page_id_t page_id) {
+  Page *page = FetchPageImpl(page_id);
+  if (page == nullptr) {
+    return false;
+  }
+  // 只需让页留在缓冲池中，不持有 pin
+  UnpinPageImpl(page_id, false);
+  return true;
+}
+
+void BufferPoolManager::CopyPage(page_id_t page_id, char *data) {
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  auto p = page_table_.find(page_id);
+  if (p == page_table_.end()) {
+    // 不在缓冲池中，磁盘上的就是最新版本，持有 latch_ 时它不会被换入修改
+    memset(data, 0, PAGE_SIZE);
+    disk_manager_->ReadPage(page_id, data);
+    return;
+  }
+  // pin 住再放开 latch_，等待页的读锁时不能挡住其它线程使用缓冲池
+  auto page = &pages_[p->second];
+  replacer_->Pin(p->second);
+  page->pin_count_++;
+  lock.unlock();
+  page->RLatch();
+  memcpy(data, page->GetData(), PAGE_SIZE);
+  page->RUnlatch();
+  UnpinPageImpl(page_id, false);
+}
+
+void BufferPoolManager::SetLogRecovery(LogRecovery *log_recovery) {
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  log_recovery_ = log_recovery;
+}
+
+void BufferPoolManager::RedoPendingPages() {
+  LogRecovery *log_recovery;
+  {
+    auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+    log_recovery = log_recovery_;
+  }
+  // 重做通过 FetchPage，不能持有 latch_
+  if (log_recovery != nullptr) {
+    log_recovery->RedoPendingPages();
+  }
+}
+
+bool BufferPoolManager::HasPendingRedo() {
+  auto lock = ContentionStats::Lock(&latch_, ContentionSource::BUFFER_POOL_LATCH);
+  return log_recovery_ != nullptr && log_recovery_->GetPendingPageNum() > 0;
+}
+
 }  // namespace bustub
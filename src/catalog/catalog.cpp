@@ -0,0 +1,191 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// catalog.cpp
+//
+// Identification: src/catalog/catalog.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "catalog/catalog.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "recovery/log_manager.h"
+#include "storage/page/header_page.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+// 目录表的 oid，它不加锁
+constexpr table_oid_t CATALOG_TABLE_OID = std::numeric_limits<table_oid_t>::max();
+// 目录表每一行是一张表或一个索引
+constexpr int32_t CATALOG_KIND_TABLE = 0;
+constexpr int32_t CATALOG_KIND_INDEX = 1;
+
+/**
+ * | kind | oid | first_page_id | name | table_name | definition |
+ * definition lists the columns of a table (name and type of each) or the key attributes of an index,
+ * table_name is the table of an index
+ */
+const Schema &CatalogSchema() {
+  static const Schema schema{std::vector<Column>{
+      Column{"kind", TypeId::INTEGER}, Column{"oid", TypeId::INTEGER}, Column{"first_page_id", TypeId::INTEGER},
+      Column{"name", TypeId::VARCHAR, 32}, Column{"table_name", TypeId::VARCHAR, 32},
+      Column{"definition", TypeId::VARCHAR, 1024}}};
+  return schema;
+}
+}  // namespace
+
+void Catalog::Open(Transaction *txn) {
+  persistent_ = true;
+  if (catalog_heap_ == nullptr) {
+    auto *header_page = static_cast<HeaderPage *>(bpm_->FetchPage(HEADER_PAGE_ID));
+    page_id_t first_page_id;
+    bool found = header_page->GetRootId(CATALOG_NAME, &first_page_id);
+    bpm_->UnpinPage(HEADER_PAGE_ID, false);
+    if (!found) {
+      return;
+    }
+    catalog_heap_ = std::make_unique<TableHeap>(bpm_, nullptr, log_manager_, first_page_id, CATALOG_TABLE_OID);
+  }
+  const Schema &schema = CatalogSchema();
+  Transaction local_txn(INVALID_TXN_ID);
+  if (txn == nullptr) {
+    txn = &local_txn;
+  }
+  std::vector<Tuple> tables;
+  std::vector<Tuple> indexes;
+  for (auto it = catalog_heap_->Begin(txn); it != catalog_heap_->End(); it++) {
+    (it->GetValue(&schema, 0).GetAs<int32_t>() == CATALOG_KIND_TABLE ? tables : indexes).push_back(*it);
+  }
+  // 表先于它的索引加载
+  std::unordered_set<table_oid_t> table_oids;
+  for (auto &tuple : tables) {
+    auto oid = static_cast<table_oid_t>(tuple.GetValue(&schema, 1).GetAs<int32_t>());
+    table_oids.insert(oid);
+    if (tables_.count(oid) > 0) {
+      continue;
+    }
+    std::vector<Column> columns;
+    std::stringstream definition(tuple.GetValue(&schema, 5).ToString());
+    std::string column_name;
+    int type;
+    while (definition >> column_name >> type) {
+      // VARCHAR 的长度不影响存储
+      columns.push_back(static_cast<TypeId>(type) == TypeId::VARCHAR
+                            ? Column{column_name, TypeId::VARCHAR, uint32_t{0}}
+                            : Column{column_name, static_cast<TypeId>(type)});
+    }
+    page_id_t first_page_id = tuple.GetValue(&schema, 2).GetAs<int32_t>();
+    AddTable(tuple.GetValue(&schema, 3).ToString(), Schema{columns},
+             std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, first_page_id, oid), oid);
+  }
+  std::unordered_set<index_oid_t> index_oids;
+  for (auto &tuple : indexes) {
+    auto oid = static_cast<index_oid_t>(tuple.GetValue(&schema, 1).GetAs<int32_t>());
+    index_oids.insert(oid);
+    if (indexes_.count(oid) > 0) {
+      // 重做或重放可能换了根页
+      indexes_[oid]->index_->Open();
+      continue;
+    }
+    std::vector<uint32_t> key_attrs;
+    std::stringstream definition(tuple.GetValue(&schema, 5).ToString());
+    uint32_t key_attr;
+    while (definition >> key_attr) {
+      key_attrs.push_back(key_attr);
+    }
+    TableMetadata *table = GetTable(tuple.GetValue(&schema, 4).ToString());
+    std::unique_ptr<Schema> key_schema(Schema::CopySchema(&table->schema_, key_attrs));
+    AddIndex(txn, tuple.GetValue(&schema, 3).ToString(), table->name_, table->schema_, *key_schema, key_attrs, oid,
+             false);
+  }
+  // 恢复时撤销了的表和索引
+  for (auto it = indexes_.begin(); it != indexes_.end();) {
+    if (index_oids.count(it->first) > 0) {
+      it++;
+      continue;
+    }
+    index_names_[it->second->table_name_].erase(it->second->name_);
+    it = indexes_.erase(it);
+  }
+  for (auto it = tables_.begin(); it != tables_.end();) {
+    if (table_oids.count(it->first) > 0) {
+      it++;
+      continue;
+    }
+    names_.erase(it->second->name_);
+    it = tables_.erase(it);
+  }
+}
+
+void Catalog::RecordTable(Transaction *txn, TableMetadata *table) {
+  if (!persistent_) {
+    return;
+  }
+  std::stringstream definition;
+  for (const auto &column : table->schema_.GetColumns()) {
+    definition << column.GetName() << ' ' << static_cast<int>(column.GetType()) << ' ';
+  }
+  Record(txn, {ValueFactory::GetIntegerValue(CATALOG_KIND_TABLE), ValueFactory::GetIntegerValue(table->oid_),
+               ValueFactory::GetIntegerValue(table->table_->GetFirstPageId()),
+               ValueFactory::GetVarcharValue(table->name_), ValueFactory::GetVarcharValue(""),
+               ValueFactory::GetVarcharValue(definition.str())});
+}
+
+void Catalog::RecordIndex(Transaction *txn, IndexInfo *index) {
+  if (!persistent_) {
+    return;
+  }
+  std::stringstream definition;
+  for (uint32_t key_attr : index->index_->GetKeyAttrs()) {
+    definition << key_attr << ' ';
+  }
+  Record(txn, {ValueFactory::GetIntegerValue(CATALOG_KIND_INDEX), ValueFactory::GetIntegerValue(index->index_oid_),
+               ValueFactory::GetIntegerValue(INVALID_PAGE_ID), ValueFactory::GetVarcharValue(index->name_),
+               ValueFactory::GetVarcharValue(index->table_name_), ValueFactory::GetVarcharValue(definition.str())});
+}
+
+/*
+ * insert a row of the catalog heap in txn, the table or index is gone after a restart if txn doesn't commit
+ */
+void Catalog::Record(Transaction *txn, const std::vector<Value> &values) {
+  if (catalog_heap_ == nullptr) {
+    CreateCatalogHeap();
+  }
+  RID rid;
+  if (!catalog_heap_->InsertTuple(Tuple{values, &CatalogSchema()}, &rid, txn)) {
+    throw Exception(ExceptionType::INVALID, "catalog is full.");
+  }
+}
+
+/*
+ * create the catalog heap and record its first page in the header page, in a transaction with INVALID_TXN_ID
+ * that is never undone, the header page is logged like a root page change of an index
+ */
+void Catalog::CreateCatalogHeap() {
+  Transaction txn(INVALID_TXN_ID);
+  catalog_heap_ = std::make_unique<TableHeap>(bpm_, nullptr, log_manager_, &txn, CATALOG_TABLE_OID);
+  auto *header_page = static_cast<HeaderPage *>(bpm_->FetchPage(HEADER_PAGE_ID));
+  header_page->InsertRecord(CATALOG_NAME, catalog_heap_->GetFirstPageId());
+  if (enable_logging && log_manager_ != nullptr) {
+    int offset = header_page->GetRecordOffset(CATALOG_NAME);
+    std::string page_writes;
+    LogRecord::AddPageWrite(&page_writes, HEADER_PAGE_ID, offset, header_page->GetData() + offset, 36);
+    LogRecord::AddPageWrite(&page_writes, HEADER_PAGE_ID, 0, header_page->GetData(), sizeof(int));
+    LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, std::move(page_writes));
+    header_page->SetLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+  bpm_->UnpinPage(HEADER_PAGE_ID, true);
+}
+
+}  // namespace bustub
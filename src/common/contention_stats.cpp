@@ -0,0 +1,226 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// contention_stats.cpp
+//
+// Identification: src/common/contention_stats.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/contention_stats.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+
+namespace bustub {
+
+std::mutex ContentionStats::registry_latch;
+std::vector<ContentionStats::ThreadStats *> ContentionStats::live_threads;
+ContentionStats::ThreadStats ContentionStats::retired_threads;
+
+namespace {
+
+void Add(std::atomic<uint64_t> *counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Max(std::atomic<uint64_t> *counter, uint64_t value) {
+  if (value > counter->load(std::memory_order_relaxed)) {
+    counter->store(value, std::memory_order_relaxed);
+  }
+}
+
+size_t HistogramBucket(int64_t wait_ns) {
+  auto us = static_cast<uint64_t>(std::max<int64_t>(wait_ns, 0)) / 1000;
+  size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  return std::min(bucket, ContentionStats::HISTOGRAM_BUCKET_NUM - 1);
+}
+
+}  // namespace
+
+ContentionStats::ThreadStats *ContentionStats::GetThreadStats() {
+  // 线程第一次计数时注册，退出时把计数并入 retired_threads
+  struct Holder {
+    Holder() : stats_(new ThreadStats) {
+      std::lock_guard<std::mutex> guard(registry_latch);
+      live_threads.push_back(stats_);
+    }
+    ~Holder() {
+      std::lock_guard<std::mutex> guard(registry_latch);
+      live_threads.erase(std::find(live_threads.begin(), live_threads.end(), stats_));
+      AddThreadStats(&retired_threads, *stats_);
+      delete stats_;
+    }
+    ThreadStats *stats_;
+  };
+  thread_local Holder holder;
+  return holder.stats_;
+}
+
+void ContentionStats::RecordWait(ContentionSource source, int64_t object_id, int64_t wait_ns) {
+  auto *stats = GetThreadStats();
+  auto &counters = stats->counters_[static_cast<size_t>(source)];
+  Add(&counters.waits_, 1);
+  Add(&counters.wait_ns_, wait_ns);
+  Add(&counters.histogram_[HistogramBucket(wait_ns)], 1);
+  Max(&counters.max_wait_ns_, wait_ns);
+  if (object_id != NO_OBJECT) {
+    std::lock_guard<std::mutex> guard(stats->hot_latch_);
+    AddHot(&stats->hot_[static_cast<size_t>(source)], object_id, HotCounter{1, static_cast<uint64_t>(wait_ns)});
+  }
+}
+
+void ContentionStats::AddHot(std::unordered_map<int64_t, HotCounter> *hot, int64_t object_id,
+                             const HotCounter &counter) {
+  auto it = hot->find(object_id);
+  if (it != hot->end()) {
+    it->second.waits_ += counter.waits_;
+    it->second.wait_ns_ += counter.wait_ns_;
+    return;
+  }
+  if (hot->size() >= MAX_HOT_OBJECTS) {
+    // 热点表满了，换掉等待时间最短的
+    auto coldest = std::min_element(hot->begin(), hot->end(), [](const auto &a, const auto &b) {
+      return a.second.wait_ns_ < b.second.wait_ns_;
+    });
+    if (coldest->second.wait_ns_ >= counter.wait_ns_) {
+      return;
+    }
+    hot->erase(coldest);
+  }
+  hot->emplace(object_id, counter);
+}
+
+void ContentionStats::AddThreadStats(ThreadStats *to, const ThreadStats &from) {
+  for (size_t i = 0; i < SOURCE_NUM; i++) {
+    auto &counters = from.counters_[i];
+    auto &total = to->counters_[i];
+    Add(&total.acquires_, counters.acquires_.load(std::memory_order_relaxed));
+    Add(&total.waits_, counters.waits_.load(std::memory_order_relaxed));
+    Add(&total.wait_ns_, counters.wait_ns_.load(std::memory_order_relaxed));
+    Max(&total.max_wait_ns_, counters.max_wait_ns_.load(std::memory_order_relaxed));
+    for (size_t j = 0; j < HISTOGRAM_BUCKET_NUM; j++) {
+      Add(&total.histogram_[j], counters.histogram_[j].load(std::memory_order_relaxed));
+    }
+    for (const auto &item : from.hot_[i]) {
+      AddHot(&to->hot_[i], item.first, item.second);
+    }
+  }
+}
+
+ContentionStats::Snapshot ContentionStats::Collect(size_t top_n) {
+  // 在副本上累加，不改动任何线程的计数
+  auto total = std::make_unique<ThreadStats>();
+  {
+    std::lock_guard<std::mutex> guard(registry_latch);
+    AddThreadStats(total.get(), retired_threads);
+    for (auto *stats : live_threads) {
+      std::lock_guard<std::mutex> hot_guard(stats->hot_latch_);
+      AddThreadStats(total.get(), *stats);
+    }
+  }
+  Snapshot snapshot;
+  for (size_t i = 0; i < SOURCE_NUM; i++) {
+    auto &counters = total->counters_[i];
+    auto &source = snapshot.sources_[i];
+    source.acquires_ = counters.acquires_;
+    source.waits_ = counters.waits_;
+    source.wait_ns_ = counters.wait_ns_;
+    source.max_wait_ns_ = counters.max_wait_ns_;
+    for (size_t j = 0; j < HISTOGRAM_BUCKET_NUM; j++) {
+      source.histogram_[j] = counters.histogram_[j];
+    }
+    auto &objects = snapshot.hot_objects_[i];
+    for (const auto &item : total->hot_[i]) {
+      objects.push_back(HotObject{item.first, item.second.waits_, item.second.wait_ns_});
+    }
+    auto middle = objects.begin() + std::min(top_n, objects.size());
+    std::partial_sort(objects.begin(), middle, objects.end(),
+                      [](const HotObject &a, const HotObject &b) { return a.wait_ns_ > b.wait_ns_; });
+    objects.erase(middle, objects.end());
+  }
+  return snapshot;
+}
+
+void ContentionStats::Reset() {
+  auto reset = [](ThreadStats *stats) {
+    for (auto &counters : stats->counters_) {
+      counters.acquires_ = 0;
+      counters.waits_ = 0;
+      counters.wait_ns_ = 0;
+      counters.max_wait_ns_ = 0;
+      for (auto &bucket : counters.histogram_) {
+        bucket = 0;
+      }
+    }
+    for (auto &hot : stats->hot_) {
+      hot.clear();
+    }
+  };
+  std::lock_guard<std::mutex> guard(registry_latch);
+  // 与线程自己计数并发，重置前后的几次计数可能丢失
+  reset(&retired_threads);
+  for (auto *stats : live_threads) {
+    std::lock_guard<std::mutex> hot_guard(stats->hot_latch_);
+    reset(stats);
+  }
+}
+
+const char *ContentionStats::SourceName(ContentionSource source) {
+  switch (source) {
+    case ContentionSource::LOCK_MANAGER:
+      return "lock_manager";
+    case ContentionSource::PAGE_LATCH:
+      return "page_latch";
+    case ContentionSource::BUFFER_POOL_LATCH:
+      return "buffer_pool_latch";
+    case ContentionSource::LOG_MANAGER_LATCH:
+      return "log_manager_latch";
+  }
+  return "";
+}
+
+std::string ContentionStats::Snapshot::ToString() const {
+  std::stringstream ss;
+  for (size_t i = 0; i < SOURCE_NUM; i++) {
+    auto source = static_cast<ContentionSource>(i);
+    const auto &stats = sources_[i];
+    ss << SourceName(source) << " acquires: " << stats.acquires_ << ", waits: " << stats.waits_
+       << ", wait_us: " << stats.wait_ns_ / 1000 << ", max_wait_us: " << stats.max_wait_ns_ / 1000
+       << ", wait_histogram_us:";
+    for (size_t j = 0; j < HISTOGRAM_BUCKET_NUM; j++) {
+      if (stats.histogram_[j] == 0) {
+        continue;
+      }
+      if (j + 1 < HISTOGRAM_BUCKET_NUM) {
+        ss << " <" << (1ULL << j) << ": " << stats.histogram_[j];
+      } else {
+        ss << " >=" << (1ULL << (j - 1)) << ": " << stats.histogram_[j];
+      }
+    }
+    ss << "\n";
+    for (const auto &object : hot_objects_[i]) {
+      ss << "  ";
+      if (source == ContentionSource::LOCK_MANAGER) {
+        // RID::Get 的高 32 位是页号，表锁的页号是 INVALID_PAGE_ID，槽号是表的 oid
+        auto page_id = static_cast<int32_t>(object.object_id_ >> 32);
+        auto slot_num = static_cast<uint32_t>(object.object_id_);
+        if (page_id == -1) {
+          ss << "table " << slot_num;
+        } else {
+          ss << "rid " << page_id << ":" << slot_num;
+        }
+      } else {
+        ss << "page " << object.object_id_;
+      }
+      ss << " waits: " << object.waits_ << ", wait_us: " << object.wait_ns_ / 1000 << "\n";
+    }
+  }
+  return ss.str();
+}
+
+}  // namespace bustub
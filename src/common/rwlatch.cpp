@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// rwlatch.cpp
+//
+// Identification: src/common/rwlatch.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/rwlatch.h"
+
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+std::array<ReaderWriterLatch::ReaderRow, ReaderWriterLatch::READER_ROW_NUM> ReaderWriterLatch::visible_readers{};
+
+namespace {
+
+std::array<std::atomic<bool>, ReaderWriterLatch::READER_ROW_NUM> row_taken{};
+
+// 线程第一次读时占一行，退出时归还
+struct ThreadRow {
+  ThreadRow() {
+    for (size_t i = 0; i < row_taken.size(); i++) {
+      bool expected = false;
+      if (row_taken[i].compare_exchange_strong(expected, true)) {
+        index_ = static_cast<int>(i);
+        return;
+      }
+    }
+  }
+  ~ThreadRow() {
+    if (index_ >= 0) {
+      row_taken[index_].store(false);
+    }
+  }
+  int index_{-1};
+};
+
+}  // namespace
+
+ReaderWriterLatch::~ReaderWriterLatch() {
+  std::lock_guard<mutex_t> guard(mutex_);
+  // 没释放的读锁不能留在读者表里，否则之后在同一地址构造的 latch 永远拿不到写锁
+  for (auto &row : visible_readers) {
+    for (auto &slot : row.slots_) {
+      ReaderWriterLatch *expected = this;
+      slot.compare_exchange_strong(expected, nullptr);
+    }
+  }
+}
+
+ReaderWriterLatch::slot_t *ReaderWriterLatch::GetThreadReaderRow() {
+  thread_local ThreadRow row;
+  return row.index_ < 0 ? nullptr : visible_readers[row.index_].slots_.data();
+}
+
+void ReaderWriterLatch::RevokeBias() {
+  read_bias_.store(false);
+  int64_t start = Now();
+  for (auto &row : visible_readers) {
+    for (auto &slot : row.slots_) {
+      for (int i = 0; slot.load() == this; i++) {
+        if (i >= SPIN_COUNT) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+  // 撤销代价越大，越晚恢复偏向
+  int64_t now = Now();
+  inhibit_until_.store(now + (now - start) * INHIBIT_MULTIPLIER, std::memory_order_relaxed);
+}
+
+bool ReaderWriterLatch::TryRevokeBias() {
+  read_bias_.store(false);
+  for (auto &row : visible_readers) {
+    for (auto &slot : row.slots_) {
+      if (slot.load() == this) {
+        // 还有读者，恢复偏向，否则下一个写者看到偏向已撤销就不会等它们
+        read_bias_.store(true);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ReaderWriterLatch::ReleaseVisibleReader() {
+  for (auto &row : visible_readers) {
+    for (auto &slot : row.slots_) {
+      ReaderWriterLatch *expected = this;
+      if (slot.compare_exchange_strong(expected, nullptr)) {
+        return;
+      }
+    }
+  }
+  BUSTUB_ASSERT(false, "Read latch released without being held");
+}
+
+}  // namespace bustub
@@ -11,11 +11,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "concurrency/lock_manager.h"
+#include "common/contention_stats.h"
 #include "concurrency/transaction_manager.h"
 
 namespace bustub {
 
-bool LockManager::LockShared(Transaction *txn, const RID &rid) {
+bool LockManager::LockShared(Transaction *txn, const RID &rid, table_oid_t oid) {
   // 事务共享锁加入 rid
   // Transaction txn tries to take a shared lock on record id rid.
   // This should be blocked on waiting and should return true when granted.
@@ -35,35 +36,36 @@ bool LockManager::LockShared(Transaction *txn, const RID &rid) {
   if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
     return true;
   }
-  // latch_ 用来保护 lock_table
-  // lock_table 中保存了 rid 对应的锁队列
-  std::unique_lock<std::mutex> latch(latch_);
-  auto &lock_request_queue = lock_table_[rid];
-  latch.unlock();  // 解锁
-
-  // 操作 rid 对应的队列，对队列加锁
-  std::unique_lock<std::mutex> queue_latch(lock_request_queue.latch_);
+  // 表锁已经覆盖，或者行锁升级成了表锁
+  if (oid != INVALID_TABLE_OID && (txn->IsTableSharedLocked(oid) || TryEscalate(txn, oid, false))) {
+    return true;
+  }
+  // 分片的 latch_ 保护 lock_table 以及 rid 对应的锁队列
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto &lock_request_queue = shard->lock_table_[rid];
   // 将事务id和加锁模式加入到队列
-  auto &lock_request =
-      lock_request_queue.request_queue_.emplace_back(txn->GetTransactionId(), LockManager::LockMode::SHARED);
-
-  // 加入后等待
-  lock_request_queue.cv_.wait(queue_latch, [&lock_request_queue, &lock_request, &txn] {
-    // 如果事务 abort，或者当前锁请求与队列中的其它锁兼容，比如都是共享锁，那么直接停止等待，继续执行
-    return LockManager::IsLockCompatible(lock_request_queue, lock_request) ||
-           txn->GetState() == TransactionState::ABORTED;
-  });
-  // abort，直接返回
+  auto lock_rq = lock_request_queue.request_queue_.emplace(lock_request_queue.request_queue_.end(),
+                                                           txn, LockMode::SHARED);
+
+  // 加入后等待，如果事务 abort，或者当前锁请求与队列中的其它锁兼容，比如都是共享锁，那么直接停止等待，继续执行
+  WaitForLock(txn, rid, &latch, &lock_request_queue, *lock_rq);
+  // abort，撤回请求后直接返回
   if (txn->GetState() == TransactionState::ABORTED) {
+    RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
     AbortImplicitly(txn, AbortReason::DEADLOCK);
   }
-  // 授予锁
-  lock_request.granted_ = true;
+  // 授予锁，后面等待的共享锁可能只是在等它被授予
+  lock_rq->granted_ = true;
+  NotifyWaiters(&lock_request_queue);
   txn->GetSharedLockSet()->emplace(rid);
+  if (oid != INVALID_TABLE_OID) {
+    (*txn->GetTableRowLockSet())[oid].emplace(rid);
+  }
   return true;
 }
 
-bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
+bool LockManager::LockExclusive(Transaction *txn, const RID &rid, table_oid_t oid) {
   // 事务独占锁加入 rid
   // shrinking A transaction may release locks, but may not obtain any new locks.
   // 因为 shrinking 状态下，事务不能再加锁
@@ -75,29 +77,31 @@ bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
   if (txn->IsExclusiveLocked(rid)) {
     return true;
   }
-  std::unique_lock<std::mutex> latch(latch_);
-  auto &lock_request_queue = lock_table_[rid];
-  latch.unlock();
-
-  std::unique_lock<std::mutex> queue_latch(lock_request_queue.latch_);
-  auto &lock_request =
-      lock_request_queue.request_queue_.emplace_back(txn->GetTransactionId(), LockManager::LockMode::EXCLUSIVE);
+  if (oid != INVALID_TABLE_OID && (txn->IsTableExclusiveLocked(oid) || TryEscalate(txn, oid, true))) {
+    return true;
+  }
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto &lock_request_queue = shard->lock_table_[rid];
+  auto lock_rq = lock_request_queue.request_queue_.emplace(lock_request_queue.request_queue_.end(),
+                                                           txn, LockMode::EXCLUSIVE);
   // 在此处等待，直到 lock 被兼容，或者 abort
-  lock_request_queue.cv_.wait(queue_latch, [&lock_request_queue, &lock_request, &txn] {
-    return LockManager::IsLockCompatible(lock_request_queue, lock_request) ||
-           txn->GetState() == TransactionState::ABORTED;
-  });
-  // 如果 abort，直接返回
+  WaitForLock(txn, rid, &latch, &lock_request_queue, *lock_rq);
+  // 如果 abort，撤回请求后直接返回
   if (txn->GetState() == TransactionState::ABORTED) {
+    RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
     AbortImplicitly(txn, AbortReason::DEADLOCK);
     return false;
   }
-  lock_request.granted_ = true;
+  lock_rq->granted_ = true;
   txn->GetExclusiveLockSet()->emplace(rid);
+  if (oid != INVALID_TABLE_OID) {
+    (*txn->GetTableRowLockSet())[oid].emplace(rid);
+  }
   return true;
 }
 
-bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+bool LockManager::LockUpgrade(Transaction *txn, const RID &rid, table_oid_t oid) {
   // 锁升级，就是将 rid 从共享锁中删除，然后加入独占锁
   // 因为 shrinking 状态下，事务不能再加锁
   if (txn->GetState() == TransactionState::SHRINKING) {
@@ -108,12 +112,13 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
   if (txn->IsExclusiveLocked(rid)) {
     return true;
   }
+  if (oid != INVALID_TABLE_OID && (txn->IsTableExclusiveLocked(oid) || TryEscalate(txn, oid, true))) {
+    return true;
+  }
 
-  std::unique_lock<std::mutex> latch(latch_);
-  auto &lock_request_queue = lock_table_[rid];
-  latch.unlock();
-
-  std::unique_lock<std::mutex> queue_latch(lock_request_queue.latch_);
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto &lock_request_queue = shard->lock_table_[rid];
   // 正在处于升级，就不用再升了吧
   if (lock_request_queue.upgrading_) {
     AbortImplicitly(txn, AbortReason::UPGRADE_CONFLICT);
@@ -130,21 +135,23 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
   // 没有 grant，直接报错
   BUSTUB_ASSERT(lock_rq->granted_, "Lock request has not be granted");
   // 处于 shared 状态下才能升级，否则报错
-  BUSTUB_ASSERT(lock_rq->lock_mode_ == LockManager::LockMode::SHARED, "Lock request is not locked in SHARED mode");
+  BUSTUB_ASSERT(lock_rq->lock_mode_ == LockMode::SHARED, "Lock request is not locked in SHARED mode");
   // 如果不在 shared 状态，那么报错
   BUSTUB_ASSERT(txn->IsSharedLocked(rid), "Rid is not shared locked by transaction when upgrade");
   // 如果处在 exclusive，那么报错
   BUSTUB_ASSERT(!txn->IsExclusiveLocked(rid), "Rid is currently exclusive locked by transaction when upgrade");
   // 升级为独占锁
-  lock_rq->lock_mode_ = LockManager::LockMode::EXCLUSIVE;
+  lock_rq->lock_mode_ = LockMode::EXCLUSIVE;
   lock_rq->granted_ = false;  // 暂时还没有 grant
 
   // 等待兼容或者 abort，在队列中等待，一个 RID 有一个等待队列
-  lock_request_queue.cv_.wait(queue_latch, [&lock_request_queue, &lock_req = *lock_rq, &txn] {
-    return LockManager::IsLockCompatible(lock_request_queue, lock_req) || txn->GetState() == TransactionState::ABORTED;
-  });
-  // 如果 abort
+  WaitForLock(txn, rid, &latch, &lock_request_queue, *lock_rq);
+  // 如果 abort，退回共享锁，由事务的 Abort 释放
   if (txn->GetState() == TransactionState::ABORTED) {
+    lock_rq->lock_mode_ = LockMode::SHARED;
+    lock_rq->granted_ = true;
+    lock_request_queue.upgrading_ = false;
+    lock_request_queue.cv_.notify_all();
     AbortImplicitly(txn, AbortReason::DEADLOCK);
     return false;
   }
@@ -154,40 +161,405 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
 
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->emplace(rid);
+  if (oid != INVALID_TABLE_OID) {
+    (*txn->GetTableRowLockSet())[oid].emplace(rid);
+  }
   return true;
 }
 
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
-  // 从共享锁和独占锁中清除 rid
-  std::unique_lock<std::mutex> latch(latch_);
-  auto &lock_request_queue = lock_table_[rid];
-  latch.unlock();
-
-  std::unique_lock<std::mutex> queue_latch(lock_request_queue.latch_);
   // 如果是可重复读级别，且当前事务状态为 GROWING，那么设置为 SHRINKING
   if (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ && txn->GetState() == TransactionState::GROWING) {
     txn->SetState(TransactionState::SHRINKING);
   }
+  // 从共享锁和独占锁中清除 rid
+  ReleaseRowLock(txn, rid);
+  // 从所在表的行锁计数中清除，事务锁住的表不多
+  auto row_lock_set = txn->GetTableRowLockSet();
+  for (auto it = row_lock_set->begin(); it != row_lock_set->end();) {
+    it->second.erase(rid);
+    it = it->second.empty() ? row_lock_set->erase(it) : std::next(it);
+  }
+  return true;
+}
+
+bool LockManager::LockTable(Transaction *txn, table_oid_t oid, LockMode mode) {
+  bool read_only = mode == LockMode::SHARED || mode == LockMode::INTENTION_SHARED;
+  // 读未提交不加读锁
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && mode != LockMode::EXCLUSIVE &&
+      mode != LockMode::INTENTION_EXCLUSIVE) {
+    AbortImplicitly(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+    return false;
+  }
+  // 与行锁相同，shrinking 状态下不能再加写锁，可重复读也不能再加读锁
+  if (txn->GetState() == TransactionState::SHRINKING &&
+      (!read_only || txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ)) {
+    AbortImplicitly(txn, AbortReason::LOCK_ON_SHRINKING);
+    return false;
+  }
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held_it = table_lock_set->find(oid);
+  bool upgrade = held_it != table_lock_set->end();
+  LockMode held_mode = upgrade ? held_it->second : mode;
+  LockMode target_mode = CombineLockModes(held_mode, mode);
+  // 已经持有的锁覆盖了 mode
+  if (upgrade && target_mode == held_mode) {
+    return true;
+  }
+
+  RID rid = TableRID(oid);
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto &lock_request_queue = shard->lock_table_[rid];
+  if (upgrade) {
+    if (lock_request_queue.upgrading_) {
+      AbortImplicitly(txn, AbortReason::UPGRADE_CONFLICT);
+      return false;
+    }
+    lock_request_queue.upgrading_ = true;
+  }
+  auto lock_rq = QueueTableRequest(&lock_request_queue, txn, upgrade, target_mode);
+
+  WaitForLock(txn, rid, &latch, &lock_request_queue, *lock_rq);
+  if (upgrade) {
+    lock_request_queue.upgrading_ = false;
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    if (upgrade) {
+      // 退回原来的锁，由事务的 Abort 释放
+      lock_rq->lock_mode_ = held_mode;
+      lock_rq->granted_ = true;
+      lock_request_queue.cv_.notify_all();
+    } else {
+      RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
+    }
+    AbortImplicitly(txn, AbortReason::DEADLOCK);
+    return false;
+  }
+  lock_rq->granted_ = true;
+  NotifyWaiters(&lock_request_queue);
+  (*table_lock_set)[oid] = target_mode;
+  return true;
+}
+
+std::list<LockManager::LockRequest>::iterator LockManager::QueueTableRequest(LockRequestQueue *lock_request_queue,
+                                                                            Transaction *txn, bool upgrade,
+                                                                            LockMode target_mode) {
+  auto &request_queue = lock_request_queue->request_queue_;
+  if (!upgrade) {
+    return request_queue.emplace(request_queue.end(), txn, target_mode);
+  }
+  auto lock_rq = std::find_if(request_queue.begin(), request_queue.end(), [&txn](const LockRequest &lock_req) {
+    return txn->GetTransactionId() == lock_req.txn_id_;
+  });
+  BUSTUB_ASSERT(lock_rq != request_queue.end(), "Cannot find lock request when upgrade lock");
+  // 升级优先于等待中的请求，移到第一个未授予的请求之前
+  auto first_waiting = std::find_if(request_queue.begin(), request_queue.end(),
+                                    [](const LockRequest &lock_req) { return !lock_req.granted_; });
+  request_queue.splice(first_waiting, request_queue, lock_rq);
+  lock_rq->lock_mode_ = target_mode;
+  lock_rq->granted_ = false;
+  return lock_rq;
+}
+
+bool LockManager::TryLockTable(Transaction *txn, table_oid_t oid, LockMode mode) {
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held_it = table_lock_set->find(oid);
+  bool upgrade = held_it != table_lock_set->end();
+  LockMode held_mode = upgrade ? held_it->second : mode;
+  LockMode target_mode = CombineLockModes(held_mode, mode);
+  if (upgrade && target_mode == held_mode) {
+    return true;
+  }
+
+  RID rid = TableRID(oid);
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto &lock_request_queue = shard->lock_table_[rid];
+  if (upgrade && lock_request_queue.upgrading_) {
+    return false;
+  }
+  // 持有分片锁期间入队再检查，不能立即授予就撤回，其它事务看不到这个请求
+  auto lock_rq = QueueTableRequest(&lock_request_queue, txn, upgrade, target_mode);
+  if (!IsLockCompatible(lock_request_queue, *lock_rq)) {
+    if (upgrade) {
+      lock_rq->lock_mode_ = held_mode;
+      lock_rq->granted_ = true;
+    } else {
+      RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
+    }
+    return false;
+  }
+  lock_rq->granted_ = true;
+  // 升级后的锁可能阻塞排在后面的请求
+  if (upgrade && deadlock_mode_ == DeadlockMode::DETECTION) {
+    std::lock_guard<std::mutex> graph_latch(latch_);
+    UpdateWaitsFor(lock_request_queue);
+  }
+  (*table_lock_set)[oid] = target_mode;
+  return true;
+}
+
+bool LockManager::TryEscalate(Transaction *txn, table_oid_t oid, bool exclusive) {
+  size_t threshold = escalation_threshold_;
+  auto row_lock_set = txn->GetTableRowLockSet();
+  auto rows_it = row_lock_set->find(oid);
+  // 每多锁 threshold 行尝试一次，表锁冲突时不会每锁一行都去抢表锁
+  if (threshold == 0 || rows_it == row_lock_set->end() || rows_it->second.size() < threshold ||
+      rows_it->second.size() % threshold != 0) {
+    return false;
+  }
+  // 表锁要覆盖所有持有的行锁
+  bool has_exclusive = exclusive || std::any_of(rows_it->second.begin(), rows_it->second.end(),
+                                                [&txn](const RID &rid) { return txn->IsExclusiveLocked(rid); });
+  if (!TryLockTable(txn, oid, has_exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED)) {
+    return false;
+  }
+  for (const auto &rid : rows_it->second) {
+    ReleaseRowLock(txn, rid);
+  }
+  row_lock_set->erase(rows_it);
+  escalation_num_++;
+  return true;
+}
+
+void LockManager::ReleaseRowLock(Transaction *txn, const RID &rid) {
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto queue_it = shard->lock_table_.find(rid);
+  // 没有找到直接报错
+  BUSTUB_ASSERT(queue_it != shard->lock_table_.end(), "Cannot find lock request queue when unlock");
+  auto &lock_request_queue = queue_it->second;
   // 找到队列中的事务
   auto lock_rq = std::find_if(
       lock_request_queue.request_queue_.begin(), lock_request_queue.request_queue_.end(),
       [&txn](const LockManager::LockRequest &lock_req) { return txn->GetTransactionId() == lock_req.txn_id_; });
   // 没有找到直接报错
   BUSTUB_ASSERT(lock_rq != lock_request_queue.request_queue_.end(), "Cannot find lock request when unlock");
+  RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
+
+  txn->GetSharedLockSet()->erase(rid);
+  txn->GetExclusiveLockSet()->erase(rid);
+}
+
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  RID rid = TableRID(oid);
+  auto *shard = GetShard(rid);
+  std::unique_lock<std::mutex> latch(shard->latch_);
+  auto queue_it = shard->lock_table_.find(rid);
+  BUSTUB_ASSERT(queue_it != shard->lock_table_.end(), "Cannot find lock request queue when unlock table");
+  auto &lock_request_queue = queue_it->second;
+  if (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ && txn->GetState() == TransactionState::GROWING) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  auto lock_rq = std::find_if(
+      lock_request_queue.request_queue_.begin(), lock_request_queue.request_queue_.end(),
+      [&txn](const LockManager::LockRequest &lock_req) { return txn->GetTransactionId() == lock_req.txn_id_; });
+  BUSTUB_ASSERT(lock_rq != lock_request_queue.request_queue_.end(), "Cannot find lock request when unlock table");
+  RemoveRequest(shard, rid, &lock_request_queue, lock_rq);
+  txn->GetTableLockSet()->erase(oid);
+  return true;
+}
+
+/*
+ * IS IX S SIX X 对应的位：
+ * 1 读部分行，2 写部分行，4 读所有行，8 写所有行
+ */
+static int LockModeBits(LockMode mode) {
+  switch (mode) {
+    case LockMode::INTENTION_SHARED:
+      return 1;
+    case LockMode::INTENTION_EXCLUSIVE:
+      return 1 | 2;
+    case LockMode::SHARED:
+      return 1 | 4;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return 1 | 2 | 4;
+    case LockMode::EXCLUSIVE:
+      return 1 | 2 | 4 | 8;
+  }
+  return 0;
+}
+
+bool LockManager::AreLocksCompatible(LockMode a, LockMode b) {
+  int a_bits = LockModeBits(a);
+  int b_bits = LockModeBits(b);
+  // 写所有行与一切冲突；写部分行与读所有行冲突；意向锁之间不冲突
+  if (((a_bits | b_bits) & 8) != 0) {
+    return false;
+  }
+  return ((a_bits & 2) == 0 || (b_bits & 4) == 0) && ((b_bits & 2) == 0 || (a_bits & 4) == 0);
+}
 
+LockMode LockManager::CombineLockModes(LockMode a, LockMode b) {
+  int bits = LockModeBits(a) | LockModeBits(b);
+  if ((bits & 8) != 0) {
+    return LockMode::EXCLUSIVE;
+  }
+  if ((bits & 4) != 0) {
+    return (bits & 2) != 0 ? LockMode::SHARED_INTENTION_EXCLUSIVE : LockMode::SHARED;
+  }
+  return (bits & 2) != 0 ? LockMode::INTENTION_EXCLUSIVE : LockMode::INTENTION_SHARED;
+}
+
+void LockManager::RemoveRequest(LockTableShard *shard, const RID &rid, LockRequestQueue *lock_request_queue,
+                                std::list<LockRequest>::iterator lock_rq) {
   // 从队列中删除 lock_rq
-  auto following_it = lock_request_queue.request_queue_.erase(lock_rq);
+  lock_request_queue->request_queue_.erase(lock_rq);
+  // 队列空了说明没有事务在等待，回收队列
+  if (lock_request_queue->request_queue_.empty()) {
+    shard->lock_table_.erase(rid);
+    return;
+  }
+  if (deadlock_mode_ == DeadlockMode::DETECTION) {
+    std::lock_guard<std::mutex> graph_latch(latch_);
+    UpdateWaitsFor(*lock_request_queue);
+  }
 
   // 通知其它在队列中等待的事务
-  // 如果删除成功，且 granted 为 false，且与队列中其它锁兼容，那么通知其它队列抢锁
-  if (following_it != lock_request_queue.request_queue_.end() && !following_it->granted_ &&
-      LockManager::IsLockCompatible(lock_request_queue, *following_it)) {
-    lock_request_queue.cv_.notify_all();
+  NotifyWaiters(lock_request_queue);
+}
+
+void LockManager::NotifyWaiters(LockRequestQueue *lock_request_queue) {
+  // 如果有未授予的请求与队列中其它锁兼容，那么通知其它队列抢锁；升级中的请求可能排在已授予的请求前面
+  for (auto it = lock_request_queue->request_queue_.begin(); it != lock_request_queue->request_queue_.end(); ++it) {
+    if (!it->granted_ && LockManager::IsLockCompatible(*lock_request_queue, *it)) {
+      lock_request_queue->cv_.notify_all();
+      break;
+    }
   }
+}
 
-  txn->GetSharedLockSet()->erase(rid);
-  txn->GetExclusiveLockSet()->erase(rid);
-  return true;
+void LockManager::WaitForLock(Transaction *txn, const RID &rid, std::unique_lock<std::mutex> *latch,
+                              LockRequestQueue *lock_request_queue, const LockRequest &lock_request) {
+  ContentionStats::RecordAcquire(ContentionSource::LOCK_MANAGER);
+  if (LockManager::IsLockCompatible(*lock_request_queue, lock_request)) {
+    return;
+  }
+  int64_t start = ContentionStats::Now();
+  txn_id_t txn_id = txn->GetTransactionId();
+  // 登记等待的 RID，被中止时据此唤醒
+  {
+    std::lock_guard<std::mutex> graph_latch(latch_);
+    waiting_[txn_id] = WaitingTxn{txn, rid};
+  }
+  while (txn->GetState() != TransactionState::ABORTED &&
+         !LockManager::IsLockCompatible(*lock_request_queue, lock_request)) {
+    std::vector<txn_id_t> victims;
+    if (deadlock_mode_ == DeadlockMode::DETECTION) {
+      // 阻塞时加入等待边，只从自己出发找环，代价与持有的锁数无关
+      std::lock_guard<std::mutex> graph_latch(latch_);
+      UpdateWaitsFor(*lock_request_queue);
+      txn_id_t victim_id;
+      if (FindCycleFrom(txn_id, &victim_id) && waiting_.count(victim_id) != 0) {
+        waiting_[victim_id].txn_->SetState(TransactionState::ABORTED);
+        waits_for_.erase(victim_id);
+        if (victim_id != txn_id) {
+          victims.push_back(victim_id);
+        }
+      }
+    } else if (PreventDeadlock(*lock_request_queue, lock_request, &victims)) {
+      // 队列可能在等待期间改变，比如前面的共享锁开始升级，每次被阻塞都要重新判断
+      txn->SetState(TransactionState::ABORTED);
+    }
+    if (txn->GetState() == TransactionState::ABORTED) {
+      break;
+    }
+    if (victims.empty()) {
+      lock_request_queue->cv_.wait(*latch);
+      continue;
+    }
+    // 唤醒被中止的事务要获取其它分片的锁，先释放本分片的锁；请求还在队列中，队列不会被回收
+    latch->unlock();
+    for (auto victim_id : victims) {
+      WakeUp(victim_id);
+    }
+    latch->lock();
+  }
+  ContentionStats::RecordWait(ContentionSource::LOCK_MANAGER, rid.Get(), ContentionStats::Now() - start);
+  std::lock_guard<std::mutex> graph_latch(latch_);
+  waiting_.erase(txn_id);
+  waits_for_.erase(txn_id);
+}
+
+std::vector<Transaction *> LockManager::GetBlockers(const LockRequestQueue &lock_request_queue,
+                                                    const LockRequest &lock_request) {
+  // 阻塞 lock_request 的请求：排在前面的未授予请求，以及不兼容的请求（升级时包括排在后面的已授予请求）
+  std::vector<Transaction *> blockers;
+  bool before = true;
+  for (const auto &request : lock_request_queue.request_queue_) {
+    if (request.txn_id_ == lock_request.txn_id_) {
+      before = false;
+      continue;
+    }
+    bool incompatible = !AreLocksCompatible(request.lock_mode_, lock_request.lock_mode_);
+    bool blocking = before ? (!request.granted_ || incompatible) : (request.granted_ && incompatible);
+    // 已经结束的事务马上会释放锁
+    auto state = request.txn_->GetState();
+    if (blocking && state != TransactionState::ABORTED && state != TransactionState::COMMITTED) {
+      blockers.push_back(request.txn_);
+    }
+  }
+  return blockers;
+}
+
+void LockManager::UpdateWaitsFor(const LockRequestQueue &lock_request_queue) {
+  // 一个事务同一时间只在一个队列中等待，它的出边全部来自这个队列
+  for (const auto &request : lock_request_queue.request_queue_) {
+    if (request.granted_ || waiting_.count(request.txn_id_) == 0) {
+      continue;
+    }
+    auto &edges = waits_for_[request.txn_id_];
+    edges.clear();
+    for (auto *blocker : GetBlockers(lock_request_queue, request)) {
+      edges.push_back(blocker->GetTransactionId());
+    }
+    std::sort(edges.begin(), edges.end());
+  }
+}
+
+bool LockManager::FindCycleFrom(txn_id_t txn_id, txn_id_t *victim) {
+  std::stack<txn_id_t> stack;
+  std::unordered_map<txn_id_t, LockManager::VisitedType> visited;
+  stack.push(txn_id);
+  visited.emplace(txn_id, LockManager::VisitedType::IN_STACK);
+  return ProcessDFSTree(victim, &stack, &visited);
+}
+
+bool LockManager::PreventDeadlock(const LockRequestQueue &lock_request_queue, const LockRequest &lock_request,
+                                  std::vector<txn_id_t> *wounded) {
+  for (auto *blocker : GetBlockers(lock_request_queue, lock_request)) {
+    if (blocker->GetTransactionId() < lock_request.txn_id_) {
+      // 更老的事务：wait-die 中年轻的事务死亡，wound-wait 中年轻的事务等待
+      if (deadlock_mode_ == DeadlockMode::WAIT_DIE) {
+        return true;
+      }
+    } else if (deadlock_mode_ == DeadlockMode::WOUND_WAIT) {
+      // 更年轻的事务：wound-wait 中伤害它，wait-die 中老的事务等待；它可能正在提交，已提交的不再中止
+      if (blocker->Wound()) {
+        wounded->push_back(blocker->GetTransactionId());
+      }
+    }
+  }
+  return false;
+}
+
+void LockManager::WakeUp(txn_id_t txn_id) {
+  RID rid;
+  {
+    std::lock_guard<std::mutex> graph_latch(latch_);
+    auto it = waiting_.find(txn_id);
+    if (it == waiting_.end()) {
+      return;  // 没有在等待，下次等锁时发现自己已中止
+    }
+    rid = it->second.rid_;
+  }
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> shard_latch(shard->latch_);
+  auto queue_it = shard->lock_table_.find(rid);
+  if (queue_it != shard->lock_table_.end()) {
+    queue_it->second.cv_.notify_all();
+  }
 }
 
 void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
@@ -244,6 +616,7 @@ std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
   // Returns a list of tuples representing the edges in your graph. We will use this to test correctness of your graph.
   // A pair (t1,t2) corresponds to an edge from t1 to t2.
   // 获取所有的边，直接遍历并且 make_pair
+  std::lock_guard<std::mutex> graph_latch(latch_);
   std::vector<std::pair<txn_id_t, txn_id_t>> ret{};
   for (const auto &[txn_id, txn_id_v] : waits_for_) {
     // 将 txn_id_v 列表中的 txn 与 txn_id 一一组合，然后推入 ret 中
@@ -254,42 +627,31 @@ std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
 }
 
 void LockManager::RunCycleDetection() {
-  // 检查是否存在死锁
-  // You should not be maintaining a graph, it should be built and destroyed every time the thread wakes up.
+  // 等待图随加锁、授予和中止增量维护，这里只在图上找环，不扫描锁表
   while (enable_cycle_detection_) {
-    std::this_thread::sleep_for(cycle_detection_interval);
+    std::vector<txn_id_t> victims;
     {
       std::unique_lock<std::mutex> latch(latch_);
+      detection_cv_.wait_for(latch, cycle_detection_interval, [this] { return !enable_cycle_detection_; });
       if (!enable_cycle_detection_) {
         break;
       }
-
-      waits_for_.clear();
-      BuildWaitsForGraph();
-
       txn_id_t txn_id;
       while (HasCycle(&txn_id)) {
-        // 得到死锁的 txn_id
-        auto txn = TransactionManager::GetTransaction(txn_id);
-        txn->SetState(TransactionState::ABORTED);  // abort
-        // 清除 txn_id 上的锁
-        // 得到 txn_id 上所有的边
-        for (const auto &wait_on_txn_id : waits_for_[txn_id]) {
-          auto wait_on_txn = TransactionManager::GetTransaction(wait_on_txn_id);
-          // 得到事务上的所有 share、exclusive 的 RID
-          std::unordered_set<RID> lock_set;
-          lock_set.insert(wait_on_txn->GetSharedLockSet()->begin(), wait_on_txn->GetSharedLockSet()->end());
-          lock_set.insert(wait_on_txn->GetExclusiveLockSet()->begin(), wait_on_txn->GetExclusiveLockSet()->end());
-          for (auto locked_rid : lock_set) {
-            // 通知
-            lock_table_[locked_rid].cv_.notify_all();
-          }
+        auto it = waiting_.find(txn_id);
+        if (it == waiting_.end()) {
+          break;  // 不是加锁产生的边
         }
-        // 重新建立图
-        waits_for_.clear();
-        BuildWaitsForGraph();
+        // abort 环中最年轻的事务，删除它的出边；唤醒后它会撤回自己的请求
+        it->second.txn_->SetState(TransactionState::ABORTED);
+        victims.push_back(txn_id);
+        waits_for_.erase(txn_id);
       }
     }
+    // 释放 latch_ 后受害者可能已经结束，只保留 id
+    for (auto victim_id : victims) {
+      WakeUp(victim_id);
+    }
   }
 }
 
@@ -302,7 +664,11 @@ bool LockManager::ProcessDFSTree(txn_id_t *txn_id, std::stack<txn_id_t> *stack,
                                  std::unordered_map<txn_id_t, VisitedType> *visited) {
   bool has_cycle = false;
 
-  for (auto &&v : waits_for_[stack->top()]) {
+  // 不在等待的事务没有出边，不向图中插入空的出边表
+  static const std::vector<txn_id_t> no_edges;
+  auto edges_it = waits_for_.find(stack->top());
+  const auto &edges = edges_it == waits_for_.end() ? no_edges : edges_it->second;
+  for (auto &&v : edges) {
     auto it = visited->find(v);
 
     // find a cycle
@@ -350,31 +716,13 @@ txn_id_t LockManager::GetYoungestTransactionInCycle(std::stack<txn_id_t> *stack,
   return max_txn_id;
 }
 
-void LockManager::BuildWaitsForGraph() {
-  for (const auto &it : lock_table_) {
-    const auto queue = it.second.request_queue_;
-    std::vector<txn_id_t> holdings;
-    std::vector<txn_id_t> waitings;
-
-    for (const auto &lock_request : queue) {
-      const auto txn = TransactionManager::GetTransaction(lock_request.txn_id_);
-      if (txn->GetState() == TransactionState::ABORTED) {
-        continue;
-      }
-
-      if (lock_request.granted_) {
-        holdings.push_back(lock_request.txn_id_);
-      } else {
-        waitings.push_back(lock_request.txn_id_);
-      }
-    }
-
-    for (auto &&t1 : waitings) {
-      for (auto &&t2 : holdings) {
-        AddEdge(t1, t2);
-      }
-    }
+size_t LockManager::GetLockTableSize() {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> shard_latch(shard.latch_);
+    size += shard.lock_table_.size();
   }
+  return size;
 }
 
 }  // namespace bustub
@@ -0,0 +1,212 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// occ_manager.cpp
+//
+// Identification: src/concurrency/occ_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/occ_manager.h"
+
+#include <algorithm>
+
+#include "common/logger.h"
+#include "storage/table/table_heap.h"
+
+namespace bustub {
+
+void OccManager::RunEpochThread(std::chrono::milliseconds interval) {
+  std::lock_guard<std::mutex> latch(epoch_latch_);
+  if (epoch_thread_ != nullptr) {
+    return;
+  }
+  epoch_interval_ = interval;
+  enable_epoch_ = true;
+  epoch_thread_ = new std::thread(&OccManager::RunEpoch, this);
+  LOG_INFO("Epoch thread launched");
+}
+
+void OccManager::StopEpochThread() {
+  {
+    std::lock_guard<std::mutex> latch(epoch_latch_);
+    if (epoch_thread_ == nullptr) {
+      return;
+    }
+    enable_epoch_ = false;
+  }
+  epoch_cv_.notify_all();
+  epoch_thread_->join();
+  delete epoch_thread_;
+  epoch_thread_ = nullptr;
+  LOG_INFO("Epoch thread stopped");
+}
+
+void OccManager::RunEpoch() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> latch(epoch_latch_);
+      epoch_cv_.wait_for(latch, epoch_interval_, [this] { return !enable_epoch_; });
+      if (!enable_epoch_) {
+        break;
+      }
+    }
+    // 结束当前 epoch，它的提交共用一次刷盘
+    epoch_++;
+    if (enable_logging && log_manager_ != nullptr) {
+      lsn_t lsn = log_manager_->GetNextLSN() - 1;
+      if (lsn > log_manager_->GetPersistentLSN()) {
+        log_manager_->WaitForFlush(lsn);
+      }
+    }
+  }
+}
+
+void OccManager::RecordRead(Transaction *txn, const RID &rid) {
+  // 只记第一次读到的版本，之后再读到不同的版本，校验时一样会失败
+  auto *read_set = txn->GetOccReadSet().get();
+  if (read_set->find(rid) == read_set->end()) {
+    read_set->emplace(rid, GetTidWord(rid) & ~TID_LOCK_BIT);
+  }
+}
+
+void OccManager::LockInsert(Transaction *txn, const RID &rid) {
+  // 新行的槽位只可能被刚回滚的插入或者提交中的删除锁住，很快会释放
+  while (!TryLockTid(rid)) {
+    std::this_thread::yield();
+  }
+  (*txn->GetOccLockSet())[rid] = true;
+}
+
+bool OccManager::ValidateAndInstall(Transaction *txn, uint64_t *commit_tid) {
+  auto *read_set = txn->GetOccReadSet().get();
+  auto *write_set = txn->GetOccWriteSet().get();
+  auto *lock_set = txn->GetOccLockSet().get();
+  // 1. 锁住要写的行，被别人锁住就放弃，不等待也就不会死锁
+  for (auto &item : *write_set) {
+    if (lock_set->find(item.first) == lock_set->end()) {
+      if (!TryLockTid(item.first)) {
+        return false;
+      }
+      lock_set->emplace(item.first, false);
+    }
+  }
+  // 2. 序列化点：读过的行没有被改过，也没有被别人锁住
+  uint64_t epoch = epoch_;
+  uint64_t max_tid = 0;
+  for (auto &item : *read_set) {
+    uint64_t tid_word = GetTidWord(item.first);
+    if ((tid_word & ~TID_LOCK_BIT) != item.second ||
+        ((tid_word & TID_LOCK_BIT) != 0 && lock_set->find(item.first) == lock_set->end())) {
+      return false;
+    }
+    max_tid = std::max(max_tid, item.second);
+  }
+  for (auto &item : *lock_set) {
+    max_tid = std::max(max_tid, GetTidWord(item.first) & ~TID_LOCK_BIT);
+  }
+  // 3. 新 TID 比读写过的 TID 都大，并且属于当前 epoch
+  *commit_tid = std::max(max_tid + 1, epoch << TID_EPOCH_SHIFT);
+
+  // 4. 写入页，事务不再缓存写
+  txn->SetState(TransactionState::SHRINKING);
+  for (auto &item : *write_set) {
+    auto &record = item.second;
+    (*lock_set)[item.first] = true;
+    bool installed = record.wtype_ == WType::DELETE ? record.table_->MarkDelete(item.first, txn)
+                                                    : record.table_->UpdateTuple(record.tuple_, item.first, txn);
+    if (!installed || txn->GetState() == TransactionState::ABORTED) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void OccManager::Release(Transaction *txn, uint64_t commit_tid) {
+  for (auto &item : *txn->GetOccLockSet()) {
+    SetTid(item.first, commit_tid);
+  }
+  txn->GetOccLockSet()->clear();
+  txn->GetOccReadSet()->clear();
+  txn->GetOccWriteSet()->clear();
+  txn->GetOccIndexWriteSet()->clear();
+}
+
+void OccManager::Abort(Transaction *txn) {
+  for (auto &item : *txn->GetOccLockSet()) {
+    // 改过又回滚的行换一个 TID，读到过中间版本的事务校验会失败
+    uint64_t tid = GetTidWord(item.first) & ~TID_LOCK_BIT;
+    SetTid(item.first, item.second ? tid + 1 : tid);
+  }
+  txn->GetOccLockSet()->clear();
+  txn->GetOccReadSet()->clear();
+  txn->GetOccWriteSet()->clear();
+  txn->GetOccIndexWriteSet()->clear();
+}
+
+void OccManager::WaitForDurable(lsn_t lsn) {
+  if (!enable_epoch_) {
+    log_manager_->WaitForFlush(lsn);
+    return;
+  }
+  // epoch 结束时统一刷盘
+  while (log_manager_->GetPersistentLSN() < lsn && enable_epoch_) {
+    log_manager_->WaitForPersistentLSN(lsn - 1, epoch_interval_);
+  }
+  if (log_manager_->GetPersistentLSN() < lsn) {
+    log_manager_->WaitForFlush(lsn);
+  }
+}
+
+uint64_t OccManager::GetTidWord(const RID &rid) {
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto it = shard->tid_words_.find(rid);
+  return it == shard->tid_words_.end() ? shard->dropped_tid_ : it->second;
+}
+
+size_t OccManager::GetTidWordNum() {
+  size_t num = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> latch(shard.latch_);
+    num += shard.tid_words_.size();
+  }
+  return num;
+}
+
+bool OccManager::TryLockTid(const RID &rid) {
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto &tid_word = shard->tid_words_.emplace(rid, shard->dropped_tid_).first->second;
+  if ((tid_word & TID_LOCK_BIT) != 0) {
+    return false;
+  }
+  tid_word |= TID_LOCK_BIT;
+  return true;
+}
+
+void OccManager::SetTid(const RID &rid, uint64_t tid) {
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  shard->tid_words_[rid] = tid;
+  if (shard->tid_words_.size() > TID_TABLE_SHARD_CAPACITY) {
+    Reclaim(shard);
+  }
+}
+
+void OccManager::Reclaim(TidTableShard *shard) {
+  // 锁住的行还在提交或者是未提交的插入，留下
+  for (auto it = shard->tid_words_.begin(); it != shard->tid_words_.end();) {
+    if ((it->second & TID_LOCK_BIT) != 0) {
+      it++;
+      continue;
+    }
+    shard->dropped_tid_ = std::max(shard->dropped_tid_, it->second);
+    it = shard->tid_words_.erase(it);
+  }
+}
+
+}  // namespace bustub
@@ -10,21 +10,43 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "catalog/catalog.h"
+#include "common/macros.h"
 #include "concurrency/transaction_manager.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
+TransactionManager::~TransactionManager() {
+  for (auto *txn : free_txns_) {
+    delete txn;
+  }
+  for (auto *txn : pinned_txns_) {
+    delete txn;
+  }
+}
 
 Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
   // Acquire the global transaction latch in shared mode.
   global_txn_latch_.RLock();  // 加读锁
 
   if (txn == nullptr) {
-    txn = new Transaction(next_txn_id_++, isolation_level);  // 新建一个事务
+    // 优先复用回收的事务，它的各个集合不用重新分配
+    txn = TakeFromPool();
+    if (txn == nullptr) {
+      txn = new Transaction(next_txn_id_++, isolation_level);  // 新建一个事务
+    } else {
+      txn->Reset(next_txn_id_++, isolation_level);
+    }
+    txn->SetAsyncCommit(async_commit_);
+  }
+  // 所有事务的写都保留旧版本，快照隔离的事务从这里拿到快照
+  txn->SetVersionStore(&version_store_);
+  txn->SetOccManager(&occ_manager_);
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT) {
+    version_store_.BeginSnapshot(txn);
   }
 
   if (enable_logging) {
@@ -35,20 +57,76 @@ Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolatio
     txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
   }
 
-  txn_map[txn->GetTransactionId()] = txn;  // 注册事务
+  // 注册事务
+  auto *shard = GetShard(txn->GetTransactionId());
+  {
+    std::lock_guard<std::mutex> latch(shard->latch_);
+    shard->txns_[txn->GetTransactionId()] = txn;
+  }
+  return txn;
+}
+
+Transaction *TransactionManager::BeginReadOnly(Transaction *txn) {
+  // 只读事务不会写，检查点不用等它，也不用 BEGIN 日志和事务表
+  if (txn == nullptr) {
+    txn = TakeFromPool();
+  }
+  if (txn == nullptr) {
+    txn = new Transaction(next_txn_id_++, IsolationLevel::SNAPSHOT);
+  } else {
+    txn->Reset(next_txn_id_++, IsolationLevel::SNAPSHOT);
+  }
+  txn->SetReadOnly(true);
+  txn->SetVersionStore(&version_store_);
+  version_store_.BeginSnapshot(txn);
   return txn;
 }
 
+void TransactionManager::EndReadOnly(Transaction *txn, TransactionState state) {
+  BUSTUB_ASSERT(txn->GetWriteSet()->empty() && txn->GetIndexWriteSet()->empty(), "Read-only transaction wrote");
+  txn->SetState(state);
+  // 没有写，只结束快照
+  version_store_.Commit(txn);
+  // 只读事务不加行锁，只有写被拒绝之前执行器可能已经加了表锁
+  if (!txn->GetTableLockSet()->empty()) {
+    ReleaseLocks(txn);
+  }
+}
+
 void TransactionManager::Commit(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::COMMITTED);
+    return;
+  }
+  // 乐观事务先校验读过的行，再把缓存的写写入页；失败时调用者 Abort
+  bool optimistic = txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC;
+  uint64_t commit_tid = 0;
+  if (optimistic && !occ_manager_.ValidateAndInstall(txn, &commit_tid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::VALIDATION_FAILED);
+  }
+  if (optimistic) {
+    InstallIndexWrites(txn);
+  }
+
   txn->SetState(TransactionState::COMMITTED);  // 设置事务状态
 
+  lsn_t commit_lsn = INVALID_LSN;
   if (enable_logging) {
     // 事务提交日志
     LogRecord log_record{txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT};
-    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
-    log_manager_->Flush(false);  // 提交后记得刷磁盘，非强制
+    commit_lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(commit_lsn);
+    // 同步提交等待 COMMIT 落盘，异步提交交给刷新线程，在 flush timeout 内落盘
+    // 乐观事务先释放 TID 锁再等：读到它的写的事务，COMMIT 日志一定在它之后
+    if (!txn->IsAsyncCommit() && !optimistic) {
+      log_manager_->WaitForFlush(commit_lsn);
+    }
   }
 
+  // 新版本对之后的快照可见
+  version_store_.Commit(txn);
+
   // Perform all deletes before we commit. 调用所有 delete 操作
   auto write_set = txn->GetWriteSet();
   while (!write_set->empty()) {
@@ -63,12 +141,42 @@ void TransactionManager::Commit(Transaction *txn) {
   write_set->clear();
 
   // Release all the locks.
+  if (optimistic) {
+    occ_manager_.Release(txn, commit_tid);
+  }
   ReleaseLocks(txn);  // 释放事务上的锁
+  if (optimistic && commit_lsn != INVALID_LSN && !txn->IsAsyncCommit()) {
+    occ_manager_.WaitForDurable(commit_lsn);
+  }
+  RemoveTransaction(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();  // 释放读锁
 }
 
+void TransactionManager::InstallIndexWrites(Transaction *txn) {
+  // 写入页之后才改索引，校验失败的事务不会留下索引项；提交中的行的 TID 还锁着，读到它们的事务会校验失败
+  for (auto &item : *txn->GetOccIndexWriteSet()) {
+    TableMetadata *table_info = item.catalog_->GetTable(item.table_oid_);
+    IndexInfo *index_info = item.catalog_->GetIndex(item.index_oid_);
+    auto key = item.tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
+                                        index_info->index_->GetKeyAttrs());
+    if (item.wtype_ == WType::DELETE) {
+      index_info->index_->DeleteEntry(key, item.rid_, txn);
+    } else if (item.wtype_ == WType::UPDATE) {
+      auto old_key = item.old_tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
+                                                  index_info->index_->GetKeyAttrs());
+      index_info->index_->DeleteEntry(old_key, item.rid_, txn);
+      index_info->index_->InsertEntry(key, item.rid_, txn);
+    }
+  }
+  txn->GetOccIndexWriteSet()->clear();
+}
+
 void TransactionManager::Abort(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::ABORTED);
+    return;
+  }
   txn->SetState(TransactionState::ABORTED);  // 设置状态
   if (enable_logging) {
     // 记录终止日志
@@ -118,13 +226,93 @@ void TransactionManager::Abort(Transaction *txn) {
   }
   table_write_set->clear();
   index_write_set->clear();
+  version_store_.Abort(txn);
+  occ_manager_.Abort(txn);
 
   // Release all the locks.
   ReleaseLocks(txn);
+  RemoveTransaction(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+Transaction *TransactionManager::GetTransaction(txn_id_t txn_id) {
+  auto *shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto it = shard->txns_.find(txn_id);
+  return it == shard->txns_.end() ? nullptr : it->second;
+}
+
+Transaction *TransactionManager::PinTransaction(txn_id_t txn_id) {
+  auto *shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto it = shard->txns_.find(txn_id);
+  if (it == shard->txns_.end()) {
+    return nullptr;
+  }
+  // 在分片锁下 pin，事务结束时要先拿这个锁把自己移出事务表，回收时一定能看到 pin
+  it->second->Pin();
+  return it->second;
+}
+
+void TransactionManager::RemoveTransaction(Transaction *txn) {
+  auto *shard = GetShard(txn->GetTransactionId());
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto it = shard->txns_.find(txn->GetTransactionId());
+  // 不同的事务管理器的事务 id 会重复，只删除自己
+  if (it != shard->txns_.end() && it->second == txn) {
+    shard->txns_.erase(it);
+  }
+}
+
+void TransactionManager::Recycle(Transaction *txn) {
+  BUSTUB_ASSERT(txn->GetState() == TransactionState::COMMITTED || txn->GetState() == TransactionState::ABORTED,
+                "Only a finished transaction can be recycled");
+  {
+    std::lock_guard<std::mutex> latch(pool_latch_);
+    if (txn->IsPinned()) {
+      pinned_txns_.push_back(txn);
+      return;
+    }
+    if (free_txns_.size() < TXN_POOL_SIZE) {
+      free_txns_.push_back(txn);
+      return;
+    }
+  }
+  delete txn;
+}
+
+Transaction *TransactionManager::TakeFromPool() {
+  std::lock_guard<std::mutex> latch(pool_latch_);
+  if (free_txns_.empty() && !pinned_txns_.empty()) {
+    // 已经 unpin 的事务可以复用了
+    auto unpinned = std::partition(pinned_txns_.begin(), pinned_txns_.end(),
+                                   [](Transaction *txn) { return txn->IsPinned(); });
+    free_txns_.insert(free_txns_.end(), unpinned, pinned_txns_.end());
+    pinned_txns_.erase(unpinned, pinned_txns_.end());
+  }
+  if (free_txns_.empty()) {
+    return nullptr;
+  }
+  auto *txn = free_txns_.back();
+  free_txns_.pop_back();
+  return txn;
+}
+
+size_t TransactionManager::GetRunningTransactionNum() {
+  size_t num = 0;
+  for (auto &shard : txn_table_) {
+    std::lock_guard<std::mutex> latch(shard.latch_);
+    num += shard.txns_.size();
+  }
+  return num;
+}
+
+size_t TransactionManager::GetPooledTransactionNum() {
+  std::lock_guard<std::mutex> latch(pool_latch_);
+  return free_txns_.size() + pinned_txns_.size();
+}
+
 // 直接加全局写锁
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
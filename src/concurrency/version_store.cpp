@@ -0,0 +1,190 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/concurrency/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/version_store.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+void VersionStore::BeginSnapshot(Transaction *txn) {
+  std::lock_guard<std::mutex> latch(latch_);
+  txn->SetReadTs(last_commit_ts_);
+  snapshots_.insert(last_commit_ts_);
+}
+
+void VersionStore::RecordWrite(Transaction *txn, const RID &rid, const Tuple *old_tuple) {
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto chain_it = shard->chains_.find(rid);
+  if (chain_it == shard->chains_.end()) {
+    // 没有版本链的行对所有快照可见，当作很早以前提交的版本
+    chain_it = shard->chains_.emplace(rid, VersionChain{}).first;
+    chain_num_++;
+  }
+  auto &chain = chain_it->second;
+  // 同一个事务多次写一行，只保留它之前的版本
+  if (chain.writer_ == txn->GetTransactionId()) {
+    return;
+  }
+  if (chain.writer_ != INVALID_TXN_ID && old_tuple == nullptr) {
+    // 回滚插入释放的槽位在写者结束前就可能被重用，槽位上的版本已经回滚了
+    RollbackVersion(&chain);
+  } else if (chain.writer_ != INVALID_TXN_ID) {
+    // 没有锁保护的写（例如同一个事务里建表装载数据之后），之前写者未提交的版本交给这个事务
+    chain.writer_ = txn->GetTransactionId();
+    txn->GetVersionWriteSet()->push_back(rid);
+    return;
+  }
+  chain.undo_.push_front(UndoVersion{old_tuple == nullptr ? Tuple{} : *old_tuple, old_tuple != nullptr,
+                                     chain.commit_ts_});
+  chain.writer_ = txn->GetTransactionId();
+  version_num_++;
+  txn->GetVersionWriteSet()->push_back(rid);
+}
+
+bool VersionStore::HasWriteConflict(Transaction *txn, const RID &rid) {
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto chain_it = shard->chains_.find(rid);
+  // 持有行的写锁，不会有其它未提交的写
+  return chain_it != shard->chains_.end() && chain_it->second.writer_ == INVALID_TXN_ID &&
+         chain_it->second.commit_ts_ > txn->GetReadTs();
+}
+
+bool VersionStore::GetVisibleVersion(Transaction *txn, const RID &rid, Tuple *tuple, bool exists) {
+  if (chain_num_ == 0) {
+    return exists;
+  }
+  auto *shard = GetShard(rid);
+  std::lock_guard<std::mutex> latch(shard->latch_);
+  auto chain_it = shard->chains_.find(rid);
+  if (chain_it == shard->chains_.end()) {
+    return exists;
+  }
+  auto &chain = chain_it->second;
+  // 自己写的，或者快照之前提交的
+  if (chain.writer_ == txn->GetTransactionId() ||
+      (chain.writer_ == INVALID_TXN_ID && chain.commit_ts_ <= txn->GetReadTs())) {
+    return exists;
+  }
+  for (const auto &version : chain.undo_) {
+    if (version.commit_ts_ <= txn->GetReadTs()) {
+      if (!version.exists_) {
+        return false;
+      }
+      *tuple = version.tuple_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void VersionStore::Commit(Transaction *txn) {
+  auto writes = txn->GetVersionWriteSet();
+  if (writes->empty()) {
+    std::lock_guard<std::mutex> latch(latch_);
+    EndTransaction(txn);
+    return;
+  }
+  timestamp_t commit_ts;
+  {
+    std::lock_guard<std::mutex> latch(latch_);
+    commit_ts = ++next_commit_ts_;
+    committing_.insert(commit_ts);
+  }
+  // 打时间戳时只拿行所在分片的 latch，新的快照还读不到 commit_ts
+  for (const auto &rid : *writes) {
+    auto *shard = GetShard(rid);
+    std::lock_guard<std::mutex> latch(shard->latch_);
+    auto chain_it = shard->chains_.find(rid);
+    if (chain_it != shard->chains_.end() && chain_it->second.writer_ == txn->GetTransactionId()) {
+      chain_it->second.writer_ = INVALID_TXN_ID;
+      chain_it->second.commit_ts_ = commit_ts;
+    }
+  }
+  std::lock_guard<std::mutex> latch(latch_);
+  committing_.erase(commit_ts);
+  // 更早的提交还没打完时间戳，快照只能读到它之前
+  last_commit_ts_ = committing_.empty() ? next_commit_ts_ : *committing_.begin() - 1;
+  gc_queue_.emplace_back(commit_ts, std::move(*writes));
+  writes->clear();
+  EndTransaction(txn);
+}
+
+void VersionStore::Abort(Transaction *txn) {
+  auto writes = txn->GetVersionWriteSet();
+  // 页已经回滚到事务之前的版本，也就是链上最新的旧版本
+  for (const auto &rid : *writes) {
+    auto *shard = GetShard(rid);
+    std::lock_guard<std::mutex> latch(shard->latch_);
+    auto chain_it = shard->chains_.find(rid);
+    if (chain_it != shard->chains_.end() && chain_it->second.writer_ == txn->GetTransactionId()) {
+      RollbackVersion(&chain_it->second);
+    }
+  }
+  std::lock_guard<std::mutex> latch(latch_);
+  if (!writes->empty()) {
+    gc_queue_.emplace_back(last_commit_ts_, std::move(*writes));
+    writes->clear();
+  }
+  EndTransaction(txn);
+}
+
+void VersionStore::RollbackVersion(VersionChain *chain) {
+  chain->writer_ = INVALID_TXN_ID;
+  chain->commit_ts_ = chain->undo_.front().commit_ts_;
+  chain->undo_.pop_front();
+  version_num_--;
+}
+
+void VersionStore::EndTransaction(Transaction *txn) {
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT) {
+    snapshots_.erase(snapshots_.find(txn->GetReadTs()));
+  }
+  // 最老的快照也能看到的版本之前的版本都不再需要
+  timestamp_t oldest_ts = snapshots_.empty() ? last_commit_ts_ : *snapshots_.begin();
+  while (!gc_queue_.empty() && gc_queue_.front().first <= oldest_ts) {
+    for (const auto &rid : gc_queue_.front().second) {
+      auto *shard = GetShard(rid);
+      std::lock_guard<std::mutex> latch(shard->latch_);
+      auto chain_it = shard->chains_.find(rid);
+      if (chain_it == shard->chains_.end()) {
+        continue;
+      }
+      auto &chain = chain_it->second;
+      if (chain.writer_ == INVALID_TXN_ID && chain.commit_ts_ <= oldest_ts) {
+        version_num_ -= chain.undo_.size();
+        shard->chains_.erase(chain_it);
+        chain_num_--;
+        continue;
+      }
+      // 行又被写过，留下最老的快照看到的版本，之后的提交会再处理这个链
+      auto visible = std::find_if(chain.undo_.begin(), chain.undo_.end(),
+                                  [oldest_ts](const UndoVersion &version) { return version.commit_ts_ <= oldest_ts; });
+      if (visible != chain.undo_.end()) {
+        version_num_ -= chain.undo_.end() - visible - 1;
+        chain.undo_.erase(visible + 1, chain.undo_.end());
+      }
+    }
+    gc_queue_.pop_front();
+  }
+}
+
+timestamp_t VersionStore::GetLastCommitTs() {
+  std::lock_guard<std::mutex> latch(latch_);
+  return last_commit_ts_;
+}
+
+size_t VersionStore::GetVersionNum() { return version_num_; }
+
+}  // namespace bustub
@@ -31,34 +31,8 @@ void AggregationExecutor::Init() {
   // 将数据从 child 中搬到 aht 中
   Tuple tup;
   RID rid;
+  // child 已经按隔离级别加了表锁或行锁
   while (child_->Next(&tup, &rid)) {
-    switch (exec_ctx_->GetTransaction()->GetIsolationLevel()) {
-      case IsolationLevel::READ_UNCOMMITTED:
-        break;  // 读未提交，未加任何锁，直接 break
-      case IsolationLevel::READ_COMMITTED:
-        // 读已提交
-        // 1.没有加读锁;
-        // 2.也没有加写锁;
-        // 3.不能加读锁后，立即解锁成功
-        if (!exec_ctx_->GetTransaction()->IsSharedLocked(rid) && !exec_ctx_->GetTransaction()->IsExclusiveLocked(rid) &&
-            !(exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), rid) &&
-              exec_ctx_->GetLockManager()->Unlock(exec_ctx_->GetTransaction(), rid))) {
-          return;
-        }
-        break;
-      case IsolationLevel::REPEATABLE_READ:
-        // 可重读读
-        // 1. 没有加读锁
-        // 2. 没有加写锁
-        // 3. 且不能加读锁
-        if (!exec_ctx_->GetTransaction()->IsSharedLocked(rid) && !exec_ctx_->GetTransaction()->IsExclusiveLocked(rid) &&
-            !exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), rid)) {
-          return;
-        }
-        break;
-      default:
-        break;
-    }
     aht_.InsertCombine(MakeKey(&tup), MakeVal(&tup));
   }
   aht_iterator_ = aht_.Begin();
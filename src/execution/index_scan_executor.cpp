@@ -20,26 +20,31 @@ IndexScanExecutor::IndexScanExecutor(ExecutorContext *exec_ctx, const IndexScanP
 }
 
 void IndexScanExecutor::Init() {
-  auto b_index = dynamic_cast<BPLUSTREE_INDEX_TYPE *>(index_info_->index_.get());
-  index_iterator_ = std::make_unique<INDEXITERATOR_TYPE>(b_index->GetBeginIterator());
+  index_iterator_ = index_info_->index_->Scan();
+  // 索引扫描只读部分行，表上加意向锁
+  auto *txn = exec_ctx_->GetTransaction();
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED ||
+      txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ) {
+    exec_ctx_->GetLockManager()->LockTable(txn, table_metadata_->oid_, LockMode::INTENTION_SHARED);
+  }
 }
 
 bool IndexScanExecutor::Next(Tuple *tuple, RID *rid) {
   Tuple tup;
   // 迭代
   do {
-    auto b_index = dynamic_cast<BPLUSTREE_INDEX_TYPE *>(index_info_->index_.get());
-    if (*index_iterator_ == b_index->GetEndIterator()) {
+    if (index_iterator_ == nullptr || index_iterator_->IsEnd()) {
       return false;
     }
-    bool found = table_metadata_->table_->GetTuple((*(*index_iterator_)).second, &tup, exec_ctx_->GetTransaction());
+    bool found = table_metadata_->table_->GetTuple(index_iterator_->GetRID(), &tup, exec_ctx_->GetTransaction());
     if (!found) {
       return false;
     }
-    ++(*index_iterator_);
+    index_iterator_->Next();
   } while (plan_->GetPredicate() != nullptr &&
            !plan_->GetPredicate()->Evaluate(&tup, &(table_metadata_->schema_)).GetAs<bool>());
-  // 判断事务隔离级别
+  // 判断事务隔离级别，表锁覆盖时不加行锁
+  bool table_locked = exec_ctx_->GetTransaction()->IsTableSharedLocked(table_metadata_->oid_);
   switch (exec_ctx_->GetTransaction()->GetIsolationLevel()) {
     case IsolationLevel::READ_UNCOMMITTED:
       break;  // 读未提交，未加任何锁，直接 break
@@ -48,7 +53,7 @@ bool IndexScanExecutor::Next(Tuple *tuple, RID *rid) {
       // 1.没有加读锁;
       // 2.也没有加写锁;
       // 3.不能加读锁后，立即解锁成功
-      if (!exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
+      if (!table_locked && !exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
           !exec_ctx_->GetTransaction()->IsExclusiveLocked(tup.GetRid()) &&
           !(exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid()) &&
             exec_ctx_->GetLockManager()->Unlock(exec_ctx_->GetTransaction(), tup.GetRid()))) {
@@ -60,9 +65,9 @@ bool IndexScanExecutor::Next(Tuple *tuple, RID *rid) {
       // 1. 没有加读锁
       // 2. 没有加写锁
       // 3. 且不能加读锁
-      if (!exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
+      if (!table_locked && !exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
           !exec_ctx_->GetTransaction()->IsExclusiveLocked(tup.GetRid()) &&
-          !exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid())) {
+          !exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid(), table_metadata_->oid_)) {
         return false;
       }
       break;
@@ -26,6 +26,11 @@ void InsertExecutor::Init() {
     child_executor_->Init();
   }
   table_indexes_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_metadata_->name_);
+  // 插入只写新行，表上加意向写锁；乐观事务不加锁
+  if (exec_ctx_->GetTransaction()->GetIsolationLevel() != IsolationLevel::OPTIMISTIC) {
+    exec_ctx_->GetLockManager()->LockTable(exec_ctx_->GetTransaction(), table_metadata_->oid_,
+                                           LockMode::INTENTION_EXCLUSIVE);
+  }
 }
 
 bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
@@ -44,8 +49,11 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   }
   bool ok = table_metadata_->table_->InsertTuple(tup, rid, exec_ctx_->GetTransaction());
   if (ok) {
-    // 锁住新插入的 RID
-    exec_ctx_->GetLockManager()->LockExclusive(exec_ctx_->GetTransaction(), *rid);
+    // 锁住新插入的 RID，表锁覆盖时不用，乐观事务在 TableHeap 中锁住新行的 TID
+    if (exec_ctx_->GetTransaction()->GetIsolationLevel() != IsolationLevel::OPTIMISTIC &&
+        !exec_ctx_->GetTransaction()->IsTableExclusiveLocked(table_metadata_->oid_)) {
+      exec_ctx_->GetLockManager()->LockExclusive(exec_ctx_->GetTransaction(), *rid, table_metadata_->oid_);
+    }
     // 插入索引数据
     std::for_each(
         table_indexes_.begin(), table_indexes_.end(),
@@ -40,9 +40,8 @@ bool NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) {
     Value val = plan_->Predicate()->GetChildAt(0)->EvaluateJoin(&left_tuple, plan_->OuterTableSchema(), &right_tuple,
                                                                 &table_info_->schema_);
     Tuple probe{std::vector<Value>{val}, index_info_->index_->GetKeySchema()};
-    auto b_index = dynamic_cast<BPlusTreeIndex<KeyType, ValueType, KeyComparator> *>(index_info_->index_.get());
     std::vector<RID> rids;
-    b_index->ScanKey(probe, &rids, exec_ctx_->GetTransaction());
+    index_info_->index_->ScanKey(probe, &rids, exec_ctx_->GetTransaction());
     if (rids.empty()) {
       done = true;
       break;
@@ -19,6 +19,13 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 }
 
 void SeqScanExecutor::Init() {
+  // 可重复读用一个表级读锁覆盖所有行；读已提交的行锁读完就释放，表上只加意向锁
+  auto *txn = exec_ctx_->GetTransaction();
+  if (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ) {
+    exec_ctx_->GetLockManager()->LockTable(txn, plan_->GetTableOid(), LockMode::SHARED);
+  } else if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+    exec_ctx_->GetLockManager()->LockTable(txn, plan_->GetTableOid(), LockMode::INTENTION_SHARED);
+  }
   table_iterator_ = std::make_unique<TableIterator>(table_metadata_->table_->Begin(exec_ctx_->GetTransaction()));
 }
 
@@ -36,7 +43,8 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
   } while (plan_->GetPredicate() != nullptr &&
            !plan_->GetPredicate()->Evaluate(&tup, &(table_metadata_->schema_)).GetAs<bool>());
 
-  // 判断事务隔离级别
+  // 判断事务隔离级别，表锁覆盖时不加行锁
+  bool table_locked = exec_ctx_->GetTransaction()->IsTableSharedLocked(plan_->GetTableOid());
   switch (exec_ctx_->GetTransaction()->GetIsolationLevel()) {
     case IsolationLevel::READ_UNCOMMITTED:
       break;  // 读未提交，未加任何锁，直接 break
@@ -45,7 +53,7 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
       // 1.没有加读锁;
       // 2.也没有加写锁;
       // 3.不能加读锁后，立即解锁成功
-      if (!exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
+      if (!table_locked && !exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
           !exec_ctx_->GetTransaction()->IsExclusiveLocked(tup.GetRid()) &&
           !(exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid()) &&
             exec_ctx_->GetLockManager()->Unlock(exec_ctx_->GetTransaction(), tup.GetRid()))) {
@@ -57,9 +65,9 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
       // 1. 没有加读锁
       // 2. 没有加写锁
       // 3. 且不能加读锁
-      if (!exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
+      if (!table_locked && !exec_ctx_->GetTransaction()->IsSharedLocked(tup.GetRid()) &&
           !exec_ctx_->GetTransaction()->IsExclusiveLocked(tup.GetRid()) &&
-          !exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid())) {
+          !exec_ctx_->GetLockManager()->LockShared(exec_ctx_->GetTransaction(), tup.GetRid(), plan_->GetTableOid())) {
         return false;
       }
       break;
@@ -22,6 +22,16 @@ UpdateExecutor::UpdateExecutor(ExecutorContext *exec_ctx, const UpdatePlanNode *
 }
 
 void UpdateExecutor::Init() {
+  // 没有谓词的全表扫描会改写所有行，一个表级写锁就够了，否则加意向写锁再锁行
+  auto *child_plan = plan_->GetChildPlan();
+  bool whole_table = child_plan->GetType() == PlanType::SeqScan &&
+                     static_cast<const SeqScanPlanNode *>(child_plan)->GetPredicate() == nullptr &&
+                     static_cast<const SeqScanPlanNode *>(child_plan)->GetTableOid() == plan_->TableOid();
+  // 乐观事务不加锁，提交时校验
+  if (exec_ctx_->GetTransaction()->GetIsolationLevel() != IsolationLevel::OPTIMISTIC) {
+    exec_ctx_->GetLockManager()->LockTable(exec_ctx_->GetTransaction(), plan_->TableOid(),
+                                           whole_table ? LockMode::EXCLUSIVE : LockMode::INTENTION_EXCLUSIVE);
+  }
   child_executor_->Init();
   table_indexes_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
 }
@@ -39,15 +49,19 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   }
   *tuple = GenerateUpdatedTuple(hit_tup);
 
-  // 如果处于读锁状态
-  if (exec_ctx_->GetTransaction()->IsSharedLocked(*rid)) {
+  // 如果表锁覆盖了所有行，不用锁行
+  if (exec_ctx_->GetTransaction()->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    // 乐观事务的写缓存到提交
+  } else if (exec_ctx_->GetTransaction()->IsTableExclusiveLocked(plan_->TableOid())) {
+    // 已经锁住整张表
+  } else if (exec_ctx_->GetTransaction()->IsSharedLocked(*rid)) {
     // 尝试进行锁升级
-    if (!exec_ctx_->GetLockManager()->LockUpgrade(exec_ctx_->GetTransaction(), *rid)) {
+    if (!exec_ctx_->GetLockManager()->LockUpgrade(exec_ctx_->GetTransaction(), *rid, plan_->TableOid())) {
       // 升级失败，直接返回
       return false;
     }
   } else if (!exec_ctx_->GetTransaction()->IsExclusiveLocked(*rid) &&
-             !exec_ctx_->GetLockManager()->LockExclusive(exec_ctx_->GetTransaction(), *rid)) {
+             !exec_ctx_->GetLockManager()->LockExclusive(exec_ctx_->GetTransaction(), *rid, plan_->TableOid())) {
     // 没有不在写锁状态，但是加写锁失败，直接返回
     return false;
   }
@@ -58,6 +72,12 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
     std::for_each(
         table_indexes_.begin(), table_indexes_.end(),
         [&hit_tup, &tuple, &rid, &table_info = table_info_, &ctx = exec_ctx_](IndexInfo *index_info) {
+          // 乐观事务的更新校验之后才写入页，索引也在那时改
+          if (ctx->GetTransaction()->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+            ctx->GetTransaction()->GetOccIndexWriteSet()->emplace_back(
+                *rid, table_info->oid_, WType::UPDATE, *tuple, hit_tup, index_info->index_oid_, ctx->GetCatalog());
+            return;
+          }
           // 没有更新这个操作，因此先删除，后插入
           index_info->index_->DeleteEntry(
               hit_tup.KeyFromTuple(table_info->schema_, index_info->key_schema_, index_info->index_->GetKeyAttrs()),
@@ -15,6 +15,7 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -23,6 +24,8 @@
 
 namespace bustub {
 
+class LogRecovery;
+
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
  */
@@ -91,6 +94,46 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Read-ahead: bring the page into the buffer pool without keeping it pinned,
+   * so that a following FetchPage on it is a hit.
+   * @param page_id id of page to be prefetched
+   * @return false if the page cannot be brought in (all frames pinned), true otherwise
+   */
+  bool PrefetchPage(page_id_t page_id);
+
+  /**
+   * Copy the latest version of a page without caching it, for backups: a page in the buffer pool is copied
+   * under its read latch, any other page is read from disk.
+   * @param page_id id of page to be copied
+   * @param[out] data output buffer of PAGE_SIZE bytes
+   */
+  void CopyPage(page_id_t page_id, char *data);
+
+  /** @return ids of the dirty pages in the buffer pool */
+  std::vector<page_id_t> GetDirtyPages();
+
+  /**
+   * Flush a dirty page while transactions may be using it, the page is written under its read latch so a
+   * half modified page never reaches the disk. Used by checkpoints to write pages back in the background.
+   * @param page_id id of page to be flushed
+   * @return true if the page was dirty and written
+   */
+  bool FlushDirtyPage(page_id_t page_id);
+
+  /**
+   * Instant restart: every page is handed to log_recovery when it is fetched, so the page is redone
+   * before anyone sees it. nullptr detaches once recovery has finished.
+   * @param log_recovery the recovery holding the pending log records of each page
+   */
+  void SetLogRecovery(LogRecovery *log_recovery);
+
+  /** Instant restart: redo every page still pending now, a checkpoint must not be taken before. */
+  void RedoPendingPages();
+
+  /** @return true while instant restart has pages not redone yet */
+  bool HasPendingRedo();
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
@@ -166,6 +209,12 @@ class BufferPoolManager {
    */
   void FlushAllPagesImpl();
 
+  /**
+   * WAL: whether the log has to be flushed before page is written. Page 0 may be the header page,
+   * which keeps its LSN in its last bytes, both are checked for it.
+   */
+  bool NeedFlushLog(Page *page);
+
   /** Number of pages in the buffer pool. */
   size_t pool_size_;
   /** Array of buffer pool pages. pages_ 序号按照 frame_id 来排序 */
@@ -174,6 +223,8 @@ class BufferPoolManager {
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
   LogManager *log_manager_ __attribute__((__unused__));
+  /** Pointer to the log recovery redoing pages on demand, nullptr when there is nothing left to redo. */
+  LogRecovery *log_recovery_{nullptr};
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
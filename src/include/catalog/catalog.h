@@ -8,6 +8,7 @@
 
 #include "buffer/buffer_pool_manager.h"
 #include "catalog/schema.h"
+#include "common/exception.h"
 #include "storage/index/b_plus_tree_index.h"
 #include "storage/index/index.h"
 #include "storage/table/table_heap.h"
@@ -54,8 +55,8 @@ struct IndexInfo {
 };
 
 /**
- * Catalog is a non-persistent catalog that is designed for the executor to use.
- * It handles table creation and table lookup.  Catalog 用于数据表创建和查找
+ * Catalog is designed for the executor to use, it handles table creation and table lookup.
+ * It is non-persistent unless opened, see Open.  Catalog 用于数据表创建和查找
  */
 class Catalog {
  public:
@@ -78,13 +79,10 @@ class Catalog {
   TableMetadata *CreateTable(Transaction *txn, const std::string &table_name, const Schema &schema) {
     BUSTUB_ASSERT(names_.count(table_name) == 0, "Table names should be unique!");
     auto table_id = next_table_oid_.load();
-    names_[table_name] = table_id;
-    std::unique_ptr<TableHeap> table_heap = std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, txn);
-    std::unique_ptr<TableMetadata> metadata =
-        std::make_unique<TableMetadata>(schema, table_name, std::move(table_heap), table_id);
-    TableMetadata *ret = metadata.get();
-    tables_[table_id] = std::move(metadata);
-    next_table_oid_++;
+    std::unique_ptr<TableHeap> table_heap =
+        std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, txn, table_id);
+    TableMetadata *ret = AddTable(table_name, schema, std::move(table_heap), table_id);
+    RecordTable(txn, ret);
     return ret;
   }
 
@@ -122,32 +120,45 @@ class Catalog {
   IndexInfo *CreateIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
                          const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
                          size_t keysize) {
-    // 索引id
-    auto index_id = next_index_oid_.load();
-    // 索引元数据
-    std::unique_ptr<IndexMetadata> index_metadata =
-        std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
-    // 索引，这个地方必须 release，不能 get
-    // 调用 release 会切断 unique_ptr 和它原来管理的对象的联系。
-    std::unique_ptr<Index> index = std::make_unique<BPLUSTREE_INDEX_TYPE>(index_metadata.release(), bpm_);
-    // 索引信息
-    std::unique_ptr<IndexInfo> index_info =
-        std::make_unique<IndexInfo>(key_schema, index_name, std::move(index), index_id, table_name, keysize);
-    auto ret = index_info.get();
-    // 记录索引
-    indexes_.emplace(ret->index_oid_, std::move(index_info));
-    index_names_[ret->table_name_].emplace(ret->name_, ret->index_oid_);
-    next_index_oid_++;
-    // table 元数据
-    TableMetadata *metadata = GetTable(table_name);
-    auto table_heap = metadata->table_.get();
-    // 遍历 table 得到 tuples，建立索引数据
-    for (auto it = table_heap->Begin(txn); it != table_heap->End(); it++) {
-      ret->index_->InsertEntry(it->KeyFromTuple(schema, key_schema, key_attrs), it->GetRid(), txn);
-    }
+    IndexInfo *ret = AddIndex<KeyType, ValueType, KeyComparator>(txn, index_name, table_name, schema, key_schema,
+                                                                 key_attrs, keysize, next_index_oid_.load(), true);
+    RecordIndex(txn, ret);
+    return ret;
+  }
+
+  /**
+   * Create a new index with the key type that compares fastest for key_schema: a single INTEGER or BIGINT column
+   * is compared as an integer, fixed-width columns as normalized bytes, anything else through Value.
+   * @param txn the transaction in which the table is being created
+   * @param index_name the name of the new index
+   * @param table_name the name of the table
+   * @param schema the schema of the table
+   * @param key_schema the schema of the key
+   * @param key_attrs key attributes
+   * @return a pointer to the metadata of the new index
+   */
+  IndexInfo *CreateIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
+                         const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs) {
+    IndexInfo *ret = AddIndex(txn, index_name, table_name, schema, key_schema, key_attrs, next_index_oid_.load(), true);
+    RecordIndex(txn, ret);
     return ret;
   }
 
+  /**
+   * Set how full CreateIndex fills the pages of a new index, 1.0 packs them as full as they can be before they
+   * split, less leaves room for the inserts that follow.
+   */
+  void SetIndexFillFactor(double fill_factor) { index_fill_factor_ = fill_factor; }
+
+  /**
+   * Keep the catalog in a table heap from now on, so the tables and indexes are found again after a restart and
+   * reach standbys through the log. The heap is recorded in the header page, which must be page 0, and created with
+   * the first table. Loads what the heap records, call it again to pick up the changes made by recovery or
+   * replication, tables and indexes it no longer records are dropped.
+   * @param txn reads the heap, a snapshot on a standby leaves out what unfinished transactions created
+   */
+  void Open(Transaction *txn = nullptr);
+
   IndexInfo *GetIndex(const std::string &index_name, const std::string &table_name) {
     auto table_indexes = index_names_.find(table_name);
     if (table_indexes == index_names_.end()) {
@@ -183,10 +194,130 @@ class Catalog {
     return indexes;
   }
 
+  /** @return the indexes of all the tables */
+  std::vector<IndexInfo *> GetIndexes() {
+    std::vector<IndexInfo *> indexes;
+    indexes.reserve(indexes_.size());
+    for (const auto &kv : indexes_) {
+      indexes.push_back(kv.second.get());
+    }
+    return indexes;
+  }
+
+  /** Name of the header page record of the catalog heap. */
+  static constexpr const char *CATALOG_NAME = "__catalog";
+
  private:
+  /** Add a table to the maps. */
+  TableMetadata *AddTable(const std::string &table_name, const Schema &schema, std::unique_ptr<TableHeap> &&table_heap,
+                          table_oid_t table_oid) {
+    names_[table_name] = table_oid;
+    std::unique_ptr<TableMetadata> metadata =
+        std::make_unique<TableMetadata>(schema, table_name, std::move(table_heap), table_oid);
+    TableMetadata *ret = metadata.get();
+    tables_[table_oid] = std::move(metadata);
+    if (next_table_oid_ <= table_oid) {
+      next_table_oid_ = table_oid + 1;
+    }
+    return ret;
+  }
+
+  /**
+   * Add an index to the maps. With create the index is new and populated from the table,
+   * otherwise it is reopened from the database file.
+   */
+  template <class KeyType, class ValueType, class KeyComparator>
+  IndexInfo *AddIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
+                      const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
+                      size_t keysize, index_oid_t index_oid, bool create) {
+    // 索引元数据
+    std::unique_ptr<IndexMetadata> index_metadata =
+        std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
+    // 索引，这个地方必须 release，不能 get
+    // 调用 release 会切断 unique_ptr 和它原来管理的对象的联系。
+    auto index = std::make_unique<BPLUSTREE_INDEX_TYPE>(index_metadata.release(), bpm_, log_manager_);
+    if (create) {
+      // table 元数据
+      TableMetadata *metadata = GetTable(table_name);
+      auto table_heap = metadata->table_.get();
+      // 遍历 table 取出所有 key，排序后自底向上建立索引，而不是逐个插入
+      std::vector<std::pair<KeyType, ValueType>> entries;
+      for (auto it = table_heap->Begin(txn); it != table_heap->End(); it++) {
+        KeyType key;
+        key.SetFromKey(it->KeyFromTuple(schema, key_schema, key_attrs), index->GetKeySchema());
+        entries.emplace_back(key, it->GetRid());
+      }
+      index->BulkLoad(&entries, index_fill_factor_, txn);
+    } else {
+      index->Open();
+    }
+    // 索引信息
+    std::unique_ptr<IndexInfo> index_info =
+        std::make_unique<IndexInfo>(key_schema, index_name, std::move(index), index_oid, table_name, keysize);
+    auto ret = index_info.get();
+    // 记录索引
+    indexes_.emplace(ret->index_oid_, std::move(index_info));
+    index_names_[ret->table_name_].emplace(ret->name_, ret->index_oid_);
+    if (next_index_oid_ <= index_oid) {
+      next_index_oid_ = index_oid + 1;
+    }
+    return ret;
+  }
+
+  /** Add an index with the key type CreateIndex picks for key_schema. */
+  IndexInfo *AddIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
+                      const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
+                      index_oid_t index_oid, bool create) {
+    const auto &columns = key_schema.GetColumns();
+    if (columns.size() == 1 && columns[0].GetType() == TypeId::INTEGER) {
+      return AddIndex<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>(txn, index_name, table_name, schema,
+                                                                            key_schema, key_attrs, 4, index_oid,
+                                                                            create);
+    }
+    if (columns.size() == 1 && columns[0].GetType() == TypeId::BIGINT) {
+      return AddIndex<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>(txn, index_name, table_name, schema,
+                                                                            key_schema, key_attrs, 8, index_oid,
+                                                                            create);
+    }
+    uint32_t length = key_schema.GetLength();
+    if (key_schema.IsInlined()) {
+      if (length <= 4) {
+        return AddIndex<BinaryKey<4>, RID, BinaryComparator<4>>(txn, index_name, table_name, schema, key_schema,
+                                                                key_attrs, 4, index_oid, create);
+      }
+      if (length <= 8) {
+        return AddIndex<BinaryKey<8>, RID, BinaryComparator<8>>(txn, index_name, table_name, schema, key_schema,
+                                                                key_attrs, 8, index_oid, create);
+      }
+      if (length <= 16) {
+        return AddIndex<BinaryKey<16>, RID, BinaryComparator<16>>(txn, index_name, table_name, schema, key_schema,
+                                                                  key_attrs, 16, index_oid, create);
+      }
+      if (length <= 32) {
+        return AddIndex<BinaryKey<32>, RID, BinaryComparator<32>>(txn, index_name, table_name, schema, key_schema,
+                                                                  key_attrs, 32, index_oid, create);
+      }
+      if (length <= 64) {
+        return AddIndex<BinaryKey<64>, RID, BinaryComparator<64>>(txn, index_name, table_name, schema, key_schema,
+                                                                  key_attrs, 64, index_oid, create);
+      }
+      throw Exception(ExceptionType::OUT_OF_RANGE, "index key is longer than 64 bytes.");
+    }
+    // VARCHAR 的 key 不定长，放得下的最大的 GenericKey
+    return AddIndex<GenericKey<64>, RID, GenericComparator<64>>(txn, index_name, table_name, schema, key_schema,
+                                                                key_attrs, 64, index_oid, create);
+  }
+
+
+  /** Record a new table or index in the catalog heap if the catalog is open, the heap is created with the first. */
+  void RecordTable(Transaction *txn, TableMetadata *table);
+  void RecordIndex(Transaction *txn, IndexInfo *index);
+  void Record(Transaction *txn, const std::vector<Value> &values);
+  void CreateCatalogHeap();
+
   [[maybe_unused]] BufferPoolManager *bpm_;
   [[maybe_unused]] LockManager *lock_manager_;
-  [[maybe_unused]] LogManager *log_manager_;
+  LogManager *log_manager_;
 
   /** tables_ : table identifiers -> table metadata. Note that tables_ owns all table metadata. */
   // table_id => table_metadata 表
@@ -211,5 +342,12 @@ class Catalog {
   // 下一个索引 index_id
   /** The next index identifier to be used */
   std::atomic<index_oid_t> next_index_oid_{0};
+
+  // 新建索引时页的填充率
+  double index_fill_factor_{0.9};
+
+  // Open 之后表和索引记录在 catalog_heap_ 中
+  bool persistent_{false};
+  std::unique_ptr<TableHeap> catalog_heap_;
 };
 }  // namespace bustub
@@ -46,6 +46,8 @@ class BustubInstance {  // db 实例
   }
 
   ~BustubInstance() {
+    // 检查点要写日志，先于刷新线程停止
+    checkpoint_manager_->StopScheduler();
     if (enable_logging) {
       log_manager_->StopFlushThread();
     }
@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// contention_stats.h
+//
+// Identification: src/include/common/contention_stats.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bustub {
+
+/** What a thread waited for. 等待的对象 */
+enum class ContentionSource { LOCK_MANAGER = 0, PAGE_LATCH, BUFFER_POOL_LATCH, LOG_MANAGER_LATCH };
+
+/**
+ * ContentionStats counts the acquisitions of lock manager locks, page latches, the buffer pool latch and the log
+ * manager latch, and how long the acquisitions that had to wait waited. It is always on.
+ *
+ * Every thread counts in its own counters, only the waits take a latch (of the thread, nobody else takes it but
+ * Collect), Collect adds up the counters of all threads, the threads that exited included. The wait times go to
+ * a histogram of power of two buckets, and each thread remembers the objects (RIDs, pages) it waited for the
+ * longest, at most MAX_HOT_OBJECTS per source; Collect merges them into the top N.
+ */
+class ContentionStats {
+ public:
+  static constexpr size_t SOURCE_NUM = 4;
+  /** Bucket i counts the waits shorter than 2^i microseconds, the last one counts the longer waits too. */
+  static constexpr size_t HISTOGRAM_BUCKET_NUM = 20;
+  /** Objects remembered per thread and source, the one waited for the shortest makes room for a new one. */
+  static constexpr size_t MAX_HOT_OBJECTS = 256;
+  /** Object id of the waits that are not for a particular object, e.g. the buffer pool latch. */
+  static constexpr int64_t NO_OBJECT = -1;
+
+  /** Counters of one source. */
+  struct SourceStats {
+    uint64_t acquires_{0};
+    uint64_t waits_{0};
+    uint64_t wait_ns_{0};
+    uint64_t max_wait_ns_{0};
+    std::array<uint64_t, HISTOGRAM_BUCKET_NUM> histogram_{};
+  };
+
+  /** An object threads waited for: a RID for the lock manager, a page id for the page latches. */
+  struct HotObject {
+    int64_t object_id_;
+    uint64_t waits_;
+    uint64_t wait_ns_;
+  };
+
+  /** The counters of all threads added up. */
+  struct Snapshot {
+    std::array<SourceStats, SOURCE_NUM> sources_;
+    /** The objects waited for the longest, longest first. */
+    std::array<std::vector<HotObject>, SOURCE_NUM> hot_objects_;
+
+    /** @return one line per source followed by its hot objects */
+    std::string ToString() const;
+  };
+
+  /** Count an acquisition, whether it waited or not. */
+  static void RecordAcquire(ContentionSource source) {
+    auto &counter = GetThreadStats()->counters_[static_cast<size_t>(source)].acquires_;
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Count a wait of an acquisition.
+   * @param object_id the RID (RID::Get) or page id waited for, NO_OBJECT if there is none
+   */
+  static void RecordWait(ContentionSource source, int64_t object_id, int64_t wait_ns);
+
+  /** Lock latch, counting the acquisition and the wait if another thread holds it. */
+  static std::unique_lock<std::mutex> Lock(std::mutex *latch, ContentionSource source) {
+    RecordAcquire(source);
+    std::unique_lock<std::mutex> lock(*latch, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      int64_t start = Now();
+      lock.lock();
+      RecordWait(source, NO_OBJECT, Now() - start);
+    }
+    return lock;
+  }
+
+  /**
+   * Add up the counters of all threads.
+   * @param top_n number of hot objects kept per source
+   */
+  static Snapshot Collect(size_t top_n);
+
+  /** Zero the counters of all threads. */
+  static void Reset();
+
+  /** @return the name of source */
+  static const char *SourceName(ContentionSource source);
+
+  static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  // 只有所属线程写，Collect 读，不需要原子的读改写
+  struct SourceCounters {
+    std::atomic<uint64_t> acquires_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> wait_ns_{0};
+    std::atomic<uint64_t> max_wait_ns_{0};
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKET_NUM> histogram_{};
+  };
+
+  struct HotCounter {
+    uint64_t waits_{0};
+    uint64_t wait_ns_{0};
+  };
+
+  struct alignas(64) ThreadStats {
+    std::array<SourceCounters, SOURCE_NUM> counters_;
+    std::mutex hot_latch_;  // 保护 hot_，所属线程只在等待之后拿
+    std::array<std::unordered_map<int64_t, HotCounter>, SOURCE_NUM> hot_;
+  };
+
+  /** @return the counters of the calling thread, registered on first use */
+  static ThreadStats *GetThreadStats();
+
+  /** Add a wait on object_id to hot, making room by dropping the object waited for the shortest. */
+  static void AddHot(std::unordered_map<int64_t, HotCounter> *hot, int64_t object_id, const HotCounter &counter);
+
+  /** Add the counters and hot objects of from to to, with the hot latch of from held. */
+  static void AddThreadStats(ThreadStats *to, const ThreadStats &from);
+
+  static std::mutex registry_latch;                // 保护下面两个成员
+  static std::vector<ThreadStats *> live_threads;  // 所有线程的计数器
+  static ThreadStats retired_threads;              // 已退出线程的计数器之和
+};
+
+}  // namespace bustub
@@ -12,25 +12,49 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <climits>
 #include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
 
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.  读写锁
+ * Reader-Writer latch biased towards readers.  读写锁
+ *
+ * While the latch is read-biased, a reader does not touch the latch: it publishes itself in the visible reader
+ * table, where every thread owns a row of slots and only writes its own row, so readers running on different cores
+ * do not bounce a cache line. A writer takes the underlying latch (std::mutex plus two condition variables), revokes
+ * the bias and waits until no slot of the table points to the latch any more. While the bias is revoked readers use
+ * the underlying latch too, a reader restores the bias once INHIBIT_MULTIPLIER times the cost of the last revocation
+ * has passed, so a latch that is written often stays on the slow path and a read-mostly one, like the root page of
+ * a B+ tree, stays on the fast path.
+ *
+ * Waiters on the underlying latch spin for a short while before blocking.
  */
 class ReaderWriterLatch {
-  using mutex_t = std::mutex;                    // 锁
-  using cond_t = std::condition_variable;        // 条件变量
-  static const uint32_t MAX_READERS = UINT_MAX;  // reader 最大个数
+  using mutex_t = std::mutex;                       // 锁
+  using cond_t = std::condition_variable;           // 条件变量
+  using slot_t = std::atomic<ReaderWriterLatch *>;  // 读者表的槽
+  static const uint32_t MAX_READERS = UINT_MAX;     // reader 最大个数
 
  public:
+  /** Rows of the visible reader table, threads beyond this many always use the underlying latch. */
+  static constexpr size_t READER_ROW_NUM = 64;
+  /** Slots per row, a thread holding more read latches than this at once falls back for some of them. */
+  static constexpr size_t READER_ROW_SIZE = 16;
+  /** How many times a waiter checks the latch before blocking. */
+  static constexpr int SPIN_COUNT = 64;
+  /** The bias stays revoked for this many times the time the last revocation took. */
+  static constexpr int INHIBIT_MULTIPLIER = 9;
+
   ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  ~ReaderWriterLatch();
 
   DISALLOW_COPY(ReaderWriterLatch);  // 禁止拷贝
 
@@ -38,13 +62,24 @@ class ReaderWriterLatch {
    * Acquire a write latch. 获取写锁
    */
   void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {  // 如果有其他人准备写，那么一直等待
-      reader_.wait(latch);
+    SpinWhile([this] { return writer_entered_.load(std::memory_order_relaxed); });
+    {
+      std::unique_lock<mutex_t> latch(mutex_);
+      while (writer_entered_) {  // 如果有其他人准备写，那么一直等待
+        reader_.wait(latch);
+      }
+      writer_entered_ = true;  // 获取到了写锁，那么设置 writer_entered_ 为 true
+    }
+    SpinWhile([this] { return reader_count_.load(std::memory_order_relaxed) > 0; });
+    {
+      std::unique_lock<mutex_t> latch(mutex_);
+      while (reader_count_ > 0) {  // 如果仍然有 reader 正在读，那么一直等待
+        writer_.wait(latch);
+      }
     }
-    writer_entered_ = true;      // 获取到了写锁，那么设置 writer_entered_ 为 true
-    while (reader_count_ > 0) {  // 如果仍然有 reader 正在读，那么一直等待
-      writer_.wait(latch);
+    // 新的读者都走慢路径了，再等偏向读的读者离开
+    if (read_bias_.load(std::memory_order_relaxed)) {
+      RevokeBias();
     }
   }
 
@@ -57,22 +92,82 @@ class ReaderWriterLatch {
     reader_.notify_all();     // 通知所有 reader
   }
 
+  /**
+   * Try to acquire a write latch without waiting. 尝试获取写锁
+   * @return false if a reader or a writer holds the latch
+   */
+  bool TryWLock() {
+    {
+      std::lock_guard<mutex_t> latch(mutex_);
+      if (writer_entered_ || reader_count_ > 0) {
+        return false;
+      }
+      writer_entered_ = true;
+    }
+    // 偏向读时还要读者表里没有读者
+    if (!read_bias_.load(std::memory_order_relaxed) || TryRevokeBias()) {
+      return true;
+    }
+    WUnlock();
+    return false;
+  }
+
   /**
    * Acquire a read latch. 获取读锁
    */
   void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);  // 在函数声明周期内加锁
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);  // 如果有人准备写，或者已达最大数量读，那么等待
+    if (TryBiasedRLock()) {
+      return;
     }
-    reader_count_++;  // 获得了读锁，count++
+    SpinWhile([this] { return writer_entered_.load(std::memory_order_relaxed); });
+    {
+      std::unique_lock<mutex_t> latch(mutex_);  // 在函数声明周期内加锁
+      while (writer_entered_ || reader_count_ == MAX_READERS) {
+        reader_.wait(latch);  // 如果有人准备写，或者已达最大数量读，那么等待
+      }
+      reader_count_++;  // 获得了读锁，count++
+    }
+    RestoreBias();
+  }
+
+  /**
+   * Try to acquire a read latch without waiting. 尝试获取读锁
+   * @return false if a writer holds or waits for the latch
+   */
+  bool TryRLock() {
+    if (TryBiasedRLock()) {
+      return true;
+    }
+    {
+      std::lock_guard<mutex_t> latch(mutex_);
+      if (writer_entered_ || reader_count_ == MAX_READERS) {
+        return false;
+      }
+      reader_count_++;
+    }
+    RestoreBias();
+    return true;
   }
 
   /**
    * Release a read latch. 释放读锁
    */
   void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
+    // 别的线程释放跨线程的读锁时会清掉任意一个指向这个 latch 的槽，包括自己的槽，所以要用 CAS 认领，
+    // 被清掉了就释放慢路径上的一个读锁
+    slot_t *slot = GetReaderSlot();
+    ReaderWriterLatch *expected = this;
+    if (slot != nullptr &&
+        slot->compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+      return;
+    }
+    std::unique_lock<mutex_t> guard(mutex_);
+    if (reader_count_ == 0) {
+      // 读锁是别的线程从读者表拿的，例如事务在一个线程开始，在另一个线程提交；读锁不区分持有者，释放任意一个
+      guard.unlock();
+      ReleaseVisibleReader();
+      return;
+    }
     reader_count_--;             // count --
     if (writer_entered_) {       // 已经有人准备写
       if (reader_count_ == 0) {  // 如果没有人读了，那么通知一个 writer
@@ -86,11 +181,78 @@ class ReaderWriterLatch {
   }
 
  private:
-  mutex_t mutex_;               // 内部锁
-  cond_t writer_;               // 可写变量
-  cond_t reader_;               // 可读变量
-  uint32_t reader_count_{0};    // reader 个数
-  bool writer_entered_{false};  // 是否正在被写
+  // 一个线程的读者槽，独占一段 cache line
+  struct alignas(64) ReaderRow {
+    std::array<slot_t, READER_ROW_SIZE> slots_{};
+  };
+
+  /** @return the slots of the calling thread, nullptr if every row is taken by other threads */
+  static slot_t *GetThreadReaderRow();
+
+  /** @return the slot of the calling thread for this latch, nullptr if the thread has no row */
+  slot_t *GetReaderSlot() {
+    slot_t *row = GetThreadReaderRow();
+    if (row == nullptr) {
+      return nullptr;
+    }
+    auto hash = reinterpret_cast<uintptr_t>(this) * 0x9E3779B97F4A7C15ULL;
+    return &row[(hash >> 32) % READER_ROW_SIZE];
+  }
+
+  /** @return true if the read latch was taken in the visible reader table */
+  bool TryBiasedRLock() {
+    if (!read_bias_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    slot_t *slot = GetReaderSlot();
+    ReaderWriterLatch *expected = nullptr;
+    if (slot != nullptr && slot->compare_exchange_strong(expected, this)) {
+      // 与写者撤销偏向之后扫描读者表配对：要么写者看到这个槽，要么这里看到偏向已撤销
+      if (read_bias_.load()) {
+        return true;
+      }
+      slot->store(nullptr, std::memory_order_release);
+    }
+    return false;
+  }
+
+  /** Called with a read latch taken through the underlying latch, no writer is around. */
+  void RestoreBias() {
+    // 撤销够久之后恢复偏向
+    if (!read_bias_.load(std::memory_order_relaxed) && Now() >= inhibit_until_.load(std::memory_order_relaxed)) {
+      read_bias_.store(true);
+    }
+  }
+
+  /** Wait until no reader is in the visible reader table, with the underlying write latch held. */
+  void RevokeBias();
+
+  /**
+   * Revoke the bias without waiting, with the underlying write latch held.
+   * @return false if readers are left in the table, the bias is then kept
+   */
+  bool TryRevokeBias();
+
+  /** Clear one slot of the visible reader table that points to this latch. */
+  void ReleaseVisibleReader();
+
+  template <typename Predicate>
+  static void SpinWhile(Predicate pred) {
+    for (int i = 0; i < SPIN_COUNT && pred(); i++) {
+    }
+  }
+
+  static int64_t Now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+  static std::array<ReaderRow, READER_ROW_NUM> visible_readers;  // 偏向读时的读者表
+
+  mutex_t mutex_;                            // 内部锁
+  cond_t writer_;                            // 可写变量
+  cond_t reader_;                            // 可读变量
+  std::atomic<uint32_t> reader_count_{0};    // reader 个数，不含读者表里的
+  std::atomic<bool> writer_entered_{false};  // 是否正在被写
+  std::atomic<bool> read_bias_{true};        // 读者是否走读者表
+  std::atomic<int64_t> inhibit_until_{0};    // 在此之前不恢复偏向
 };
 
 }  // namespace bustub
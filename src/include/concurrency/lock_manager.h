@@ -13,6 +13,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <condition_variable>  // NOLINT
 #include <list>
 #include <memory>
@@ -30,81 +31,131 @@ namespace bustub {
 class TransactionManager;
 
 /**
- * LockManager handles transactions asking for locks on records.
+ * How deadlocks are handled. 死锁处理策略
  *
- * 实现一个严格的二阶段提交协议；注意，LockManager 是对 RID 的并发控制，而 B+树 是对 index 的并发控制
+ * DETECTION: a background thread finds cycles in the waits-for graph and aborts the youngest transaction.
+ * WOUND_WAIT: an older transaction aborts (wounds) the younger ones it would wait for, a younger one waits.
+ * WAIT_DIE: an older transaction waits for younger ones, a younger one aborts (dies) instead of waiting for an older.
+ * A transaction is older when its id is smaller.
+ */
+enum class DeadlockMode { DETECTION, WOUND_WAIT, WAIT_DIE };
+
+/**
+ * LockManager handles transactions asking for locks on tables and records.
+ *
+ * 实现一个严格的二阶段提交协议；注意，LockManager 是对表和 RID 的并发控制，而 B+树 是对 index 的并发控制
+ *
+ * Multi-granularity locking: a transaction takes IS (IX) on a table before shared (exclusive) locks on its rows,
+ * or a single S / SIX / X table lock that covers reading (writing) every row, so a full scan takes one lock.
+ * Table and row locks share the lock table, a table is locked through a RID that no row has.
  */
 class LockManager {
-  enum class LockMode { SHARED, EXCLUSIVE };                  // 锁类型，共享还是独占
   enum class VisitedType { NOT_VISITED, IN_STACK, VISITED };  // 访问访问
 
   // 锁请求
   class LockRequest {
    public:
-    LockRequest(txn_id_t txn_id, LockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+    LockRequest(Transaction *txn, LockMode lock_mode)
+        : txn_(txn), txn_id_(txn->GetTransactionId()), lock_mode_(lock_mode), granted_(false) {}
 
+    Transaction *txn_;    // 事务，请求在事务结束前出队
     txn_id_t txn_id_;     // 事务id
     LockMode lock_mode_;  // 锁类型
     bool granted_;        // 是否颁发
   };
 
-  // 锁请求队列
+  // 锁请求队列，由所在分片的 latch_ 保护
   class LockRequestQueue {
    public:
     std::list<LockRequest> request_queue_;
     std::condition_variable cv_;  // for notifying blocked transactions on this rid
     bool upgrading_ = false;      // 是否升级
-    std::mutex latch_;            // 锁
+  };
+
+  /** Number of lock table shards, a power of two. */
+  static constexpr size_t LOCK_TABLE_SHARD_NUM = 64;
+  /** Row locks a transaction holds on a table before they are escalated to a table lock. */
+  static constexpr size_t LOCK_ESCALATION_THRESHOLD = 1000;
+
+  // 锁表分片，RID 的哈希值决定分片；队列空了就从分片中删除
+  struct LockTableShard {
+    std::mutex latch_;  // 保护 lock_table_ 和其中的队列
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
   };
 
  public:
   /**
-   * Creates a new lock manager configured for the deadlock detection policy.
+   * Creates a new lock manager configured for the deadlock policy, only detection runs a background thread.
    */
-  LockManager() {
+  explicit LockManager(DeadlockMode deadlock_mode = DeadlockMode::DETECTION) : deadlock_mode_(deadlock_mode) {
+    if (deadlock_mode_ != DeadlockMode::DETECTION) {
+      return;
+    }
     enable_cycle_detection_ = true;                                                    // 是否死锁检测
     cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);  // 新建线程检查死锁
     LOG_INFO("Cycle detection thread launched");
   }
 
   ~LockManager() {
-    enable_cycle_detection_ = false;
+    if (cycle_detection_thread_ == nullptr) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> latch(latch_);
+      enable_cycle_detection_ = false;
+    }
+    detection_cv_.notify_all();
     cycle_detection_thread_->join();
     delete cycle_detection_thread_;
     LOG_INFO("Cycle detection thread stopped");
   }
 
+  DeadlockMode GetDeadlockMode() const { return deadlock_mode_; }
+
+  /** Set the row locks per table that trigger lock escalation, 0 turns escalation off. */
+  void SetEscalationThreshold(size_t threshold) { escalation_threshold_ = threshold; }
+
+  /** @return how many times row locks were escalated to a table lock */
+  size_t GetEscalationNum() const { return escalation_num_; }
+
   /*
    * [LOCK_NOTE]: For all locking functions, we:
    * 1. return false if the transaction is aborted; and
    * 2. block on wait, return true when the lock request is granted; and
    * 3. it is undefined behavior to try locking an already locked RID in the same transaction, i.e. the transaction
    *    is responsible for keeping track of its current locks.
+   *
+   * Row locks taken with the oid of their table are counted per table. Once a transaction holds
+   * escalation_threshold_ of them, the lock manager tries to take a table lock covering them and releases the row
+   * locks. Escalation never waits: on a conflict the transaction goes on with row locks and tries again later.
    */
 
   /**
    * Acquire a lock on RID in shared mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the shared lock
    * @param rid the RID to be locked in shared mode
+   * @param oid the table of rid, INVALID_TABLE_OID if the lock should never be escalated
    * @return true if the lock is granted, false otherwise
    */
-  bool LockShared(Transaction *txn, const RID &rid);
+  bool LockShared(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Acquire a lock on RID in exclusive mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the exclusive lock
    * @param rid the RID to be locked in exclusive mode
+   * @param oid the table of rid, INVALID_TABLE_OID if the lock should never be escalated
    * @return true if the lock is granted, false otherwise
    */
-  bool LockExclusive(Transaction *txn, const RID &rid);
+  bool LockExclusive(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Upgrade a lock from a shared lock to an exclusive lock.
    * @param txn the transaction requesting the lock upgrade
    * @param rid the RID that should already be locked in shared mode by the requesting transaction
+   * @param oid the table of rid, INVALID_TABLE_OID if the lock should never be escalated
    * @return true if the upgrade is successful, false otherwise
    */
-  bool LockUpgrade(Transaction *txn, const RID &rid);
+  bool LockUpgrade(Transaction *txn, const RID &rid, table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Release the lock held by the transaction.
@@ -114,6 +165,28 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
+  /**
+   * Acquire a table lock, or upgrade the table lock held by the transaction so that it covers mode too,
+   * e.g. S then IX gives SIX. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the lock
+   * @param oid the table to be locked
+   * @param mode any of the five lock modes
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, table_oid_t oid, LockMode mode);
+
+  /**
+   * Release the table lock held by the transaction, its row locks should be released before.
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
+
+  /** @return true if a lock in mode a held by one transaction allows a lock in mode b by another */
+  static bool AreLocksCompatible(LockMode a, LockMode b);
+
+  /** @return the weakest mode that covers both a and b */
+  static LockMode CombineLockModes(LockMode a, LockMode b);
+
   /*** Graph API ***/
   /**
    * Adds edge t1->t2
@@ -135,7 +208,13 @@ class LockManager {
   /** @return the set of all edges in the graph, used for testing only! */
   std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
 
-  /** Runs cycle detection in the background. */
+  /** @return the number of RIDs with a lock request queue, used for testing only! */
+  size_t GetLockTableSize();
+
+  /**
+   * Runs cycle detection in the background. A blocked transaction already looks for the cycles it closes,
+   * the thread is a fallback for the cycles closed while the queues change, e.g. by an upgrade.
+   */
   void RunCycleDetection();
 
   /**
@@ -144,23 +223,26 @@ class LockManager {
    *
    * Return true if and only if:
    * - queue is empty
-   * - compatible with locks that are currently held
+   * - compatible with locks that are currently held, including the ones queued after an upgrading request
    * - all **earlier** requests have been granted already
    * @param lock_request_queue the queue to test compatibility
    * @param lock_request the request to test
    * @return true if compatible, otherwise false
    */
   static bool IsLockCompatible(const LockRequestQueue &lock_request_queue, const LockRequest &target_request) {
+    bool before = true;
     for (auto &&lock_request : lock_request_queue.request_queue_) {
       if (lock_request.txn_id_ == target_request.txn_id_) {  // 如果事务已经在队列中存在
-        return true;
+        before = false;
+        continue;
       }
       // 这个地方需要遍历队列中的每个锁请求，如果有一个不满足，那么直接返回 false
-      // 满足的条件是：所有锁请求，都请求共享锁，且已经被 granted，条件很苛刻
-      // 如果当前锁请求已经被 granted，且 lock_request 和 target_request 都不是独占锁请求
-      const auto isCompatible = lock_request.granted_ &&  // all **earlier** requests have been granted already
-                                lock_request.lock_mode_ != LockMode::EXCLUSIVE &&
-                                target_request.lock_mode_ != LockMode::EXCLUSIVE;
+      // 排在前面的锁请求都要已经被 granted，且与 target_request 兼容；
+      // 升级中的请求排在一些已授予的请求前面，也要与它们兼容
+      const auto isCompatible =
+          before ? lock_request.granted_ &&  // all **earlier** requests have been granted already
+                       AreLocksCompatible(lock_request.lock_mode_, target_request.lock_mode_)
+                 : !lock_request.granted_ || AreLocksCompatible(lock_request.lock_mode_, target_request.lock_mode_);
       if (!isCompatible) {
         return false;
       }
@@ -172,6 +254,88 @@ class LockManager {
   // 隐式 abort
   void AbortImplicitly(Transaction *txn, AbortReason abort_reason);
 
+  /**
+   * Queue the table lock request of txn in target_mode. An upgrade changes the held request in place and moves it
+   * ahead of the waiting requests. The shard latch must be held.
+   */
+  std::list<LockRequest>::iterator QueueTableRequest(LockRequestQueue *lock_request_queue, Transaction *txn,
+                                                     bool upgrade, LockMode target_mode);
+
+  /** Take or upgrade a table lock only if it can be granted right away. */
+  bool TryLockTable(Transaction *txn, table_oid_t oid, LockMode mode);
+
+  /**
+   * Escalate the row locks of txn on the table once they reach the threshold.
+   * @param exclusive whether the row lock being requested is exclusive
+   * @return true if the table lock now covers the request
+   */
+  bool TryEscalate(Transaction *txn, table_oid_t oid, bool exclusive);
+
+  /** Release a row lock without changing the transaction state. */
+  void ReleaseRowLock(Transaction *txn, const RID &rid);
+
+  /** @return the RID through which a table is locked, no row has an invalid page id */
+  static RID TableRID(table_oid_t oid) { return RID(INVALID_PAGE_ID, oid); }
+
+  /** @return the shard of rid, the bits of page id and slot number are mixed so that both spread the rids */
+  LockTableShard *GetShard(const RID &rid) {
+    uint64_t hash = rid.Get();
+    hash = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ULL;
+    return &shards_[hash >> 58 & (LOCK_TABLE_SHARD_NUM - 1)];
+  }
+
+  /**
+   * Remove a lock request with the shard latch held, wake up the waiters it blocked,
+   * and reclaim the queue once it is empty.
+   */
+  void RemoveRequest(LockTableShard *shard, const RID &rid, LockRequestQueue *lock_request_queue,
+                     std::list<LockRequest>::iterator lock_rq);
+
+  /**
+   * Wake up the waiters of the queue if one of them can be granted now, with the shard latch held. Called after a
+   * request is removed, and after a request is granted: a waiter behind it may only have been blocked by it being
+   * ungranted.
+   */
+  static void NotifyWaiters(LockRequestQueue *lock_request_queue);
+
+  /**
+   * Wait with the shard latch held until the request is compatible or the transaction is aborted,
+   * applying the deadlock prevention policy each time the request is found blocked.
+   */
+  void WaitForLock(Transaction *txn, const RID &rid, std::unique_lock<std::mutex> *latch,
+                   LockRequestQueue *lock_request_queue, const LockRequest &lock_request);
+
+  /** @return the unfinished transactions whose requests block lock_request */
+  static std::vector<Transaction *> GetBlockers(const LockRequestQueue &lock_request_queue,
+                                                const LockRequest &lock_request);
+
+  /**
+   * Point the waits-for edges of the waiting requests in the queue at their current blockers,
+   * called with the shard latch and latch_ held whenever the queue changes.
+   */
+  void UpdateWaitsFor(const LockRequestQueue &lock_request_queue);
+
+  /**
+   * Look for a cycle reachable from a blocked transaction, with latch_ held.
+   * @param[out] victim the youngest transaction in the cycle
+   * @return true if there is a cycle
+   */
+  bool FindCycleFrom(txn_id_t txn_id, txn_id_t *victim);
+
+  /**
+   * Apply wound-wait or wait-die to the requests that block lock_request.
+   * @param[out] wounded ids of the younger transactions aborted by wound-wait
+   * @return true if the requesting transaction has to die
+   */
+  bool PreventDeadlock(const LockRequestQueue &lock_request_queue, const LockRequest &lock_request,
+                       std::vector<txn_id_t> *wounded);
+
+  /**
+   * Wake up an aborted transaction if it is waiting for a lock, without a shard latch or latch_ held.
+   * 只按 id 查找：释放锁之后被中止的事务可能已经结束并被回收
+   */
+  void WakeUp(txn_id_t txn_id);
+
   // DFS
   bool ProcessDFSTree(txn_id_t *txn_id, std::stack<txn_id_t> *stack,
                       std::unordered_map<txn_id_t, VisitedType> *visited);
@@ -179,17 +343,26 @@ class LockManager {
   // 获取栈中最早的事务
   txn_id_t GetYoungestTransactionInCycle(std::stack<txn_id_t> *stack, txn_id_t vertex);
 
-  // 构建等待图
-  void BuildWaitsForGraph();
+  // 正在等待的事务
+  struct WaitingTxn {
+    Transaction *txn_;
+    RID rid_;  // 等待的 RID
+  };
 
-  std::mutex latch_;                            // lock_manager 全局锁
+  DeadlockMode deadlock_mode_;                  // 死锁处理策略
+  std::mutex latch_;                            // 保护等待图和 waiting_，在分片锁之后获取
   std::atomic<bool> enable_cycle_detection_{};  // 是否开启死锁检查
   std::thread *cycle_detection_thread_{};       // 死锁检查线程
+  std::condition_variable detection_cv_;        // 停止死锁检查线程
+
+  std::atomic<size_t> escalation_threshold_{LOCK_ESCALATION_THRESHOLD};  // 锁升级阈值
+  std::atomic<size_t> escalation_num_{0};                                // 锁升级次数
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_{};  // RID 加锁队列表
-  /** Waits-for graph representation. */
+  /** Lock table for lock requests, sharded by RID. */
+  std::array<LockTableShard, LOCK_TABLE_SHARD_NUM> shards_;  // RID 加锁队列表
+  /** Waits-for graph representation, only the waiting transactions have edges. */
   std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_{};  // 事务等待队列表
+  std::unordered_map<txn_id_t, WaitingTxn> waiting_{};                // 正在等待的事务
 };
 
 }  // namespace bustub
@@ -0,0 +1,141 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// occ_manager.h
+//
+// Identification: src/include/concurrency/occ_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <unordered_map>
+
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
+
+namespace bustub {
+
+/**
+ * OccManager runs the commit protocol of the OPTIMISTIC transactions (Silo).
+ *
+ * Every row has a TID word, the TID of the transaction that changed it last plus a lock bit. A transaction reads
+ * without locks and records the TID word of each row it reads, its updates and deletes are buffered in its OCC
+ * write set. At commit it locks the TID words of the rows it writes, checks that the rows it read still have the
+ * TID words it saw and are not locked by others, installs the writes in the pages and unlocks the TID words with
+ * its new TID. The index changes of the buffered writes are made after they are installed. Inserts go to the page
+ * at once, the TID word of the new row stays locked until the end of the transaction so that nobody validates a
+ * read of it.
+ *
+ * TIDs carry the epoch they were committed in. With the epoch thread running, each epoch ends with one log flush
+ * and the committers wait for it instead of flushing the log themselves (epoch-based group commit).
+ *
+ * A shard of the TID table drops its unlocked TID words once it holds too many rows. A row without a TID word reads
+ * as the largest TID dropped from its shard, so a dropped row never goes back to an older TID and the readers of
+ * it before the drop fail validation instead of missing a write.
+ *
+ * Only the OPTIMISTIC transactions validate, rows written by 2PL transactions at the same time are not detected.
+ */
+class OccManager {
+ public:
+  /** Number of TID table shards, a power of two. */
+  static constexpr size_t TID_TABLE_SHARD_NUM = 64;
+  /** A shard with more TID words drops the unlocked ones. */
+  static constexpr size_t TID_TABLE_SHARD_CAPACITY = 4096;
+  /** Set while a committing transaction installs its write of the row, or while the row is an uncommitted insert. */
+  static constexpr uint64_t TID_LOCK_BIT = 1ULL << 63;
+  /** A TID is the epoch in the high bits and a sequence number in the low bits. */
+  static constexpr int TID_EPOCH_SHIFT = 32;
+
+  explicit OccManager(LogManager *log_manager = nullptr) : log_manager_(log_manager) {}
+
+  ~OccManager() { StopEpochThread(); }
+
+  /**
+   * Start the thread that ends an epoch every interval, flushing the log of the commits made in it.
+   * @param interval length of an epoch
+   */
+  void RunEpochThread(std::chrono::milliseconds interval);
+
+  /** Stop the epoch thread, committers flush the log themselves again. */
+  void StopEpochThread();
+
+  /** Remember the TID word of rid in the read set of txn, must be called with the page latch held. */
+  void RecordRead(Transaction *txn, const RID &rid);
+
+  /** Lock the TID word of a row just inserted by txn, until txn ends. */
+  void LockInsert(Transaction *txn, const RID &rid);
+
+  /**
+   * Validate the read set of txn and install its buffered writes in the pages, the TID words of the written rows
+   * stay locked until Release.
+   * @param[out] commit_tid the TID of txn, larger than any TID it read or overwrote
+   * @return false if the validation failed, the caller aborts txn
+   */
+  bool ValidateAndInstall(Transaction *txn, uint64_t *commit_tid);
+
+  /** Unlock the TID words of the rows written by a committed txn, setting them to its TID. */
+  void Release(Transaction *txn, uint64_t commit_tid);
+
+  /** Unlock the TID words held by txn after its writes were rolled back, the changed rows get a new TID word. */
+  void Abort(Transaction *txn);
+
+  /** Block until the log up to and including lsn is on disk, with the epoch thread running one flush per epoch. */
+  void WaitForDurable(lsn_t lsn);
+
+  /** @return the current epoch */
+  uint64_t GetEpoch() const { return epoch_; }
+
+  /** @return the TID word of rid, the largest TID dropped from its shard if it has none */
+  uint64_t GetTidWord(const RID &rid);
+
+  /** @return the number of TID words kept */
+  size_t GetTidWordNum();
+
+ private:
+  struct TidTableShard {
+    std::mutex latch_;
+    std::unordered_map<RID, uint64_t> tid_words_;
+    uint64_t dropped_tid_{0};  // 丢掉的 TID 的最大值，没有 TID 字的行读到它
+  };
+
+  /** @return the shard of rid, mixed the same way as the lock table */
+  TidTableShard *GetShard(const RID &rid) {
+    uint64_t hash = rid.Get();
+    hash = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ULL;
+    return &shards_[hash >> 58 & (TID_TABLE_SHARD_NUM - 1)];
+  }
+
+  /** @return false if the TID word of rid is already locked */
+  bool TryLockTid(const RID &rid);
+
+  /** Set the TID word of rid, which also unlocks it. */
+  void SetTid(const RID &rid, uint64_t tid);
+
+  /** Drop the unlocked TID words of a full shard, its latch must be held. */
+  void Reclaim(TidTableShard *shard);
+
+  void RunEpoch();
+
+  LogManager *log_manager_;
+  std::array<TidTableShard, TID_TABLE_SHARD_NUM> shards_;
+  std::atomic<uint64_t> epoch_{1};
+
+  std::mutex epoch_latch_;                       // 保护 epoch 线程的启停
+  std::condition_variable epoch_cv_;             // 停止 epoch 线程
+  std::thread *epoch_thread_{nullptr};           // epoch 线程
+  std::atomic<bool> enable_epoch_{false};        // epoch 线程是否在运行
+  std::chrono::milliseconds epoch_interval_{0};  // epoch 长度
+};
+
+}  // namespace bustub
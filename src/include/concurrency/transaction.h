@@ -12,12 +12,16 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
@@ -51,18 +55,32 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };  // 事
  * 脏读： A事务读取B事务尚未提交的数据，此时如果B事务发生错误并执行回滚操作，那么A事务读取到的数据就是脏数据。
  * 不可重复读：A事务第一次读取数据1，然后B事务更改了数据1为2，然后A事务再次读取，发现数据变成了2。
  * 幻读：幻读发生在其他事务 insert 数据，A事务第一次查询有100条，第二次查询却发现有200条，原因在于其它事务插入了数据。
+ *
+ * 快照隔离：读 Begin 时的快照，不加锁，读写互不阻塞；写仍然加写锁，快照之后被其它事务修改过的行不能再写。
+ * 乐观并发控制（可串行化）：读不加锁，记下行的版本；写缓存在事务里，提交时校验读过的行没有被改过，再写入页。
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };  // 事务隔离级别
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT, OPTIMISTIC };  // 事务隔离级别
 
 /**
  * Type of write operation.
  */
 enum class WType { INSERT = 0, DELETE, UPDATE };  // 写操作
 
+/**
+ * Lock modes of multi-granularity locking, a table takes all of them, a row only SHARED and EXCLUSIVE.
+ * 意向锁表示事务会在表中的行上加对应的锁，SIX 是读整张表并修改其中的一些行
+ */
+enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
+
 class TableHeap;
 class Catalog;
+class VersionStore;
+class OccManager;
 using table_oid_t = uint32_t;
 using index_oid_t = uint32_t;
+static constexpr table_oid_t INVALID_TABLE_OID = UINT32_MAX;
+/** Commit timestamps order the versions of rows, snapshots read the versions up to a timestamp. */
+using timestamp_t = uint64_t;
 
 /**
  * WriteRecord tracks information related to a write.
@@ -111,6 +129,16 @@ class IndexWriteRecord {
   Catalog *catalog_;
 };
 
+/**
+ * LoggedPage tracks a page modified by the current index operation.
+ */
+struct LoggedPage {
+  /** True if children got this page as their new parent. */
+  bool children_moved_{false};
+  /** The page is logged from this offset to the end of its used part, besides its header. */
+  uint32_t offset_{0};
+};
+
 /**
  * Reason to a transaction abortion
  */
@@ -119,7 +147,10 @@ enum class AbortReason {
   UNLOCK_ON_SHRINKING,
   UPGRADE_CONFLICT,
   DEADLOCK,
-  LOCKSHARED_ON_READ_UNCOMMITTED
+  LOCKSHARED_ON_READ_UNCOMMITTED,
+  WRITE_CONFLICT,
+  VALIDATION_FAILED,
+  WRITE_ON_READ_ONLY
 };
 
 /**
@@ -149,6 +180,14 @@ class TransactionAbortException : public std::exception {
         return "Transaction " + std::to_string(txn_id_) + " aborted on deadlock\n";
       case AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED:
         return "Transaction " + std::to_string(txn_id_) + " aborted on lockshared on READ_UNCOMMITTED\n";
+      case AbortReason::WRITE_CONFLICT:
+        return "Transaction " + std::to_string(txn_id_) +
+               " aborted because the row was changed by another transaction after its snapshot\n";
+      case AbortReason::VALIDATION_FAILED:
+        return "Transaction " + std::to_string(txn_id_) +
+               " aborted because the rows it read were changed by another transaction before it committed\n";
+      case AbortReason::WRITE_ON_READ_ONLY:
+        return "Transaction " + std::to_string(txn_id_) + " aborted because it is read-only and tried to write\n";
     }
     // Todo: Should fail with unreachable.
     return "";
@@ -167,18 +206,68 @@ class Transaction {
         txn_id_(txn_id),
         prev_lsn_(INVALID_LSN),
         shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        exclusive_lock_set_{new std::unordered_set<RID>},
+        table_lock_set_{new std::unordered_map<table_oid_t, LockMode>},
+        table_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>} {
     // Initialize the sets that will be tracked.
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    logged_page_set_ = std::make_shared<std::unordered_map<page_id_t, LoggedPage>>();
+    version_write_set_ = std::make_shared<std::vector<RID>>();
+    occ_read_set_ = std::make_shared<std::unordered_map<RID, uint64_t>>();
+    occ_write_set_ = std::make_shared<std::unordered_map<RID, TableWriteRecord>>();
+    occ_lock_set_ = std::make_shared<std::unordered_map<RID, bool>>();
+    occ_index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
   }
 
   ~Transaction() = default;
 
   DISALLOW_COPY(Transaction);  // 禁止拷贝
 
+  /**
+   * Reinitialize a finished transaction as a new one, the sets keep the memory they allocated.
+   * @param txn_id id of the new transaction
+   * @param isolation_level isolation level of the new transaction
+   */
+  void Reset(txn_id_t txn_id, IsolationLevel isolation_level) {
+    state_ = TransactionState::GROWING;
+    isolation_level_ = isolation_level;
+    thread_id_ = std::this_thread::get_id();
+    txn_id_ = txn_id;
+    prev_lsn_ = INVALID_LSN;
+    async_commit_ = false;
+    read_only_ = false;
+    read_ts_ = 0;
+    version_store_ = nullptr;
+    occ_manager_ = nullptr;
+    // 结束的事务的集合通常已经是空的，空的哈希表 clear 也要清零所有桶
+    ClearIfNotEmpty(table_write_set_.get());
+    ClearIfNotEmpty(index_write_set_.get());
+    ClearIfNotEmpty(page_set_.get());
+    ClearIfNotEmpty(deleted_page_set_.get());
+    ClearIfNotEmpty(logged_page_set_.get());
+    ClearIfNotEmpty(version_write_set_.get());
+    ClearIfNotEmpty(occ_read_set_.get());
+    ClearIfNotEmpty(occ_write_set_.get());
+    ClearIfNotEmpty(occ_lock_set_.get());
+    ClearIfNotEmpty(occ_index_write_set_.get());
+    ClearIfNotEmpty(shared_lock_set_.get());
+    ClearIfNotEmpty(exclusive_lock_set_.get());
+    ClearIfNotEmpty(table_lock_set_.get());
+    ClearIfNotEmpty(table_row_lock_set_.get());
+  }
+
+  /** Keep the transaction object from being reused, see TransactionManager::PinTransaction. */
+  inline void Pin() { pin_count_++; }
+
+  /** Undo one Pin. */
+  inline void Unpin() { pin_count_--; }
+
+  /** @return true if someone looked the transaction up and still uses it */
+  inline bool IsPinned() const { return pin_count_ > 0; }
+
   /** @return the id of the thread running the transaction */
   inline std::thread::id GetThreadId() const { return thread_id_; }
 
@@ -228,6 +317,23 @@ class Transaction {
    */
   inline void AddIntoDeletedPageSet(page_id_t page_id) { deleted_page_set_->insert(page_id); }
 
+  /** @return the pages modified by the current index operation */
+  inline std::shared_ptr<std::unordered_map<page_id_t, LoggedPage>> GetLoggedPageSet() { return logged_page_set_; }
+
+  /**
+   * Adds a page to the logged page set, it is logged when the index operation releases its latches.
+   * @param page_id id of the modified page
+   * @param children_moved true if children got a new parent page id
+   * @param offset the first byte modified after the page header
+   */
+  inline void AddIntoLoggedPageSet(page_id_t page_id, bool children_moved = false, uint32_t offset = 0) {
+    auto [iter, inserted] = logged_page_set_->try_emplace(page_id, LoggedPage{children_moved, offset});
+    if (!inserted) {
+      iter->second.children_moved_ |= children_moved;
+      iter->second.offset_ = std::min(iter->second.offset_, offset);
+    }
+  }
+
   /** @return the set of resources under a shared lock */
   inline std::shared_ptr<std::unordered_set<RID>> GetSharedLockSet() { return shared_lock_set_; }
 
@@ -240,6 +346,61 @@ class Transaction {
   /** @return true if rid is exclusively locked by this transaction */
   bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end(); }
 
+  /** @return the locked tables and their lock modes */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> GetTableLockSet() { return table_lock_set_; }
+
+  /** @return the locked rows of each table, lock escalation counts them */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> GetTableRowLockSet() {
+    return table_row_lock_set_;
+  }
+
+  /** @return true if the table lock covers reading every row (S, SIX or X), no row shared lock is needed */
+  bool IsTableSharedLocked(table_oid_t oid) {
+    auto it = table_lock_set_->find(oid);
+    return it != table_lock_set_->end() &&
+           (it->second == LockMode::SHARED || it->second == LockMode::SHARED_INTENTION_EXCLUSIVE ||
+            it->second == LockMode::EXCLUSIVE);
+  }
+
+  /** @return true if the table lock covers writing every row (X), no row lock is needed */
+  bool IsTableExclusiveLocked(table_oid_t oid) {
+    auto it = table_lock_set_->find(oid);
+    return it != table_lock_set_->end() && it->second == LockMode::EXCLUSIVE;
+  }
+
+  /** @return the commit timestamp the snapshot reads up to, only for SNAPSHOT */
+  inline timestamp_t GetReadTs() const { return read_ts_; }
+
+  /** Set the commit timestamp the snapshot reads up to. */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return where the writes keep the old versions of rows, nullptr if they are not versioned */
+  inline VersionStore *GetVersionStore() { return version_store_; }
+
+  /** Set where the writes keep the old versions of rows. */
+  inline void SetVersionStore(VersionStore *version_store) { version_store_ = version_store; }
+
+  /** @return the rows whose version in the page this transaction wrote, stamped at commit */
+  inline std::shared_ptr<std::vector<RID>> GetVersionWriteSet() { return version_write_set_; }
+
+  /** @return the OCC read set, the TID word of each row when it was first read */
+  inline std::shared_ptr<std::unordered_map<RID, uint64_t>> GetOccReadSet() { return occ_read_set_; }
+
+  /** @return the OCC write set, the updates and deletes buffered until commit */
+  inline std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> GetOccWriteSet() { return occ_write_set_; }
+
+  /** @return the rows whose TID word is locked by this transaction, and whether the row was changed in the page */
+  inline std::shared_ptr<std::unordered_map<RID, bool>> GetOccLockSet() { return occ_lock_set_; }
+
+  /** @return the index changes of the buffered updates and deletes, made once the writes are installed */
+  inline std::shared_ptr<std::deque<IndexWriteRecord>> GetOccIndexWriteSet() { return occ_index_write_set_; }
+
+  /** @return where the TID words of rows live, nullptr if the transaction was not started by Begin */
+  inline OccManager *GetOccManager() { return occ_manager_; }
+
+  /** Set where the TID words of rows live. */
+  inline void SetOccManager(OccManager *occ_manager) { occ_manager_ = occ_manager; }
+
   /** @return the current state of the transaction */
   inline TransactionState GetState() { return state_; }
 
@@ -249,6 +410,21 @@ class Transaction {
    */
   inline void SetState(TransactionState state) { state_ = state; }
 
+  /**
+   * Abort the transaction from another thread unless it has already committed or aborted.
+   * 被其它事务中止时不能覆盖已经写入的 COMMITTED
+   * @return true if this call aborted the transaction
+   */
+  inline bool Wound() {
+    auto state = state_.load();
+    while (state == TransactionState::GROWING || state == TransactionState::SHRINKING) {
+      if (state_.compare_exchange_weak(state, TransactionState::ABORTED)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   /** @return the previous LSN */
   inline lsn_t GetPrevLSN() { return prev_lsn_; }
 
@@ -258,15 +434,40 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return true if commit returns without waiting for the COMMIT record to be flushed */
+  inline bool IsAsyncCommit() { return async_commit_; }
+
+  /**
+   * Set the commit mode, an asynchronous commit may be lost on a crash if the flush thread
+   * has not written it yet (at most one flush timeout of commits).
+   * @param async_commit true for asynchronous commit
+   */
+  inline void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
+
+  /** @return true if the transaction was started by BeginReadOnly, any write aborts it */
+  inline bool IsReadOnly() const { return read_only_; }
+
+  /** Declare the transaction read-only, see TransactionManager::BeginReadOnly. */
+  inline void SetReadOnly(bool read_only) { read_only_ = read_only; }
+
  private:
-  /** The current transaction state. */
-  TransactionState state_;
+  template <typename Container>
+  static void ClearIfNotEmpty(Container *container) {
+    if (!container->empty()) {
+      container->clear();
+    }
+  }
+
+  /** The current transaction state, other transactions abort it under wound-wait. */
+  std::atomic<TransactionState> state_;
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
   txn_id_t txn_id_;
+  /** Lookups still using this object, it is not reused before they are done. */
+  std::atomic<int> pin_count_{0};
 
   /** The undo set of table tuples. */
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
@@ -274,16 +475,42 @@ class Transaction {
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** Asynchronous commit, don't wait for the log flush. 异步提交 */
+  bool async_commit_{false};
+  /** Declared read-only: no latch, log records, locks or transaction table entry. 只读事务 */
+  bool read_only_{false};
+  /** Snapshot isolation: the commit timestamp the snapshot reads up to. */
+  timestamp_t read_ts_{0};
+  /** The old versions of the rows written by this transaction are kept here. */
+  VersionStore *version_store_{nullptr};
+  /** Snapshot isolation: the rows this transaction wrote a version of. */
+  std::shared_ptr<std::vector<RID>> version_write_set_;
+  /** OCC: the TID words of rows, validated at commit. */
+  OccManager *occ_manager_{nullptr};
+  /** OCC: the TID word of each row read. */
+  std::shared_ptr<std::unordered_map<RID, uint64_t>> occ_read_set_;
+  /** OCC: the updates and deletes installed at commit. */
+  std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> occ_write_set_;
+  /** OCC: the locked TID words, true if the row was changed. */
+  std::shared_ptr<std::unordered_map<RID, bool>> occ_lock_set_;
+  /** OCC: the index changes made at commit. */
+  std::shared_ptr<std::deque<IndexWriteRecord>> occ_index_write_set_;
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
   /** Concurrent index: the page IDs that were deleted during index operation.*/
   std::shared_ptr<std::unordered_set<page_id_t>> deleted_page_set_;
+  /** Concurrent index: the pages that were modified during index operation, not logged yet. */
+  std::shared_ptr<std::unordered_map<page_id_t, LoggedPage>> logged_page_set_;
 
   /** LockManager: the set of shared-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the locked tables held by this transaction and their lock modes. */
+  std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> table_lock_set_;
+  /** LockManager: the row locks above grouped by table, only rows locked with their table oid are here. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> table_row_lock_set_;
 };
 
 }  // namespace bustub
@@ -12,13 +12,18 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <mutex>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/occ_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/version_store.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -26,13 +31,23 @@ class LockManager;
 
 /**
  * TransactionManager keeps track of all the transactions running in the system.
+ *
+ * The running transactions are kept in a sharded table, a transaction is removed from it when it commits or aborts.
+ * The owner of a finished transaction either deletes it or hands it back with Recycle, Begin reuses recycled
+ * objects so that their sets keep the memory they allocated. A transaction found by PinTransaction is not reused
+ * until it is unpinned, even if it ends and gets recycled meanwhile.
  */
 class TransactionManager {
  public:
+  /** Number of transaction table shards, a power of two. */
+  static constexpr size_t TXN_TABLE_SHARD_NUM = 16;
+  /** At most this many recycled transactions are kept for reuse, the others are deleted. */
+  static constexpr size_t TXN_POOL_SIZE = 1024;
+
   explicit TransactionManager(LockManager *lock_manager, LogManager *log_manager = nullptr)
-      : lock_manager_(lock_manager), log_manager_(log_manager) {}
+      : lock_manager_(lock_manager), log_manager_(log_manager), occ_manager_(log_manager) {}
 
-  ~TransactionManager() = default;
+  ~TransactionManager();
 
   /**
    * Begins a new transaction. 开始一个事务
@@ -42,8 +57,21 @@ class TransactionManager {
    */
   Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
 
+  /**
+   * Begins a read-only transaction. 开始一个只读事务
+   * It reads a snapshot (IsolationLevel::SNAPSHOT) and so takes no locks. It does not take the global
+   * transaction latch, write log records or enter the transaction table, a checkpoint does not wait for it and
+   * GetTransaction does not find it. A write aborts it with AbortReason::WRITE_ON_READ_ONLY. Commit and Abort end
+   * it as usual.
+   * @param txn an optional transaction object to be initialized, otherwise a recycled or new one is used
+   * @return an initialized read-only transaction
+   */
+  Transaction *BeginReadOnly(Transaction *txn = nullptr);
+
   /**
    * Commits a transaction. 事务提交
+   * A synchronous commit returns once the COMMIT record is on disk, an asynchronous one as soon
+   * as it is in the log buffer.
    * @param txn the transaction to commit
    */
   void Commit(Transaction *txn);
@@ -55,23 +83,40 @@ class TransactionManager {
   void Abort(Transaction *txn);
 
   /**
-   * Global list of running transactions
+   * Locates and returns the running transaction with the given transaction ID. The transaction may end and be
+   * reused as soon as the lookup returns, use PinTransaction to keep it.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it is not running
+   */
+  Transaction *GetTransaction(txn_id_t txn_id);
+
+  /**
+   * Locates the running transaction with the given id and pins it, the object is not reused until UnpinTransaction.
+   * @return the pinned transaction, nullptr if it is not running
    */
+  Transaction *PinTransaction(txn_id_t txn_id);
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
+  /** Undo PinTransaction, txn may be reused afterwards if it was recycled. */
+  void UnpinTransaction(Transaction *txn) { txn->Unpin(); }
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * Hand a committed or aborted transaction back for reuse by Begin, instead of deleting it. The caller must not
+   * touch txn afterwards.
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    return res;
-  }
+  void Recycle(Transaction *txn);
+
+  /** @return the number of running transactions */
+  size_t GetRunningTransactionNum();
+
+  /** @return the number of recycled transactions waiting to be reused, pinned ones included */
+  size_t GetPooledTransactionNum();
+
+  /**
+   * Set the commit mode of the transactions created by Begin from now on, each transaction
+   * can still change its own mode with Transaction::SetAsyncCommit.
+   * @param async_commit true for asynchronous commit
+   */
+  void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
 
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
@@ -79,6 +124,12 @@ class TransactionManager {
   /** Resumes(回收) all transactions, used for checkpointing. */
   void ResumeTransactions();
 
+  /** @return the old versions of rows, read by the SNAPSHOT transactions */
+  VersionStore *GetVersionStore() { return &version_store_; }
+
+  /** @return the TID words and epochs of the OPTIMISTIC transactions */
+  OccManager *GetOccManager() { return &occ_manager_; }
+
  private:
   /**
    * Releases all the locks held by the given transaction.
@@ -95,14 +146,52 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    // 先释放行锁，再释放表锁
+    std::vector<table_oid_t> table_set;
+    for (auto &item : *txn->GetTableLockSet()) {
+      table_set.push_back(item.first);
+    }
+    for (auto oid : table_set) {
+      lock_manager_->UnlockTable(txn, oid);
+    }
   }
 
+  struct TxnTableShard {
+    std::mutex latch_;
+    std::unordered_map<txn_id_t, Transaction *> txns_;
+  };
+
+  TxnTableShard *GetShard(txn_id_t txn_id) { return &txn_table_[txn_id & (TXN_TABLE_SHARD_NUM - 1)]; }
+
+  /** Make the index changes buffered by an OPTIMISTIC transaction, after its writes are installed in the pages. */
+  void InstallIndexWrites(Transaction *txn);
+
+  /** End a read-only transaction, it has nothing to undo or to make durable. */
+  void EndReadOnly(Transaction *txn, TransactionState state);
+
+  /** Remove a finished transaction from the transaction table. */
+  void RemoveTransaction(Transaction *txn);
+
+  /** @return a recycled transaction that nobody pins, nullptr if there is none */
+  Transaction *TakeFromPool();
+
   std::atomic<txn_id_t> next_txn_id_{0};
+  /** The running transactions, by id. 运行中的事务表 */
+  std::array<TxnTableShard, TXN_TABLE_SHARD_NUM> txn_table_;
+  std::mutex pool_latch_;                   // 保护下面两个列表
+  std::vector<Transaction *> free_txns_;    // 可以复用的事务
+  std::vector<Transaction *> pinned_txns_;  // 回收时还被 pin 住的事务，unpin 后才能复用
+  /** Commit mode of new transactions. */
+  std::atomic_bool async_commit_{false};
   LockManager *lock_manager_ __attribute__((__unused__));
   LogManager *log_manager_ __attribute__((__unused__));
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
+  /** Multi-version: the old versions of rows written by the running transactions. */
+  VersionStore version_store_;
+  /** Optimistic concurrency control: validates the OPTIMISTIC transactions at commit. */
+  OccManager occ_manager_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,130 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/concurrency/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the old versions of rows for snapshot isolation.
+ *
+ * The table page always holds the newest version of a row, the versions it overwrote are kept here as an undo
+ * chain, newest first. Each version is stamped with the commit timestamp of the transaction that wrote it, a
+ * snapshot sees the newest version committed no later than its read timestamp. A row without a chain is visible
+ * to every snapshot as it is in the page.
+ *
+ * Versions are written under the page latch, so a reader holding the page latch sees the page and its chain
+ * consistently. The chains are sharded by RID, a write latches only the shard of its row. A commit takes its
+ * timestamp under latch_ and then stamps its versions shard by shard, snapshots only read up to the newest
+ * timestamp whose commit and all the earlier ones are stamped, so a snapshot never sees half of a transaction.
+ * A chain is dropped once the oldest active snapshot is newer than the version in the page.
+ */
+class VersionStore {
+ public:
+  /** Take the snapshot of txn, it reads the versions committed before now. */
+  void BeginSnapshot(Transaction *txn);
+
+  /**
+   * Keep the version of rid that txn is overwriting, must be called with the page latch held.
+   * @param old_tuple the overwritten version, nullptr if the row did not exist (insert)
+   */
+  void RecordWrite(Transaction *txn, const RID &rid, const Tuple *old_tuple);
+
+  /** @return true if a version of rid newer than the snapshot of txn was committed (first updater wins) */
+  bool HasWriteConflict(Transaction *txn, const RID &rid);
+
+  /**
+   * Turn the version of rid in the page into the version the snapshot of txn sees, must be called with the
+   * page latch held.
+   * @param[in,out] tuple the tuple in the page, replaced by an older version if needed
+   * @param exists whether the page has a live tuple at rid
+   * @return true if the snapshot sees a version of rid
+   */
+  bool GetVisibleVersion(Transaction *txn, const RID &rid, Tuple *tuple, bool exists);
+
+  /**
+   * Stamp the versions written by txn with a new commit timestamp and end its snapshot. Called before the deletes
+   * are applied, a slot freed by the commit may be reused at once.
+   */
+  void Commit(Transaction *txn);
+
+  /** Drop the versions of txn after its writes were rolled back in the pages, and end its snapshot. */
+  void Abort(Transaction *txn);
+
+  /** @return the commit timestamp of the newest committed transaction */
+  timestamp_t GetLastCommitTs();
+
+  /** @return the number of old versions kept */
+  size_t GetVersionNum();
+
+ private:
+  // 被覆盖的版本
+  struct UndoVersion {
+    Tuple tuple_;
+    bool exists_;            // 插入之前，行不存在
+    timestamp_t commit_ts_;  // 写这个版本的事务的提交时间戳
+  };
+
+  // 一行的版本链，页中是最新版本
+  struct VersionChain {
+    txn_id_t writer_{INVALID_TXN_ID};  // 页中版本未提交时，写它的事务
+    timestamp_t commit_ts_{0};         // 页中版本已提交时，它的提交时间戳
+    std::deque<UndoVersion> undo_;     // 旧版本，新的在前
+  };
+
+  static constexpr size_t VERSION_TABLE_SHARD_NUM = 64;
+
+  struct VersionTableShard {
+    std::mutex latch_;
+    std::unordered_map<RID, VersionChain> chains_;
+  };
+
+  /** @return the shard of rid, mixed the same way as the lock table */
+  VersionTableShard *GetShard(const RID &rid) {
+    uint64_t hash = rid.Get();
+    hash = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ULL;
+    return &shards_[hash >> 58 & (VERSION_TABLE_SHARD_NUM - 1)];
+  }
+
+  /** The page holds the version before the uncommitted one again, the shard latch must be held. */
+  void RollbackVersion(VersionChain *chain);
+
+  /** End the snapshot of txn and drop the chains no snapshot needs, latch_ must be held. */
+  void EndTransaction(Transaction *txn);
+
+  std::array<VersionTableShard, VERSION_TABLE_SHARD_NUM> shards_;
+  std::mutex latch_;                      // 保护下面的快照、提交时间戳和回收队列，在分片的 latch 之前拿
+  std::multiset<timestamp_t> snapshots_;  // 活跃快照的读时间戳
+  std::set<timestamp_t> committing_;      // 已经分配，还在给版本打的提交时间戳
+  /** Rows stamped at a timestamp, their chains may be dropped once every snapshot is at least that new. */
+  std::deque<std::pair<timestamp_t, std::vector<RID>>> gc_queue_;
+  timestamp_t next_commit_ts_{0};  // 最后分配的提交时间戳
+  timestamp_t last_commit_ts_{0};  // 它和之前的提交都打完了时间戳，快照从这里读
+  std::atomic<size_t> version_num_{0};
+  /** Readers skip the shard latch while there is no chain, written under the page latch of the row. */
+  std::atomic<size_t> chain_num_{0};
+};
+
+}  // namespace bustub
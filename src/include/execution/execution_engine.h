@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
@@ -31,6 +32,10 @@ class ExecutionEngine {
 
   bool Execute(const AbstractPlanNode *plan, std::vector<Tuple> *result_set, Transaction *txn,
                ExecutorContext *exec_ctx) {
+    // 索引没有多版本，快照从索引找不到删除了或者改了键的旧版本，用索引的计划要在加锁的事务里执行
+    if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT && ReadsIndex(plan)) {
+      throw NotImplementedException("index scans do not read snapshots, run the plan in a locking transaction");
+    }
     // construct executor
     auto executor = ExecutorFactory::CreateExecutor(exec_ctx, plan);
 
@@ -55,6 +60,12 @@ class ExecutionEngine {
   }
 
  private:
+  /** @return true if the plan finds rows through an index */
+  static bool ReadsIndex(const AbstractPlanNode *plan) {
+    return plan->GetType() == PlanType::IndexScan || plan->GetType() == PlanType::NestedIndexJoin ||
+           std::any_of(plan->GetChildren().begin(), plan->GetChildren().end(), ReadsIndex);
+  }
+
   [[maybe_unused]] BufferPoolManager *bpm_;
   [[maybe_unused]] TransactionManager *txn_mgr_;
   [[maybe_unused]] Catalog *catalog_;
@@ -30,10 +30,6 @@ namespace bustub {
  */
 
 class IndexScanExecutor : public AbstractExecutor {
-  using KeyType = GenericKey<8>;
-  using ValueType = RID;
-  using KeyComparator = GenericComparator<8>;
-
  public:
   /**
    * Creates a new index scan executor.
@@ -55,6 +51,7 @@ class IndexScanExecutor : public AbstractExecutor {
   IndexInfo *index_info_;
   TableMetadata *table_metadata_;
 
-  std::unique_ptr<INDEXITERATOR_TYPE> index_iterator_{nullptr};
+  // 与 key 类型无关的迭代器，索引为空时是 nullptr
+  std::unique_ptr<IndexScanIterator> index_iterator_{nullptr};
 };
 }  // namespace bustub
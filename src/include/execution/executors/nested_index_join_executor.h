@@ -31,10 +31,6 @@ namespace bustub {
  * IndexJoinExecutor executes index join operations.
  */
 class NestIndexJoinExecutor : public AbstractExecutor {
-  using KeyType = GenericKey<8>;
-  using ValueType = RID;
-  using KeyComparator = GenericComparator<8>;
-
  public:
   /**
    * Creates a new nested index join executor.
@@ -19,6 +19,7 @@
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/update_plan.h"
+#include "execution/plans/seq_scan_plan.h"
 #include "storage/table/tuple.h"
 #include "type/value_factory.h"
 
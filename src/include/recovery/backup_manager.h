@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_manager.h
+//
+// Identification: src/include/recovery/backup_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "recovery/log_manager.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * What a backup contains, stored in the manifest file of the backup directory.
+ */
+struct BackupManifest {
+  lsn_t base_start_lsn_;      // 增量备份的基准，只复制 lsn >= 它的页，全量备份为 INVALID_LSN
+  lsn_t start_lsn_;           // 备份开始时的 next lsn，之后修改过的页 lsn 都不小于它
+  lsn_t end_lsn_;             // 备份的日志中最大的 lsn，复制的页都不比它新
+  int64_t log_begin_offset_;  // 备份的日志在日志文件中的范围
+  int64_t log_end_offset_;
+  int32_t page_num_;  // 复制的页数
+};
+
+/**
+ * Online backup, pages are copied while writers continue.
+ *
+ * The copies are fuzzy, each page is consistent on its own but they are taken at different times, the log
+ * copied after them brings every page up to end_lsn_. An incremental backup copies only the pages changed
+ * since its base started and the log written since its base ended, a restore applies a full backup and its
+ * incrementals in order and keeps the log up to the target lsn, the usual recovery finishes the job.
+ *
+ *   backup dir: | manifest | pages: (page_id, page data)... | log: log file [log_begin_offset_, log_end_offset_) |
+ */
+class BackupManager {
+ public:
+  BackupManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager)
+      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), log_manager_(log_manager) {}
+
+  /**
+   * Limit the I/O of a backup so foreground requests don't starve.
+   * @param bytes_per_sec bytes copied per second, 0 means no limit
+   */
+  void SetThrottle(size_t bytes_per_sec) { max_bytes_per_sec_ = bytes_per_sec; }
+
+  /**
+   * Back the database up into backup_dir, logging must be on.
+   * @param backup_dir directory of the backup, created if it does not exist
+   * @param base manifest of the previous backup of the chain, nullptr for a full backup
+   * @return manifest of the backup
+   */
+  BackupManifest Backup(const std::string &backup_dir, const BackupManifest *base = nullptr);
+
+  static BackupManifest ReadManifest(const std::string &backup_dir);
+
+  /**
+   * Rebuild the database file and its log from a backup chain, the database must then be recovered
+   * (Redo and Undo) before use. Existing files at db_file are overwritten.
+   * @param backup_dirs a full backup followed by its incrementals, in order
+   * @param db_file the database file to restore to
+   * @param target_lsn the last lsn to restore, INVALID_LSN restores everything in the backups
+   * @return the last lsn restored
+   */
+  static lsn_t Restore(const std::vector<std::string> &backup_dirs, const std::string &db_file,
+                       lsn_t target_lsn = INVALID_LSN);
+
+ private:
+  void Throttle(size_t bytes);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
+  size_t max_bytes_per_sec_{0};
+  size_t copied_bytes_{0};
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+}  // namespace bustub
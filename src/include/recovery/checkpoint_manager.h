@@ -12,14 +12,56 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
 
+/**
+ * Targets of the checkpoint scheduler, reaching any of them triggers a checkpoint.
+ */
+struct CheckpointPolicy {
+  /** Log bytes written since the last checkpoint, recovery reads all of them. */
+  size_t max_log_bytes_{16 << 20};
+  /** Dirty pages / buffer pool size. */
+  double max_dirty_ratio_{0.75};
+  /** Estimated time to recover if the database crashed now. */
+  std::chrono::milliseconds max_recovery_time_{std::chrono::seconds(10)};
+  /** Redo speed and the time to read a dirty page back, the recovery time is estimated from them. */
+  size_t redo_bytes_per_sec_{64 << 20};
+  std::chrono::microseconds page_read_time_{100};
+  /** How often the targets are checked. */
+  std::chrono::milliseconds check_interval_{100};
+  /** Dirty pages are written back evenly over this time before transactions are blocked. */
+  std::chrono::milliseconds flush_duration_{std::chrono::seconds(1)};
+};
+
+/** Checkpoint metrics. */
+struct CheckpointStats {
+  size_t checkpoint_num_;         // 检查点次数
+  int64_t last_duration_ms_;      // 上次检查点耗时，包括均匀刷脏页的时间
+  int64_t last_block_ms_;         // 上次检查点阻塞事务的时间
+  size_t last_pages_written_;     // 上次检查点写的页数
+  size_t total_pages_written_;    // 所有检查点写的页数
+  size_t log_bytes_;              // 上次检查点之后的日志字节数
+  double dirty_ratio_;            // 脏页比例
+  int64_t estimated_recovery_ms_;  // 现在崩溃，估计的恢复时间
+};
+
 /**
  * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ *
+ * The scheduler thread keeps the recovery work bounded: when a target of the policy is reached, the dirty
+ * pages are written back at a steady pace while transactions go on, then the checkpoint itself only has
+ * the pages dirtied meanwhile to flush. Recovery starts at the last checkpoint.
  */
 class CheckpointManager {
  public:
@@ -29,15 +71,43 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager() { StopScheduler(); }
 
   void BeginCheckpoint();
   void EndCheckpoint();
 
+  /**
+   * Write the dirty pages back over flush_duration, then take a consistent checkpoint.
+   */
+  void Checkpoint(std::chrono::milliseconds flush_duration = std::chrono::milliseconds(0));
+
+  /**
+   * Start the scheduler thread, checkpoints are taken only while logging is on and no page waits for the redo
+   * of an instant restart.
+   */
+  void StartScheduler(const CheckpointPolicy &policy);
+  void StopScheduler();
+
+  CheckpointStats GetStats();
+
  private:
+  void RunScheduler();
+  /** @return why a checkpoint is needed, empty if it is not */
+  std::string NeedCheckpoint(const CheckpointStats &stats);
+
   TransactionManager *transaction_manager_ __attribute__((__unused__));
   LogManager *log_manager_ __attribute__((__unused__));
   BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+
+  size_t flushed_pages_{0};  // 上次 BeginCheckpoint 写的页数
+  CheckpointPolicy policy_;
+  std::thread *scheduler_thread_{nullptr};
+  std::mutex scheduler_latch_;
+  std::condition_variable scheduler_cv_;
+  bool stop_scheduler_{false};
+
+  std::mutex stats_latch_;  // 保护 stats_
+  CheckpointStats stats_{};
 };
 
 }  // namespace bustub
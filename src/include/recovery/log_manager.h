@@ -13,6 +13,7 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
@@ -32,6 +33,10 @@ class LogManager {
       : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
+    lsn_t checkpoint_lsn;
+    if (disk_manager_ != nullptr && !disk_manager_->ReadMasterRecord(&checkpoint_offset_, &checkpoint_lsn)) {
+      checkpoint_offset_ = 0;
+    }
   }
 
   ~LogManager() {
@@ -45,14 +50,49 @@ class LogManager {
   void StopFlushThread();
   void Flush(bool force);
 
+  /** Block until the log up to and including lsn is on disk, concurrent waiters share one flush. */
+  void WaitForFlush(lsn_t lsn);
+
+  /**
+   * Set how long the flush thread sleeps between two flushes when nobody asks for one, this bounds
+   * the commits an asynchronous commit can lose on a crash. Zero means log_timeout.
+   */
+  void SetFlushTimeout(std::chrono::milliseconds timeout);
+
+  /**
+   * Block until the persistent lsn moves past lsn or the timeout expires, used to ship the log as soon
+   * as it reaches the disk.
+   * @return the persistent lsn
+   */
+  lsn_t WaitForPersistentLSN(lsn_t lsn, std::chrono::milliseconds timeout);
+
   lsn_t AppendLogRecord(LogRecord *log_record);
 
+  /**
+   * Log a checkpoint and point the master record at it, the caller makes sure every page is flushed and
+   * no transaction is active, the log before it is no longer needed by recovery.
+   * @return lsn of the checkpoint record
+   */
+  lsn_t LogCheckpoint();
+
+  /** @return bytes of log written after the last checkpoint, buffered ones included */
+  int GetLogSizeSinceCheckpoint();
+
   inline lsn_t GetNextLSN() { return next_lsn_; }
+  /** Continue numbering after the log found on disk, used by recovery. */
+  inline void SetNextLSN(lsn_t lsn) { next_lsn_ = lsn; }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
+  /**
+   * Whether a page stamped with lsn must wait for a log flush before it is written (WAL). Only LSNs this log manager
+   * handed out count: with logging off nothing is appended, and pages keep the LSNs of an older log.
+   */
+  inline bool NeedFlush(lsn_t lsn) { return persistent_lsn_ < lsn && lsn < next_lsn_; }
   inline char *GetLogBuffer() { return log_buffer_; }
 
  private:
+  void FlushLogBuffer();
+
   /** The atomic counter which records the next log sequence number. */
   std::atomic<lsn_t> next_lsn_;  // 下一个日志id
   /** The log records before and including the persistent lsn have been written to disk. */
@@ -60,7 +100,7 @@ class LogManager {
   char *log_buffer_;                                       // 日志缓存
   char *flush_buffer_;                                     // 刷新缓存
   std::mutex latch_;                                       // 锁
-  std::thread *flush_thread_ __attribute__((__unused__));  // 刷新线程
+  std::thread *flush_thread_{nullptr};                     // 刷新线程
   std::condition_variable cv_;                             // 等待条件变量
   DiskManager *disk_manager_ __attribute__((__unused__));  // 磁盘管理器
   lsn_t last_lsn_{INVALID_LSN};                            // 最后一个日志 LSN
@@ -68,6 +108,8 @@ class LogManager {
   std::condition_variable append_cv_;                      // 追加等待变量
   int32_t flush_buffer_size_{0};                           // flush_buffer 大小
   int32_t log_buffer_offset_{0};                           // log_buffer 偏移
+  std::chrono::milliseconds flush_timeout_{0};             // 刷新间隔，0 表示 log_timeout
+  int checkpoint_offset_{0};                               // 最后一个检查点在日志文件中的偏移
 };
 
 }  // namespace bustub
@@ -14,6 +14,8 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +34,17 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Compensation log record, written by undo. */
+  CLR,
+  /** Update of a same-size tuple that only logs the changed byte ranges. */
+  DELTAUPDATE,
+  /** Key inserted into / removed from an index, logical, only used to undo losers. */
+  INDEXINSERT,
+  INDEXDELETE,
+  /** Pages written by one index operation, physical and redo only, a whole split or merge is one record. */
+  INDEXPAGES,
+  /** Consistent checkpoint: every page flushed and no transaction active, recovery starts at the last one. */
+  CHECKPOINT,
 };
 
 /**
@@ -59,10 +72,33 @@ enum class LogRecordType {
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
  *
+ * For delta update type log record, each range is | offset | length | old_bytes | new_bytes |
+ * (uint16_t offset/length), the number of ranges follows from size
+ *--------------------------------------------
+ * | HEADER | tuple_rid | range_1 | range_2 ... |
+ *--------------------------------------------
+ *
+ * For index insert/delete type log record (the key and value are the raw bytes of the index entry)
+ *-------------------------------------------------------------------------------------------
+ * | HEADER | name_size | index_name | key_size | key | value_size | value |
+ *-------------------------------------------------------------------------------------------
+ *
+ * For index pages type log record, each write is | page_id | offset | length | bytes |
+ * (uint16_t offset/length), written with INVALID_TXN_ID since it is never undone
+ *--------------------------------------------
+ * | HEADER | write_1 | write_2 ... |
+ *--------------------------------------------
+ *
  * For new page type log record
  *------------------------------------
  * | HEADER | prev_page_id | page_id |
  *------------------------------------
+ *
+ * For compensation log record, the body is the action that undid a record, laid out as the
+ * record of action_type above (undoing a NEWPAGE is logged as a NEWPAGE action, meaning unlink)
+ *------------------------------------------------------------
+ * | HEADER | undo_next_lsn | action_type | action body ... |
+ *------------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
@@ -104,6 +140,38 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
 
+  // constructor for DELTAUPDATE type 增量更新，delta 由 EncodeDelta 生成
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, const RID &update_rid, std::string delta)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(LogRecordType::DELTAUPDATE),
+        update_rid_(update_rid),
+        delta_(std::move(delta)) {
+    size_ = HEADER_SIZE + sizeof(RID) + delta_.size();
+  }
+
+  // constructor for INDEXINSERT/INDEXDELETE type 索引插入、删除
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, std::string index_name,
+            std::string index_key, std::string index_value)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        index_name_(std::move(index_name)),
+        index_key_(std::move(index_key)),
+        index_value_(std::move(index_value)) {
+    assert(log_record_type == LogRecordType::INDEXINSERT || log_record_type == LogRecordType::INDEXDELETE);
+    size_ = HEADER_SIZE + 3 * sizeof(int32_t) + index_name_.size() + index_key_.size() + index_value_.size();
+  }
+
+  // constructor for INDEXPAGES type 索引页修改，page_writes 由 AddPageWrite 生成
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, std::string page_writes)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(LogRecordType::INDEXPAGES),
+        page_writes_(std::move(page_writes)) {
+    size_ = HEADER_SIZE + page_writes_.size();
+  }
+
   // constructor for NEWPAGE type 新页
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
       : size_(HEADER_SIZE),
@@ -116,6 +184,16 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for CLR type 补偿日志，action 为撤销所执行的操作
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, lsn_t undo_next_lsn, const LogRecord &action) : LogRecord(action) {
+    txn_id_ = txn_id;
+    prev_lsn_ = prev_lsn;
+    log_record_type_ = LogRecordType::CLR;
+    undo_next_lsn_ = undo_next_lsn;
+    action_type_ = action.log_record_type_;
+    size_ = action.size_ + sizeof(lsn_t) + sizeof(LogRecordType);
+  }
+
   ~LogRecord() = default;
 
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
@@ -132,6 +210,16 @@ class LogRecord {
 
   inline RID &GetUpdateRID() { return update_rid_; }
 
+  inline const std::string &GetDelta() { return delta_; }
+
+  inline const std::string &GetIndexName() { return index_name_; }
+
+  inline const std::string &GetIndexKey() { return index_key_; }
+
+  inline const std::string &GetIndexValue() { return index_value_; }
+
+  inline const std::string &GetPageWrites() { return page_writes_; }
+
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
   inline int32_t GetSize() { return size_; }
@@ -144,6 +232,39 @@ class LogRecord {
 
   inline LogRecordType &GetLogRecordType() { return log_record_type_; }
 
+  inline lsn_t GetUndoNextLSN() { return undo_next_lsn_; }
+
+  /** @return the type of the action carried in the body, the record type itself unless this is a CLR */
+  inline LogRecordType GetActionType() {
+    return log_record_type_ == LogRecordType::CLR ? action_type_ : log_record_type_;
+  }
+
+  /**
+   * Encode the byte ranges that differ between two tuples into delta.
+   * @return false if the tuples differ in size or the delta is not smaller than the full images,
+   * in which case an UPDATE record should be logged instead
+   */
+  static bool EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::string *delta);
+
+  /** Write the new bytes of every range of delta into data. */
+  static void ApplyDelta(const std::string &delta, char *data);
+
+  /** @return delta with the old and new bytes of every range swapped, applying it undoes delta */
+  static std::string InvertDelta(const std::string &delta);
+
+  /** Append a write of length bytes at offset of page page_id to page_writes. */
+  static void AddPageWrite(std::string *page_writes, page_id_t page_id, uint32_t offset, const char *data,
+                           uint32_t length);
+
+  /**
+   * Apply the writes for page_id to data.
+   * @return true if page_writes has a write for page_id
+   */
+  static bool ApplyPageWrites(const std::string &page_writes, page_id_t page_id, char *data);
+
+  /** @return the pages written by page_writes, each once, in the order of their first write */
+  static std::vector<page_id_t> GetWrittenPages(const std::string &page_writes);
+
   // For debug purpose
   inline std::string ToString() const {
     std::ostringstream os;
@@ -178,10 +299,22 @@ class LogRecord {
   RID update_rid_;
   Tuple old_tuple_;
   Tuple new_tuple_;
+  // for delta update operation, the changed ranges
+  std::string delta_;
+
+  // case6: for index operation
+  std::string index_name_;
+  std::string index_key_;
+  std::string index_value_;
+  std::string page_writes_;
 
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case5: for compensation log record
+  lsn_t undo_next_lsn_{INVALID_LSN};
+  LogRecordType action_type_{LogRecordType::INVALID};
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
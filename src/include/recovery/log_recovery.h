@@ -13,26 +13,65 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/version_store.h"
+#include "recovery/log_manager.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo 可以按页并行：读线程顺序解析日志，按 page_id 哈希把记录分发给 worker，
+ * 同一页的记录始终落在同一个 worker 上，因此单页内仍按 LSN 顺序重做。
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /** Max records buffered per redo worker before the log reader blocks. */
+  static constexpr size_t REDO_QUEUE_DEPTH = 64;
+
+  /**
+   * Undo of a logged index entry: is_insert tells the entry was inserted (so it has to be removed),
+   * key and value are the raw bytes of the entry.
+   */
+  using IndexUndoHandler = std::function<void(bool is_insert, const char *key, const char *value)>;
+
+  /**
+   * @param disk_manager the disk manager
+   * @param buffer_pool_manager the buffer pool manager
+   * @param log_manager the log manager compensation log records are written to, nullptr means no CLR
+   * @param redo_worker_num number of redo workers, 1 means redo on the calling thread
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager = nullptr,
+              size_t redo_worker_num = 1)
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        log_manager_(log_manager),
+        redo_worker_num_(std::max<size_t>(redo_worker_num, 1)),
+        offset_(0) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
   ~LogRecovery() {
+    StopBackgroundRedo();
+    if (pending_page_num_ > 0) {
+      buffer_pool_manager_->SetLogRecovery(nullptr);
+    }
     delete[] log_buffer_;
     log_buffer_ = nullptr;
   }
@@ -41,19 +80,109 @@ class LogRecovery {
   void Undo();
   bool DeserializeLogRecord(const char *data, LogRecord *log_record);
 
+  /**
+   * Index undo is logical, so an index must be opened after redo and registered here before Undo,
+   * entries of losers in indexes nobody registered are left as they are.
+   */
+  void RegisterIndex(const std::string &index_name, IndexUndoHandler handler) {
+    index_undo_handlers_[index_name] = std::move(handler);
+  }
+
+  /*
+   * Instant restart, instead of Redo():
+   *   Analyze();             // build the per-page pending records, attach to the buffer pool
+   *   Undo();                // loser pages are redone on demand first
+   *   StartBackgroundRedo(); // queries can be served from here on
+   */
+  void Analyze();
+  bool RecoverPage(Page *page);
+  void StartBackgroundRedo();
+  void StopBackgroundRedo();
+  /** Redo every page still pending on the calling thread, before a checkpoint. */
+  void RedoPendingPages();
+  /** @return number of pages still waiting for redo */
+  size_t GetPendingPageNum() { return pending_page_num_; }
+
+  /*
+   * Hot standby, the log shipped from the primary is replayed as it arrives:
+   *   SetVersionStore(...);                   // before Redo
+   *   Redo();                                 // the local copy of the log
+   *   ReplayLog(GetLogEndOffset(), ...) ...   // records received from the primary
+   *   Undo();                                 // on failover, then turn logging on
+   */
+  int ReplayLog(int log_offset, const char *data, int size);
+  /**
+   * Keep the versions overwritten by the transactions the log hasn't finished in version_store, snapshot reads
+   * on the standby see a transaction once its COMMIT is replayed.
+   */
+  void SetVersionStore(VersionStore *version_store) { version_store_ = version_store; }
+  /** @return offset in the log file right after the last complete record redone */
+  int GetLogEndOffset() { return log_end_offset_; }
+  /** @return the largest lsn redone */
+  lsn_t GetMaxLSN() { return max_lsn_; }
+
  private:
+  /** Records dispatched to one redo worker, each tagged with the page it should be applied to. */
+  struct RedoQueue {
+    std::deque<std::pair<page_id_t, LogRecord>> records_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    bool finished_{false};
+  };
+
+  void StartRedoWorkers();
+  void StopRedoWorkers();
+  void RunRedoWorker(RedoQueue *queue);
+  bool RedoNextPendingPage();
+  static void DeserializeHeader(const char *data, LogRecord *log_record);
+  void DispatchRedo(page_id_t page_id, LogRecord *log);
+  void ScanLog();
+  int GetStartOffset();
+  void ScanRecord(LogRecord *log, int offset);
+  void RedoPage(page_id_t page_id, LogRecord *log);
+  bool RedoOnPage(page_id_t page_id, TablePage *page, LogRecord *log);
+  void ApplyAction(TablePage *page, LogRecord *log);
+  void UndoRecord(LogRecord *log, lsn_t *last_lsn);
+  void UndoIndexRecord(LogRecord *log, lsn_t *last_lsn);
+  void ReadLogRecord(int offset, LogRecord *log);
+  void RecordActiveVersions();
+  void RecordVersion(TablePage *page, LogRecord *log);
+  void EndVersions(txn_id_t txn_id, bool commit);
+  Page *FetchPage(page_id_t page_id);
+
   DiskManager *disk_manager_ __attribute__((__unused__));
   BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
+
+  size_t redo_worker_num_;
+  std::vector<std::unique_ptr<RedoQueue>> redo_queues_;
+  std::vector<std::thread> redo_workers_;
+  page_id_t last_prefetch_page_id_{INVALID_PAGE_ID};  // 读线程上一次预读的页
+
+  /** Instant restart: pending log records of every page not redone yet. */
+  // page_id => records
+  std::unordered_map<page_id_t, std::vector<LogRecord>> pending_pages_;
+  std::mutex pending_latch_;
+  std::atomic<size_t> pending_page_num_{0};
+  bool analyze_only_{false};
+  std::atomic<bool> enable_background_redo_{false};
+  std::thread *background_redo_thread_{nullptr};
 
-  /** Maintain active transactions and its corresponding latest lsn. */
-  // txb => lsn
-  std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  // lsn => log offset
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** Maintain active transactions and the (lsn, log file offset) of their records, for undos. */
+  // txn => [(lsn, log offset)]
+  std::unordered_map<txn_id_t, std::vector<std::pair<lsn_t, int>>> active_txn_;
+  std::atomic<lsn_t> max_lsn_{INVALID_LSN};  // 日志中最大的 lsn
+  int log_end_offset_{0};                    // 最后一条完整日志在日志文件中的结尾
+  /** Standby: the unfinished transactions whose versions are kept in version_store_. */
+  VersionStore *version_store_{nullptr};
+  std::unordered_map<txn_id_t, std::unique_ptr<Transaction>> version_txns_;
+  bool replaying_{false};  // ReplayLog 中，页按日志顺序重做
+  // index name => undo handler
+  std::unordered_map<std::string, IndexUndoHandler> index_undo_handlers_;
 
   int offset_ __attribute__((__unused__));  // 日志缓冲区已读偏移
   char *log_buffer_;                        // 日志缓冲区
+  int window_offset_{-1};                   // undo 时 log_buffer_ 对应的日志文件偏移
 };
 
 }  // namespace bustub
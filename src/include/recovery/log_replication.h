@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_replication.h
+//
+// Identification: src/include/recovery/log_replication.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * Streaming log replication to hot standbys over local TCP.
+ *
+ * The standby connects and sends the offset its copy of the log ends at, the primary streams its log file
+ * from there as soon as the log manager flushes it. The standby appends what it receives to its own log,
+ * so the two log files stay byte for byte the same, replays it with LogRecovery and acknowledges.
+ *
+ *   standby -> primary: | start offset (8) |
+ *   primary -> standby: | ShipHeader | log bytes |    (no log bytes: heartbeat)
+ *   standby -> primary: | ShipAck |
+ */
+struct ShipHeader {
+  int64_t offset_;        // 这段日志在日志文件中的偏移
+  int32_t size_;          // 日志字节数
+  lsn_t persistent_lsn_;  // 主库已持久化的 lsn
+  int64_t send_time_us_;  // 发送时间，system_clock，主备在同一台机器上
+};
+
+struct ShipAck {
+  int64_t replayed_offset_;  // standby 已重做到的日志偏移
+  lsn_t replayed_lsn_;       // standby 已重做的最大 lsn
+};
+
+/**
+ * Primary side, one sender thread per connected standby.
+ */
+class LogShipper {
+ public:
+  /** Heartbeats carry the persistent lsn while the primary is idle, so the standby lag stays fresh. */
+  static constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{100};
+
+  /** Replication metrics of one standby. */
+  struct StandbyStats {
+    int64_t shipped_offset_;   // 已发送的日志偏移
+    int64_t replayed_offset_;  // standby 已重做到的日志偏移
+    lsn_t replayed_lsn_;       // standby 已重做的最大 lsn
+    int64_t lag_bytes_;        // 主库日志文件大小 - replayed_offset_
+  };
+
+  LogShipper(DiskManager *disk_manager, LogManager *log_manager)
+      : disk_manager_(disk_manager), log_manager_(log_manager) {}
+
+  ~LogShipper() { Stop(); }
+
+  /**
+   * Listen for standbys on 127.0.0.1.
+   * @param port the port, 0 picks a free one
+   * @return the port listened on
+   */
+  int Start(int port);
+  void Stop();
+
+  /** @return metrics of the connected standbys */
+  std::vector<StandbyStats> GetStats();
+
+ private:
+  struct Standby {
+    int fd_;
+    std::thread sender_;
+    std::thread ack_receiver_;
+    std::atomic<bool> connected_{true};
+    std::atomic<int64_t> shipped_offset_{0};
+    std::atomic<int64_t> replayed_offset_{0};
+    std::atomic<lsn_t> replayed_lsn_{INVALID_LSN};
+  };
+
+  void Accept();
+  void Ship(Standby *standby);
+  void ReceiveAcks(Standby *standby);
+
+  DiskManager *disk_manager_;
+  LogManager *log_manager_;
+  int listen_fd_{-1};
+  std::atomic<bool> running_{false};
+  std::thread *accept_thread_{nullptr};
+  std::mutex latch_;  // 保护 standbys_
+  std::vector<std::unique_ptr<Standby>> standbys_;
+};
+
+/**
+ * Standby side, receives the log of the primary and replays it continuously. The standby must have
+ * redone its local copy of the log with log_recovery before Start, logging stays off until failover.
+ */
+class LogReceiver {
+ public:
+  /** Replication metrics of the standby. */
+  struct Stats {
+    bool connected_;
+    int64_t received_offset_;  // 已收到的日志偏移
+    int64_t replayed_offset_;  // 已重做到的日志偏移
+    lsn_t replayed_lsn_;       // 已重做的最大 lsn
+    lsn_t primary_lsn_;        // 主库已持久化的 lsn
+    lsn_t lag_lsn_;            // primary_lsn_ - replayed_lsn_
+    int64_t replay_lag_ms_;    // 最近一段日志从主库发出到重做完的时间，追上后为 0
+  };
+
+  LogReceiver(DiskManager *disk_manager, LogManager *log_manager, LogRecovery *log_recovery)
+      : disk_manager_(disk_manager), log_manager_(log_manager), log_recovery_(log_recovery) {
+    buffers_[0] = new char[LOG_BUFFER_SIZE];
+    buffers_[1] = new char[LOG_BUFFER_SIZE];
+  }
+
+  ~LogReceiver() {
+    Stop();
+    delete[] buffers_[0];
+    delete[] buffers_[1];
+  }
+
+  /**
+   * Connect to the primary and start replaying, throws an Exception when the primary is unreachable.
+   */
+  void Start(const std::string &host, int port);
+  /** Disconnect, what was received is replayed and on disk, the standby can be promoted afterwards. */
+  void Stop();
+
+  Stats GetStats();
+
+ private:
+  void Receive();
+
+  DiskManager *disk_manager_;
+  LogManager *log_manager_;
+  LogRecovery *log_recovery_;
+  int fd_{-1};
+  std::thread *receive_thread_{nullptr};
+  std::atomic<bool> connected_{false};
+  // 日志先写入本地日志文件，DiskManager 要求两个缓冲区交替使用
+  char *buffers_[2];
+  int next_buffer_{0};
+  std::string pending_;  // 收到但还不完整的日志记录
+  std::atomic<int64_t> received_offset_{0};
+  std::atomic<int64_t> replayed_offset_{0};
+  std::atomic<lsn_t> primary_lsn_{INVALID_LSN};
+  std::atomic<int64_t> replay_lag_ms_{0};
+};
+
+}  // namespace bustub
@@ -101,11 +101,38 @@ class DiskManager {
   /** Checks if the non-blocking flush future was set. */
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
+  /** @return the name of the log file */
+  inline const std::string &GetLogFileName() const { return log_name_; }
+
+  /** @return the size of the log file in bytes */
+  inline int GetLogFileSize() { return GetFileSize(log_name_); }
+
+  /** @return number of pages allocated, page ids are below it */
+  inline page_id_t GetNumPages() const { return next_page_id_; }
+
+  /**
+   * Write the master record: offset and lsn of the last checkpoint record in the log, recovery starts there.
+   * @param log_offset offset of the checkpoint record in the log file
+   * @param lsn lsn of the checkpoint record
+   */
+  void WriteMasterRecord(int log_offset, lsn_t lsn);
+
+  /**
+   * Read the master record.
+   * @return false if there is none
+   */
+  bool ReadMasterRecord(int *log_offset, lsn_t *lsn);
+
+  /** @return the name of the master record file */
+  inline const std::string &GetMasterRecordFileName() const { return master_name_; }
+
  private:
   int GetFileSize(const std::string &file_name);
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
+  // master record, 最后一个检查点的位置
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
@@ -15,7 +15,9 @@
 #include <utility>
 #include <vector>
 
+#include "common/rwlatch.h"
 #include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
@@ -45,7 +47,14 @@ class BPlusTree {
 
  public:
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     LogManager *log_manager = nullptr);
+
+  // Reopen the tree recorded in the header page, e.g. after a restart. 从 header page 中读取根节点
+  bool LoadRootPageId();
+
+  // Undo a logged entry of a loser transaction, registered to LogRecovery by the owner of the tree.
+  void UndoEntry(bool is_insert, const char *key, const char *value);
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -56,6 +65,12 @@ class BPlusTree {
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
+  // Load entries at once, sorted here; a key given more than once keeps its first value, as with Insert. An empty
+  // tree is built bottom up, each page fill_factor full, and installed as a whole; otherwise the entries are
+  // inserted one by one. 批量加载
+  void BulkLoad(std::vector<std::pair<KeyType, ValueType>> *entries, double fill_factor = 1.0,
+                Transaction *transaction = nullptr);
+
   // return the value associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
@@ -84,6 +99,10 @@ class BPlusTree {
   // expose for test purpose
   Page *FindLeafPage(const KeyType &key, bool leftMost = false);
 
+  // Descend optimistically for INSERT and DELETE and split the B-link way (the default), false for latch crabbing
+  // only; searches always go down the B-link way. 乐观下降
+  void SetOptimisticDescent(bool optimistic) { optimistic_descent_ = optimistic; }
+
   // int isBalanced(page_id_t pid);
   // bool isPageCorr(page_id_t pid, std::pair<KeyType, KeyType> &out);
   // bool Check(bool forceCheck);
@@ -93,19 +112,29 @@ class BPlusTree {
                                                   OperationType op_type = OperationType::SEARCH,
                                                   Transaction *transaction = nullptr);
 
+  Page *FindLeafPageOptimistic(const KeyType &key, bool leftMost, bool rightMost, OperationType op_type,
+                               bool require_safe);
+
+  page_id_t GetRightLink(BPlusTreePage *node, const KeyType &key, bool rightMost);
+
   void ClearTransactionPageSet(Transaction *transaction);
 
   void ClearTransactionPageSetAndUnpin(Transaction *transaction);
 
-  void StartNewTree(const KeyType &key, const ValueType &value);
+  void StartNewTree(const KeyType &key, const ValueType &value, Transaction *transaction);
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
                         Transaction *transaction = nullptr, bool is_root_page_id_locked = false);
 
+  void InsertIntoParentOptimistic(Page *old_page, const KeyType &key, BPlusTreePage *new_node,
+                                  Transaction *transaction);
+
+  void SetParentLatched(BPlusTreePage *node, page_id_t parent_page_id);
+
   template <typename N>
-  N *Split(N *node);
+  N *Split(N *node, Transaction *transaction);
 
   template <typename N>
   bool CoalesceOrRedistribute(N *node, Transaction *transaction = nullptr, bool is_root_page_id_locked = false);
@@ -116,14 +145,42 @@ class BPlusTree {
 
   template <typename N>
   void Redistribute(N *neighbor_node, N *node, BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent,
-                    int index, bool is_root_page_id_locked);
+                    int index, Transaction *transaction, bool is_root_page_id_locked);
+
+  bool AdjustRoot(BPlusTreePage *node, Transaction *transaction, bool is_root_page_id_locked);
 
-  bool AdjustRoot(BPlusTreePage *node, bool is_root_page_id_locked);
+  void UpdateRootPageId(int insert_record = 0, Transaction *transaction = nullptr);
 
-  void UpdateRootPageId(int insert_record = 0);
+  /* WAL: every operation logs its entry for undo, and the pages it modified as one record for redo */
+  bool IsLogging(Transaction *transaction);
+
+  void LogEntry(LogRecordType type, const KeyType &key, const ValueType &value, Transaction *transaction);
+
+  void LogPage(BPlusTreePage *node, Transaction *transaction, bool children_moved = false, int index = 0);
+
+  void LogPages(Transaction *transaction);
 
   bool IsSafety(BPlusTreePage *node, OperationType op_type);
 
+  /* Bulk loading: the page being filled on each level, the leaves first, and the pages of every level */
+  struct BulkLevel {
+    Page *page_{nullptr};
+    size_t items_{0};       // 这一层的项数（叶子节点）或孩子数（内部节点）
+    size_t pages_{0};       // 这一层的节点数，项平均分到每个节点
+    size_t page_index_{0};  // 已经建了几个节点
+    size_t PageSize(size_t index) const { return items_ / pages_ + (index < items_ % pages_ ? 1 : 0); }
+  };
+
+  void SortEntries(std::vector<std::pair<KeyType, ValueType>> *entries);
+
+  Page *BulkNewPage(std::vector<BulkLevel> *levels, size_t level, const KeyType &first_key,
+                    std::vector<page_id_t> *page_ids);
+
+  page_id_t BulkAppendChild(std::vector<BulkLevel> *levels, size_t level, const KeyType &key, page_id_t child,
+                            std::vector<page_id_t> *page_ids);
+
+  void BulkClosePage(Page *page, page_id_t next_page_id, const KeyType &high_key);
+
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
 
@@ -137,6 +194,9 @@ class BPlusTree {
   KeyComparator comparator_;                // 比较器
   int leaf_max_size_;                       // 叶子节点最大项数量
   int internal_max_size_;                   // 内部节点最大项数量
+  LogManager *log_manager_;                 // 日志管理器，nullptr 表示不记录日志
+  bool optimistic_descent_{true};           // 插入、删除先读锁下降，只写锁叶子节点
+  ReaderWriterLatch structure_latch_;       // B-link 分裂插入父节点时持读锁，合并、重组持写锁
 };
 
 }  // namespace bustub
@@ -12,7 +12,9 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "storage/index/b_plus_tree.h"
@@ -22,11 +24,29 @@ namespace bustub {
 
 #define BPLUSTREE_INDEX_TYPE BPlusTreeIndex<KeyType, ValueType, KeyComparator>
 
+/** Scan of a B+ tree index, from the left most leaf. */
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTreeIndexScanIterator : public IndexScanIterator {
+ public:
+  // 迭代器持有 page 的 pin 和读锁，不能拷贝，直接在成员上构造
+  explicit BPlusTreeIndexScanIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree)
+      : iterator_(tree->begin()) {}
+
+  bool IsEnd() override { return iterator_.isEnd(); }
+
+  RID GetRID() override { return (*iterator_).second; }
+
+  void Next() override { ++iterator_; }
+
+ private:
+  INDEXITERATOR_TYPE iterator_;
+};
+
 // B+树索引
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager);
+  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager, LogManager *log_manager = nullptr);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
@@ -34,6 +54,15 @@ class BPlusTreeIndex : public Index {
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  std::unique_ptr<IndexScanIterator> Scan() override;
+
+  bool Open() override;
+
+  void UndoEntry(bool is_insert, const char *key, const char *value) override;
+
+  /** Build the index from entries, see BPlusTree::BulkLoad. 批量加载 */
+  void BulkLoad(std::vector<std::pair<KeyType, ValueType>> *entries, double fill_factor, Transaction *transaction);
+
   INDEXITERATOR_TYPE GetBeginIterator();
 
   INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key);
@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// binary_key.h
+//
+// Identification: src/include/storage/index/binary_key.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstring>
+
+#include "catalog/schema.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * Key of one or more fixed-width columns, normalized so that memcmp orders keys like the columns would.
+ * 规范化的二进制 key，可以直接 memcmp
+ *
+ * Every column is written big endian with the sign bit flipped (all bits for a negative DECIMAL), one after the
+ * other in key schema order, the rest of the key is zero. VARCHAR columns can't be normalized, their keys are
+ * GenericKeys.
+ */
+template <size_t KeySize>
+class BinaryKey {
+ public:
+  inline void SetFromKey(const Tuple &tuple, const Schema *key_schema) {
+    memset(data_, 0, KeySize);
+    size_t pos = 0;
+    for (const auto &col : key_schema->GetColumns()) {
+      size_t size = col.GetFixedLength();
+      uint64_t bits = 0;
+      // 小端读出，按类型变换后大端写入
+      memcpy(&bits, tuple.GetData() + col.GetOffset(), size);
+      switch (col.GetType()) {
+        case TypeId::DECIMAL: {
+          double value;
+          memcpy(&value, &bits, sizeof(double));
+          // -0.0 与 0.0 相等
+          bits = value == 0 ? 1ULL << 63 : (bits >> 63 != 0 ? ~bits : bits ^ (1ULL << 63));
+          break;
+        }
+        default:
+          // BOOLEAN 和整数都是有符号数
+          bits ^= 1ULL << (size * 8 - 1);
+          break;
+      }
+      for (size_t i = 0; i < size; i++) {
+        data_[pos + i] = static_cast<char>(bits >> ((size - 1 - i) * 8));
+      }
+      pos += size;
+    }
+  }
+
+  // NOTE: for test purpose only
+  // the key of a single BIGINT column, cut to KeySize
+  inline void SetFromInteger(int64_t key) {
+    memset(data_, 0, KeySize);
+    uint64_t bits = static_cast<uint64_t>(key) ^ (1ULL << 63);
+    for (size_t i = 0; i < INTEGER_SIZE; i++) {
+      data_[i] = static_cast<char>(bits >> ((sizeof(int64_t) - 1 - i) * 8));
+    }
+  }
+
+  // NOTE: for test purpose only
+  // interpret the first 8 bytes as a BIGINT column
+  inline int64_t ToString() const {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < INTEGER_SIZE; i++) {
+      bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[i])) << ((sizeof(int64_t) - 1 - i) * 8);
+    }
+    return static_cast<int64_t>(bits ^ (1ULL << 63));
+  }
+
+  // NOTE: for test purpose only
+  friend std::ostream &operator<<(std::ostream &os, const BinaryKey &key) {
+    os << key.ToString();
+    return os;
+  }
+
+  char data_[KeySize];
+
+ private:
+  static constexpr size_t INTEGER_SIZE = KeySize < sizeof(int64_t) ? KeySize : sizeof(int64_t);
+};
+
+/**
+ * Compares BinaryKeys byte by byte.
+ */
+template <size_t KeySize>
+class BinaryComparator {
+ public:
+  inline int operator()(const BinaryKey<KeySize> &lhs, const BinaryKey<KeySize> &rhs) const {
+    return memcmp(lhs.data_, rhs.data_, KeySize);
+  }
+
+  BinaryComparator(const BinaryComparator &other) = default;
+
+  // constructor, the key schema is already applied by BinaryKey::SetFromKey
+  explicit BinaryComparator(Schema *key_schema) {}
+};
+
+}  // namespace bustub
@@ -36,6 +36,9 @@ class GenericKey {
     memcpy(data_, tuple.GetData(), tuple.GetLength());
   }
 
+  // the tuple is kept as it is, key_schema is applied by the comparator
+  inline void SetFromKey(const Tuple &tuple, const Schema *key_schema) { SetFromKey(tuple); }
+
   // NOTE: for test purpose only
   inline void SetFromInteger(int64_t key) {
     memset(data_, 0, KeySize);
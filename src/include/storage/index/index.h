@@ -82,6 +82,23 @@ class IndexMetadata {  // 索引元数据
   Schema *key_schema_;
 };
 
+/**
+ * IndexScanIterator walks the entries of an index in key order, whatever the key type of the index.
+ */
+class IndexScanIterator {
+ public:
+  virtual ~IndexScanIterator() = default;
+
+  // Whether the iterator is past the last entry
+  virtual bool IsEnd() = 0;
+
+  // The RID of the current entry
+  virtual RID GetRID() = 0;
+
+  // Move to the next entry
+  virtual void Next() = 0;
+};
+
 /////////////////////////////////////////////////////////////////////
 // Index class definition
 /////////////////////////////////////////////////////////////////////
@@ -137,6 +154,15 @@ class Index {
 
   virtual void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) = 0;
 
+  // Scan all entries in key order, nullptr if the index is empty or not ordered
+  virtual std::unique_ptr<IndexScanIterator> Scan() { return nullptr; }
+
+  // Reopen an index kept in the database file, false if it was never written there
+  virtual bool Open() { return false; }
+
+  // Undo an entry of a transaction that didn't finish before a crash, key and value are the raw bytes from the log
+  virtual void UndoEntry(bool is_insert, const char *key, const char *value) {}
+
  private:
   //===--------------------------------------------------------------------===//
   //  Data members
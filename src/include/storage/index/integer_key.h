@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// integer_key.h
+//
+// Identification: src/include/storage/index/integer_key.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "catalog/schema.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * Key of a single INTEGER (int32_t) or BIGINT (int64_t) column. 单列整数 key
+ *
+ * The integer is kept in its tuple format, so the key is the same size as a GenericKey of the same width and
+ * needs no alignment in a page.
+ */
+template <typename IntType>
+class IntegerKey {
+ public:
+  inline void SetFromKey(const Tuple &tuple) { memcpy(data_, tuple.GetData(), sizeof(IntType)); }
+
+  inline void SetFromKey(const Tuple &tuple, const Schema *key_schema) { SetFromKey(tuple); }
+
+  // NOTE: for test purpose only
+  inline void SetFromInteger(int64_t key) {
+    auto value = static_cast<IntType>(key);
+    memcpy(data_, &value, sizeof(IntType));
+  }
+
+  inline IntType GetValue() const {
+    IntType value;
+    memcpy(&value, data_, sizeof(IntType));
+    return value;
+  }
+
+  // NOTE: for test purpose only
+  inline int64_t ToString() const { return GetValue(); }
+
+  // NOTE: for test purpose only
+  friend std::ostream &operator<<(std::ostream &os, const IntegerKey &key) {
+    os << key.ToString();
+    return os;
+  }
+
+  char data_[sizeof(IntType)];
+};
+
+/**
+ * Compares IntegerKeys as integers, without going through Value. NULL (the smallest integer) sorts first.
+ */
+template <typename IntType>
+class IntegerComparator {
+ public:
+  inline int operator()(const IntegerKey<IntType> &lhs, const IntegerKey<IntType> &rhs) const {
+    IntType lhs_value = lhs.GetValue();
+    IntType rhs_value = rhs.GetValue();
+    return static_cast<int>(lhs_value > rhs_value) - static_cast<int>(lhs_value < rhs_value);
+  }
+
+  IntegerComparator(const IntegerComparator &other) = default;
+
+  // constructor, the key schema is always a single integer column
+  explicit IntegerComparator(Schema *key_schema) {}
+};
+
+/** Whether KeyType is an IntegerKey, whose pages are searched by SearchIntegerKeys. */
+template <typename KeyType>
+struct IsIntegerKey {
+  static constexpr bool VALUE = false;
+};
+
+template <typename IntType>
+struct IsIntegerKey<IntegerKey<IntType>> {
+  static constexpr bool VALUE = true;
+};
+
+/** How SearchIntegerKeys compares keys. 页内查找的实现 */
+enum class SearchKernel { SCALAR = 0, AVX2, AVX512 };
+
+/**
+ * Search count sorted integer keys, stride bytes apart from first (the keys of a B+ tree page), for key.
+ * The scalar kernel is a binary search. The SIMD kernels binary search down to a few dozen keys, then compare
+ * them all at once, gathering the keys out of the (key, value) pairs.
+ * @param upper whether to count the keys equal to key too
+ * @return the number of keys less than key (less than or equal to key if upper)
+ */
+template <typename IntType>
+int SearchIntegerKeys(const char *first, size_t stride, int count, IntType key, bool upper);
+
+/** @return the kernel SearchIntegerKeys uses, the fastest one the CPU supports unless set */
+SearchKernel GetSearchKernel();
+
+/**
+ * Make SearchIntegerKeys use kernel, for tests and benchmarks.
+ * @return false if the CPU doesn't support kernel
+ */
+bool SetSearchKernel(SearchKernel kernel);
+
+}  // namespace bustub
@@ -16,7 +16,9 @@
 #include <string>
 
 #include "buffer/buffer_pool_manager.h"
+#include "storage/index/binary_key.h"
 #include "storage/index/generic_key.h"
+#include "storage/index/integer_key.h"
 
 namespace bustub {
 
@@ -46,6 +48,9 @@ enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
  */
 class BPlusTreePage {
  public:
+  /** Offset of ParentPageId in the header, children moved to another page are logged as a write there. */
+  static constexpr uint32_t OFFSET_PARENT_PAGE_ID = 16;
+
   bool IsLeafPage() const;
   bool IsRootPage() const;
   void SetPageType(IndexPageType page_type);
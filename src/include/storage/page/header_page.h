@@ -24,9 +24,10 @@ namespace bustub {
  * 头部页，用于存储元数据，表名称、索引名称
  *
  * Format (size in byte):
- *  -----------------------------------------------------------------
- * | RecordCount (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... |
- *  -----------------------------------------------------------------
+ *  ------------------------------------------------------------------------
+ * | RecordCount (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... | LSN (4) |
+ *  ------------------------------------------------------------------------
+ * The LSN is kept in the last bytes, the records start where other pages keep theirs.
  */
 class HeaderPage : public Page {
  public:
@@ -42,6 +43,15 @@ class HeaderPage : public Page {
   bool GetRootId(const std::string &name, page_id_t *root_id);
   int GetRecordCount();
 
+  /** @return the offset of the record of name, -1 if there is none */
+  int GetRecordOffset(const std::string &name);
+
+  /** Get/Set the LSN of the last logged change to the records. */
+  inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
+  inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
+
+  static constexpr size_t OFFSET_LSN = PAGE_SIZE - sizeof(lsn_t);
+
  private:
   /**
    * helper functions
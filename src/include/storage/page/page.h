@@ -16,6 +16,7 @@
 #include <iostream>
 
 #include "common/config.h"
+#include "common/contention_stats.h"
 #include "common/rwlatch.h"
 
 namespace bustub {
@@ -50,17 +51,50 @@ class Page {
   inline bool IsDirty() { return is_dirty_; }
 
   /** Acquire the page write latch. */
-  inline void WLatch() { rwlatch_.WLock(); }
+  inline void WLatch() {
+    ContentionStats::RecordAcquire(ContentionSource::PAGE_LATCH);
+    // 只有要等待时才计时
+    if (!rwlatch_.TryWLock()) {
+      int64_t start = ContentionStats::Now();
+      rwlatch_.WLock();
+      ContentionStats::RecordWait(ContentionSource::PAGE_LATCH, page_id_, ContentionStats::Now() - start);
+    }
+  }
 
   /** Release the page write latch. */
   inline void WUnlatch() { rwlatch_.WUnlock(); }
 
   /** Acquire the page read latch. */
-  inline void RLatch() { rwlatch_.RLock(); }
+  inline void RLatch() {
+    ContentionStats::RecordAcquire(ContentionSource::PAGE_LATCH);
+    if (!rwlatch_.TryRLock()) {
+      int64_t start = ContentionStats::Now();
+      rwlatch_.RLock();
+      ContentionStats::RecordWait(ContentionSource::PAGE_LATCH, page_id_, ContentionStats::Now() - start);
+    }
+  }
 
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /** Acquire the page write latch if no other thread holds it. @return false if the latch was not taken */
+  inline bool TryWLatch() {
+    if (!rwlatch_.TryWLock()) {
+      return false;
+    }
+    ContentionStats::RecordAcquire(ContentionSource::PAGE_LATCH);
+    return true;
+  }
+
+  /** Acquire the page read latch if no writer holds it. @return false if the latch was not taken */
+  inline bool TryRLatch() {
+    if (!rwlatch_.TryRLock()) {
+      return false;
+    }
+    ContentionStats::RecordAcquire(ContentionSource::PAGE_LATCH);
+    return true;
+  }
+
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
@@ -38,9 +38,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param first_page_id the id of the first page
+   * @param table_oid the table whose locks cover the rows, INVALID_TABLE_OID if the rows are always locked
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            page_id_t first_page_id);
+            page_id_t first_page_id, table_oid_t table_oid = INVALID_TABLE_OID);
 
   /**
    * Create a table heap with a transaction. (create table)
@@ -48,9 +49,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param table_oid the table whose locks cover the rows, INVALID_TABLE_OID if the rows are always locked
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, table_oid_t table_oid = INVALID_TABLE_OID);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
@@ -110,11 +112,39 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
+  /** @return the oid of this table, INVALID_TABLE_OID if it is not in the catalog */
+  inline table_oid_t GetTableOid() const { return table_oid_; }
+
  private:
+  /** @return the lock manager for row locks, nullptr if the table lock held by txn already covers the access */
+  LockManager *GetRowLockManager(Transaction *txn, bool exclusive);
+
+  /** @return true if txn reads its snapshot instead of the newest versions */
+  static bool IsSnapshotRead(Transaction *txn);
+
+  /** @return true if txn is an OPTIMISTIC transaction in its read phase, its updates and deletes are buffered */
+  static bool IsOptimisticRead(Transaction *txn);
+
+  /** Abort txn if it was declared read-only, every write goes through here first. */
+  static void CheckWritable(Transaction *txn);
+
+  /**
+   * Snapshot isolation: write-lock rid, then abort txn if another transaction committed rid after its snapshot.
+   * @return false if the lock could not be acquired
+   */
+  bool CheckWriteConflict(const RID &rid, Transaction *txn);
+
+  /**
+   * Read rid from page, which the caller has fetched and read-latched.
+   * 迭代器持有页锁时用它读，不能再次获取页的读锁，否则排在中间的写锁会造成死锁
+   */
+  bool GetTupleLatched(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  table_oid_t table_oid_{INVALID_TABLE_OID};
 };
 
 }  // namespace bustub
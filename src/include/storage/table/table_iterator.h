@@ -33,7 +33,11 @@ class TableIterator {
   TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        txn_(other.txn_),
+        snapshot_(other.snapshot_),
+        skip_invisible_(other.skip_invisible_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -53,6 +57,8 @@ class TableIterator {
     table_heap_ = other.table_heap_;
     *tuple_ = *other.tuple_;
     txn_ = other.txn_;
+    snapshot_ = other.snapshot_;
+    skip_invisible_ = other.skip_invisible_;
     return *this;
   }
 
@@ -60,6 +66,10 @@ class TableIterator {
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** Snapshot reads visit every slot and skip the rows not visible to the snapshot. */
+  bool snapshot_{false};
+  /** Snapshot reads and OPTIMISTIC transactions (their own buffered deletes) skip the rows they can't read. */
+  bool skip_invisible_{false};
 };
 
 }  // namespace bustub
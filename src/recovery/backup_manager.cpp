@@ -0,0 +1,226 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_manager.cpp
+//
+// Identification: src/recovery/backup_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/backup_manager.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>  // NOLINT
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+/** Every log record starts with its size and its lsn. */
+static constexpr int RECORD_PREFIX_SIZE = sizeof(int32_t) + sizeof(lsn_t);
+
+/*
+ * find the complete log records at the start of data
+ * @param[out] last_lsn: lsn of the last complete record, untouched if there is none
+ * @param[out] reach_target: set when a record newer than target_lsn stopped the parse
+ * @return: bytes of the complete records up to target_lsn
+ */
+static int ParseRecords(const char *data, int size, lsn_t target_lsn, lsn_t *last_lsn, bool *reach_target) {
+  int offset = 0;
+  while (offset + RECORD_PREFIX_SIZE <= size) {
+    int32_t record_size;
+    lsn_t lsn;
+    memcpy(&record_size, data + offset, sizeof(int32_t));
+    memcpy(&lsn, data + offset + sizeof(int32_t), sizeof(lsn_t));
+    if (record_size <= 0 || offset + record_size > size) {
+      break;
+    }
+    if (target_lsn != INVALID_LSN && lsn > target_lsn) {
+      *reach_target = true;
+      break;
+    }
+    *last_lsn = lsn;
+    offset += record_size;
+  }
+  return offset;
+}
+
+BackupManifest BackupManager::Backup(const std::string &backup_dir, const BackupManifest *base) {
+  if (!enable_logging) {
+    throw Exception("backup needs logging on");
+  }
+  if (mkdir(backup_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw Exception("can't create backup directory " + backup_dir);
+  }
+  start_time_ = std::chrono::steady_clock::now();
+  copied_bytes_ = 0;
+  BackupManifest manifest{};
+  manifest.base_start_lsn_ = base == nullptr ? INVALID_LSN : base->start_lsn_;
+  manifest.start_lsn_ = log_manager_->GetNextLSN();
+  manifest.end_lsn_ = base == nullptr ? INVALID_LSN : base->end_lsn_;
+  manifest.log_begin_offset_ = base == nullptr ? 0 : base->log_end_offset_;
+
+  // 1. 复制页，缓冲池中的页在读锁下复制，不在缓冲池中的直接读磁盘，不会把冷页换入缓冲池
+  std::ofstream pages_file(backup_dir + "/pages", std::ios::binary | std::ios::trunc);
+  char data[PAGE_SIZE];
+  page_id_t page_num = disk_manager_->GetNumPages();
+  for (page_id_t page_id = 0; page_id < page_num; page_id++) {
+    buffer_pool_manager_->CopyPage(page_id, data);
+    lsn_t lsn;
+    memcpy(&lsn, data + sizeof(page_id_t), sizeof(lsn_t));
+    // header page 没有 lsn，总是复制
+    if (base != nullptr && page_id != HEADER_PAGE_ID && lsn != INVALID_LSN && lsn < manifest.base_start_lsn_) {
+      continue;
+    }
+    pages_file.write(reinterpret_cast<const char *>(&page_id), sizeof(page_id_t));
+    pages_file.write(data, PAGE_SIZE);
+    manifest.page_num_++;
+    Throttle(PAGE_SIZE);
+  }
+  pages_file.close();
+
+  // 2. 复制的页可能包含还没落盘的日志，先刷日志，再复制基准之后的日志
+  log_manager_->WaitForFlush(log_manager_->GetNextLSN() - 1);
+  std::ifstream log_file(disk_manager_->GetLogFileName(), std::ios::binary | std::ios::in);
+  std::ofstream backup_log(backup_dir + "/log", std::ios::binary | std::ios::trunc);
+  std::vector<char> buffer(LOG_BUFFER_SIZE);
+  int64_t offset = manifest.log_begin_offset_;
+  int64_t log_end = disk_manager_->GetLogFileSize();
+  while (offset < log_end) {
+    log_file.clear();
+    log_file.seekg(offset);
+    log_file.read(buffer.data(), std::min<int64_t>(log_end - offset, LOG_BUFFER_SIZE));
+    bool reach_target = false;
+    int size = ParseRecords(buffer.data(), log_file.gcount(), INVALID_LSN, &manifest.end_lsn_, &reach_target);
+    if (size == 0) {
+      break;  // 日志文件结尾的半条日志还在写
+    }
+    backup_log.write(buffer.data(), size);
+    offset += size;
+    Throttle(size);
+  }
+  backup_log.close();
+  manifest.log_end_offset_ = offset;
+
+  // 3. manifest 最后写，没有 manifest 的备份是不完整的
+  std::ofstream manifest_file(backup_dir + "/manifest", std::ios::binary | std::ios::trunc);
+  manifest_file.write(reinterpret_cast<const char *>(&manifest), sizeof(manifest));
+  manifest_file.close();
+  if (manifest_file.bad()) {
+    throw Exception("can't write backup manifest of " + backup_dir);
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_);
+  LOG_INFO("backup %s: %d pages, log [%ld, %ld), lsn %d, %ld ms", backup_dir.c_str(), manifest.page_num_,
+           manifest.log_begin_offset_, manifest.log_end_offset_, manifest.end_lsn_, ms.count());
+  return manifest;
+}
+
+BackupManifest BackupManager::ReadManifest(const std::string &backup_dir) {
+  BackupManifest manifest;
+  std::ifstream manifest_file(backup_dir + "/manifest", std::ios::binary | std::ios::in);
+  manifest_file.read(reinterpret_cast<char *>(&manifest), sizeof(manifest));
+  if (manifest_file.gcount() != sizeof(manifest)) {
+    throw Exception("no complete backup in " + backup_dir);
+  }
+  return manifest;
+}
+
+lsn_t BackupManager::Restore(const std::vector<std::string> &backup_dirs, const std::string &db_file,
+                             lsn_t target_lsn) {
+  if (backup_dirs.empty()) {
+    throw Exception("no backup to restore");
+  }
+  std::vector<BackupManifest> manifests;
+  for (const auto &backup_dir : backup_dirs) {
+    auto manifest = ReadManifest(backup_dir);
+    if (manifests.empty() && manifest.base_start_lsn_ != INVALID_LSN) {
+      throw Exception(backup_dir + " is not a full backup");
+    }
+    if (!manifests.empty() && manifest.log_begin_offset_ != manifests.back().log_end_offset_) {
+      throw Exception(backup_dir + " does not follow the previous backup");
+    }
+    manifests.push_back(manifest);
+  }
+  // 页只能用 end_lsn_ 不晚于 target 的备份，之后的备份只用它们的日志
+  size_t last = manifests.size() - 1;
+  if (target_lsn != INVALID_LSN) {
+    if (manifests[0].end_lsn_ > target_lsn) {
+      throw Exception("lsn " + std::to_string(target_lsn) + " is before the end of the full backup");
+    }
+    last = 0;
+    while (last + 1 < manifests.size() && manifests[last + 1].end_lsn_ <= target_lsn) {
+      last++;
+    }
+  }
+
+  DiskManager disk_manager(db_file);
+  if (truncate(db_file.c_str(), 0) != 0 || truncate(disk_manager.GetLogFileName().c_str(), 0) != 0) {
+    throw Exception("can't truncate " + db_file);
+  }
+  // 恢复出的页比之前的检查点旧，恢复要从日志开头开始
+  remove(disk_manager.GetMasterRecordFileName().c_str());
+  char data[PAGE_SIZE];
+  for (size_t i = 0; i <= last; i++) {
+    std::ifstream pages_file(backup_dirs[i] + "/pages", std::ios::binary | std::ios::in);
+    page_id_t page_id;
+    while (pages_file.read(reinterpret_cast<char *>(&page_id), sizeof(page_id_t)) &&
+           pages_file.read(data, PAGE_SIZE)) {
+      disk_manager.WritePage(page_id, data);
+    }
+  }
+
+  // 日志截断到 target，DiskManager 要求两个缓冲区交替使用
+  std::vector<char> buffers[2] = {std::vector<char>(LOG_BUFFER_SIZE), std::vector<char>(LOG_BUFFER_SIZE)};
+  int next_buffer = 0;
+  lsn_t last_lsn = INVALID_LSN;
+  bool reach_target = false;
+  for (size_t i = 0; i < backup_dirs.size() && !reach_target; i++) {
+    std::ifstream log_file(backup_dirs[i] + "/log", std::ios::binary | std::ios::in);
+    int64_t offset = 0;
+    int64_t log_size = manifests[i].log_end_offset_ - manifests[i].log_begin_offset_;
+    while (offset < log_size && !reach_target) {
+      char *buffer = buffers[next_buffer].data();
+      next_buffer ^= 1;
+      log_file.clear();
+      log_file.seekg(offset);
+      log_file.read(buffer, std::min<int64_t>(log_size - offset, LOG_BUFFER_SIZE));
+      int size = ParseRecords(buffer, log_file.gcount(), target_lsn, &last_lsn, &reach_target);
+      if (size == 0 && !reach_target) {
+        throw Exception("broken log in " + backup_dirs[i]);
+      }
+      disk_manager.WriteLog(buffer, size);
+      offset += size;
+    }
+  }
+  disk_manager.ShutDown();
+  LOG_INFO("restored %s from %zu backups up to lsn %d", db_file.c_str(), last + 1, last_lsn);
+  return last_lsn;
+}
+
+/*
+ * sleep until the bytes copied so far fit the limit
+ */
+void BackupManager::Throttle(size_t bytes) {
+  if (max_bytes_per_sec_ == 0) {
+    return;
+  }
+  copied_bytes_ += bytes;
+  auto expect = std::chrono::microseconds(copied_bytes_ * 1000000 / max_bytes_per_sec_);
+  auto elapsed = std::chrono::steady_clock::now() - start_time_;
+  if (expect > elapsed) {
+    std::this_thread::sleep_for(expect - elapsed);
+  }
+}
+
+}  // namespace bustub
@@ -12,6 +12,8 @@
 
 #include "recovery/checkpoint_manager.h"
 
+#include "common/logger.h"
+
 namespace bustub {
 
 void CheckpointManager::BeginCheckpoint() {
@@ -22,8 +24,19 @@ void CheckpointManager::BeginCheckpoint() {
   transaction_manager_->BlockAllTransactions();
   // 强制刷日志
   log_manager_->Flush(true);
-  // 刷脏页
-  buffer_pool_manager_->FlushAllPages();
+  // 即时恢复还没重做的页先重做，检查点之前的日志之后不会再读
+  buffer_pool_manager_->RedoPendingPages();
+  // 刷脏页，记下实际写了多少页
+  flushed_pages_ = 0;
+  for (page_id_t page_id : buffer_pool_manager_->GetDirtyPages()) {
+    if (buffer_pool_manager_->FlushDirtyPage(page_id)) {
+      flushed_pages_++;
+    }
+  }
+  // 记录检查点，恢复从这里开始
+  if (enable_logging) {
+    log_manager_->LogCheckpoint();
+  }
 }
 
 void CheckpointManager::EndCheckpoint() {
@@ -31,4 +44,97 @@ void CheckpointManager::EndCheckpoint() {
   transaction_manager_->ResumeTransactions();
 }
 
+void CheckpointManager::Checkpoint(std::chrono::milliseconds flush_duration) {
+  auto start = std::chrono::steady_clock::now();
+  // 1. 事务继续执行，脏页在 flush_duration 内均匀地写回，避免一次性写爆磁盘
+  auto page_ids = buffer_pool_manager_->GetDirtyPages();
+  size_t pages_written = 0;
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    if (buffer_pool_manager_->FlushDirtyPage(page_ids[i])) {
+      pages_written++;
+    }
+    std::this_thread::sleep_until(start + flush_duration * (i + 1) / page_ids.size());
+  }
+  // 2. 阻塞事务，只需要刷期间新产生的脏页
+  auto block_start = std::chrono::steady_clock::now();
+  BeginCheckpoint();
+  EndCheckpoint();
+  pages_written += flushed_pages_;
+  auto end = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> guard(stats_latch_);
+  stats_.checkpoint_num_++;
+  stats_.last_duration_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+  stats_.last_block_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(end - block_start).count();
+  stats_.last_pages_written_ = pages_written;
+  stats_.total_pages_written_ += pages_written;
+}
+
+void CheckpointManager::StartScheduler(const CheckpointPolicy &policy) {
+  StopScheduler();
+  policy_ = policy;
+  stop_scheduler_ = false;
+  scheduler_thread_ = new std::thread(&CheckpointManager::RunScheduler, this);
+}
+
+void CheckpointManager::StopScheduler() {
+  if (scheduler_thread_ == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(scheduler_latch_);
+    stop_scheduler_ = true;
+  }
+  scheduler_cv_.notify_one();
+  scheduler_thread_->join();
+  delete scheduler_thread_;
+  scheduler_thread_ = nullptr;
+}
+
+CheckpointStats CheckpointManager::GetStats() {
+  size_t dirty_num = buffer_pool_manager_->GetDirtyPages().size();
+  std::lock_guard<std::mutex> guard(stats_latch_);
+  CheckpointStats stats = stats_;
+  stats.log_bytes_ = log_manager_->GetLogSizeSinceCheckpoint();
+  stats.dirty_ratio_ = static_cast<double>(dirty_num) / buffer_pool_manager_->GetPoolSize();
+  // 恢复要读完检查点之后的日志，再把脏页读回来重做
+  auto redo_time = std::chrono::microseconds(stats.log_bytes_ * 1000000 / policy_.redo_bytes_per_sec_);
+  auto estimated = redo_time + policy_.page_read_time_ * dirty_num;
+  stats.estimated_recovery_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(estimated).count();
+  return stats;
+}
+
+std::string CheckpointManager::NeedCheckpoint(const CheckpointStats &stats) {
+  if (stats.log_bytes_ >= policy_.max_log_bytes_) {
+    return "log size " + std::to_string(stats.log_bytes_);
+  }
+  if (stats.dirty_ratio_ >= policy_.max_dirty_ratio_) {
+    return "dirty ratio " + std::to_string(stats.dirty_ratio_);
+  }
+  if (stats.estimated_recovery_ms_ >= policy_.max_recovery_time_.count()) {
+    return "estimated recovery time " + std::to_string(stats.estimated_recovery_ms_) + " ms";
+  }
+  return "";
+}
+
+void CheckpointManager::RunScheduler() {
+  std::unique_lock<std::mutex> latch(scheduler_latch_);
+  while (!scheduler_cv_.wait_for(latch, policy_.check_interval_, [&] { return stop_scheduler_; })) {
+    // 即时恢复的后台重做完成之前不打检查点，否则检查点要同步重做所有页
+    if (!enable_logging || buffer_pool_manager_->HasPendingRedo()) {
+      continue;
+    }
+    std::string reason = NeedCheckpoint(GetStats());
+    if (reason.empty()) {
+      continue;
+    }
+    latch.unlock();
+    Checkpoint(policy_.flush_duration_);
+    auto stats = GetStats();
+    LOG_INFO("checkpoint for %s: %zu pages written in %ld ms, transactions blocked %ld ms", reason.c_str(),
+             stats.last_pages_written_, stats.last_duration_ms_, stats.last_block_ms_);
+    latch.lock();
+  }
+}
+
 }  // namespace bustub
@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "recovery/log_manager.h"
+#include "common/contention_stats.h"
 #include "common/logger.h"
 
 namespace bustub {
@@ -29,30 +30,22 @@ void LogManager::RunFlushThread() {
     return;
   }
   enable_logging = true;
+  auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
   // 新建刷新线程
   flush_thread_ = new std::thread([&] {
-    while (enable_logging) {
-      std::unique_lock<std::mutex> latch(latch_);  // 初始化锁
-      // 当前线程等待，直到超时，或者 need_flush 为 true
-      cv_.wait_for(latch, log_timeout, [&] { return need_flush_.load(); });
-      assert(flush_buffer_size_ == 0);
-      // 如果 log_buffer 偏移 > 0
-      if (log_buffer_offset_ > 0) {
-        // 注意：
-        // log_buffer 用于装日志数据，待需要刷磁盘时，和 flush_buffer 交换，然后将 flush_buffer 刷到磁盘中
-        //
-        // 交换 log_buffer 和 flush_buffer
-        std::swap(log_buffer_, flush_buffer_);
-        // 交换 log_buffer_offset_ 与 flush_buffer_size_
-        // log_buffer 的偏移就是 flush_buffer 的大小
-        std::swap(log_buffer_offset_, flush_buffer_size_);
-        // 写日志
-        disk_manager_->WriteLog(flush_buffer_, flush_buffer_size_);
-        flush_buffer_size_ = 0;       // flush_buffer 大小为 0
-        SetPersistentLSN(last_lsn_);  // 设置持久化日志序号
-      }
+    while (true) {
+      auto latch = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);  // 初始化锁
+      // 当前线程等待，直到超时，或者 need_flush 为 true，或者要停止刷新线程
+      auto timeout = flush_timeout_.count() > 0 ? flush_timeout_
+                                                : std::chrono::duration_cast<std::chrono::milliseconds>(log_timeout);
+      cv_.wait_for(latch, timeout, [&] { return need_flush_.load() || !enable_logging; });
+      FlushLogBuffer();
       need_flush_ = false;      // flush 完毕
       append_cv_.notify_all();  // 通知追加线程
+      // 停止前的最后一次 flush 已完成
+      if (!enable_logging) {
+        break;
+      }
     }
   });
 }
@@ -64,11 +57,38 @@ void LogManager::StopFlushThread() {
   if (!enable_logging) {
     return;
   }
-  enable_logging = false;
-  Flush(true);            // 强制刷新磁盘
+  {
+    auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+    enable_logging = false;
+  }
+  cv_.notify_one();       // 唤醒刷新线程做最后一次 flush
   flush_thread_->join();  // 刷新线程 join
+  auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
   assert(log_buffer_offset_ == 0 && flush_buffer_size_ == 0);
   delete flush_thread_;  // 删除刷新线程
+  flush_thread_ = nullptr;
+}
+
+/*
+ * write log_buffer to disk, caller must hold latch_
+ */
+void LogManager::FlushLogBuffer() {
+  assert(flush_buffer_size_ == 0);
+  // 如果 log_buffer 偏移 > 0
+  if (log_buffer_offset_ > 0) {
+    // 注意：
+    // log_buffer 用于装日志数据，待需要刷磁盘时，和 flush_buffer 交换，然后将 flush_buffer 刷到磁盘中
+    //
+    // 交换 log_buffer 和 flush_buffer
+    std::swap(log_buffer_, flush_buffer_);
+    // 交换 log_buffer_offset_ 与 flush_buffer_size_
+    // log_buffer 的偏移就是 flush_buffer 的大小
+    std::swap(log_buffer_offset_, flush_buffer_size_);
+    // 写日志
+    disk_manager_->WriteLog(flush_buffer_, flush_buffer_size_);
+    flush_buffer_size_ = 0;       // flush_buffer 大小为 0
+    SetPersistentLSN(last_lsn_);  // 设置持久化日志序号
+  }
 }
 
 /*
@@ -92,35 +112,47 @@ void LogManager::StopFlushThread() {
  *
  */
 lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
-  std::unique_lock<std::mutex> latch(latch_);  // 加锁
+  auto latch = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);  // 加锁
   // 如果 log_buffer 偏移 + 日志记录大小 >= 日志缓冲区大小
   // 表示添加当前日志记录后，需要刷日志到磁盘
   if (log_buffer_offset_ + log_record->GetSize() >= LOG_BUFFER_SIZE) {
-    need_flush_ = true;  // 需要刷日志
-    cv_.notify_one();    // 通知一个线程刷日志
-    // 当前追加日志线程等待，等待 log_buffer 能够容纳这次日志记录
-    append_cv_.wait(latch, [&] { return log_buffer_offset_ + log_record->GetSize() < LOG_BUFFER_SIZE; });
+    if (flush_thread_ == nullptr) {
+      // 没有刷新线程（例如恢复时写补偿日志），直接在当前线程刷
+      FlushLogBuffer();
+    } else {
+      need_flush_ = true;  // 需要刷日志
+      cv_.notify_one();    // 通知一个线程刷日志
+      // 当前追加日志线程等待，等待 log_buffer 能够容纳这次日志记录
+      append_cv_.wait(latch, [&] { return log_buffer_offset_ + log_record->GetSize() < LOG_BUFFER_SIZE; });
+    }
   }
   log_record->lsn_ = next_lsn_++;  // 日志记录 lsn
   // 将日志记录 header 拷贝到 log_buffer 中
   memcpy(log_buffer_ + log_buffer_offset_, log_record, LogRecord::HEADER_SIZE);
   // 拷贝后的 log_buffer 偏移
   int pos = log_buffer_offset_ + LogRecord::HEADER_SIZE;
+  // 补偿日志，先写 undo_next_lsn 与 action_type，之后按 action 的类型写入
+  if (log_record->log_record_type_ == LogRecordType::CLR) {
+    memcpy(log_buffer_ + pos, &log_record->undo_next_lsn_, sizeof(lsn_t));
+    pos += sizeof(lsn_t);
+    memcpy(log_buffer_ + pos, &log_record->action_type_, sizeof(LogRecordType));
+    pos += sizeof(LogRecordType);
+  }
+  LogRecordType action_type = log_record->GetActionType();
   // 如果是插入记录
-  if (log_record->log_record_type_ == LogRecordType::INSERT) {
+  if (action_type == LogRecordType::INSERT) {
     // 拷贝 tuple_rid
     memcpy(log_buffer_ + pos, &log_record->insert_rid_, sizeof(RID));
     pos += sizeof(RID);
     // 拷贝 tuple，即 tuple_size + tuple_data
     log_record->insert_tuple_.SerializeTo(log_buffer_ + pos);
-  } else if (log_record->log_record_type_ == LogRecordType::MARKDELETE ||
-             log_record->log_record_type_ == LogRecordType::APPLYDELETE ||
-             log_record->log_record_type_ == LogRecordType::ROLLBACKDELETE) {
+  } else if (action_type == LogRecordType::MARKDELETE || action_type == LogRecordType::APPLYDELETE ||
+             action_type == LogRecordType::ROLLBACKDELETE) {
     // mark_delete apply_delete rollback_delete 日志数据都是一样的
     memcpy(log_buffer_ + pos, &log_record->delete_rid_, sizeof(RID));
     pos += sizeof(RID);
     log_record->delete_tuple_.SerializeTo(log_buffer_ + pos);
-  } else if (log_record->log_record_type_ == LogRecordType::UPDATE) {
+  } else if (action_type == LogRecordType::UPDATE) {
     // update
     memcpy(log_buffer_ + pos, &log_record->update_rid_, sizeof(RID));
     pos += sizeof(RID);
@@ -130,7 +162,23 @@ lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
     pos += (log_record->old_tuple_.GetLength() + sizeof(int32_t));
     // 新数据
     log_record->new_tuple_.SerializeTo(log_buffer_ + pos);
-  } else if (log_record->log_record_type_ == LogRecordType::NEWPAGE) {
+  } else if (action_type == LogRecordType::DELTAUPDATE) {
+    // delta update，只有变化的区间
+    memcpy(log_buffer_ + pos, &log_record->update_rid_, sizeof(RID));
+    pos += sizeof(RID);
+    memcpy(log_buffer_ + pos, log_record->delta_.data(), log_record->delta_.size());
+  } else if (action_type == LogRecordType::INDEXINSERT || action_type == LogRecordType::INDEXDELETE) {
+    // 索引名、key、value，都是 size + data
+    for (const std::string *field : {&log_record->index_name_, &log_record->index_key_, &log_record->index_value_}) {
+      auto field_size = static_cast<int32_t>(field->size());
+      memcpy(log_buffer_ + pos, &field_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(log_buffer_ + pos, field->data(), field_size);
+      pos += field_size;
+    }
+  } else if (action_type == LogRecordType::INDEXPAGES) {
+    memcpy(log_buffer_ + pos, log_record->page_writes_.data(), log_record->page_writes_.size());
+  } else if (action_type == LogRecordType::NEWPAGE) {
     // new page
     memcpy(log_buffer_ + pos, &log_record->prev_page_id_, sizeof(page_id_t));
     pos += sizeof(page_id_t);
@@ -142,18 +190,63 @@ lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
 }
 
 void LogManager::Flush(bool force) {
-  std::unique_lock<std::mutex> latch(latch_);  // 加锁
+  auto latch = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);  // 加锁
   if (force) {                                 // 是否强制刷磁盘
+    // 没有刷新线程，直接在当前线程刷
+    if (flush_thread_ == nullptr) {
+      FlushLogBuffer();
+      return;
+    }
     need_flush_ = true;
     cv_.notify_one();  // 通知一个线程刷磁盘
-    if (enable_logging) {
-      // append_cv_ 用来阻塞追加线程，等待刷磁盘完成后解锁
-      append_cv_.wait(latch, [&] { return !need_flush_.load(); });
-    } else {
-      // 等待，知道 append_cv 被磁盘刷完后唤醒
-      append_cv_.wait(latch);
-    }
+    // append_cv_ 用来阻塞追加线程，等待刷磁盘完成后解锁
+    append_cv_.wait(latch, [&] { return !need_flush_.load(); });
+  }
+}
+
+void LogManager::WaitForFlush(lsn_t lsn) {
+  auto latch = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+  // 已经落盘，可能被其它提交一起刷了
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  if (flush_thread_ == nullptr) {
+    FlushLogBuffer();
+    return;
   }
+  need_flush_ = true;
+  cv_.notify_one();
+  append_cv_.wait(latch, [&] { return persistent_lsn_ >= lsn; });
+}
+
+lsn_t LogManager::LogCheckpoint() {
+  Flush(true);
+  // 没有活跃事务，日志缓冲区已经刷空，检查点日志就从文件结尾开始
+  int log_offset = disk_manager_->GetLogFileSize();
+  LogRecord log(INVALID_TXN_ID, INVALID_LSN, LogRecordType::CHECKPOINT);
+  lsn_t lsn = AppendLogRecord(&log);
+  WaitForFlush(lsn);
+  disk_manager_->WriteMasterRecord(log_offset, lsn);
+  auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+  checkpoint_offset_ = log_offset;
+  return lsn;
+}
+
+int LogManager::GetLogSizeSinceCheckpoint() {
+  auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+  return std::max(disk_manager_->GetLogFileSize() + log_buffer_offset_ - checkpoint_offset_, 0);
+}
+
+void LogManager::SetFlushTimeout(std::chrono::milliseconds timeout) {
+  auto guard = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+  flush_timeout_ = timeout;
+}
+
+lsn_t LogManager::WaitForPersistentLSN(lsn_t lsn, std::chrono::milliseconds timeout) {
+  auto latch = ContentionStats::Lock(&latch_, ContentionSource::LOG_MANAGER_LATCH);
+  // 每次 flush 后都会唤醒 append_cv_
+  append_cv_.wait_for(latch, timeout, [&] { return persistent_lsn_ > lsn; });
+  return persistent_lsn_;
 }
 
 }  // namespace bustub
@@ -0,0 +1,141 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_record.cpp
+//
+// Identification: src/recovery/log_record.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_record.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bustub {
+
+/*
+ * ranges closer than MERGE_GAP bytes are merged, logging the unchanged gap twice is cheaper than
+ * another offset/length pair
+ */
+static constexpr uint32_t MERGE_GAP = 2;
+
+bool LogRecord::EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::string *delta) {
+  if (old_tuple.GetLength() != new_tuple.GetLength()) {
+    return false;
+  }
+  const char *old_data = old_tuple.GetData();
+  const char *new_data = new_tuple.GetData();
+  uint32_t length = old_tuple.GetLength();
+  // 整条 update 日志 body(除 rid) 的大小
+  size_t full_size = 2 * sizeof(int32_t) + 2 * length;
+  delta->clear();
+  uint32_t i = 0;
+  while (i < length) {
+    if (old_data[i] == new_data[i]) {
+      i++;
+      continue;
+    }
+    // 找到一段变化区间 [begin, end)，间隔很小的区间合并
+    uint32_t begin = i;
+    uint32_t end = i + 1;
+    for (uint32_t j = end; j < length && j <= end + MERGE_GAP; j++) {
+      if (old_data[j] != new_data[j]) {
+        end = j + 1;
+      }
+    }
+    auto offset = static_cast<uint16_t>(begin);
+    auto range_length = static_cast<uint16_t>(end - begin);
+    delta->append(reinterpret_cast<const char *>(&offset), sizeof(uint16_t));
+    delta->append(reinterpret_cast<const char *>(&range_length), sizeof(uint16_t));
+    delta->append(old_data + begin, range_length);
+    delta->append(new_data + begin, range_length);
+    if (delta->size() >= full_size) {
+      return false;
+    }
+    i = end;
+  }
+  return true;
+}
+
+void LogRecord::ApplyDelta(const std::string &delta, char *data) {
+  size_t pos = 0;
+  while (pos < delta.size()) {
+    uint16_t offset;
+    uint16_t range_length;
+    memcpy(&offset, delta.data() + pos, sizeof(uint16_t));
+    memcpy(&range_length, delta.data() + pos + sizeof(uint16_t), sizeof(uint16_t));
+    pos += 2 * sizeof(uint16_t);
+    // 跳过旧数据，写入新数据
+    memcpy(data + offset, delta.data() + pos + range_length, range_length);
+    pos += 2 * range_length;
+  }
+}
+
+std::string LogRecord::InvertDelta(const std::string &delta) {
+  std::string inverse;
+  inverse.reserve(delta.size());
+  size_t pos = 0;
+  while (pos < delta.size()) {
+    uint16_t range_length;
+    memcpy(&range_length, delta.data() + pos + sizeof(uint16_t), sizeof(uint16_t));
+    inverse.append(delta, pos, 2 * sizeof(uint16_t));
+    pos += 2 * sizeof(uint16_t);
+    // 新旧数据交换
+    inverse.append(delta, pos + range_length, range_length);
+    inverse.append(delta, pos, range_length);
+    pos += 2 * range_length;
+  }
+  return inverse;
+}
+
+void LogRecord::AddPageWrite(std::string *page_writes, page_id_t page_id, uint32_t offset, const char *data,
+                             uint32_t length) {
+  auto write_offset = static_cast<uint16_t>(offset);
+  auto write_length = static_cast<uint16_t>(length);
+  page_writes->append(reinterpret_cast<const char *>(&page_id), sizeof(page_id_t));
+  page_writes->append(reinterpret_cast<const char *>(&write_offset), sizeof(uint16_t));
+  page_writes->append(reinterpret_cast<const char *>(&write_length), sizeof(uint16_t));
+  page_writes->append(data, length);
+}
+
+bool LogRecord::ApplyPageWrites(const std::string &page_writes, page_id_t page_id, char *data) {
+  bool applied = false;
+  size_t pos = 0;
+  while (pos < page_writes.size()) {
+    page_id_t write_page_id;
+    uint16_t offset;
+    uint16_t length;
+    memcpy(&write_page_id, page_writes.data() + pos, sizeof(page_id_t));
+    memcpy(&offset, page_writes.data() + pos + sizeof(page_id_t), sizeof(uint16_t));
+    memcpy(&length, page_writes.data() + pos + sizeof(page_id_t) + sizeof(uint16_t), sizeof(uint16_t));
+    pos += sizeof(page_id_t) + 2 * sizeof(uint16_t);
+    if (write_page_id == page_id) {
+      memcpy(data + offset, page_writes.data() + pos, length);
+      applied = true;
+    }
+    pos += length;
+  }
+  return applied;
+}
+
+std::vector<page_id_t> LogRecord::GetWrittenPages(const std::string &page_writes) {
+  std::vector<page_id_t> page_ids;
+  size_t pos = 0;
+  while (pos < page_writes.size()) {
+    page_id_t page_id;
+    uint16_t length;
+    memcpy(&page_id, page_writes.data() + pos, sizeof(page_id_t));
+    memcpy(&length, page_writes.data() + pos + sizeof(page_id_t) + sizeof(uint16_t), sizeof(uint16_t));
+    pos += sizeof(page_id_t) + 2 * sizeof(uint16_t) + length;
+    if (std::find(page_ids.begin(), page_ids.end(), page_id) == page_ids.end()) {
+      page_ids.push_back(page_id);
+    }
+  }
+  return page_ids;
+}
+
+}  // namespace bustub
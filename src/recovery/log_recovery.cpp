@@ -12,9 +12,39 @@
 
 #include "recovery/log_recovery.h"
 
+#include <limits>
+#include <queue>
+
+#include "storage/page/header_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+/*
+ * rid of the tuple a record (or the action carried by a CLR) works on
+ */
+static RID GetActionRID(LogRecord *log) {
+  LogRecordType type = log->GetActionType();
+  return type == LogRecordType::INSERT ? log->GetInsertRID()
+         : type == LogRecordType::UPDATE || type == LogRecordType::DELTAUPDATE ? log->GetUpdateRID()
+                                                                               : log->GetDeleteRID();
+}
+
+/*
+ * read the header of a record field by field, | size | LSN | transID | prevLSN | LogType |
+ */
+void LogRecovery::DeserializeHeader(const char *data, LogRecord *log_record) {
+  memcpy(&log_record->size_, data, sizeof(int32_t));
+  data += sizeof(int32_t);
+  memcpy(&log_record->lsn_, data, sizeof(lsn_t));
+  data += sizeof(lsn_t);
+  memcpy(&log_record->txn_id_, data, sizeof(txn_id_t));
+  data += sizeof(txn_id_t);
+  memcpy(&log_record->prev_lsn_, data, sizeof(lsn_t));
+  data += sizeof(lsn_t);
+  memcpy(&log_record->log_record_type_, data, sizeof(LogRecordType));
+}
+
 /*
  * deserialize a log record from log buffer
  * @link: https://www.bdwms.com/?p=750
@@ -26,13 +56,20 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
   if (data + LogRecord::HEADER_SIZE > log_buffer_ + LOG_BUFFER_SIZE) {
     return false;
   }
-  memcpy(log_record, data, LogRecord::HEADER_SIZE);  // 拷贝头部数据
+  DeserializeHeader(data, log_record);  // 拷贝头部数据
   // 如果 log_record 大小 <= 0 或者
   if (log_record->size_ <= 0 || data + log_record->size_ > log_buffer_ + LOG_BUFFER_SIZE) {
     return false;
   }
+  const char *end = data + log_record->size_;
   data += LogRecord::HEADER_SIZE;
-  switch (log_record->log_record_type_) {
+  // 补偿日志，先读 undo_next_lsn 与 action_type，之后按 action 的类型解析
+  if (log_record->log_record_type_ == LogRecordType::CLR) {
+    log_record->undo_next_lsn_ = *reinterpret_cast<const lsn_t *>(data);
+    log_record->action_type_ = *reinterpret_cast<const LogRecordType *>(data + sizeof(lsn_t));
+    data += sizeof(lsn_t) + sizeof(LogRecordType);
+  }
+  switch (log_record->GetActionType()) {
     case LogRecordType::INSERT:
       log_record->insert_rid_ = *reinterpret_cast<const RID *>(data);
       // 已经包含了处理 tuple_size
@@ -49,9 +86,26 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
       log_record->old_tuple_.DeserializeFrom(data + sizeof(RID));
       log_record->new_tuple_.DeserializeFrom(data + sizeof(RID) + sizeof(int32_t) + log_record->old_tuple_.GetLength());
       break;
+    case LogRecordType::DELTAUPDATE:
+      log_record->update_rid_ = *reinterpret_cast<const RID *>(data);
+      // 剩下的都是变化区间
+      log_record->delta_.assign(data + sizeof(RID), end);
+      break;
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE:
+      for (std::string *field : {&log_record->index_name_, &log_record->index_key_, &log_record->index_value_}) {
+        int32_t field_size = *reinterpret_cast<const int32_t *>(data);
+        field->assign(data + sizeof(int32_t), field_size);
+        data += sizeof(int32_t) + field_size;
+      }
+      break;
+    case LogRecordType::INDEXPAGES:
+      log_record->page_writes_.assign(data, end);
+      break;
     case LogRecordType::BEGIN:
     case LogRecordType::COMMIT:
     case LogRecordType::ABORT:
+    case LogRecordType::CHECKPOINT:
       break;
     case LogRecordType::NEWPAGE:
       log_record->prev_page_id_ = *reinterpret_cast<const page_id_t *>(data);
@@ -67,166 +121,682 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  * redo phase on TABLE PAGE level(table/table_page.h)
  * read log file from the beginning to end (you must prefetch log records into
  * log buffer to reduce unnecessary I/O operations), remember to compare page's
- * LSN with log_record's sequence number, and also build active_txn_ table &
- * lsn_mapping_ table
+ * LSN with log_record's sequence number, and also build active_txn_ table
  * 重做，对缓冲区中的日志记录进行重做
- * 这里的 Redo 有些暴力，从头到尾的读取日志文件，然后记录 lsn_mapping_ 和 active_txn_
+ * 这里的 Redo 有些暴力，从头到尾的读取日志文件，然后记录 active_txn_，已结束事务的记录会被丢弃
+ * 当 redo_worker_num_ > 1 时，当前线程只负责读日志与分发，页级别的重做交给 worker 并行执行
  */
 void LogRecovery::Redo() {
   assert(enable_logging == false);
-  // 从头开始读到结尾
-  offset_ = 0;
+  StartRedoWorkers();
+  ScanLog();
+  StopRedoWorkers();
+  RecordActiveVersions();
+}
+
+/*
+ * analysis phase of instant restart: scan the log like Redo, but only build active_txn_ and
+ * the per-page index of pending records, pages are redone when the buffer pool first fetches them
+ * 即时恢复的分析阶段，只建立每个页待重做的日志索引，不访问任何页
+ */
+void LogRecovery::Analyze() {
+  assert(enable_logging == false);
+  analyze_only_ = true;
+  ScanLog();
+  analyze_only_ = false;
+  pending_page_num_ = pending_pages_.size();
+  if (pending_page_num_ > 0) {
+    buffer_pool_manager_->SetLogRecovery(this);
+  }
+}
+
+/*
+ * read the whole log, dispatch every page level record
+ */
+void LogRecovery::ScanLog() {
+  window_offset_ = -1;  // log_buffer_ 将被覆盖
+  // 从最后一个检查点开始读到结尾
+  offset_ = GetStartOffset();
   int buffer_offset = 0;
   // 从磁盘中读取日志数据到 log_buffer 中
   while (disk_manager_->ReadLog(log_buffer_ + buffer_offset, LOG_BUFFER_SIZE - buffer_offset, offset_)) {
-    int buffer_start = offset_;                    // 开始偏移
+    int buffer_start = offset_ - buffer_offset;    // log_buffer_ 开头在文件中的偏移，包含上次剩下的半条日志
     offset_ += (LOG_BUFFER_SIZE - buffer_offset);  // 增加偏移
     buffer_offset = 0;                             // 重制缓冲区
     LogRecord log;
     while (DeserializeLogRecord(log_buffer_ + buffer_offset, &log)) {
-      lsn_mapping_[log.GetLSN()] = buffer_start + buffer_offset;  // 更新 lsn_mapping
-      active_txn_[log.txn_id_] = log.lsn_;                        // 更新 active_txn
-      buffer_offset += log.size_;                                 // 更新 buffer_offset
-      // 事务开始无需操作
-      if (log.log_record_type_ == LogRecordType::BEGIN) {
-        continue;
-      }
-      // 事务提交、终止无需操作
-      if (log.log_record_type_ == LogRecordType::COMMIT || log.log_record_type_ == LogRecordType::ABORT) {
-        // 如果事务已经提交、或者已经终止了，那么就从 active_txn_ 中删除
-        // active_txn 中只记录活跃的事务
-        assert(active_txn_.erase(log.GetTxnId()) > 0);  // 从 active_txn_ 中删除 lsn
-        continue;
-      }
-      // 新页
-      if (log.log_record_type_ == LogRecordType::NEWPAGE) {
-        // 获取新页
-        auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(log.page_id_));
-        assert(page != nullptr);
-        bool need_redo = log.lsn_ > page->GetLSN();  // 判断 lsn 是否需要重做
-        if (need_redo) {                             // redo
-          // 初始化 page
-          page->Init(log.page_id_, PAGE_SIZE, log.prev_page_id_, nullptr, nullptr);
-          // 设置 lsn
-          page->SetLSN(log.lsn_);
-          // 如果有前页
-          if (log.prev_page_id_ != INVALID_PAGE_ID) {
-            auto prev_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(log.prev_page_id_));
-            assert(prev_page != nullptr);
-            bool needChange =
-                prev_page->GetNextPageId() == log.page_id_;  // 判断前页的 next_page 是否为 page，是否需要改变
-            prev_page->SetNextPageId(log.page_id_);          // 设置 next_page_id
-            buffer_pool_manager_->UnpinPage(prev_page->GetPageId(), needChange);
-          }
-        }
-        buffer_pool_manager_->UnpinPage(page->GetPageId(), need_redo);
-        continue;
-      }
-      // 插入、更新、删除
-      RID rid = log.log_record_type_ == LogRecordType::INSERT   ? log.insert_rid_
-                : log.log_record_type_ == LogRecordType::UPDATE ? log.update_rid_
-                                                                : log.delete_rid_;
-      auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
-      assert(page != nullptr);
-      bool need_redo = log.lsn_ > page->GetLSN();  // lsn 记录了序号，lsn 必须大于页的 lsn 才能 redo
-      if (need_redo) {
-        if (log.log_record_type_ == LogRecordType::INSERT) {
-          page->InsertTuple(log.insert_tuple_, &rid, nullptr, nullptr, nullptr);
-        } else if (log.log_record_type_ == LogRecordType::UPDATE) {
-          page->UpdateTuple(log.new_tuple_, &log.old_tuple_, rid, nullptr, nullptr, nullptr);
-        } else if (log.log_record_type_ == LogRecordType::MARKDELETE) {
-          page->MarkDelete(rid, nullptr, nullptr, nullptr);
-        } else if (log.log_record_type_ == LogRecordType::APPLYDELETE) {
-          page->ApplyDelete(rid, nullptr, nullptr);
-        } else if (log.log_record_type_ == LogRecordType::ROLLBACKDELETE) {
-          page->RollbackDelete(rid, nullptr, nullptr);
-        } else {
-          assert(false);  // 非法
-        }
-        page->SetLSN(log.lsn_);  // redo 后更新 lsn
-      }
-      // 记得 unpin
-      buffer_pool_manager_->UnpinPage(page->GetPageId(), need_redo);
+      ScanRecord(&log, buffer_start + buffer_offset);
+      buffer_offset += log.size_;  // 更新 buffer_offset
     }
+    log_end_offset_ = buffer_start + buffer_offset;  // 最后一条完整日志的结尾
     // 移动 log_buffer_ + buffer_offset 到 log_buffer_
     memmove(log_buffer_, log_buffer_ + buffer_offset, LOG_BUFFER_SIZE - buffer_offset);
     buffer_offset = LOG_BUFFER_SIZE - buffer_offset;  // 更新 buffer_offset
   }
 }
 
+/*
+ * the log before the last checkpoint is not needed, every page was flushed then and no transaction was
+ * active. The master record tells where the checkpoint record is, one that doesn't match the log is ignored
+ * @return: offset in the log file to scan from
+ */
+int LogRecovery::GetStartOffset() {
+  int log_offset;
+  lsn_t lsn;
+  if (!disk_manager_->ReadMasterRecord(&log_offset, &lsn)) {
+    return 0;
+  }
+  // 只看头部，偏移不对时读到的可能是任意数据
+  LogRecord log;
+  if (log_offset >= 0 && disk_manager_->ReadLog(log_buffer_, LogRecord::HEADER_SIZE, log_offset)) {
+    DeserializeHeader(log_buffer_, &log);
+  }
+  if (log.log_record_type_ == LogRecordType::CHECKPOINT && log.lsn_ == lsn && log.size_ == LogRecord::HEADER_SIZE) {
+    LOG_INFO("recovery starts at the checkpoint at offset %d, lsn %d", log_offset, lsn);
+    return log_offset;
+  }
+  LOG_WARN("master record doesn't match the log, recovery starts at the beginning");
+  return 0;
+}
+
+/*
+ * track the transaction of a record and dispatch the redo of every page it touches
+ * @param offset: offset of the record in the log file
+ */
+void LogRecovery::ScanRecord(LogRecord *log, int offset) {
+  // 索引页修改不属于任何事务，不会被撤销
+  if (log->txn_id_ != INVALID_TXN_ID) {
+    active_txn_[log->txn_id_].emplace_back(log->lsn_, offset);  // 更新 active_txn
+  }
+  max_lsn_ = std::max(max_lsn_.load(), log->lsn_);
+  // 事务开始、检查点无需操作
+  if (log->log_record_type_ == LogRecordType::BEGIN || log->log_record_type_ == LogRecordType::CHECKPOINT) {
+    return;
+  }
+  // 事务提交、终止无需操作
+  if (log->log_record_type_ == LogRecordType::COMMIT || log->log_record_type_ == LogRecordType::ABORT) {
+    // 如果事务已经提交、或者已经终止了，那么就从 active_txn_ 中删除
+    // active_txn 中只记录活跃的事务
+    active_txn_.erase(log->GetTxnId());  // 从 active_txn_ 中删除
+    EndVersions(log->GetTxnId(), log->log_record_type_ == LogRecordType::COMMIT);
+    return;
+  }
+  // 新页，涉及新页本身的初始化和前页 next_page_id 的链接两个页
+  // 补偿日志中的新页表示撤销，只需断开前页的链接
+  if (log->GetActionType() == LogRecordType::NEWPAGE) {
+    if (log->log_record_type_ == LogRecordType::NEWPAGE) {
+      DispatchRedo(log->page_id_, log);
+    }
+    if (log->prev_page_id_ != INVALID_PAGE_ID) {
+      DispatchRedo(log->prev_page_id_, log);
+    }
+    return;
+  }
+  // 索引项（以及撤销它的补偿日志）只用于撤销，页的修改由 INDEXPAGES 重做，一次分裂或合并涉及的页都在同一条记录里
+  if (log->GetActionType() == LogRecordType::INDEXINSERT || log->GetActionType() == LogRecordType::INDEXDELETE) {
+    return;
+  }
+  if (log->log_record_type_ == LogRecordType::INDEXPAGES) {
+    for (page_id_t page_id : LogRecord::GetWrittenPages(log->page_writes_)) {
+      DispatchRedo(page_id, log);
+    }
+    return;
+  }
+  // 插入、更新、删除，以及它们的补偿日志
+  DispatchRedo(GetActionRID(log).GetPageId(), log);
+}
+
+/*
+ * standby: redo a piece of the log streamed from the primary, data starts at a record boundary,
+ * a record cut at the end is left to the caller to send again with the rest of it
+ * @return: bytes of the complete records replayed
+ */
+int LogRecovery::ReplayLog(int log_offset, const char *data, int size) {
+  assert(size <= LOG_BUFFER_SIZE);
+  window_offset_ = -1;  // log_buffer_ 将被覆盖
+  memcpy(log_buffer_, data, size);
+  memset(log_buffer_ + size, 0, LOG_BUFFER_SIZE - size);  // 之后的数据不能被当作日志
+  int buffer_offset = 0;
+  LogRecord log;
+  replaying_ = true;
+  while (DeserializeLogRecord(log_buffer_ + buffer_offset, &log)) {
+    ScanRecord(&log, log_offset + buffer_offset);
+    buffer_offset += log.size_;
+  }
+  replaying_ = false;
+  log_end_offset_ = log_offset + buffer_offset;
+  return buffer_offset;
+}
+
+/*
+ * start the redo workers, nothing to do when redo runs on the calling thread
+ */
+void LogRecovery::StartRedoWorkers() {
+  last_prefetch_page_id_ = INVALID_PAGE_ID;
+  if (redo_worker_num_ <= 1) {
+    return;
+  }
+  for (size_t i = 0; i < redo_worker_num_; i++) {
+    redo_queues_.emplace_back(std::make_unique<RedoQueue>());
+  }
+  for (size_t i = 0; i < redo_worker_num_; i++) {
+    redo_workers_.emplace_back(&LogRecovery::RunRedoWorker, this, redo_queues_[i].get());
+  }
+}
+
+/*
+ * tell every worker that the log is exhausted, wait them to drain their queues
+ */
+void LogRecovery::StopRedoWorkers() {
+  for (auto &queue : redo_queues_) {
+    {
+      std::lock_guard<std::mutex> guard(queue->latch_);
+      queue->finished_ = true;
+    }
+    queue->cv_.notify_all();
+  }
+  for (auto &worker : redo_workers_) {
+    worker.join();
+  }
+  redo_workers_.clear();
+  redo_queues_.clear();
+}
+
+void LogRecovery::RunRedoWorker(RedoQueue *queue) {
+  while (true) {
+    std::unique_lock<std::mutex> latch(queue->latch_);
+    queue->cv_.wait(latch, [&] { return !queue->records_.empty() || queue->finished_; });
+    if (queue->records_.empty()) {
+      return;  // 日志已读完且队列已清空
+    }
+    auto record = std::move(queue->records_.front());
+    queue->records_.pop_front();
+    latch.unlock();
+    queue->cv_.notify_all();  // 唤醒可能因队列满而阻塞的读线程
+    RedoPage(record.first, &record.second);
+  }
+}
+
+/*
+ * hand a log record to the worker owning page_id; the reader prefetches the page
+ * so that it is already in the buffer pool when the worker gets to the record
+ */
+void LogRecovery::DispatchRedo(page_id_t page_id, LogRecord *log) {
+  if (analyze_only_) {
+    pending_pages_[page_id].push_back(*log);
+    return;
+  }
+  if (redo_queues_.empty()) {
+    RedoPage(page_id, log);
+    return;
+  }
+  auto &queue = redo_queues_[static_cast<size_t>(page_id) % redo_queues_.size()];
+  {
+    std::unique_lock<std::mutex> latch(queue->latch_);
+    queue->cv_.wait(latch, [&] { return queue->records_.size() < REDO_QUEUE_DEPTH; });
+    queue->records_.emplace_back(page_id, *log);
+  }
+  queue->cv_.notify_all();
+  // 预读，连续落在同一页的记录只预读一次
+  if (page_id != last_prefetch_page_id_) {
+    buffer_pool_manager_->PrefetchPage(page_id);
+    last_prefetch_page_id_ = page_id;
+  }
+}
+
+/*
+ * redo a log record against a single page, NEWPAGE records are applied twice:
+ * once to init the new page and once to link it from prev_page_id
+ */
+void LogRecovery::RedoPage(page_id_t page_id, LogRecord *log) {
+  auto page = reinterpret_cast<TablePage *>(FetchPage(page_id));
+  // standby 重做时可能有只读查询在读这一页
+  page->WLatch();
+  bool changed = RedoOnPage(page_id, page, log);
+  page->WUnlatch();
+  // 记得 unpin
+  buffer_pool_manager_->UnpinPage(page_id, changed);
+}
+
+/*
+ * @return: true if the page was changed
+ */
+bool LogRecovery::RedoOnPage(page_id_t page_id, TablePage *page, LogRecord *log) {
+  if (log->log_record_type_ == LogRecordType::INDEXPAGES) {
+    // header page 的 lsn 在页尾
+    auto *header_page = page_id == HEADER_PAGE_ID ? reinterpret_cast<HeaderPage *>(page) : nullptr;
+    if (log->lsn_ <= (header_page != nullptr ? header_page->GetLSN() : page->GetLSN())) {
+      return false;
+    }
+    LogRecord::ApplyPageWrites(log->page_writes_, page_id, page->GetData());
+    if (header_page != nullptr) {
+      header_page->SetLSN(log->lsn_);
+    } else {
+      page->SetLSN(log->lsn_);
+    }
+    return true;
+  }
+  if (log->GetActionType() == LogRecordType::NEWPAGE && page_id == log->prev_page_id_) {
+    // 判断前页的 next_page 是否需要改变，补偿日志需要断开链接
+    bool is_undo = log->log_record_type_ == LogRecordType::CLR;
+    bool need_change =
+        is_undo ? page->GetNextPageId() == log->page_id_ : page->GetNextPageId() != log->page_id_;
+    if (need_change) {
+      page->SetNextPageId(is_undo ? INVALID_PAGE_ID : log->page_id_);  // 设置 next_page_id
+    }
+    return need_change;
+  }
+  bool need_redo = log->lsn_ > page->GetLSN();  // lsn 记录了序号，lsn 必须大于页的 lsn 才能 redo
+  if (need_redo) {
+    if (replaying_) {
+      RecordVersion(page, log);
+    }
+    ApplyAction(page, log);
+    page->SetLSN(log->lsn_);  // redo 后更新 lsn
+  }
+  return need_redo;
+}
+
+/*
+ * instant restart: called by the buffer pool (holding its latch) with a page it just fetched,
+ * apply the pending records of the page, the page must not be fetched from here
+ * @return: true if the page was changed
+ */
+bool LogRecovery::RecoverPage(Page *page) {
+  if (pending_page_num_ == 0) {
+    return false;
+  }
+  std::vector<LogRecord> records;
+  {
+    std::lock_guard<std::mutex> guard(pending_latch_);
+    auto iter = pending_pages_.find(page->GetPageId());
+    if (iter == pending_pages_.end()) {
+      return false;
+    }
+    records = std::move(iter->second);
+    pending_pages_.erase(iter);
+    pending_page_num_ = pending_pages_.size();
+  }
+  bool changed = false;
+  for (auto &log : records) {
+    changed = RedoOnPage(page->GetPageId(), reinterpret_cast<TablePage *>(page), &log) || changed;
+  }
+  return changed;
+}
+
+/*
+ * start a thread redoing the pages no query has touched yet
+ */
+void LogRecovery::StartBackgroundRedo() {
+  if (background_redo_thread_ != nullptr) {
+    return;
+  }
+  enable_background_redo_ = true;
+  background_redo_thread_ = new std::thread([&] {
+    while (enable_background_redo_ && RedoNextPendingPage()) {
+    }
+    if (pending_page_num_ == 0) {
+      buffer_pool_manager_->SetLogRecovery(nullptr);
+    }
+  });
+}
+
+/*
+ * redo all the pages still pending, together with the background thread if it runs
+ */
+void LogRecovery::RedoPendingPages() {
+  while (RedoNextPendingPage()) {
+  }
+  buffer_pool_manager_->SetLogRecovery(nullptr);
+}
+
+/*
+ * redo one of the pending pages by fetching it
+ * @return: false if no page is pending
+ */
+bool LogRecovery::RedoNextPendingPage() {
+  page_id_t page_id;
+  {
+    std::lock_guard<std::mutex> guard(pending_latch_);
+    if (pending_pages_.empty()) {
+      return false;
+    }
+    page_id = pending_pages_.begin()->first;
+  }
+  // 通过 FetchPage 触发重做
+  if (buffer_pool_manager_->FetchPage(page_id) == nullptr) {
+    std::this_thread::yield();
+    return true;
+  }
+  buffer_pool_manager_->UnpinPage(page_id, false);
+  return true;
+}
+
+/*
+ * stop and join the background redo thread, pages left are still redone on demand
+ */
+void LogRecovery::StopBackgroundRedo() {
+  if (background_redo_thread_ == nullptr) {
+    return;
+  }
+  enable_background_redo_ = false;
+  background_redo_thread_->join();
+  delete background_redo_thread_;
+  background_redo_thread_ = nullptr;
+}
+
+/*
+ * apply the table page operation of a record, for a CLR this is the compensating action it carries
+ */
+void LogRecovery::ApplyAction(TablePage *page, LogRecord *log) {
+  LogRecordType type = log->GetActionType();
+  RID rid = GetActionRID(log);
+  if (type == LogRecordType::NEWPAGE) {
+    // 初始化 page
+    page->Init(log->page_id_, PAGE_SIZE, log->prev_page_id_, nullptr, nullptr);
+  } else if (type == LogRecordType::INSERT) {
+    page->InsertTuple(log->insert_tuple_, &rid, nullptr, nullptr, nullptr);
+  } else if (type == LogRecordType::UPDATE) {
+    page->UpdateTuple(log->new_tuple_, &log->old_tuple_, rid, nullptr, nullptr, nullptr);
+  } else if (type == LogRecordType::DELTAUPDATE) {
+    // 在当前 tuple 上打补丁
+    Tuple tuple;
+    page->GetTuple(rid, &tuple, nullptr, nullptr);
+    LogRecord::ApplyDelta(log->delta_, tuple.GetData());
+    page->UpdateTuple(tuple, &log->old_tuple_, rid, nullptr, nullptr, nullptr);
+  } else if (type == LogRecordType::MARKDELETE) {
+    page->MarkDelete(rid, nullptr, nullptr, nullptr);
+  } else if (type == LogRecordType::APPLYDELETE) {
+    page->ApplyDelete(rid, nullptr, nullptr, nullptr);
+  } else if (type == LogRecordType::ROLLBACKDELETE) {
+    page->RollbackDelete(rid, nullptr, nullptr);
+  } else {
+    assert(false);  // 非法
+  }
+}
+
+/*
+ * fetch a page, several workers may pin pages at the same time, so wait for a free frame
+ * instead of failing when the buffer pool is momentarily full
+ */
+Page *LogRecovery::FetchPage(page_id_t page_id) {
+  Page *page;
+  while ((page = buffer_pool_manager_->FetchPage(page_id)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return page;
+}
+
 /*
  * undo phase on TABLE PAGE level(table/table_page.h)
- * iterate through active txn map and undo each operation
- * 撤销，对缓冲区的日志执行撤销
+ * undo all the active txns together, always picking the record with the largest lsn,
+ * so that the log is read backwards through the log buffer instead of one read per record
+ * 撤销，所有未完成事务按 lsn 从大到小一起撤销；若有 log_manager_，为每次撤销写补偿日志，
+ * 事务撤销完成后写 ABORT，恢复中途崩溃后再次恢复不会重复撤销
  */
 void LogRecovery::Undo() {
   assert(enable_logging == false);
+  if (log_manager_ != nullptr) {
+    // 接着日志文件中已有的 lsn 编号
+    log_manager_->SetNextLSN(max_lsn_ + 1);
+    log_manager_->SetPersistentLSN(max_lsn_);
+  }
+  // (lsn, txn_id)，大顶堆
+  std::priority_queue<std::pair<lsn_t, txn_id_t>> undo_queue;
+  // 事务最后一条日志的 lsn，作为补偿日志的 prev_lsn
+  std::unordered_map<txn_id_t, lsn_t> last_lsn;
   for (auto &txn : active_txn_) {
-    lsn_t lsn = txn.second;  // 得到 lsn
-    while (lsn != INVALID_LSN) {
-      LogRecord log;
-      // 读取日志数据
-      disk_manager_->ReadLog(log_buffer_, PAGE_SIZE, lsn_mapping_[lsn]);
-      assert(DeserializeLogRecord(log_buffer_, &log));  // 序列化日志记录
-      assert(log.lsn_ == lsn);
-      lsn = log.prev_lsn_;  // 得到上一个 lsn，为什么是上一个？因为是 undo，所以得反向执行
-      if (log.log_record_type_ == LogRecordType::BEGIN) {  // 事务开始
-        assert(log.prev_lsn_ == INVALID_LSN);              // 上一个 lsn 应该是 invalid
-        continue;
+    undo_queue.emplace(txn.second.back().first, txn.first);
+    last_lsn[txn.first] = txn.second.back().first;
+  }
+  while (!undo_queue.empty()) {
+    txn_id_t txn_id = undo_queue.top().second;
+    undo_queue.pop();
+    auto &records = active_txn_[txn_id];
+    LogRecord log;
+    ReadLogRecord(records.back().second, &log);
+    assert(log.lsn_ == records.back().first);
+    records.pop_back();
+    if (log.log_record_type_ == LogRecordType::CLR) {
+      // 上一次恢复已经撤销到 undo_next_lsn，跳过已补偿的记录
+      while (!records.empty() && records.back().first > log.undo_next_lsn_) {
+        records.pop_back();
+      }
+    } else if (log.log_record_type_ == LogRecordType::BEGIN) {
+      assert(log.prev_lsn_ == INVALID_LSN);  // 上一个 lsn 应该是 invalid
+    } else if (log.log_record_type_ == LogRecordType::INDEXINSERT ||
+               log.log_record_type_ == LogRecordType::INDEXDELETE) {
+      UndoIndexRecord(&log, &last_lsn[txn_id]);
+    } else {
+      UndoRecord(&log, &last_lsn[txn_id]);
+    }
+    if (!records.empty()) {
+      undo_queue.emplace(records.back().first, txn_id);
+      continue;
+    }
+    // 事务已经全部撤销
+    if (log_manager_ != nullptr) {
+      LogRecord abort_log(txn_id, last_lsn[txn_id], LogRecordType::ABORT);
+      log_manager_->AppendLogRecord(&abort_log);
+    }
+  }
+  if (log_manager_ != nullptr) {
+    log_manager_->Flush(true);
+  }
+  // 页已经撤销，未完成事务的旧版本不再需要
+  while (!version_txns_.empty()) {
+    EndVersions(version_txns_.begin()->first, false);
+  }
+  // 清空
+  active_txn_.clear();
+}
+
+/*
+ * undo a single record, write a CLR for it when a log manager is present
+ */
+void LogRecovery::UndoRecord(LogRecord *log, lsn_t *last_lsn) {
+  // 事务提交、终止，不应该出现
+  assert(log->log_record_type_ != LogRecordType::COMMIT && log->log_record_type_ != LogRecordType::ABORT);
+  if (log->log_record_type_ == LogRecordType::NEWPAGE) {  // 如果是 new page
+    {
+      // 即时恢复时页可能还没重做过，丢掉它待重做的日志，否则删除后又被重做出来
+      std::lock_guard<std::mutex> guard(pending_latch_);
+      if (pending_pages_.erase(log->page_id_) > 0) {
+        pending_page_num_ = pending_pages_.size();
       }
-      // 事务提交、终止，不应该出现
-      if (log.log_record_type_ == LogRecordType::COMMIT || log.log_record_type_ == LogRecordType::ABORT) {
-        assert(false);
+    }
+    if (!buffer_pool_manager_->DeletePage(log->page_id_)) {  // 那么删除 page(反向执行)
+      disk_manager_->DeallocatePage(log->page_id_);
+    }
+    // 表的第一页没有前页，也要写补偿日志，再次恢复时不会重复撤销
+    if (log_manager_ != nullptr) {
+      LogRecord clr(log->txn_id_, *last_lsn, log->prev_lsn_, *log);
+      *last_lsn = log_manager_->AppendLogRecord(&clr);
+    }
+    if (log->prev_page_id_ != INVALID_PAGE_ID) {  // 上一页的 next_page 得重置
+      auto prev_page = reinterpret_cast<TablePage *>(FetchPage(log->prev_page_id_));
+      assert(prev_page->GetNextPageId() == log->page_id_);
+      prev_page->SetNextPageId(INVALID_PAGE_ID);
+      if (log_manager_ != nullptr) {
+        prev_page->SetLSN(*last_lsn);
       }
-      // 剩下的全部反操作
-      if (log.log_record_type_ == LogRecordType::NEWPAGE) {     // 如果是 new page
-        if (!buffer_pool_manager_->DeletePage(log.page_id_)) {  // 那么删除 page(反向执行)
-          disk_manager_->DeallocatePage(log.page_id_);
-        }
-        if (log.prev_page_id_ != INVALID_PAGE_ID) {  // 上一页的 next_page 得重置
-          auto prev_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(log.prev_page_id_));
-          assert(prev_page != nullptr);
-          assert(prev_page->GetNextPageId() == log.page_id_);
-          prev_page->SetNextPageId(INVALID_PAGE_ID);
-          buffer_pool_manager_->UnpinPage(prev_page->GetPageId(), true);
-        }
+      buffer_pool_manager_->UnpinPage(prev_page->GetPageId(), true);
+    }
+    return;
+  }
+  // 插入、更新、删除，构造反操作
+  LogRecord action;
+  if (log->log_record_type_ == LogRecordType::INSERT) {
+    // insert，反向执行 apply delete
+    action = LogRecord(log->txn_id_, INVALID_LSN, LogRecordType::APPLYDELETE, log->insert_rid_, log->insert_tuple_);
+  } else if (log->log_record_type_ == LogRecordType::UPDATE) {
+    // update 交换 old,new 执行
+    action = LogRecord(log->txn_id_, INVALID_LSN, LogRecordType::UPDATE, log->update_rid_, log->new_tuple_,
+                       log->old_tuple_);
+  } else if (log->log_record_type_ == LogRecordType::DELTAUPDATE) {
+    // delta update 交换每段的新旧字节
+    action = LogRecord(log->txn_id_, INVALID_LSN, log->update_rid_, LogRecord::InvertDelta(log->delta_));
+  } else if (log->log_record_type_ == LogRecordType::MARKDELETE) {
+    // mark_delete 反向执行 roll back delete
+    action = LogRecord(log->txn_id_, INVALID_LSN, LogRecordType::ROLLBACKDELETE, log->delete_rid_, log->delete_tuple_);
+  } else if (log->log_record_type_ == LogRecordType::APPLYDELETE) {
+    // apply delete 反向执行 insert
+    action = LogRecord(log->txn_id_, INVALID_LSN, LogRecordType::INSERT, log->delete_rid_, log->delete_tuple_);
+  } else if (log->log_record_type_ == LogRecordType::ROLLBACKDELETE) {
+    // rollback delete 反向执行 mark delete
+    action = LogRecord(log->txn_id_, INVALID_LSN, LogRecordType::MARKDELETE, log->delete_rid_, log->delete_tuple_);
+  } else {
+    assert(false);
+  }
+  auto page = reinterpret_cast<TablePage *>(FetchPage(GetActionRID(log).GetPageId()));  // 获取页
+  assert(page->GetLSN() >= log->lsn_);
+  if (log_manager_ != nullptr) {
+    // 先写补偿日志，页的 lsn 指向补偿日志
+    LogRecord clr(log->txn_id_, *last_lsn, log->prev_lsn_, action);
+    *last_lsn = log_manager_->AppendLogRecord(&clr);
+    page->SetLSN(*last_lsn);
+  }
+  ApplyAction(page, &action);
+  // 记得 unpin
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+}
+
+/*
+ * undo an index entry through the index itself, the pages it changes are logged by the index,
+ * then a CLR carrying the inverse entry is written, so a recovery crashed halfway doesn't undo the
+ * entry again (redoing the undo twice would be harmless, removing a missing key changes nothing)
+ */
+void LogRecovery::UndoIndexRecord(LogRecord *log, lsn_t *last_lsn) {
+  auto handler = index_undo_handlers_.find(log->index_name_);
+  if (handler == index_undo_handlers_.end()) {
+    LOG_WARN("index %s is not registered, entry of txn %d is not undone", log->index_name_.c_str(), log->txn_id_);
+    return;
+  }
+  bool is_insert = log->log_record_type_ == LogRecordType::INDEXINSERT;
+  handler->second(is_insert, log->index_key_.data(), log->index_value_.data());
+  if (log_manager_ != nullptr) {
+    LogRecord action(log->txn_id_, INVALID_LSN, is_insert ? LogRecordType::INDEXDELETE : LogRecordType::INDEXINSERT,
+                     log->index_name_, log->index_key_, log->index_value_);
+    LogRecord clr(log->txn_id_, *last_lsn, log->prev_lsn_, action);
+    *last_lsn = log_manager_->AppendLogRecord(&clr);
+  }
+}
+
+/*
+ * read the log record at offset, log_buffer_ is kept as a window over the log file, undo walks the log
+ * backwards, so the window ends a little past the requested record and most reads are served from memory
+ */
+void LogRecovery::ReadLogRecord(int offset, LogRecord *log) {
+  if (window_offset_ >= 0 && offset >= window_offset_ && offset < window_offset_ + LOG_BUFFER_SIZE &&
+      DeserializeLogRecord(log_buffer_ + (offset - window_offset_), log)) {
+    return;
+  }
+  // 一条日志最多包含两个 tuple
+  window_offset_ = std::max(0, offset + 2 * PAGE_SIZE - LOG_BUFFER_SIZE);
+  disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, window_offset_);
+  bool ok = DeserializeLogRecord(log_buffer_ + (offset - window_offset_), log);
+  if (!ok) {
+    // 索引页的日志可能包含多个页，窗口从这条日志开始
+    window_offset_ = offset;
+    disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, window_offset_);
+    ok = DeserializeLogRecord(log_buffer_, log);
+  }
+  assert(ok);
+  (void)ok;
+}
+
+/*
+ * standby: the pages already hold what the local log redid for the transactions it didn't finish, undo each
+ * of them on a private copy of the rows it wrote, newest record first, to find the versions it overwrote.
+ * Nothing reads the pages yet, so no page latch is needed to record them
+ */
+void LogRecovery::RecordActiveVersions() {
+  if (version_store_ == nullptr) {
+    return;
+  }
+  for (auto &txn : active_txn_) {
+    // rid => 事务写之前的版本，nullptr 表示行不存在
+    std::unordered_map<RID, std::unique_ptr<Tuple>> versions;
+    lsn_t undo_next_lsn = std::numeric_limits<lsn_t>::max();  // 补偿日志已经撤销了之后的记录
+    for (auto iter = txn.second.rbegin(); iter != txn.second.rend(); ++iter) {
+      if (iter->first > undo_next_lsn) {
         continue;
       }
-      // 插入、更新、删除
-      RID rid = log.log_record_type_ == LogRecordType::INSERT   ? log.insert_rid_
-                : log.log_record_type_ == LogRecordType::UPDATE ? log.update_rid_
-                                                                : log.delete_rid_;
-      auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));  // 获取页
-      assert(page != nullptr);
-      assert(page->GetLSN() >= log.lsn_);
+      LogRecord log;
+      ReadLogRecord(iter->second, &log);
+      if (log.log_record_type_ == LogRecordType::CLR) {
+        undo_next_lsn = log.undo_next_lsn_;
+        continue;
+      }
+      RID rid = GetActionRID(&log);
       if (log.log_record_type_ == LogRecordType::INSERT) {
-        // insert，反向执行 apply delete
-        page->ApplyDelete(log.insert_rid_, nullptr, nullptr);
+        versions[rid] = nullptr;
       } else if (log.log_record_type_ == LogRecordType::UPDATE) {
-        // update 交换 old,new 执行
-        Tuple tuple;
-        page->UpdateTuple(log.old_tuple_, &tuple, log.update_rid_, nullptr, nullptr, nullptr);
-        assert(tuple.GetLength() == log.new_tuple_.GetLength() &&
-               memcmp(tuple.GetData(), log.new_tuple_.GetData(), tuple.GetLength()) == 0);
+        versions[rid] = std::make_unique<Tuple>(log.old_tuple_);
       } else if (log.log_record_type_ == LogRecordType::MARKDELETE) {
-        // mark_delete 反向执行 roll back delete
-        page->RollbackDelete(log.delete_rid_, nullptr, nullptr);
-      } else if (log.log_record_type_ == LogRecordType::APPLYDELETE) {
-        // apply delete 反向执行 insert
-        page->InsertTuple(log.delete_tuple_, &log.delete_rid_, nullptr, nullptr, nullptr);
-      } else if (log.log_record_type_ == LogRecordType::ROLLBACKDELETE) {
-        // rollback delete 反向执行 mark delete
-        page->MarkDelete(log.delete_rid_, nullptr, nullptr, nullptr);
-      } else {
-        assert(false);
+        versions[rid] = std::make_unique<Tuple>(log.delete_tuple_);
+      } else if (log.log_record_type_ == LogRecordType::DELTAUPDATE) {
+        // 在更新之后的版本上反向打补丁
+        auto tuple = std::make_unique<Tuple>();
+        auto version = versions.find(rid);
+        if (version != versions.end() && version->second != nullptr) {
+          *tuple = *version->second;
+        } else {
+          auto *page = reinterpret_cast<TablePage *>(FetchPage(rid.GetPageId()));
+          page->GetTuple(rid, tuple.get(), nullptr, nullptr);
+          buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+        }
+        LogRecord::ApplyDelta(LogRecord::InvertDelta(log.delta_), tuple->GetData());
+        versions[rid] = std::move(tuple);
       }
-      // 记得 unpin
-      buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+    }
+    if (versions.empty()) {
+      continue;
+    }
+    auto &version_txn = version_txns_[txn.first];
+    version_txn = std::make_unique<Transaction>(txn.first);
+    for (auto &version : versions) {
+      version_store_->RecordWrite(version_txn.get(), version.first, version.second.get());
     }
   }
-  // 清空
-  active_txn_.clear();
-  lsn_mapping_.clear();
+}
+
+/*
+ * standby: keep the version of the row a record of an unfinished transaction is about to overwrite, called
+ * with the page latch held before the record is applied, readers see the page and its versions consistently
+ */
+void LogRecovery::RecordVersion(TablePage *page, LogRecord *log) {
+  LogRecordType type = log->log_record_type_;
+  if (version_store_ == nullptr || log->txn_id_ == INVALID_TXN_ID ||
+      (type != LogRecordType::INSERT && type != LogRecordType::UPDATE && type != LogRecordType::DELTAUPDATE &&
+       type != LogRecordType::MARKDELETE)) {
+    return;
+  }
+  auto &version_txn = version_txns_[log->txn_id_];
+  if (version_txn == nullptr) {
+    version_txn = std::make_unique<Transaction>(log->txn_id_);
+  }
+  RID rid = GetActionRID(log);
+  Tuple old_tuple;
+  bool exists = type != LogRecordType::INSERT && page->GetTuple(rid, &old_tuple, nullptr, nullptr);
+  version_store_->RecordWrite(version_txn.get(), rid, exists ? &old_tuple : nullptr);
+}
+
+/*
+ * standby: the transaction finished, its versions become visible to the snapshots taken from now on,
+ * or are dropped if it aborted, the pages were rolled back by the records before the ABORT
+ */
+void LogRecovery::EndVersions(txn_id_t txn_id, bool commit) {
+  auto iter = version_txns_.find(txn_id);
+  if (iter == version_txns_.end()) {
+    return;
+  }
+  if (commit) {
+    version_store_->Commit(iter->second.get());
+  } else {
+    version_store_->Abort(iter->second.get());
+  }
+  version_txns_.erase(iter);
 }
 
 }  // namespace bustub
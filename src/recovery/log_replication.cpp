@@ -0,0 +1,291 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_replication.cpp
+//
+// Identification: src/recovery/log_replication.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_replication.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+/*
+ * send / recv exactly size bytes
+ * @return: false if the connection is closed
+ */
+static bool SendAll(int fd, const void *data, size_t size) {
+  auto *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool RecvAll(int fd, void *data, size_t size) {
+  auto *p = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = recv(fd, p, size, 0);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static int64_t NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/*****************************************************************************
+ * PRIMARY
+ *****************************************************************************/
+int LogShipper::Start(int port) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    throw Exception("log shipper: can't create socket");
+  }
+  int on = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd_, 4) != 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    throw Exception("log shipper: can't listen on port " + std::to_string(port));
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len);
+  running_ = true;
+  accept_thread_ = new std::thread(&LogShipper::Accept, this);
+  LOG_INFO("log shipper listening on port %d", ntohs(addr.sin_port));
+  return ntohs(addr.sin_port);
+}
+
+void LogShipper::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // 唤醒阻塞在 accept 上的线程
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_->join();
+  delete accept_thread_;
+  accept_thread_ = nullptr;
+  close(listen_fd_);
+  listen_fd_ = -1;
+  std::lock_guard<std::mutex> guard(latch_);
+  for (auto &standby : standbys_) {
+    shutdown(standby->fd_, SHUT_RDWR);
+    standby->sender_.join();
+    standby->ack_receiver_.join();
+    close(standby->fd_);
+  }
+  standbys_.clear();
+}
+
+std::vector<LogShipper::StandbyStats> LogShipper::GetStats() {
+  int64_t log_size = disk_manager_->GetLogFileSize();
+  std::vector<StandbyStats> stats;
+  std::lock_guard<std::mutex> guard(latch_);
+  for (auto &standby : standbys_) {
+    if (!standby->connected_) {
+      continue;
+    }
+    stats.push_back({standby->shipped_offset_, standby->replayed_offset_, standby->replayed_lsn_,
+                     std::max<int64_t>(log_size - standby->replayed_offset_, 0)});
+  }
+  return stats;
+}
+
+void LogShipper::Accept() {
+  while (running_) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;  // Stop 关闭了监听
+    }
+    int64_t start_offset;
+    if (!RecvAll(fd, &start_offset, sizeof(start_offset))) {
+      close(fd);
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    LOG_INFO("standby connected, shipping log from offset %ld", start_offset);
+    auto standby = std::make_unique<Standby>();
+    standby->fd_ = fd;
+    standby->shipped_offset_ = start_offset;
+    standby->replayed_offset_ = start_offset;
+    std::lock_guard<std::mutex> guard(latch_);
+    standby->sender_ = std::thread(&LogShipper::Ship, this, standby.get());
+    standby->ack_receiver_ = std::thread(&LogShipper::ReceiveAcks, this, standby.get());
+    standbys_.push_back(std::move(standby));
+  }
+}
+
+/*
+ * stream the log file from the offset the standby asked for, the file is read through its own stream,
+ * the log manager keeps appending to it meanwhile. Only whole flushes are in the file, a record cut at
+ * the end of a read is completed by the next one on the standby.
+ */
+void LogShipper::Ship(Standby *standby) {
+  std::ifstream log_file(disk_manager_->GetLogFileName(), std::ios::binary | std::ios::in);
+  std::vector<char> buffer(LOG_BUFFER_SIZE);
+  int64_t offset = standby->shipped_offset_;
+  lsn_t persistent_lsn = log_manager_->GetPersistentLSN();
+  while (running_ && standby->connected_) {
+    ShipHeader header{offset, 0, log_manager_->GetPersistentLSN(), 0};
+    int64_t log_size = disk_manager_->GetLogFileSize();
+    if (offset < log_size) {
+      log_file.clear();
+      log_file.seekg(offset);
+      log_file.read(buffer.data(), std::min<int64_t>(log_size - offset, LOG_BUFFER_SIZE));
+      header.size_ = static_cast<int32_t>(log_file.gcount());
+    }
+    header.send_time_us_ = NowMicros();
+    if (!SendAll(standby->fd_, &header, sizeof(header)) || !SendAll(standby->fd_, buffer.data(), header.size_)) {
+      break;
+    }
+    offset += header.size_;
+    standby->shipped_offset_ = offset;
+    if (header.size_ == 0) {
+      // 已经发完，等下一次 flush，超时就再发一次心跳
+      persistent_lsn = log_manager_->WaitForPersistentLSN(persistent_lsn, HEARTBEAT_INTERVAL);
+    }
+  }
+  standby->connected_ = false;
+}
+
+void LogShipper::ReceiveAcks(Standby *standby) {
+  ShipAck ack;
+  while (RecvAll(standby->fd_, &ack, sizeof(ack))) {
+    standby->replayed_offset_ = ack.replayed_offset_;
+    standby->replayed_lsn_ = ack.replayed_lsn_;
+  }
+  LOG_INFO("standby disconnected at offset %ld", standby->replayed_offset_.load());
+  standby->connected_ = false;
+}
+
+/*****************************************************************************
+ * STANDBY
+ *****************************************************************************/
+void LogReceiver::Start(const std::string &host, int port) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+    throw Exception("log receiver: can't resolve " + host);
+  }
+  fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = fd_ >= 0 && connect(fd_, result->ai_addr, result->ai_addrlen) == 0;
+  freeaddrinfo(result);
+  if (!ok) {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+    throw Exception("log receiver: can't connect to " + host + ":" + std::to_string(port));
+  }
+  // 本地日志结尾可能有上次没收完的半条日志，从最后一条完整日志之后接着收
+  int64_t start_offset = log_recovery_->GetLogEndOffset();
+  if (disk_manager_->GetLogFileSize() > start_offset &&
+      truncate(disk_manager_->GetLogFileName().c_str(), start_offset) != 0) {
+    throw Exception("log receiver: can't truncate the local log");
+  }
+  received_offset_ = start_offset;
+  replayed_offset_ = start_offset;
+  if (!SendAll(fd_, &start_offset, sizeof(start_offset))) {
+    throw Exception("log receiver: primary closed the connection");
+  }
+  connected_ = true;
+  receive_thread_ = new std::thread(&LogReceiver::Receive, this);
+  LOG_INFO("standby connected to %s:%d, receiving log from offset %ld", host.c_str(), port, start_offset);
+}
+
+void LogReceiver::Stop() {
+  if (receive_thread_ == nullptr) {
+    return;
+  }
+  shutdown(fd_, SHUT_RDWR);
+  receive_thread_->join();
+  delete receive_thread_;
+  receive_thread_ = nullptr;
+  close(fd_);
+  fd_ = -1;
+}
+
+LogReceiver::Stats LogReceiver::GetStats() {
+  lsn_t replayed_lsn = log_recovery_->GetMaxLSN();
+  lsn_t primary_lsn = primary_lsn_;
+  return {connected_,   received_offset_, replayed_offset_, replayed_lsn, primary_lsn,
+          std::max<lsn_t>(primary_lsn - replayed_lsn, 0), replay_lag_ms_};
+}
+
+void LogReceiver::Receive() {
+  ShipHeader header;
+  while (RecvAll(fd_, &header, sizeof(header))) {
+    if (header.size_ > 0) {
+      char *buffer = buffers_[next_buffer_];
+      next_buffer_ ^= 1;
+      if (header.offset_ != received_offset_ || !RecvAll(fd_, buffer, header.size_)) {
+        LOG_WARN("standby: broken log stream at offset %ld", header.offset_);
+        break;
+      }
+      // 先写本地日志，本地日志与主库的日志文件完全相同，重做与之后的故障切换都用它
+      disk_manager_->WriteLog(buffer, header.size_);
+      received_offset_ += header.size_;
+      pending_.append(buffer, header.size_);
+      while (!pending_.empty()) {
+        int size = static_cast<int>(std::min<size_t>(pending_.size(), LOG_BUFFER_SIZE));
+        int replayed = log_recovery_->ReplayLog(replayed_offset_, pending_.data(), size);
+        if (replayed == 0) {
+          break;  // 剩下半条日志，等后面的数据
+        }
+        pending_.erase(0, replayed);
+        replayed_offset_ += replayed;
+      }
+      // 重做过的日志已经在本地日志文件中，刷脏页时不需要再刷日志
+      log_manager_->SetPersistentLSN(log_recovery_->GetMaxLSN());
+      replay_lag_ms_ = (NowMicros() - header.send_time_us_) / 1000;
+    } else if (replayed_offset_ == received_offset_) {
+      replay_lag_ms_ = 0;  // 心跳，已经追上主库
+    }
+    primary_lsn_ = header.persistent_lsn_;
+    ShipAck ack{replayed_offset_, log_recovery_->GetMaxLSN()};
+    if (!SendAll(fd_, &ack, sizeof(ack))) {
+      break;
+    }
+  }
+  connected_ = false;
+  LOG_INFO("standby disconnected from the primary at offset %ld", replayed_offset_.load());
+}
+
+}  // namespace bustub
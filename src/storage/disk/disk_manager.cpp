@@ -12,6 +12,7 @@
 
 #include <sys/stat.h>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -25,6 +26,13 @@ namespace bustub {
 
 static char *buffer_used;  // 用于 log 读写
 
+// 读写过的页都已经分配过，保证 next_page_id 在它之后
+static void AdvanceNextPageId(std::atomic<page_id_t> *next_page_id, page_id_t page_id) {
+  page_id_t next = next_page_id->load();
+  while (next <= page_id && !next_page_id->compare_exchange_weak(next, page_id + 1)) {
+  }
+}
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
@@ -36,7 +44,8 @@ DiskManager::DiskManager(const std::string &db_file)
     LOG_DEBUG("wrong file format");
     return;
   }
-  log_name_ = file_name_.substr(0, n) + ".log";  // test.log
+  log_name_ = file_name_.substr(0, n) + ".log";      // test.log
+  master_name_ = file_name_.substr(0, n) + ".ckpt";  // test.ckpt
   // 打开 log 文件
   log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
   // directory or file does not exist
@@ -65,6 +74,8 @@ DiskManager::DiskManager(const std::string &db_file)
       throw Exception("can't open db file");
     }
   }
+  // 重新打开已有的 db 文件时，从文件末尾继续分配页，否则重启后会覆盖已有的页
+  next_page_id_ = GetFileSize(file_name_) / PAGE_SIZE;
   buffer_used = nullptr;  // buffer 为 null
 }
 
@@ -81,6 +92,7 @@ void DiskManager::ShutDown() {
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
   size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;  // 通过 PAGE_SIZE 和 page_id 计算得到页的偏移量
+  AdvanceNextPageId(&next_page_id_, page_id);
   // set write cursor to offset
   num_writes_ += 1;      // +1
   db_io_.seekp(offset);  // seek
@@ -99,6 +111,7 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   int offset = page_id * PAGE_SIZE;  // 计算得到 offset
+  AdvanceNextPageId(&next_page_id_, page_id);
   // check if read beyond file length
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
@@ -185,6 +198,26 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
   return true;
 }
 
+/**
+ * Write the master record to a temporary file and rename it, a crash never leaves half of it
+ */
+void DiskManager::WriteMasterRecord(int log_offset, lsn_t lsn) {
+  std::string tmp_name = master_name_ + ".tmp";
+  std::ofstream master(tmp_name, std::ios::binary | std::ios::trunc | std::ios::out);
+  master.write(reinterpret_cast<const char *>(&log_offset), sizeof(int));
+  master.write(reinterpret_cast<const char *>(&lsn), sizeof(lsn_t));
+  master.close();
+  if (master.fail() || rename(tmp_name.c_str(), master_name_.c_str()) != 0) {
+    LOG_WARN("can't write the master record %s", master_name_.c_str());
+  }
+}
+
+bool DiskManager::ReadMasterRecord(int *log_offset, lsn_t *lsn) {
+  std::ifstream master(master_name_, std::ios::binary | std::ios::in);
+  return master.read(reinterpret_cast<char *>(log_offset), sizeof(int)) &&
+         master.read(reinterpret_cast<char *>(lsn), sizeof(lsn_t));
+}
+
 /**
  * Allocate new page (operations like create index/table)
  * For now just keep an increasing counter
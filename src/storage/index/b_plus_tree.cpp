@@ -9,7 +9,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <functional>
 #include <string>
+#include <thread>  // NOLINT
+#include <tuple>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -20,13 +24,47 @@
 namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, LogManager *log_manager)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      internal_max_size_(internal_max_size),
+      log_manager_(log_manager) {}
+
+/*
+ * Read the root page id of this tree from the header page
+ * @return: false if the header page has no record for this tree
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LoadRootPageId() {
+  std::lock_guard<std::mutex> guard(root_page_id_mutex_);
+  Page *page = buffer_pool_manager_->FetchPage(HEADER_PAGE_ID);
+  HeaderPage *header_page = static_cast<HeaderPage *>(page);
+  bool found = header_page->GetRootId(index_name_, &root_page_id_);
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false);
+  return found;
+}
+
+/*
+ * Undo an entry inserted or removed by a loser transaction, the key and value are the raw bytes
+ * from the log. The pages are changed through a transaction with INVALID_TXN_ID, its modifications
+ * are logged for redo even though logging is not turned on during recovery
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UndoEntry(bool is_insert, const char *key, const char *value) {
+  KeyType index_key;
+  ValueType index_value;
+  memcpy(&index_key, key, sizeof(KeyType));
+  memcpy(&index_value, value, sizeof(ValueType));
+  Transaction transaction(INVALID_TXN_ID);
+  if (is_insert) {
+    Remove(index_key, &transaction);
+  } else {
+    Insert(index_key, index_value, &transaction);
+  }
+}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -92,7 +130,7 @@ bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
   // 加锁，避免多个线程同时 StartNewTree
   root_page_id_mutex_.lock();
   if (IsEmpty()) {
-    StartNewTree(key, value);
+    StartNewTree(key, value, transaction);
     root_page_id_mutex_.unlock();
     return true;
   }
@@ -107,17 +145,20 @@ bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
  * tree's root page id and insert entry directly into leaf page.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
+void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value, Transaction *transaction) {
   // 开始一个新 B+树
   // LOG_DEBUG("StartNewTree key: %lld.", key.ToString());
   Page *root_page = buffer_pool_manager_->NewPage(&root_page_id_);  // 新建 page
-  UpdateRootPageId(1);  // 第一个更新 root_page_id，所以设置为 true
+  UpdateRootPageId(1, transaction);  // 第一个更新 root_page_id，所以设置为 true
   // 根节点也是叶子节点
   LeafPage *root_node = reinterpret_cast<LeafPage *>(root_page->GetData());
   // 初始化根节点
   root_node->Init(root_page_id_, INVALID_PAGE_ID, leaf_max_size_);
   // 向根节点中插入数据
   root_node->Insert(key, value, comparator_);
+  LogEntry(LogRecordType::INDEXINSERT, key, value, transaction);
+  LogPage(root_node, transaction);
+  LogPages(transaction);
   // Unpin，设置为 dirty
   buffer_pool_manager_->UnpinPage(root_page_id_, true);
 }
@@ -133,8 +174,25 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction) {
   // 寻找 key 所在的叶子节点
-  auto [leaf_page, is_root_page_id_locked] =
-      FindLeafPageByOperation(key, false, false, OperationType::INSERT, transaction);
+  Page *leaf_page = nullptr;
+  bool is_root_page_id_locked = false;
+  if (optimistic_descent_) {
+    leaf_page = FindLeafPageOptimistic(key, false, false, OperationType::INSERT, true);
+  } else {
+    std::tie(leaf_page, is_root_page_id_locked) =
+        FindLeafPageByOperation(key, false, false, OperationType::INSERT, transaction);
+  }
+  // 叶子节点可能分裂（或者加写锁下降遇到了还没插入父节点的分裂）：按 B-link 树的方式插入，分裂逐层向上，
+  // 持有 structure_latch_ 的读锁直到新节点插入父节点，期间不会有合并
+  bool structure_latched = leaf_page == nullptr;
+  if (structure_latched) {
+    structure_latch_.RLock();
+    leaf_page = FindLeafPageOptimistic(key, false, false, OperationType::INSERT, false);
+    if (leaf_page == nullptr) {  // 树被删空了，从头开始
+      structure_latch_.RUnlock();
+      return Insert(key, value, transaction);
+    }
+  }
   // 得到叶子结点
   LeafPage *leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
 
@@ -150,22 +208,38 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
     ClearTransactionPageSetAndUnpin(transaction);
     leaf_page->WUnlatch();  // 叶子结点解锁
     buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), true);
+    if (structure_latched) {
+      structure_latch_.RUnlock();
+    }
     return false;
   }
 
+  LogEntry(LogRecordType::INDEXINSERT, key, value, transaction);
+  LogPage(leaf_node, transaction, false, leaf_node->KeyIndex(key, comparator_));
+
   // 无需 split，所以节点是安全的
   if (sz < leaf_max_size_) {
+    LogPages(transaction);
     if (is_root_page_id_locked) {
       root_page_id_mutex_.unlock();
     }
     ClearTransactionPageSetAndUnpin(transaction);
     leaf_page->WUnlatch();
     buffer_pool_manager_->UnpinPage(leaf_node->GetPageId(), true);  // leaf_node 数据发生了更改
+    if (structure_latched) {
+      structure_latch_.RUnlock();
+    }
     return true;
   }
   // 需要分裂，由于 new_node 是新建的节点，所以无需加锁
   // you should correctly perform split if insertion triggers current number of key/value pairs after insertion equals
-  LeafPage *new_node = Split<LeafPage>(leaf_node);  // 将 page 分裂，new_page 是右边，page 是左边
+  LeafPage *new_node = Split<LeafPage>(leaf_node, transaction);  // 将 page 分裂，new_page 是右边，page 是左边
+  if (structure_latched) {
+    // 释放叶子节点之后再插入父节点
+    InsertIntoParentOptimistic(leaf_page, new_node->KeyAt(0), new_node, transaction);
+    structure_latch_.RUnlock();
+    return true;
+  }
   // 分裂后，leaf_node 是左孩子，new_node 是右孩子，右孩子的第一个 key 拷贝至父节点作为 key
   // InsertIntoParent 中只能对新 fetch 的 page 做 Unpin
   // 注意：此处暂时无法解锁 root_page_id，在 InsertIntoParent 中插入完毕后再解锁
@@ -187,7 +261,7 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
-N *BPLUSTREE_TYPE::Split(N *node) {
+N *BPLUSTREE_TYPE::Split(N *node, Transaction *transaction) {
   // 新建一个页，node 在上层 Unpin
   page_id_t page_id;
   auto *page = buffer_pool_manager_->NewPage(&page_id);
@@ -207,15 +281,25 @@ N *BPLUSTREE_TYPE::Split(N *node) {
     // 判断 leaf 节点有无 next_page_id，如果有，那么将其转交给 new_leaf
     if (leaf->GetNextPageId() != INVALID_PAGE_ID) {
       new_leaf->SetNextPageId(leaf->GetNextPageId());
+      new_leaf->SetHighKey(leaf->GetHighKey());
     }
+    // 右链先于父节点指向 new_leaf，不小于 high key 的 key 都去右边找
     leaf->SetNextPageId(page_id);
+    leaf->SetHighKey(new_leaf->KeyAt(0));
   } else {
     // 分离内部节点
     InternalPage *internal = reinterpret_cast<InternalPage *>(node);
     InternalPage *new_internal = reinterpret_cast<InternalPage *>(new_node);
     new_internal->Init(page_id, node->GetParentPageId(), internal_max_size_);
     internal->MoveHalfTo(new_internal, buffer_pool_manager_);
+    // 内部节点同样有右链，new_internal 的第一个 key 是要插入父节点的分隔 key
+    new_internal->SetNextPageId(internal->GetNextPageId());
+    new_internal->SetHighKey(internal->GetHighKey());
+    internal->SetNextPageId(page_id);
+    internal->SetHighKey(new_internal->KeyAt(0));
   }
+  LogPage(node, transaction);
+  LogPage(new_node, transaction, !node->IsLeafPage());
 
   return new_node;
 }
@@ -248,10 +332,14 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
     // 更新 new_node 和 old_node 的父节点
     old_node->SetParentPageId(new_page->GetPageId());
     new_node->SetParentPageId(new_page->GetPageId());
-    // Unpin，new_page 不再使用
-    buffer_pool_manager_->UnpinPage(new_page->GetPageId(), true);
+    LogPage(new_root_node, transaction);
+    LogPage(old_node, transaction);
+    LogPage(new_node, transaction);
 
-    UpdateRootPageId(0);  // root_page_id_ 发生了变化
+    UpdateRootPageId(0, transaction);  // root_page_id_ 发生了变化
+    LogPages(transaction);
+    // Unpin，new_page 不再使用，要在写日志之后，否则可能先于日志被刷盘
+    buffer_pool_manager_->UnpinPage(new_page->GetPageId(), true);
     if (is_root_page_id_locked) {
       root_page_id_mutex_.unlock();  // 现在才能解锁 root_page_id
     }
@@ -269,7 +357,10 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
   new_node->SetParentPageId(parent_id);  // new_node 设置父节点
   // 将 new_node 的 page_id 插入父节点，一定要插在 old_node 位置的后面
   int sz = parent_node->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
+  LogPage(parent_node, transaction);
+  LogPage(new_node, transaction);
   if (sz < internal_max_size_) {
+    LogPages(transaction);
     if (is_root_page_id_locked) {
       root_page_id_mutex_.unlock();  // 现在才能解锁 root_page_id
     }
@@ -280,7 +371,7 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
   }
   // 分裂 parent 节点，因为刚刚插入了 new_old，可能要发生分裂
   // LOG_DEBUG("内部节点分裂: max_size: %d, size: %d", parent_node->GetMaxSize(), parent_node->GetSize());
-  InternalPage *parent_sibling = Split<InternalPage>(parent_node);  // 分裂
+  InternalPage *parent_sibling = Split<InternalPage>(parent_node, transaction);  // 分裂
   // InsertIntoParent 函数递归时，只负责 Unpin 自己当前函数栈 fetch 的页，穿进去的页一律不准 Unpin
   InsertIntoParent(parent_node, parent_sibling->KeyAt(0), parent_sibling, transaction, is_root_page_id_locked);
   if (is_root_page_id_locked) {
@@ -291,6 +382,110 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
   buffer_pool_manager_->UnpinPage(parent_sibling->GetPageId(), true);
 }
 
+/*
+ * Insert new_node into the parent of old_node the B-link (Sagiv) way, with structure_latch_ read latched so no
+ * page is merged meanwhile. old_page, write latched by the caller, is the only page latched at a time: new_node is
+ * already reachable through the right link of old_node, so the split is logged and old_page released before the
+ * parent is latched. The parent is the one recorded in old_node, or a page to its right if it split in between;
+ * new_node goes in by its key, old_node itself may still be waiting for its own split to reach the parent.
+ * Splits of the parent go up the same way. Releases old_page and unpins new_node.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::InsertIntoParentOptimistic(Page *old_page, const KeyType &key, BPlusTreePage *new_node,
+                                                Transaction *transaction) {
+  auto *old_node = reinterpret_cast<BPlusTreePage *>(old_page->GetData());
+  KeyType separator = key;
+  while (true) {
+    // 从根节点分裂出来的节点也没有父节点，要等新的根节点建好，只有 root_page_id_ 才是根节点
+    for (bool retry = false; old_node->IsRootPage(); retry = true) {
+      // root_page_id_mutex_ 要先于页锁拿，先释放 old_page，其间它可能又被别人分裂
+      LogPages(transaction);
+      old_page->WUnlatch();
+      if (retry) {
+        std::this_thread::yield();
+      }
+      std::lock_guard<std::mutex> guard(root_page_id_mutex_);
+      old_page->WLatch();
+      if (old_node->GetPageId() != root_page_id_) {
+        continue;
+      }
+      page_id_t root_page_id;
+      Page *root_page = buffer_pool_manager_->NewPage(&root_page_id);
+      if (root_page == nullptr) {
+        throw Exception(ExceptionType::OUT_OF_MEMORY, "can't allocate new page.");
+      }
+      InternalPage *root_node = reinterpret_cast<InternalPage *>(root_page->GetData());
+      root_node->Init(root_page_id, INVALID_PAGE_ID, internal_max_size_);
+      root_node->PopulateNewRoot(old_node->GetPageId(), separator, new_node->GetPageId());
+      old_node->SetParentPageId(root_page_id);
+      // new_node 在 old_node 右边，按从左到右的顺序加锁
+      SetParentLatched(new_node, root_page_id);
+      root_page_id_ = root_page_id;
+      // 两个孩子都改了父节点，new_node 可能已经被别人锁住修改，只记它的父节点
+      LogPage(root_node, transaction, true);
+      LogPage(old_node, transaction);
+      UpdateRootPageId(0, transaction);
+      LogPages(transaction);
+      buffer_pool_manager_->UnpinPage(root_page_id, true);
+      old_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(old_page->GetPageId(), true);
+      buffer_pool_manager_->UnpinPage(new_node->GetPageId(), true);
+      return;
+    }
+    // 写完日志才能释放 old_page
+    page_id_t parent_page_id = old_node->GetParentPageId();
+    LogPages(transaction);
+    old_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(old_page->GetPageId(), true);
+
+    Page *parent_page = buffer_pool_manager_->FetchPage(parent_page_id);
+    parent_page->WLatch();
+    InternalPage *parent_node = reinterpret_cast<InternalPage *>(parent_page->GetData());
+    // 父节点分裂了，separator 已经不归它管，沿右链向右找
+    while (GetRightLink(parent_node, separator, false) != INVALID_PAGE_ID) {
+      Page *next_page = buffer_pool_manager_->FetchPage(parent_node->GetNextPageId());
+      next_page->WLatch();
+      parent_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
+      parent_page = next_page;
+      parent_node = reinterpret_cast<InternalPage *>(parent_page->GetData());
+    }
+    int sz = parent_node->InsertNode(separator, new_node->GetPageId(), comparator_);
+    // 分裂时记下的父节点已经过时了
+    bool parent_changed = new_node->GetParentPageId() != parent_node->GetPageId();
+    if (parent_changed) {
+      // 从上往下加锁，new_node 的写者插入父节点之前已经释放了它
+      SetParentLatched(new_node, parent_node->GetPageId());
+    }
+    LogPage(parent_node, transaction, parent_changed);
+    buffer_pool_manager_->UnpinPage(new_node->GetPageId(), true);
+    if (sz < internal_max_size_) {
+      LogPages(transaction);
+      parent_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), true);
+      return;
+    }
+    // 父节点也要分裂，继续向上
+    InternalPage *parent_sibling = Split<InternalPage>(parent_node, transaction);
+    old_page = parent_page;
+    old_node = parent_node;
+    new_node = parent_sibling;
+    separator = parent_sibling->KeyAt(0);
+  }
+}
+
+/*
+ * Set the parent of a node that other threads can already reach through a right link, under its write latch.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetParentLatched(BPlusTreePage *node, page_id_t parent_page_id) {
+  Page *page = buffer_pool_manager_->FetchPage(node->GetPageId());
+  page->WLatch();
+  node->SetParentPageId(parent_page_id);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(node->GetPageId(), true);
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -316,10 +511,37 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   // 2. 找到含有 key 的叶子节点，然后删除该项，注意一定要注意 redistribute 和 merge
   // merge：当前叶子节点删除 entry 后，所剩的 entry 个数与兄弟节点 entry 个数加起来 < MaxSize，则二者合并
   // redistribute：当前叶子节点删除 entry 后，所剩 entry 个数与兄弟节点 entry 个数加起来 >= MaxSize，则进行重组
-  auto [page, is_root_page_id_locked] = FindLeafPageByOperation(key, false, false, OperationType::DELETE, transaction);
-  assert(page != nullptr);
+  // 叶子节点删除后不会合并时不用加写锁下降，否则持有 structure_latch_ 的写锁，等进行中的分裂都插入父节点
+  Page *page = nullptr;
+  bool is_root_page_id_locked = false;
+  bool structure_latched = false;
+  if (optimistic_descent_) {
+    page = FindLeafPageOptimistic(key, false, false, OperationType::DELETE, true);
+    if (page == nullptr) {
+      structure_latch_.WLock();
+      structure_latched = true;
+    }
+  }
+  if (page == nullptr) {
+    std::tie(page, is_root_page_id_locked) =
+        FindLeafPageByOperation(key, false, false, OperationType::DELETE, transaction);
+  }
+  // 遇到了崩溃留下的、还没插入父节点的分裂，父节点不能修改，只删除不合并
+  bool can_rebalance = page != nullptr;
+  if (!can_rebalance) {
+    page = FindLeafPageOptimistic(key, false, false, OperationType::DELETE, false);
+    if (page == nullptr) {  // 树被删空了
+      if (structure_latched) {
+        structure_latch_.WUnlock();
+      }
+      return;
+    }
+  }
   LeafPage *leaf_node = reinterpret_cast<LeafPage *>(page->GetData());
   int old_sz = leaf_node->GetSize();
+  // 撤销删除需要原来的 value
+  ValueType value;
+  leaf_node->Lookup(key, &value, comparator_);
   // 删除 entry
   // 得到删除后的叶子节点 entry 个数
   int sz = leaf_node->RemoveAndDeleteRecord(key, comparator_);
@@ -330,14 +552,24 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
     ClearTransactionPageSetAndUnpin(transaction);
     page->WUnlatch();
     buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    if (structure_latched) {
+      structure_latch_.WUnlock();
+    }
     // LOG_DEBUG("txid: %d, thread_id: %zu, key: %lld delete failed", transaction->GetTransactionId(),
     //           std::hash<std::thread::id>{}(transaction->GetThreadId()), key.ToString());
     return;
   }
+  LogEntry(LogRecordType::INDEXDELETE, key, value, transaction);
+  LogPage(leaf_node, transaction, false, leaf_node->KeyIndex(key, comparator_));
 
   // 需要合并或者重组，注意：里面无需对 leaf_node Unpin
   // coalesce 或者 redistribute
-  bool should_delete = CoalesceOrRedistribute(leaf_node, transaction, is_root_page_id_locked);
+  bool should_delete = false;
+  if (can_rebalance) {
+    should_delete = CoalesceOrRedistribute(leaf_node, transaction, is_root_page_id_locked);
+  } else {
+    ClearTransactionPageSetAndUnpin(transaction);
+  }
   if (should_delete) {
     // LOG_DEBUG("page : %d AddIntoDeletedPageSet. ", leaf_node->GetPageId());
     transaction->AddIntoDeletedPageSet(leaf_node->GetPageId());
@@ -350,6 +582,9 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   std::for_each(transaction->GetDeletedPageSet()->begin(), transaction->GetDeletedPageSet()->end(),
                 [&bpm = buffer_pool_manager_](const page_id_t page_id) { bpm->DeletePage(page_id); });
   transaction->GetDeletedPageSet()->clear();
+  if (structure_latched) {
+    structure_latch_.WUnlock();
+  }
 }
 
 /*
@@ -366,7 +601,7 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction, b
   // 为什么 is_root_page_id_locked 需要一直向下传？
   // 因为 CoalesceOrRedistribute 是递归调用的，不知道是否需要在 AdjustRoot 中调整根节点，所以就一直向下
   if (node->IsRootPage()) {
-    bool root_should_delete = AdjustRoot(node, is_root_page_id_locked);
+    bool root_should_delete = AdjustRoot(node, transaction, is_root_page_id_locked);
     ClearTransactionPageSetAndUnpin(transaction);  // 清除 page set，全部解锁
     return root_should_delete;
   }
@@ -388,6 +623,15 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction, b
   // Let K′ be the value between pointers N and N′ in parent(N)
   // K 应该是右边孩子节点的第一个元素
   int idx = parent->ValueIndex(node->GetPageId());
+  // node 是崩溃留下的、还没插入父节点的分裂节点，不合并也不重组
+  if (idx == parent->GetSize()) {
+    buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
+    ClearTransactionPageSetAndUnpin(transaction);
+    if (is_root_page_id_locked) {
+      root_page_id_mutex_.unlock();
+    }
+    return false;
+  }
   Page *sibling_page;
   if (idx == 0) {
     // 如果 node 在 0 号，sliding 在右边
@@ -400,11 +644,23 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction, b
   }
   sibling_page->WLatch();  // 兄弟节点也需要加锁
   N *sibling_node = reinterpret_cast<N *>(sibling_page->GetData());
+  // 两者之间还有分裂出来、不在父节点中的节点，同样不合并也不重组
+  page_id_t left_next_page_id = idx == 0 ? node->GetNextPageId() : sibling_node->GetNextPageId();
+  if (left_next_page_id != (idx == 0 ? sibling_node->GetPageId() : node->GetPageId())) {
+    sibling_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(sibling_page->GetPageId(), false);
+    buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
+    ClearTransactionPageSetAndUnpin(transaction);
+    if (is_root_page_id_locked) {
+      root_page_id_mutex_.unlock();
+    }
+    return false;
+  }
   // If sibling's size + input* page's size > page's max size, then redistribute. Otherwise, merge.
   // 如果 leaf 和 sibling entry 个数 >= MaxSize，Coalesce
   if (node->GetSize() + sibling_node->GetSize() > node->GetMaxSize()) {
     // Redistribute，就不会有删除发生
-    Redistribute(sibling_node, node, parent, idx, is_root_page_id_locked);
+    Redistribute(sibling_node, node, parent, idx, transaction, is_root_page_id_locked);
     ClearTransactionPageSetAndUnpin(transaction);
     sibling_page->WUnlatch();
     // 重组完毕后，需要更新 parent
@@ -473,6 +729,11 @@ bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
   }
   // 从 parent 中删除 right_key
   (*parent)->Remove(right_index);
+  LogPage(*neighbor_node, transaction, !(*node)->IsLeafPage());
+  LogPage(*node, transaction);
+  LogPage(*parent, transaction);
+  // 右边节点被合并掉了，沿着旧的指针找到它的人要从根节点重新开始
+  (*node)->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
   // this->Print(buffer_pool_manager_);
   // true means parent node should be deleted, false means no deletion
   return CoalesceOrRedistribute(*parent, transaction, is_root_page_id_locked);
@@ -491,7 +752,7 @@ INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node,
                                   BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent, int index,
-                                  bool is_root_page_id_locked) {
+                                  Transaction *transaction, bool is_root_page_id_locked) {
   // 重组
   if (is_root_page_id_locked) {
     root_page_id_mutex_.unlock();  // 重组不可能删除根节点，也不会改变根节点的id，因此直接解锁
@@ -525,6 +786,15 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node,
       parent->SetKeyAt(index, internal_node->KeyAt(0));
     }
   }
+  // 分隔 key 变了，左边节点的 high key 随之改变
+  if (index == 0) {
+    node->SetHighKey(parent->KeyAt(1));
+  } else {
+    neighbor_node->SetHighKey(parent->KeyAt(index));
+  }
+  LogPage(node, transaction, !node->IsLeafPage());
+  LogPage(neighbor_node, transaction);
+  LogPage(parent, transaction);
 }
 /*
  * Update root page if necessary
@@ -537,7 +807,7 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node,
  * happend
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node, bool is_root_page_id_locked) {
+bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node, Transaction *transaction, bool is_root_page_id_locked) {
   // if (N is the root and N has only one remaining child)
   // then make the child of N the new root of the tree and delete N
   // case 1: when you delete the last element in root page, but root page still has one last child
@@ -550,7 +820,12 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node, bool is_root_page_
     BPlusTreePage *new_root_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
     new_root_node->SetParentPageId(INVALID_PAGE_ID);
     root_page_id_ = new_root_node->GetPageId();
-    UpdateRootPageId(0);
+    // 旧的根节点可能还被 pin 住，删除失败，标记它被删除了
+    old_root_node->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
+    LogPage(old_root_node, transaction);
+    LogPage(new_root_node, transaction);
+    UpdateRootPageId(0, transaction);
+    LogPages(transaction);
     if (is_root_page_id_locked) {
       root_page_id_mutex_.unlock();
     }
@@ -563,15 +838,194 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node, bool is_root_page_
   // 只剩下根节点了，且已经没有子节点了
   // true means root page should be deleted, false means no deletion happend
   bool should_delete = old_root_node->IsLeafPage() && old_root_node->GetSize() == 0;
-  if (should_delete) {  // 删除根节点
+  if (should_delete) {  // 删除根节点，header page 也要更新，否则重新打开时会找到已删除的根节点
+    old_root_node->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
     root_page_id_ = INVALID_PAGE_ID;
+    UpdateRootPageId(0, transaction);
   }
+  LogPages(transaction);
   if (is_root_page_id_locked) {
     root_page_id_mutex_.unlock();
   }
   return should_delete;
 }
 
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+/*
+ * Build the tree bottom up instead of descending once per entry: the sorted entries fill the leaves left to
+ * right, and every page gets its parent from the level above when it is created. The entries of a level are
+ * spread evenly over its pages, so the last page is not left nearly empty. Nothing is latched, the pages are
+ * unreachable until the root is installed; with logging they are flushed before, so the header page never
+ * points at a tree that is not on disk.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoad(std::vector<std::pair<KeyType, ValueType>> *entries, double fill_factor,
+                              Transaction *transaction) {
+  SortEntries(entries);
+  // 排序是稳定的，重复的 key 保留第一个，与逐个插入一致
+  entries->erase(std::unique(entries->begin(), entries->end(),
+                             [this](const auto &a, const auto &b) { return comparator_(a.first, b.first) == 0; }),
+                 entries->end());
+  root_page_id_mutex_.lock();
+  bool empty = IsEmpty();
+  root_page_id_mutex_.unlock();
+  if (!empty) {
+    for (const auto &[key, value] : *entries) {
+      Insert(key, value, transaction);
+    }
+    return;
+  }
+  if (entries->empty()) {
+    return;
+  }
+
+  // 节点在 size 达到 max size 时分裂，装满是 max size - 1
+  auto fill = [fill_factor](int max_size, int min_fill) {
+    return static_cast<size_t>(std::max(min_fill, std::min(static_cast<int>(max_size * fill_factor), max_size - 1)));
+  };
+  size_t leaf_fill = fill(leaf_max_size_, 1);
+  size_t internal_fill = fill(internal_max_size_, 2);
+  // 自底向上算出每层的节点数，最上层只有根节点
+  std::vector<BulkLevel> levels(1);
+  levels[0].items_ = entries->size();
+  levels[0].pages_ = (levels[0].items_ + leaf_fill - 1) / leaf_fill;
+  while (levels.back().pages_ > 1) {
+    BulkLevel level;
+    level.items_ = levels.back().pages_;
+    level.pages_ = (level.items_ + internal_fill - 1) / internal_fill;
+    levels.push_back(level);
+  }
+
+  std::vector<page_id_t> page_ids;
+  size_t pos = 0;
+  for (size_t i = 0; i < levels[0].pages_; i++) {
+    size_t size = levels[0].PageSize(i);
+    Page *page = BulkNewPage(&levels, 0, (*entries)[pos].first, &page_ids);
+    reinterpret_cast<LeafPage *>(page->GetData())->AppendSorted(entries->data() + pos, static_cast<int>(size));
+    pos += size;
+  }
+  // 每层最后一个节点没有右兄弟，high key 不用设置
+  page_id_t root_page_id = levels.back().page_->GetPageId();
+  for (auto &level : levels) {
+    BUSTUB_ASSERT(level.page_index_ == level.pages_, "Bulk load built a wrong number of pages");
+    buffer_pool_manager_->UnpinPage(level.page_->GetPageId(), true);
+  }
+  if (IsLogging(transaction)) {
+    // 新的页不记日志，先落盘，再让 header page 指向它们
+    for (page_id_t page_id : page_ids) {
+      buffer_pool_manager_->FlushPage(page_id);
+    }
+  }
+  std::lock_guard<std::mutex> guard(root_page_id_mutex_);
+  BUSTUB_ASSERT(root_page_id_ == INVALID_PAGE_ID, "B+ tree modified during bulk load");
+  root_page_id_ = root_page_id;
+  UpdateRootPageId(1, transaction);
+  LogPages(transaction);
+}
+
+/*
+ * Stable sort of the entries by key: chunks are sorted in parallel, then merged pairwise, each round of merges
+ * in parallel too.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SortEntries(std::vector<std::pair<KeyType, ValueType>> *entries) {
+  // 太小的块不值得开线程
+  const size_t min_chunk_size = 1 << 16;
+  auto less = [this](const auto &a, const auto &b) { return comparator_(a.first, b.first) < 0; };
+  auto parallel = [](size_t num_tasks, const std::function<void(size_t)> &task) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_tasks; i++) {
+      threads.emplace_back(task, i);
+    }
+    task(0);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  };
+  size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(std::thread::hardware_concurrency(), entries->size() / min_chunk_size));
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i <= num_chunks; i++) {
+    bounds.push_back(entries->size() * i / num_chunks);
+  }
+  auto begin = entries->begin();
+  parallel(num_chunks, [&](size_t i) { std::stable_sort(begin + bounds[i], begin + bounds[i + 1], less); });
+  for (size_t width = 1; width < num_chunks; width *= 2) {
+    parallel((num_chunks + 2 * width - 1) / (2 * width), [&](size_t i) {
+      size_t first = 2 * width * i;
+      size_t middle = std::min(first + width, num_chunks);
+      size_t last = std::min(first + 2 * width, num_chunks);
+      std::inplace_merge(begin + bounds[first], begin + bounds[middle], begin + bounds[last], less);
+    });
+  }
+}
+
+/*
+ * Open a new page on level, closing the one being filled, and append it to its parent on the level above,
+ * first_key is the first key below it. The page stays pinned until it is closed.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::BulkNewPage(std::vector<BulkLevel> *levels, size_t level, const KeyType &first_key,
+                                  std::vector<page_id_t> *page_ids) {
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(&page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "can't allocate new page.");
+  }
+  page_ids->push_back(page_id);
+  page_id_t parent_page_id = level + 1 == levels->size()
+                                 ? INVALID_PAGE_ID
+                                 : BulkAppendChild(levels, level + 1, first_key, page_id, page_ids);
+  if (level == 0) {
+    reinterpret_cast<LeafPage *>(page->GetData())->Init(page_id, parent_page_id, leaf_max_size_);
+  } else {
+    reinterpret_cast<InternalPage *>(page->GetData())->Init(page_id, parent_page_id, internal_max_size_);
+  }
+  auto &bulk_level = (*levels)[level];
+  if (bulk_level.page_ != nullptr) {
+    BulkClosePage(bulk_level.page_, page_id, first_key);
+  }
+  bulk_level.page_ = page;
+  bulk_level.page_index_++;
+  return page;
+}
+
+/*
+ * Append child to the page being filled on level, opening a new page when it holds its share.
+ * @return the page id of the parent of child
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::BulkAppendChild(std::vector<BulkLevel> *levels, size_t level, const KeyType &key,
+                                          page_id_t child, std::vector<page_id_t> *page_ids) {
+  auto &bulk_level = (*levels)[level];
+  if (bulk_level.page_ == nullptr ||
+      static_cast<size_t>(reinterpret_cast<InternalPage *>(bulk_level.page_->GetData())->GetSize()) ==
+          bulk_level.PageSize(bulk_level.page_index_ - 1)) {
+    BulkNewPage(levels, level, key, page_ids);
+  }
+  auto *node = reinterpret_cast<InternalPage *>(bulk_level.page_->GetData());
+  node->AppendChild(key, child);
+  return node->GetPageId();
+}
+
+/*
+ * Link a full page to its right sibling and unpin it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkClosePage(Page *page, page_id_t next_page_id, const KeyType &high_key) {
+  auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    reinterpret_cast<LeafPage *>(node)->SetNextPageId(next_page_id);
+    reinterpret_cast<LeafPage *>(node)->SetHighKey(high_key);
+  } else {
+    reinterpret_cast<InternalPage *>(node)->SetNextPageId(next_page_id);
+    reinterpret_cast<InternalPage *>(node)->SetHighKey(high_key);
+  }
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+}
+
 /*****************************************************************************
  * INDEX ITERATOR
  *****************************************************************************/
@@ -629,24 +1083,31 @@ Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
   return FindLeafPageByOperation(key, leftMost, false, OperationType::SEARCH).first;
 }
 
+/*
+ * Find the leaf page of key for op_type. SEARCH goes down the B-link way (FindLeafPageOptimistic), INSERT and
+ * DELETE crab down with write latches, keeping the unsafe ancestors in the page set of the transaction and
+ * root_page_id_mutex_ locked while the root may change.
+ * @return the latched leaf page and whether root_page_id_mutex_ is still locked; nullptr if the tree is empty, or
+ * if a child split whose new page is not in its parent yet (left behind by a crash) was met on the way down
+ */
 INDEX_TEMPLATE_ARGUMENTS
 std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &key, bool leftMost, bool rightMost,
                                                                 OperationType op_type, Transaction *transaction) {
+  if (op_type == OperationType::SEARCH) {
+    return std::make_pair(FindLeafPageOptimistic(key, leftMost, rightMost, op_type, false), false);
+  }
   root_page_id_mutex_.lock();
   bool is_root_page_id_latched = true;
-  assert(root_page_id_ != INVALID_PAGE_ID);
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    root_page_id_mutex_.unlock();
+    return std::make_pair(nullptr, false);
+  }
   auto page = buffer_pool_manager_->FetchPage(root_page_id_);
   BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
-  if (op_type == OperationType::SEARCH) {
-    page->RLatch();
+  page->WLatch();
+  if (IsSafety(node, op_type)) {
     is_root_page_id_latched = false;
     root_page_id_mutex_.unlock();
-  } else {
-    page->WLatch();
-    if (IsSafety(node, op_type)) {
-      is_root_page_id_latched = false;
-      root_page_id_mutex_.unlock();
-    }
   }
   while (!node->IsLeafPage()) {
     InternalPage *i_node = reinterpret_cast<InternalPage *>(node);
@@ -662,20 +1123,24 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
 
     auto child_page = buffer_pool_manager_->FetchPage(child_node_page_id);
     auto child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
-    if (op_type == OperationType::SEARCH) {
-      child_page->RLatch();
-      page->RUnlatch();
-      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
-    } else {
-      child_page->WLatch();
-      transaction->AddIntoPageSet(page);
-      if (IsSafety(child_node, op_type)) {
-        if (is_root_page_id_latched) {
-          is_root_page_id_latched = false;
-          root_page_id_mutex_.unlock();
-        }
-        ClearTransactionPageSetAndUnpin(transaction);
+    child_page->WLatch();
+    transaction->AddIntoPageSet(page);
+    if (GetRightLink(child_node, key, rightMost) != INVALID_PAGE_ID) {
+      // key 在孩子节点右链上的节点里，它还不在父节点中，父节点不能加写锁修改，放弃
+      child_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(child_page->GetPageId(), false);
+      if (is_root_page_id_latched) {
+        root_page_id_mutex_.unlock();
+      }
+      ClearTransactionPageSetAndUnpin(transaction);
+      return std::make_pair(nullptr, false);
+    }
+    if (IsSafety(child_node, op_type)) {
+      if (is_root_page_id_latched) {
+        is_root_page_id_latched = false;
+        root_page_id_mutex_.unlock();
       }
+      ClearTransactionPageSetAndUnpin(transaction);
     }
     page = child_page;
     node = child_node;
@@ -683,6 +1148,122 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
   return std::make_pair(page, is_root_page_id_latched);
 }
 
+/*
+ * B-link descent, taken by every search and by the optimistic INSERT and DELETE: internal pages are read latched
+ * hand over hand and only INSERT and DELETE write latch the leaf. Nothing is modified on the way down. A page whose
+ * keys above its high key moved to a new right sibling not yet in the parent is left through its right link, so a
+ * split never makes a reader restart. A page merged away (dead) restarts the descent from the root, and so does a
+ * right sibling latched by someone else, moving right must not wait against the left to right order.
+ * @param require_safe return nullptr instead of a leaf that INSERT or DELETE may split or merge
+ * @return the latched leaf page (write latched unless SEARCH), nullptr if the tree is empty or the leaf is unsafe
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key, bool leftMost, bool rightMost, OperationType op_type,
+                                             bool require_safe) {
+  // 页类型只在新建和被合并掉时改变，被合并掉的页不会重用，拿锁之前就能判断加哪种锁
+  auto is_write = [op_type](BPlusTreePage *node) { return op_type != OperationType::SEARCH && node->IsLeafPage(); };
+  auto release = [this](Page *page, bool write) {
+    if (write) {
+      page->WUnlatch();
+    } else {
+      page->RUnlatch();
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  };
+  while (true) {
+    // 在 root_page_id_mutex_ 内 pin 住根节点，它被换掉也不会被删除，拿页锁时不持有 root_page_id_mutex_
+    root_page_id_mutex_.lock();
+    if (root_page_id_ == INVALID_PAGE_ID) {
+      root_page_id_mutex_.unlock();
+      return nullptr;
+    }
+    auto page = buffer_pool_manager_->FetchPage(root_page_id_);
+    root_page_id_mutex_.unlock();
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    bool write = is_write(node);
+    if (write) {
+      page->WLatch();
+    } else {
+      page->RLatch();
+    }
+    bool restart = false;
+    while (true) {
+      if (node->GetPageType() == IndexPageType::INVALID_INDEX_PAGE) {
+        restart = true;
+        break;
+      }
+      page_id_t next_page_id = leftMost ? INVALID_PAGE_ID : GetRightLink(node, key, rightMost);
+      if (next_page_id == INVALID_PAGE_ID && node->IsLeafPage()) {
+        break;
+      }
+      page_id_t child_node_page_id = next_page_id;
+      if (next_page_id == INVALID_PAGE_ID) {
+        InternalPage *i_node = reinterpret_cast<InternalPage *>(node);
+        if (leftMost) {
+          child_node_page_id = i_node->ValueAt(0);
+        } else if (rightMost) {
+          child_node_page_id = i_node->ValueAt(i_node->GetSize() - 1);
+        } else {
+          child_node_page_id = i_node->Lookup(key, comparator_);
+        }
+      }
+      assert(child_node_page_id > 0);
+      auto child_page = buffer_pool_manager_->FetchPage(child_node_page_id);
+      auto child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
+      bool child_write = is_write(child_node);
+      if (next_page_id != INVALID_PAGE_ID) {
+        // 向右走，合并和重组拿锁的顺序是从左到右，这里只能尝试
+        if (!(child_write ? child_page->TryWLatch() : child_page->TryRLatch())) {
+          buffer_pool_manager_->UnpinPage(child_node_page_id, false);
+          restart = true;
+          break;
+        }
+      } else if (child_write) {
+        child_page->WLatch();
+      } else {
+        child_page->RLatch();
+      }
+      release(page, write);
+      page = child_page;
+      node = child_node;
+      write = child_write;
+    }
+    if (restart) {
+      release(page, write);
+      std::this_thread::yield();
+      continue;
+    }
+    if (require_safe && !IsSafety(node, op_type)) {
+      release(page, write);
+      return nullptr;
+    }
+    return page;
+  }
+}
+
+/*
+ * @return the right sibling of node if key is not below its high key (for rightMost, whenever there is one),
+ * INVALID_PAGE_ID if key belongs to node
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::GetRightLink(BPlusTreePage *node, const KeyType &key, bool rightMost) {
+  page_id_t next_page_id;
+  const KeyType *high_key;
+  if (node->IsLeafPage()) {
+    LeafPage *leaf_node = reinterpret_cast<LeafPage *>(node);
+    next_page_id = leaf_node->GetNextPageId();
+    high_key = &leaf_node->GetHighKey();
+  } else {
+    InternalPage *internal_node = reinterpret_cast<InternalPage *>(node);
+    next_page_id = internal_node->GetNextPageId();
+    high_key = &internal_node->GetHighKey();
+  }
+  if (next_page_id == INVALID_PAGE_ID || (!rightMost && comparator_(key, *high_key) < 0)) {
+    return INVALID_PAGE_ID;
+  }
+  return next_page_id;
+}
+
 /*
  * Update/Insert root page id in header page(where page_id = 0, header_page is
  * defined under include/page/header_page.h)
@@ -692,20 +1273,132 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
  * updating it.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
+void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record, Transaction *transaction) {
   Page *page = buffer_pool_manager_->FetchPage(HEADER_PAGE_ID);
   HeaderPage *header_page = static_cast<HeaderPage *>(page);
-  if (insert_record != 0) {
-    // create a new record<index_name + root_page_id> in header_page
-    header_page->InsertRecord(index_name_, root_page_id_);
-  } else {
+  // create a new record<index_name + root_page_id> in header_page
+  // 树被删空后再插入时记录已经存在，此时更新即可
+  if (insert_record == 0 || !header_page->InsertRecord(index_name_, root_page_id_)) {
     // update root_page_id in header_page
     header_page->UpdateRecord(index_name_, root_page_id_);
   }
+  // 记录日志时 header page 保持 pin 住，由 LogPages 写完日志后 Unpin
+  if (IsLogging(transaction)) {
+    transaction->AddIntoLoggedPageSet(HEADER_PAGE_ID, false, header_page->GetRecordOffset(index_name_));
+    return;
+  }
   // 每次更新 header_page，顺便 Unpin
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
+/*
+ * Modifications are logged when a log manager is given, normal transactions log once logging is
+ * turned on, the transaction recovery undoes entries with (INVALID_TXN_ID) always logs
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsLogging(Transaction *transaction) {
+  return log_manager_ != nullptr && transaction != nullptr &&
+         (enable_logging || transaction->GetTransactionId() == INVALID_TXN_ID);
+}
+
+/*
+ * Log the entry inserted or removed, chained to the transaction so a loser can be undone logically,
+ * must be called while the leaf is still latched
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogEntry(LogRecordType type, const KeyType &key, const ValueType &value,
+                              Transaction *transaction) {
+  if (!IsLogging(transaction) || transaction->GetTransactionId() == INVALID_TXN_ID) {
+    return;
+  }
+  LogRecord log_record(transaction->GetTransactionId(), transaction->GetPrevLSN(), type, index_name_,
+                       std::string(reinterpret_cast<const char *>(&key), sizeof(KeyType)),
+                       std::string(reinterpret_cast<const char *>(&value), sizeof(ValueType)));
+  transaction->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+}
+
+/*
+ * Remember a page modified by the current operation, children_moved means the children of this
+ * internal page got it as their new parent, index is the first slot of a leaf that changed
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogPage(BPlusTreePage *node, Transaction *transaction, bool children_moved, int index) {
+  if (IsLogging(transaction)) {
+    uint32_t offset = index == 0 ? 0 : LEAF_PAGE_HEADER_SIZE + index * sizeof(MappingType);
+    transaction->AddIntoLoggedPageSet(node->GetPageId(), children_moved, offset);
+  }
+}
+
+/*
+ * Log the pages modified by the current operation as a single INDEXPAGES record, a split or merge
+ * is therefore atomic in the log. Must be called before the operation releases any latch (or the
+ * root page id mutex), so records of one page are in the order the page was modified.
+ * Every page is logged by its header and the used part of its image from the first changed byte
+ * (an insert or remove in a leaf shifts only the entries after it), children moved to another
+ * internal page by a write of their parent page id.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogPages(Transaction *transaction) {
+  if (transaction == nullptr || transaction->GetLoggedPageSet()->empty()) {
+    return;
+  }
+  auto logged_page_set = transaction->GetLoggedPageSet();
+  std::string page_writes;
+  std::vector<Page *> pages;
+  std::vector<page_id_t> children;
+  bool header_logged = false;
+  for (auto &[page_id, logged_page] : *logged_page_set) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    pages.push_back(page);
+    uint32_t header_size;
+    uint32_t used_size;
+    if (page_id == HEADER_PAGE_ID) {
+      header_logged = true;
+      // | RecordCount (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... |
+      header_size = sizeof(int);
+      used_size = sizeof(int) + static_cast<HeaderPage *>(page)->GetRecordCount() * 36;
+    } else if (reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage()) {
+      auto *leaf_node = reinterpret_cast<LeafPage *>(page->GetData());
+      header_size = LEAF_PAGE_HEADER_SIZE;
+      used_size = LEAF_PAGE_HEADER_SIZE + leaf_node->GetSize() * sizeof(MappingType);
+    } else {
+      auto *internal_node = reinterpret_cast<InternalPage *>(page->GetData());
+      header_size = INTERNAL_PAGE_HEADER_SIZE;
+      used_size = INTERNAL_PAGE_HEADER_SIZE + internal_node->GetSize() * sizeof(std::pair<KeyType, page_id_t>);
+      for (int i = 0; logged_page.children_moved_ && i < internal_node->GetSize(); i++) {
+        page_id_t child_page_id = internal_node->ValueAt(i);
+        LogRecord::AddPageWrite(&page_writes, child_page_id, BPlusTreePage::OFFSET_PARENT_PAGE_ID,
+                                reinterpret_cast<const char *>(&page_id), sizeof(page_id_t));
+        children.push_back(child_page_id);
+      }
+    }
+    uint32_t offset = std::max(logged_page.offset_, header_size);
+    if (offset < used_size) {
+      LogRecord::AddPageWrite(&page_writes, page_id, offset, page->GetData() + offset, used_size - offset);
+    }
+    LogRecord::AddPageWrite(&page_writes, page_id, 0, page->GetData(), header_size);
+  }
+  LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, std::move(page_writes));
+  lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+  for (page_id_t child_page_id : children) {
+    Page *child_page = buffer_pool_manager_->FetchPage(child_page_id);
+    reinterpret_cast<BPlusTreePage *>(child_page->GetData())->SetLSN(lsn);
+    buffer_pool_manager_->UnpinPage(child_page_id, true);
+  }
+  for (Page *page : pages) {
+    if (page->GetPageId() == HEADER_PAGE_ID) {
+      static_cast<HeaderPage *>(page)->SetLSN(lsn);
+    } else {
+      reinterpret_cast<BPlusTreePage *>(page->GetData())->SetLSN(lsn);
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  }
+  if (header_logged) {
+    buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);  // UpdateRootPageId 留下的 pin
+  }
+  logged_page_set->clear();
+}
+
 /*
  * 判断当前节点是否并发安全
  */
@@ -735,6 +1428,8 @@ void BPLUSTREE_TYPE::ClearTransactionPageSet(Transaction *transaction) {
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::ClearTransactionPageSetAndUnpin(Transaction *transaction) {
   assert(transaction != nullptr);
+  // 释放锁之前先写日志
+  LogPages(transaction);
   std::for_each(transaction->GetPageSet()->begin(), transaction->GetPageSet()->end(),
                 [&bpm = buffer_pool_manager_](Page *page) {
                   page->WUnlatch();
@@ -1007,5 +1702,12 @@ template class BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTree<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTree<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTree<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTree<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class BPlusTree<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
+template class BPlusTree<BinaryKey<4>, RID, BinaryComparator<4>>;
+template class BPlusTree<BinaryKey<8>, RID, BinaryComparator<8>>;
+template class BPlusTree<BinaryKey<16>, RID, BinaryComparator<16>>;
+template class BPlusTree<BinaryKey<32>, RID, BinaryComparator<32>>;
+template class BPlusTree<BinaryKey<64>, RID, BinaryComparator<64>>;
 
 }  // namespace bustub
@@ -66,4 +66,18 @@ template class IndexIterator<GenericKey<32>, RID, GenericComparator<32>>;
 
 template class IndexIterator<GenericKey<64>, RID, GenericComparator<64>>;
 
+template class IndexIterator<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+
+template class IndexIterator<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
+
+template class IndexIterator<BinaryKey<4>, RID, BinaryComparator<4>>;
+
+template class IndexIterator<BinaryKey<8>, RID, BinaryComparator<8>>;
+
+template class IndexIterator<BinaryKey<16>, RID, BinaryComparator<16>>;
+
+template class IndexIterator<BinaryKey<32>, RID, BinaryComparator<32>>;
+
+template class IndexIterator<BinaryKey<64>, RID, BinaryComparator<64>>;
+
 }  // namespace bustub
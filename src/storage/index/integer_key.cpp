@@ -0,0 +1,180 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// integer_key.cpp
+//
+// Identification: src/storage/index/integer_key.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/integer_key.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUSTUB_SIMD_SEARCH
+#endif
+
+namespace bustub {
+
+namespace {
+
+// SIMD 内核二分到这么多个 key 以内，再一起比较
+constexpr int SIMD_WINDOW = 32;
+
+template <typename IntType>
+IntType LoadKey(const char *data) {
+  IntType value;
+  memcpy(&value, data, sizeof(IntType));
+  return value;
+}
+
+// upper 时数大于 key 的，否则数小于 key 的，与 SIMD 内核一致
+template <typename IntType>
+int CountScalar(const char *first, size_t stride, int count, IntType key, bool upper) {
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    IntType value = LoadKey<IntType>(first + i * stride);
+    n += static_cast<int>(upper ? value > key : value < key);
+  }
+  return n;
+}
+
+#ifdef BUSTUB_SIMD_SEARCH
+
+// 按 stride 从 (key, value) 数组里 gather 出 key，偏移以字节为单位。
+// 返回前清掉 ymm/zmm 的高位，否则之后的 SSE 代码都要付状态切换的代价
+__attribute__((target("avx2"))) int CountAvx2(const char *first, size_t stride, int count, int32_t key, bool upper) {
+  const __m256i offsets =
+      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(stride)));
+  const __m256i keys = _mm256_set1_epi32(key);
+  int n = 0;
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i values = _mm256_i32gather_epi32(reinterpret_cast<const int *>(first + i * stride), offsets, 1);
+    __m256i greater = upper ? _mm256_cmpgt_epi32(values, keys) : _mm256_cmpgt_epi32(keys, values);
+    n += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(greater)));
+  }
+  _mm256_zeroupper();
+  return n + CountScalar(first + i * stride, stride, count - i, key, upper);
+}
+
+__attribute__((target("avx2"))) int CountAvx2(const char *first, size_t stride, int count, int64_t key, bool upper) {
+  const __m128i offsets = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(stride)));
+  const __m256i keys = _mm256_set1_epi64x(key);
+  int n = 0;
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i values = _mm256_i32gather_epi64(reinterpret_cast<const long long *>(first + i * stride), offsets, 1);
+    __m256i greater = upper ? _mm256_cmpgt_epi64(values, keys) : _mm256_cmpgt_epi64(keys, values);
+    n += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(greater)));
+  }
+  _mm256_zeroupper();
+  return n + CountScalar(first + i * stride, stride, count - i, key, upper);
+}
+
+// 最后不满一组的 key 用掩码 gather，不读数组之外
+__attribute__((target("avx512f"))) int CountAvx512(const char *first, size_t stride, int count, int32_t key,
+                                                   bool upper) {
+  const __m512i offsets =
+      _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                         _mm512_set1_epi32(static_cast<int>(stride)));
+  const __m512i keys = _mm512_set1_epi32(key);
+  int n = 0;
+  for (int i = 0; i < count; i += 16) {
+    auto mask = static_cast<__mmask16>(count - i >= 16 ? 0xFFFF : (1U << (count - i)) - 1);
+    __m512i values = _mm512_mask_i32gather_epi32(keys, mask, offsets, first + i * stride, 1);
+    __mmask16 greater = upper ? _mm512_cmpgt_epi32_mask(values, keys) : _mm512_cmpgt_epi32_mask(keys, values);
+    n += __builtin_popcount(greater & mask);
+  }
+  _mm256_zeroupper();
+  return n;
+}
+
+__attribute__((target("avx512f"))) int CountAvx512(const char *first, size_t stride, int count, int64_t key,
+                                                   bool upper) {
+  const __m256i offsets =
+      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(stride)));
+  const __m512i keys = _mm512_set1_epi64(key);
+  int n = 0;
+  for (int i = 0; i < count; i += 8) {
+    auto mask = static_cast<__mmask8>(count - i >= 8 ? 0xFF : (1U << (count - i)) - 1);
+    __m512i values = _mm512_mask_i32gather_epi64(keys, mask, offsets, first + i * stride, 1);
+    __mmask8 greater = upper ? _mm512_cmpgt_epi64_mask(values, keys) : _mm512_cmpgt_epi64_mask(keys, values);
+    n += __builtin_popcount(greater & mask);
+  }
+  _mm256_zeroupper();
+  return n;
+}
+
+#endif
+
+SearchKernel BestSearchKernel() {
+#ifdef BUSTUB_SIMD_SEARCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SearchKernel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SearchKernel::AVX2;
+  }
+#endif
+  return SearchKernel::SCALAR;
+}
+
+std::atomic<SearchKernel> &CurrentSearchKernel() {
+  static std::atomic<SearchKernel> kernel{BestSearchKernel()};
+  return kernel;
+}
+
+}  // namespace
+
+template <typename IntType>
+int SearchIntegerKeys(const char *first, size_t stride, int count, IntType key, bool upper) {
+  SearchKernel kernel = CurrentSearchKernel().load(std::memory_order_relaxed);
+  int window = kernel == SearchKernel::SCALAR ? 0 : SIMD_WINDOW;
+  // 二分查找，直到剩下的 key 不超过 window 个
+  int low = 0;
+  while (count > window) {
+    int half = count / 2;
+    IntType middle = LoadKey<IntType>(first + (low + half) * stride);
+    if (upper ? middle <= key : middle < key) {
+      low += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  if (count == 0) {
+    return low;
+  }
+  // 剩下的 key 一起比较，upper 时数出的是大于 key 的
+  int n = 0;
+#ifdef BUSTUB_SIMD_SEARCH
+  if (kernel == SearchKernel::AVX512) {
+    n = CountAvx512(first + low * stride, stride, count, key, upper);
+  } else {
+    n = CountAvx2(first + low * stride, stride, count, key, upper);
+  }
+#endif
+  return low + (upper ? count - n : n);
+}
+
+template int SearchIntegerKeys<int32_t>(const char *first, size_t stride, int count, int32_t key, bool upper);
+template int SearchIntegerKeys<int64_t>(const char *first, size_t stride, int count, int64_t key, bool upper);
+
+SearchKernel GetSearchKernel() { return CurrentSearchKernel().load(); }
+
+bool SetSearchKernel(SearchKernel kernel) {
+  if (static_cast<int>(kernel) > static_cast<int>(BestSearchKernel())) {
+    return false;
+  }
+  CurrentSearchKernel().store(kernel);
+  return true;
+}
+
+}  // namespace bustub
@@ -33,7 +33,23 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id
   SetPageId(page_id);
   SetParentPageId(parent_id);
   SetMaxSize(max_size);
+  SetNextPageId(INVALID_PAGE_ID);
 }
+
+/*
+ * Helper methods to set/get the right link and the high key, the high key is valid only if there is a right link
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+INDEX_TEMPLATE_ARGUMENTS
+const KeyType &B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const { return high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetHighKey(const KeyType &high_key) { high_key_ = high_key; }
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
  * array offset)
@@ -104,6 +120,12 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyCo
   // <= 1 还怎么找
   int sz = GetSize();
   assert(sz >= 1);
+  if constexpr (IsIntegerKey<KeyType>::VALUE) {
+    // 整数 key 用 SIMD 查找，第一个 key 无效
+    return array[SearchIntegerKeys(reinterpret_cast<const char *>(array + 1), sizeof(MappingType), sz - 1,
+                                   key.GetValue(), true)]
+        .second;
+  }
   int st = 1;
   int ed = sz - 1;
   while (st <= ed) {  // find the last key in array <= input
@@ -157,6 +179,39 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
   return sz + 1;
 }
 
+/*
+ * Insert new_key & new_value pair at the position of new_key, used when the left sibling of the new child may
+ * not be in this page, e.g. its own split has not reached this page yet
+ * @return:  new size after insertion
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNode(const KeyType &new_key, const ValueType &new_value,
+                                               const KeyComparator &comparator) {
+  // 第一个 key 无效，从 1 开始找第一个大于 new_key 的位置
+  auto new_index = std::upper_bound(array + 1, array + GetSize(), new_key,
+                                    [&comparator](const KeyType &key, const MappingType &pair) {
+                                      return comparator(key, pair.first) < 0;
+                                    }) -
+                   array;
+  int sz = GetSize();
+  std::move_backward(array + new_index, array + sz, array + sz + 1);
+  array[new_index].first = new_key;
+  array[new_index].second = new_value;
+  IncreaseSize(1);
+  return sz + 1;
+}
+
+/*
+ * Append a child after the last one, key is the smallest key of the child and larger than the keys in the page.
+ * The key of the first child is kept as well, like after MoveHalfTo. Used by bulk loading.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::AppendChild(const KeyType &key, const ValueType &value) {
+  array[GetSize()].first = key;
+  array[GetSize()].second = value;
+  IncreaseSize(1);
+}
+
 /*****************************************************************************
  * SPLIT
  *****************************************************************************/
@@ -245,6 +300,10 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient,
   // 注意：全部拷贝
   recipient->CopyNFrom(array, sz, buffer_pool_manager);
   SetSize(0);  // 当前为空
+  // 继承右链和 high key
+  recipient->SetNextPageId(GetNextPageId());
+  recipient->SetHighKey(GetHighKey());
+  SetNextPageId(INVALID_PAGE_ID);
 }
 
 /*****************************************************************************
@@ -261,10 +320,10 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient,
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                       BufferPoolManager *buffer_pool_manager) {
-  // 将第一个移动到 recipient 的末尾
+  // 将第一个移动到 recipient 的末尾，第一个 key 是无效的，移动过去的 key 是父节点上的 middle_key
+  SetKeyAt(0, middle_key);
   auto first_pair = array[0];
   recipient->CopyLastFrom(first_pair, buffer_pool_manager);
-  SetKeyAt(0, middle_key);
 
   // 第一个 pair 被拷贝后，记得删除
   std::move(array + 1, array + GetSize(), array);
@@ -301,8 +360,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *re
                                                        BufferPoolManager *buffer_pool_manager) {
   auto last_pair = array[GetSize() - 1];
   // 注意：此处有区别，recipient 现在是右孩子
-  recipient->CopyFirstFrom(last_pair, buffer_pool_manager);
+  // recipient 原来的第一个 pair 后移一位，它的 key 是父节点上的 middle_key，last_pair 的 key 成为新的分隔 key
   recipient->SetKeyAt(0, middle_key);
+  recipient->CopyFirstFrom(last_pair, buffer_pool_manager);
   // 直接 -1，无需移动
   IncreaseSize(-1);
 }
@@ -331,4 +391,11 @@ template class BPlusTreeInternalPage<GenericKey<8>, page_id_t, GenericComparator
 template class BPlusTreeInternalPage<GenericKey<16>, page_id_t, GenericComparator<16>>;
 template class BPlusTreeInternalPage<GenericKey<32>, page_id_t, GenericComparator<32>>;
 template class BPlusTreeInternalPage<GenericKey<64>, page_id_t, GenericComparator<64>>;
+template class BPlusTreeInternalPage<IntegerKey<int32_t>, page_id_t, IntegerComparator<int32_t>>;
+template class BPlusTreeInternalPage<IntegerKey<int64_t>, page_id_t, IntegerComparator<int64_t>>;
+template class BPlusTreeInternalPage<BinaryKey<4>, page_id_t, BinaryComparator<4>>;
+template class BPlusTreeInternalPage<BinaryKey<8>, page_id_t, BinaryComparator<8>>;
+template class BPlusTreeInternalPage<BinaryKey<16>, page_id_t, BinaryComparator<16>>;
+template class BPlusTreeInternalPage<BinaryKey<32>, page_id_t, BinaryComparator<32>>;
+template class BPlusTreeInternalPage<BinaryKey<64>, page_id_t, BinaryComparator<64>>;
 }  // namespace bustub
@@ -48,6 +48,15 @@ page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { return next_page_i
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
 
+/**
+ * Helper methods to set/get the high key, valid only if the page has a next page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+const KeyType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const { return high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetHighKey(const KeyType &high_key) { high_key_ = high_key; }
+
 /**
  * Helper method to find the first index i so that array[i].first >= key
  * NOTE: This method is only used when generating index iterator
@@ -56,6 +65,10 @@ INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const {
   int sz = GetSize();
   assert(sz >= 0);
+  if constexpr (IsIntegerKey<KeyType>::VALUE) {
+    // 整数 key 用 SIMD 查找
+    return SearchIntegerKeys(reinterpret_cast<const char *>(array), sizeof(MappingType), sz, key.GetValue(), false);
+  }
   int st = 0;
   int ed = sz - 1;
   while (st <= ed) {  // find the last key in array <= input
@@ -108,8 +121,8 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &valu
   // LOG_DEBUG("try Insert key: %lld.", key.ToString());
   int sz = GetSize();
   int gtIdx = KeyIndex(key, comparator);
-  // 不支持重复 key，相等则不插入
-  if (comparator(array[gtIdx].first, key) == 0) {
+  // 不支持重复 key，相等则不插入，末位之后是残留的数据，不能比较
+  if (gtIdx < sz && comparator(array[gtIdx].first, key) == 0) {
     return sz;
   }
   // 末位
@@ -133,6 +146,15 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &valu
   return sz + 1;
 }
 
+/*
+ * Append size sorted items after the last item, all of them larger than the keys in the page. Used by bulk loading.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::AppendSorted(const MappingType *items, int size) {
+  std::copy(items, items + size, array + GetSize());
+  IncreaseSize(size);
+}
+
 /*****************************************************************************
  * SPLIT
  *****************************************************************************/
@@ -222,7 +244,8 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient) {
   recipient->CopyNFrom(array, sz);
   SetSize(0);
   // Don't forget to update the next_page id in the sibling page
-  recipient->SetNextPageId(GetNextPageId());  // 继承我的 next_page_id
+  recipient->SetNextPageId(GetNextPageId());  // 继承我的 next_page_id 和 high key
+  recipient->SetHighKey(GetHighKey());
   SetNextPageId(INVALID_PAGE_ID);
 }
 
@@ -279,4 +302,11 @@ template class BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeLeafPage<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTreeLeafPage<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTreeLeafPage<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTreeLeafPage<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class BPlusTreeLeafPage<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
+template class BPlusTreeLeafPage<BinaryKey<4>, RID, BinaryComparator<4>>;
+template class BPlusTreeLeafPage<BinaryKey<8>, RID, BinaryComparator<8>>;
+template class BPlusTreeLeafPage<BinaryKey<16>, RID, BinaryComparator<16>>;
+template class BPlusTreeLeafPage<BinaryKey<32>, RID, BinaryComparator<32>>;
+template class BPlusTreeLeafPage<BinaryKey<64>, RID, BinaryComparator<64>>;
 }  // namespace bustub
@@ -25,6 +25,7 @@ bool HeaderPage::InsertRecord(const std::string &name, const page_id_t root_id)
 
   int record_num = GetRecordCount();
   int offset = 4 + record_num * 36;
+  assert(offset + 36 <= static_cast<int>(OFFSET_LSN));
   // check for duplicate name
   if (FindRecord(name) != -1) {
     return false;
@@ -82,6 +83,11 @@ bool HeaderPage::GetRootId(const std::string &name, page_id_t *root_id) {
   return true;
 }
 
+int HeaderPage::GetRecordOffset(const std::string &name) {
+  int index = FindRecord(name);
+  return index == -1 ? -1 : 4 + index * 36;
+}
+
 /**
  * helper functions
  */
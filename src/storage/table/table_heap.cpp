@@ -13,20 +13,26 @@
 #include <cassert>
 
 #include "common/logger.h"
+#include "concurrency/occ_manager.h"
+#include "concurrency/version_store.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     page_id_t first_page_id)
+                     page_id_t first_page_id, table_oid_t table_oid)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
       log_manager_(log_manager),
-      first_page_id_(first_page_id) {}
+      first_page_id_(first_page_id),
+      table_oid_(table_oid) {}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+                     Transaction *txn, table_oid_t table_oid)
+    : buffer_pool_manager_(buffer_pool_manager),
+      lock_manager_(lock_manager),
+      log_manager_(log_manager),
+      table_oid_(table_oid) {
   // Initialize the first table page.
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
@@ -37,6 +43,7 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
+  CheckWritable(txn);
   if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
@@ -51,7 +58,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, GetRowLockManager(txn, true), log_manager_, table_oid_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -81,16 +88,30 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  // 插入之前行不存在
+  if (txn->GetVersionStore() != nullptr) {
+    txn->GetVersionStore()->RecordWrite(txn, *rid, nullptr);
+  }
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
   // Update the transaction's write set.
   txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
+  // 乐观事务的插入直接写入页，新行在提交前一直锁着
+  if (IsOptimisticRead(txn)) {
+    txn->GetOccManager()->LockInsert(txn, *rid);
+  }
   return true;
 }
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
+  CheckWritable(txn);
+  // 乐观事务提交时才删除
+  if (IsOptimisticRead(txn)) {
+    txn->GetOccWriteSet()->insert_or_assign(rid, TableWriteRecord{rid, WType::DELETE, Tuple{}, this});
+    return true;
+  }
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -99,9 +120,18 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
+  if (IsSnapshotRead(txn) && !CheckWriteConflict(rid, txn)) {
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    return false;
+  }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  // 删除前的版本留给快照读
+  Tuple old_tuple;
+  bool exists = txn->GetVersionStore() != nullptr && page->GetTuple(rid, &old_tuple, nullptr, nullptr);
+  if (page->MarkDelete(rid, txn, GetRowLockManager(txn, true), log_manager_, table_oid_) && exists) {
+    txn->GetVersionStore()->RecordWrite(txn, rid, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +140,12 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  CheckWritable(txn);
+  // 乐观事务提交时才更新
+  if (IsOptimisticRead(txn)) {
+    txn->GetOccWriteSet()->insert_or_assign(rid, TableWriteRecord{rid, WType::UPDATE, tuple, this});
+    return true;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -117,10 +153,18 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
+  if (IsSnapshotRead(txn) && !CheckWriteConflict(rid, txn)) {
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    return false;
+  }
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  bool is_updated =
+      page->UpdateTuple(tuple, &old_tuple, rid, txn, GetRowLockManager(txn, true), log_manager_, table_oid_);
+  if (is_updated && txn->GetVersionStore() != nullptr) {
+    txn->GetVersionStore()->RecordWrite(txn, rid, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
@@ -136,8 +180,11 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
   page->WLatch();
-  page->ApplyDelete(rid, txn, log_manager_);
-  lock_manager_->Unlock(txn, rid);
+  page->ApplyDelete(rid, txn, lock_manager_, log_manager_, table_oid_);
+  // 表锁覆盖时行没有加锁
+  if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
+    lock_manager_->Unlock(txn, rid);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
@@ -153,6 +200,52 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+LockManager *TableHeap::GetRowLockManager(Transaction *txn, bool exclusive) {
+  // 乐观事务不加锁，TID 锁保护它写入的行
+  if (txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && txn->GetOccManager() != nullptr) {
+    return nullptr;
+  }
+  if (txn == nullptr || table_oid_ == INVALID_TABLE_OID) {
+    return lock_manager_;
+  }
+  bool covered = exclusive ? txn->IsTableExclusiveLocked(table_oid_) : txn->IsTableSharedLocked(table_oid_);
+  return covered ? nullptr : lock_manager_;
+}
+
+bool TableHeap::IsSnapshotRead(Transaction *txn) {
+  return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT && txn->GetVersionStore() != nullptr;
+}
+
+bool TableHeap::IsOptimisticRead(Transaction *txn) {
+  return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && txn->GetOccManager() != nullptr &&
+         txn->GetState() == TransactionState::GROWING;
+}
+
+void TableHeap::CheckWritable(Transaction *txn) {
+  if (txn != nullptr && txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_ON_READ_ONLY);
+  }
+}
+
+bool TableHeap::CheckWriteConflict(const RID &rid, Transaction *txn) {
+  // 持有写锁后没有并发的写者，已提交的写者在释放锁之前已经打上了提交时间戳
+  auto *lock_manager = GetRowLockManager(txn, true);
+  if (lock_manager != nullptr && !txn->IsExclusiveLocked(rid)) {
+    bool locked = txn->IsSharedLocked(rid) ? lock_manager->LockUpgrade(txn, rid, table_oid_)
+                                           : lock_manager->LockExclusive(txn, rid, table_oid_);
+    if (!locked) {
+      return false;
+    }
+  }
+  // 先提交者胜
+  if (txn->GetVersionStore()->HasWriteConflict(txn, rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_CONFLICT);
+  }
+  return true;
+}
+
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -163,12 +256,39 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   }
   // Read the tuple from the page.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res = GetTupleLatched(page, rid, tuple, txn);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
 }
 
+bool TableHeap::GetTupleLatched(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn) {
+  // 乐观事务读到自己缓存的写
+  if (IsOptimisticRead(txn)) {
+    auto write_it = txn->GetOccWriteSet()->find(rid);
+    if (write_it != txn->GetOccWriteSet()->end()) {
+      if (write_it->second.wtype_ == WType::DELETE) {
+        return false;
+      }
+      *tuple = write_it->second.tuple_;
+      tuple->rid_ = write_it->first;  // rid 可能就是 tuple->rid_
+      return true;
+    }
+  }
+  if (IsSnapshotRead(txn)) {
+    // 快照读不加锁，页中的版本对快照不可见时从版本链上找
+    bool res = page->GetTuple(rid, tuple, nullptr, nullptr);
+    return txn->GetVersionStore()->GetVisibleVersion(txn, rid, tuple, res);
+  }
+  if (IsOptimisticRead(txn)) {
+    // 乐观读不加锁，在页锁下记下行的版本，读到的数据和版本是一致的
+    bool res = page->GetTuple(rid, tuple, nullptr, nullptr);
+    txn->GetOccManager()->RecordRead(txn, rid);
+    return res;
+  }
+  return page->GetTuple(rid, tuple, txn, GetRowLockManager(txn, false), table_oid_);
+}
+
 TableIterator TableHeap::Begin(Transaction *txn) {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
@@ -178,7 +298,7 @@ TableIterator TableHeap::Begin(Transaction *txn) {
     auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-    auto found_tuple = page->GetFirstTupleRid(&rid);
+    auto found_tuple = page->GetFirstTupleRid(&rid, IsSnapshotRead(txn));
     page->RUnlatch();
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (found_tuple) {
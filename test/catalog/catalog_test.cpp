@@ -10,8 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
@@ -132,4 +134,90 @@ TEST(CatalogTest, CreateIndexTest) {
   delete disk_manager;
 }
 
+// The key type of an index follows its key schema, every key type finds and scans the rows in key order
+// NOLINTNEXTLINE
+TEST(CatalogTest, CreateIndexKeyTypeTest) {
+  auto disk_manager = new DiskManager("catalog_test.db");
+  auto bpm = new BufferPoolManager(32, disk_manager);
+  // 索引的根节点记在 header page 上
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  auto catalog = new Catalog(bpm, nullptr, nullptr);
+  std::string table_name = "potato";
+  std::vector<Column> columns;
+  columns.emplace_back("A", TypeId::INTEGER);
+  columns.emplace_back("B", TypeId::BIGINT);
+  columns.emplace_back("C", TypeId::SMALLINT);
+  columns.emplace_back("D", TypeId::VARCHAR, 8);
+  Schema schema(columns);
+  auto *table_metadata = catalog->CreateTable(nullptr, table_name, schema);
+
+  Transaction *txn = new Transaction(0);
+  const int num_rows = 200;
+  std::vector<RID> rids;
+  for (int i = 0; i < num_rows; i++) {
+    // A 和 B 有正有负，C 只有两个值，(C, A) 仍然唯一
+    int32_t a = (i % 2 == 0 ? 1 : -1) * i;
+    Tuple tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetBigIntValue(int64_t{a} * 1000000000),
+                 ValueFactory::GetSmallIntValue(static_cast<int16_t>(i % 2 - 1)),
+                 ValueFactory::GetVarcharValue("v" + std::to_string(1000 + i))},
+                &schema};
+    RID rid;
+    ASSERT_TRUE(table_metadata->table_->InsertTuple(tuple, &rid, txn));
+    rids.push_back(rid);
+  }
+
+  auto check = [&](const std::string &index_name, const std::vector<uint32_t> &key_attrs, auto *typed_index,
+                   size_t key_size) {
+    auto key_schema = Schema::CopySchema(&schema, key_attrs);
+    auto *index_info = catalog->CreateIndex(txn, index_name, table_name, schema, *key_schema, key_attrs);
+    EXPECT_NE(nullptr, dynamic_cast<decltype(typed_index)>(index_info->index_.get()));
+    EXPECT_EQ(key_size, index_info->key_size_);
+    std::vector<std::pair<Tuple, RID>> keys;
+    for (int i = 0; i < num_rows; i++) {
+      Tuple tuple;
+      ASSERT_TRUE(table_metadata->table_->GetTuple(rids[i], &tuple, txn));
+      Tuple key = tuple.KeyFromTuple(schema, *key_schema, key_attrs);
+      std::vector<RID> result;
+      index_info->index_->ScanKey(key, &result, txn);
+      ASSERT_EQ(1, result.size());
+      EXPECT_EQ(rids[i], result[0]);
+      keys.emplace_back(key, rids[i]);
+    }
+    // 按 key 的顺序扫描
+    std::sort(keys.begin(), keys.end(), [&](const auto &a, const auto &b) {
+      for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+        Value lhs = a.first.GetValue(key_schema, i);
+        Value rhs = b.first.GetValue(key_schema, i);
+        if (lhs.CompareNotEquals(rhs) == CmpBool::CmpTrue) {
+          return lhs.CompareLessThan(rhs) == CmpBool::CmpTrue;
+        }
+      }
+      return false;
+    });
+    auto iterator = index_info->index_->Scan();
+    for (const auto &key : keys) {
+      ASSERT_FALSE(iterator->IsEnd());
+      EXPECT_EQ(key.second, iterator->GetRID());
+      iterator->Next();
+    }
+    EXPECT_TRUE(iterator->IsEnd());
+    delete key_schema;
+  };
+  check("index_a", {0}, static_cast<BPlusTreeIndex<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>> *>(nullptr),
+        4);
+  check("index_b", {1}, static_cast<BPlusTreeIndex<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>> *>(nullptr),
+        8);
+  check("index_ca", {2, 0}, static_cast<BPlusTreeIndex<BinaryKey<8>, RID, BinaryComparator<8>> *>(nullptr), 8);
+  check("index_cb", {2, 1}, static_cast<BPlusTreeIndex<BinaryKey<16>, RID, BinaryComparator<16>> *>(nullptr), 16);
+  check("index_d", {3}, static_cast<BPlusTreeIndex<GenericKey<64>, RID, GenericComparator<64>> *>(nullptr), 64);
+  EXPECT_EQ(5, catalog->GetTableIndexes(table_name).size());
+
+  bpm->UnpinPage(header_page_id, true);
+  delete txn;
+  delete catalog;
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
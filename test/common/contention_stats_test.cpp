@@ -0,0 +1,203 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// contention_stats_test.cpp
+//
+// Identification: test/common/contention_stats_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <mutex>  // NOLINT
+#include <numeric>
+#include <thread>  // NOLINT
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/contention_stats.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+static const ContentionStats::SourceStats &GetSource(const ContentionStats::Snapshot &snapshot,
+                                                     ContentionSource source) {
+  return snapshot.sources_[static_cast<size_t>(source)];
+}
+
+static uint64_t HistogramSum(const ContentionStats::SourceStats &stats) {
+  return std::accumulate(stats.histogram_.begin(), stats.histogram_.end(), 0ULL);
+}
+
+// Only the acquisitions that found the latch taken wait, the counters of exited threads are kept
+// NOLINTNEXTLINE
+TEST(ContentionStatsTest, MutexTest) {
+  ContentionStats::Reset();
+  std::mutex latch;
+  { auto guard = ContentionStats::Lock(&latch, ContentionSource::BUFFER_POOL_LATCH); }
+  latch.lock();
+  std::thread waiter([&] { auto guard = ContentionStats::Lock(&latch, ContentionSource::BUFFER_POOL_LATCH); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  latch.unlock();
+  waiter.join();
+
+  auto snapshot = ContentionStats::Collect(10);
+  auto &stats = GetSource(snapshot, ContentionSource::BUFFER_POOL_LATCH);
+  EXPECT_EQ(2, stats.acquires_);
+  EXPECT_EQ(1, stats.waits_);
+  EXPECT_GE(stats.wait_ns_, 10000000);
+  EXPECT_EQ(stats.wait_ns_, stats.max_wait_ns_);
+  EXPECT_EQ(1, HistogramSum(stats));
+  // 大约 20ms，落在 2^14 到 2^15 微秒的桶，睡眠可能更久
+  EXPECT_EQ(0, std::accumulate(stats.histogram_.begin(), stats.histogram_.begin() + 14, 0ULL));
+  // 等的不是某个对象，没有热点
+  EXPECT_TRUE(snapshot.hot_objects_[static_cast<size_t>(ContentionSource::BUFFER_POOL_LATCH)].empty());
+  EXPECT_EQ(0, GetSource(snapshot, ContentionSource::LOG_MANAGER_LATCH).acquires_);
+}
+
+// NOLINTNEXTLINE
+TEST(ContentionStatsTest, PageLatchTest) {
+  auto *disk_manager = new DiskManager("contention_test.db");
+  auto *bpm = new BufferPoolManager(10, disk_manager);
+  page_id_t hot_page_id;
+  page_id_t cold_page_id;
+  auto *hot_page = bpm->NewPage(&hot_page_id);
+  auto *cold_page = bpm->NewPage(&cold_page_id);
+
+  ContentionStats::Reset();
+  for (int i = 0; i < 100; i++) {
+    cold_page->RLatch();
+    cold_page->RUnlatch();
+  }
+  hot_page->WLatch();
+  std::thread reader([&] {
+    hot_page->RLatch();
+    hot_page->RUnlatch();
+  });
+  std::thread writer([&] {
+    hot_page->WLatch();
+    hot_page->WUnlatch();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  hot_page->WUnlatch();
+  reader.join();
+  writer.join();
+
+  auto snapshot = ContentionStats::Collect(10);
+  auto &stats = GetSource(snapshot, ContentionSource::PAGE_LATCH);
+  EXPECT_EQ(103, stats.acquires_);
+  EXPECT_EQ(2, stats.waits_);
+  auto &hot_objects = snapshot.hot_objects_[static_cast<size_t>(ContentionSource::PAGE_LATCH)];
+  ASSERT_EQ(1, hot_objects.size());
+  EXPECT_EQ(hot_page_id, hot_objects[0].object_id_);
+  EXPECT_EQ(2, hot_objects[0].waits_);
+  EXPECT_NE(std::string::npos, snapshot.ToString().find("page " + std::to_string(hot_page_id) + " waits: 2"));
+
+  bpm->UnpinPage(hot_page_id, false);
+  bpm->UnpinPage(cold_page_id, false);
+  delete bpm;
+  delete disk_manager;
+  remove("contention_test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(ContentionStatsTest, LockManagerTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{3, 4};
+  ContentionStats::Reset();
+  auto *txn1 = txn_mgr.Begin();
+  auto *txn2 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid));
+  std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockShared(txn2, rid)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  txn_mgr.Commit(txn1);
+  waiter.join();
+  txn_mgr.Commit(txn2);
+
+  auto snapshot = ContentionStats::Collect(10);
+  auto &stats = GetSource(snapshot, ContentionSource::LOCK_MANAGER);
+  EXPECT_EQ(2, stats.acquires_);
+  EXPECT_EQ(1, stats.waits_);
+  EXPECT_GE(stats.wait_ns_, 10000000);
+  auto &hot_objects = snapshot.hot_objects_[static_cast<size_t>(ContentionSource::LOCK_MANAGER)];
+  ASSERT_EQ(1, hot_objects.size());
+  EXPECT_EQ(rid.Get(), hot_objects[0].object_id_);
+  EXPECT_NE(std::string::npos, snapshot.ToString().find("rid 3:4 waits: 1"));
+  delete txn1;
+  delete txn2;
+}
+
+// Each thread keeps the objects it waited for the longest, Collect returns the top N of all threads
+// NOLINTNEXTLINE
+TEST(ContentionStatsTest, HotObjectsTest) {
+  ContentionStats::Reset();
+  const int64_t num_objects = 4 * ContentionStats::MAX_HOT_OBJECTS;
+  auto record = [&](int64_t first) {
+    for (int64_t i = first; i < num_objects; i += 2) {
+      ContentionStats::RecordWait(ContentionSource::PAGE_LATCH, i, i * 1000);
+    }
+  };
+  std::thread even(record, 0);
+  std::thread odd(record, 1);
+  even.join();
+  odd.join();
+  // 表锁：页号是 INVALID_PAGE_ID，槽号是 oid
+  ContentionStats::RecordWait(ContentionSource::LOCK_MANAGER, RID(INVALID_PAGE_ID, 7).Get(), 1000);
+
+  auto snapshot = ContentionStats::Collect(3);
+  auto &hot_objects = snapshot.hot_objects_[static_cast<size_t>(ContentionSource::PAGE_LATCH)];
+  ASSERT_EQ(3, hot_objects.size());
+  for (int64_t i = 0; i < 3; i++) {
+    EXPECT_EQ(num_objects - 1 - i, hot_objects[i].object_id_);
+    EXPECT_EQ(1, hot_objects[i].waits_);
+  }
+  EXPECT_EQ(num_objects, GetSource(snapshot, ContentionSource::PAGE_LATCH).waits_);
+  EXPECT_EQ((num_objects - 1) * 1000, GetSource(snapshot, ContentionSource::PAGE_LATCH).max_wait_ns_);
+  EXPECT_NE(std::string::npos, snapshot.ToString().find("table 7 waits: 1"));
+}
+
+/*
+ * Cost of counting on the uncontended path: page latches against the bare latch, the buffer pool latch
+ * against a plain lock_guard.
+ */
+// NOLINTNEXTLINE
+TEST(ContentionStatsTest, DISABLED_OverheadBenchmark) {
+  const int num_ops = 10000000;
+  auto bench = [&](const char *name, auto op) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_ops; i++) {
+      op();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BENCH contention op=" << name << " ns_per_op=" << static_cast<double>(ns) / num_ops << std::endl;
+  };
+  ReaderWriterLatch latch;
+  Page page;
+  std::mutex mutex;
+  bench("rwlatch_read", [&] {
+    latch.RLock();
+    latch.RUnlock();
+  });
+  bench("page_read_latch", [&] {
+    page.RLatch();
+    page.RUnlatch();
+  });
+  bench("rwlatch_write", [&] {
+    latch.WLock();
+    latch.WUnlock();
+  });
+  bench("page_write_latch", [&] {
+    page.WLatch();
+    page.WUnlatch();
+  });
+  bench("mutex", [&] { std::lock_guard<std::mutex> guard(mutex); });
+  bench("counted_mutex", [&] { auto guard = ContentionStats::Lock(&mutex, ContentionSource::BUFFER_POOL_LATCH); });
+}
+
+}  // namespace bustub
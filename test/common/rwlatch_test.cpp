@@ -10,11 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <iostream>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <thread>  // NOLINT
 #include <vector>
 
 #include "common/rwlatch.h"
 #include "gtest/gtest.h"
+#include "storage/page/page.h"
 
 namespace bustub {
 
@@ -57,4 +64,188 @@ TEST(RWLatchTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// Readers never see a writer half done, whether they take the fast or the slow path
+// NOLINTNEXTLINE
+TEST(RWLatchTest, ReadersAndWritersTest) {
+  const int num_threads = 8;
+  const int num_ops = 20000;
+  ReaderWriterLatch latch;
+  int64_t a = 0;
+  int64_t b = 0;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      for (int i = 0; i < num_ops; i++) {
+        // 写很少，偏向会被反复撤销和恢复
+        if (tid == 0 && i % 100 == 0) {
+          latch.WLock();
+          a++;
+          std::this_thread::yield();
+          b++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          EXPECT_EQ(a, b);
+          latch.RUnlock();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_ops / 100, a);
+}
+
+// A read latch may be released by another thread, and a thread may hold more read latches than its slots
+// NOLINTNEXTLINE
+TEST(RWLatchTest, ReleaseAnywhereTest) {
+  const int num_latches = 3 * ReaderWriterLatch::READER_ROW_SIZE;
+  std::vector<std::unique_ptr<ReaderWriterLatch>> latches;
+  for (int i = 0; i < num_latches; i++) {
+    latches.emplace_back(std::make_unique<ReaderWriterLatch>());
+  }
+  // 一个线程拿读锁，另一个线程释放，例如事务管理器的全局锁
+  std::thread reader([&] {
+    for (auto &latch : latches) {
+      latch->RLock();
+      latch->RLock();
+    }
+  });
+  reader.join();
+  for (auto &latch : latches) {
+    latch->RUnlock();
+  }
+  std::thread releaser([&] {
+    for (auto &latch : latches) {
+      latch->RUnlock();
+    }
+  });
+  releaser.join();
+  // 都释放了，写锁不会等待
+  for (auto &latch : latches) {
+    latch->WLock();
+    latch->WUnlock();
+    latch->RLock();
+    latch->RUnlock();
+  }
+  // 持有读锁时销毁，同一地址上的新 latch 不受影响，例如崩溃时没有结束的事务
+  latches[0]->RLock();
+  auto *address = latches[0].get();
+  address->~ReaderWriterLatch();
+  new (address) ReaderWriterLatch();
+  address->WLock();
+  address->WUnlock();
+}
+
+// A failed TryWLock leaves the readers in the table visible to the next writer
+// NOLINTNEXTLINE
+TEST(RWLatchTest, FailedTryWLockTest) {
+  ReaderWriterLatch latch;
+  std::atomic<bool> written{false};
+  latch.RLock();
+  std::thread writer([&] {
+    EXPECT_FALSE(latch.TryWLock());
+    latch.WLock();
+    written = true;
+    latch.WUnlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(written);
+  latch.RUnlock();
+  writer.join();
+  EXPECT_TRUE(written);
+}
+
+/** The latch before it was biased towards readers, every reader takes the mutex. */
+class MutexReaderWriterLatch {
+ public:
+  void WLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    while (writer_entered_) {
+      reader_.wait(latch);
+    }
+    writer_entered_ = true;
+    while (reader_count_ > 0) {
+      writer_.wait(latch);
+    }
+  }
+  void WUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    writer_entered_ = false;
+    reader_.notify_all();
+  }
+  void RLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    while (writer_entered_) {
+      reader_.wait(latch);
+    }
+    reader_count_++;
+  }
+  void RUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    reader_count_--;
+    if (writer_entered_ && reader_count_ == 0) {
+      writer_.notify_one();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable writer_;
+  std::condition_variable reader_;
+  uint32_t reader_count_{0};
+  bool writer_entered_{false};
+};
+
+/*
+ * Every thread read latches the same page over and over, as every B+ tree descent does on the root page, with
+ * one write latch per 10000 reads.
+ */
+// NOLINTNEXTLINE
+TEST(RWLatchTest, DISABLED_RootLatchBenchmark) {
+  const int num_reads = 1000000;
+  auto bench = [&](const char *name, int num_threads, auto *latch, const char *data) {
+    std::atomic<int64_t> sum{0};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.emplace_back([&, tid] {
+        int64_t local = 0;
+        for (int i = 0; i < num_reads / num_threads; i++) {
+          if (tid == 0 && i % 10000 == 0) {
+            latch->WLock();
+            latch->WUnlock();
+          }
+          latch->RLock();
+          local += data[i % 64];
+          latch->RUnlock();
+        }
+        sum += local;
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BENCH rwlatch impl=" << name << " threads=" << num_threads
+              << " rlocks_per_sec=" << num_reads * 1000000L / std::max<int64_t>(us, 1) << std::endl;
+  };
+  for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+    MutexReaderWriterLatch mutex_latch;
+    Page mutex_root;
+    bench("mutex", num_threads, &mutex_latch, mutex_root.GetData());
+    Page root;
+    struct PageLatch {
+      void WLock() { page_->WLatch(); }
+      void WUnlock() { page_->WUnlatch(); }
+      void RLock() { page_->RLatch(); }
+      void RUnlock() { page_->RUnlatch(); }
+      Page *page_;
+    } page_latch{&root};
+    bench("biased", num_threads, &page_latch, root.GetData());
+  }
+}
+
 }  // namespace bustub
@@ -2,12 +2,16 @@
  * lock_manager_test.cpp
  */
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
 #include <random>
 #include <thread>  // NOLINT
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
+#include "concurrency/zipf_generator.h"  // NOLINT
 #include "gtest/gtest.h"
 
 namespace bustub {
@@ -270,4 +274,510 @@ TEST(LockManagerTest, BasicDeadlockDetectionTest) {
   delete txn0;
   delete txn1;
 }
+
+// Lock queues are reclaimed once the last request leaves, including the request of an aborted waiter
+// NOLINTNEXTLINE
+TEST(LockManagerTest, LockTableReclaimTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const int num_threads = 8;
+  const int num_rids = 16;
+  const int num_iters = 2000;
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < num_threads; i++) {
+    txns.push_back(txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED));
+  }
+  // 独占锁保护的计数器，不加锁的 ++ 丢失更新就说明互斥失效
+  std::vector<int> counters(num_rids, 0);
+  auto task = [&](int i) {
+    std::mt19937 gen(i);
+    for (int j = 0; j < num_iters; j++) {
+      int k = gen() % num_rids;
+      RID rid{k, static_cast<uint32_t>(k)};
+      if (j % 4 == 0) {
+        EXPECT_TRUE(lock_mgr.LockShared(txns[i], rid));
+      } else {
+        EXPECT_TRUE(lock_mgr.LockExclusive(txns[i], rid));
+        counters[k]++;
+      }
+      EXPECT_TRUE(lock_mgr.Unlock(txns[i], rid));
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(task, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  int total = 0;
+  for (int counter : counters) {
+    total += counter;
+  }
+  EXPECT_EQ(num_threads * num_iters * 3 / 4, total);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  for (auto *txn : txns) {
+    txn_mgr.Commit(txn);
+    delete txn;
+  }
+
+  // 被中止的等待者撤回自己的请求
+  RID rid{0, 0};
+  auto *holder = txn_mgr.Begin();
+  auto *waiter = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(holder, rid));
+  std::thread t([&] { EXPECT_THROW(lock_mgr.LockExclusive(waiter, rid), TransactionAbortException); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  waiter->SetState(TransactionState::ABORTED);
+  EXPECT_TRUE(lock_mgr.Unlock(holder, rid));
+  t.join();
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  txn_mgr.Commit(holder);
+  txn_mgr.Abort(waiter);
+  delete holder;
+  delete waiter;
+}
+
+// Shared waiters queued behind an exclusive lock are all granted when it is released; a waiter that wakes up
+// before the one ahead of it is granted must be woken up again
+// NOLINTNEXTLINE
+TEST(LockManagerTest, SharedWaitersTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  const int num_readers = 8;
+  for (int round = 0; round < 100; round++) {
+    auto *writer = txn_mgr.Begin();
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, rid));
+    std::vector<Transaction *> readers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_readers; i++) {
+      readers.push_back(txn_mgr.Begin());
+      threads.emplace_back([&, i] { EXPECT_TRUE(lock_mgr.LockShared(readers[i], rid)); });
+    }
+    // 等所有读者阻塞，每个读者等写者和排在它前面的读者
+    while (lock_mgr.GetEdgeList().size() < num_readers * (num_readers + 1) / 2) {
+      std::this_thread::yield();
+    }
+    txn_mgr.Commit(writer);
+    for (int i = 0; i < num_readers; i++) {
+      threads[i].join();
+      txn_mgr.Commit(readers[i]);
+      delete readers[i];
+    }
+    delete writer;
+  }
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+}
+
+// The transaction that closes a cycle finds it when it blocks, long before the periodic sweep
+// NOLINTNEXTLINE
+TEST(LockManagerTest, EagerDeadlockDetectionTest) {
+  auto interval = cycle_detection_interval;
+  cycle_detection_interval = std::chrono::seconds(10);
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  // 大量与死锁无关的锁不影响检测
+  auto *reader = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(reader, RID{i + 2, 0}));
+  }
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid1));
+    txn_mgr.Commit(txn0);
+  });
+  // 等 txn0 阻塞
+  while (lock_mgr.GetEdgeList().empty()) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(1, lock_mgr.GetEdgeList().size());
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_THROW(lock_mgr.LockExclusive(txn1, rid0), TransactionAbortException);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  t0.join();
+  CheckCommitted(txn0);
+  // 等待结束的事务没有出边
+  EXPECT_TRUE(lock_mgr.GetEdgeList().empty());
+  txn_mgr.Commit(reader);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  delete txn0;
+  delete txn1;
+  delete reader;
+  cycle_detection_interval = interval;
+}
+
+// An older transaction wounds the younger holder and waits, a younger one waits for the older holder
+// NOLINTNEXTLINE
+TEST(LockManagerTest, WoundWaitTest) {
+  LockManager lock_mgr{DeadlockMode::WOUND_WAIT};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+
+  // 年轻的 txn1 持有 rid0，老的 txn0 伤害它并等待
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid0));
+  std::atomic<bool> granted{false};
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  CheckAborted(txn1);
+  // 被伤害的事务下次加锁时中止
+  EXPECT_THROW(lock_mgr.LockShared(txn1, rid1), TransactionAbortException);
+  txn_mgr.Abort(txn1);
+  t0.join();
+  EXPECT_TRUE(granted);
+
+  // 年轻的 txn2 等待老的 txn0
+  auto *txn2 = txn_mgr.Begin();
+  granted = false;
+  std::thread t2([&] {
+    EXPECT_TRUE(lock_mgr.LockShared(txn2, rid0));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  CheckGrowing(txn0);
+  txn_mgr.Commit(txn0);
+  t2.join();
+  EXPECT_TRUE(granted);
+  txn_mgr.Commit(txn2);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  delete txn0;
+  delete txn1;
+  delete txn2;
+}
+
+// A younger transaction dies instead of waiting for an older one, an older one waits
+// NOLINTNEXTLINE
+TEST(LockManagerTest, WaitDieTest) {
+  LockManager lock_mgr{DeadlockMode::WAIT_DIE};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+
+  EXPECT_TRUE(lock_mgr.LockShared(txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockShared(txn1, rid0));  // 共享锁不冲突
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+  // 老的 txn0 等待年轻的 txn1
+  std::atomic<bool> granted{false};
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid1));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  // 年轻的 txn1 升级时要等待老的 txn0，死亡
+  EXPECT_THROW(lock_mgr.LockUpgrade(txn1, rid0), TransactionAbortException);
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  t0.join();
+  EXPECT_TRUE(granted);
+  CheckGrowing(txn0);
+  txn_mgr.Commit(txn0);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  delete txn0;
+  delete txn1;
+}
+
+// Two transactions lock two rids in opposite order, the prevention policies break the deadlock without waiting
+// NOLINTNEXTLINE
+TEST(LockManagerTest, DeadlockPreventionTest) {
+  for (auto mode : {DeadlockMode::WOUND_WAIT, DeadlockMode::WAIT_DIE}) {
+    LockManager lock_mgr{mode};
+    TransactionManager txn_mgr{&lock_mgr};
+    RID rid0{0, 0};
+    RID rid1{1, 1};
+    auto *txn0 = txn_mgr.Begin();
+    auto *txn1 = txn_mgr.Begin();
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread t1([&] {
+      try {
+        lock_mgr.LockExclusive(txn1, rid0);
+      } catch (TransactionAbortException &e) {
+      }
+      // 两种策略下年轻的 txn1 都被中止
+      CheckAborted(txn1);
+      txn_mgr.Abort(txn1);
+    });
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid1));
+    t1.join();
+    txn_mgr.Commit(txn0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+    delete txn0;
+    delete txn1;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(LockManagerTest, TableLockCompatibilityTest) {
+  const LockMode modes[] = {LockMode::INTENTION_SHARED, LockMode::INTENTION_EXCLUSIVE, LockMode::SHARED,
+                            LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::EXCLUSIVE};
+  // 行：已持有的锁，列：请求的锁，顺序 IS IX S SIX X
+  const bool compatible[5][5] = {{true, true, true, true, false},
+                                 {true, true, false, false, false},
+                                 {true, false, true, false, false},
+                                 {true, false, false, false, false},
+                                 {false, false, false, false, false}};
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < 5; j++) {
+      EXPECT_EQ(compatible[i][j], LockManager::AreLocksCompatible(modes[i], modes[j])) << i << " " << j;
+    }
+  }
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE,
+            LockManager::CombineLockModes(LockMode::SHARED, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_EQ(LockMode::SHARED, LockManager::CombineLockModes(LockMode::INTENTION_SHARED, LockMode::SHARED));
+  EXPECT_EQ(LockMode::INTENTION_EXCLUSIVE,
+            LockManager::CombineLockModes(LockMode::INTENTION_EXCLUSIVE, LockMode::INTENTION_SHARED));
+  EXPECT_EQ(LockMode::EXCLUSIVE,
+            LockManager::CombineLockModes(LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::EXCLUSIVE));
+}
+
+// NOLINTNEXTLINE
+TEST(LockManagerTest, TableLockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+  auto *reader = txn_mgr.Begin();
+  auto *writer = txn_mgr.Begin();
+  auto *other = txn_mgr.Begin();
+
+  // 表级读锁阻塞其它事务的意向写锁，但允许意向读锁
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::SHARED));
+  EXPECT_TRUE(lock_mgr.LockTable(other, oid, LockMode::INTENTION_SHARED));
+  std::atomic<bool> granted{false};
+  std::thread t([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(writer, oid, LockMode::INTENTION_EXCLUSIVE));
+    granted = true;
+    // 意向写锁之后再锁行
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, RID{0, 0}));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+
+  // 持有读锁的事务升级为 SIX，意向读锁仍然兼容
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE, reader->GetTableLockSet()->at(oid));
+  EXPECT_TRUE(reader->IsTableSharedLocked(oid));
+  EXPECT_FALSE(reader->IsTableExclusiveLocked(oid));
+  // 已经覆盖的请求直接返回
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::INTENTION_SHARED));
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE, reader->GetTableLockSet()->at(oid));
+  EXPECT_FALSE(granted);
+
+  txn_mgr.Commit(reader);
+  t.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(1, writer->GetExclusiveLockSet()->size());
+  txn_mgr.Commit(writer);
+  EXPECT_TRUE(writer->GetTableLockSet()->empty());
+  EXPECT_EQ(1, other->GetTableLockSet()->size());
+  txn_mgr.Commit(other);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+
+  // 读未提交不加读锁
+  auto *dirty = txn_mgr.Begin(nullptr, IsolationLevel::READ_UNCOMMITTED);
+  EXPECT_THROW(lock_mgr.LockTable(dirty, oid, LockMode::INTENTION_SHARED), TransactionAbortException);
+  txn_mgr.Abort(dirty);
+  delete reader;
+  delete writer;
+  delete other;
+  delete dirty;
+}
+
+// NOLINTNEXTLINE
+TEST(LockManagerTest, LockEscalationTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  lock_mgr.SetEscalationThreshold(10);
+  const table_oid_t oid = 0;
+
+  // 行锁达到阈值后升级为表锁，行锁被释放
+  auto *writer = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(writer, oid, LockMode::INTENTION_EXCLUSIVE));
+  for (int i = 0; i < 25; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, RID{i, 0}, oid));
+  }
+  EXPECT_EQ(1, lock_mgr.GetEscalationNum());
+  EXPECT_TRUE(writer->IsTableExclusiveLocked(oid));
+  CheckTxnLockSize(writer, 0, 0);
+  EXPECT_TRUE(writer->GetTableRowLockSet()->empty());
+  EXPECT_EQ(1, lock_mgr.GetLockTableSize());
+  CheckGrowing(writer);
+  txn_mgr.Commit(writer);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+
+  // 表锁冲突时不等待，继续加行锁，下一次到阈值再试
+  auto *reader = txn_mgr.Begin();
+  auto *other = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::INTENTION_SHARED));
+  EXPECT_TRUE(lock_mgr.LockTable(other, oid, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_TRUE(lock_mgr.LockExclusive(other, RID{100, 0}, oid));
+  for (int i = 0; i < 15; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(reader, RID{i, 0}, oid));
+  }
+  EXPECT_EQ(1, lock_mgr.GetEscalationNum());
+  CheckTxnLockSize(reader, 15, 0);
+  EXPECT_EQ(15, reader->GetTableRowLockSet()->at(oid).size());
+  txn_mgr.Commit(other);
+  for (int i = 15; i < 25; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(reader, RID{i, 0}, oid));
+  }
+  EXPECT_EQ(2, lock_mgr.GetEscalationNum());
+  EXPECT_EQ(LockMode::SHARED, reader->GetTableLockSet()->at(oid));
+  CheckTxnLockSize(reader, 0, 0);
+
+  // 读锁升级后，写行锁仍然要加意向写锁：S + IX = SIX
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_TRUE(lock_mgr.LockExclusive(reader, RID{0, 0}, oid));
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE, reader->GetTableLockSet()->at(oid));
+  CheckTxnLockSize(reader, 0, 1);
+  txn_mgr.Commit(reader);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+  delete writer;
+  delete reader;
+  delete other;
+}
+
+/*
+ * Lock/unlock throughput with 1-16 threads, rids drawn uniformly or from a zipfian distribution,
+ * one exclusive lock for every four shared ones.
+ */
+// NOLINTNEXTLINE
+TEST(LockManagerTest, DISABLED_LockThroughputBenchmark) {
+  const int num_rids = 100000;
+  const int num_ops = 200000;
+  for (double theta : {0.0, 0.99}) {
+    ZipfGenerator zipf(num_rids, theta);
+    for (int num_threads : {1, 2, 4, 8, 16}) {
+      LockManager lock_mgr{};
+      TransactionManager txn_mgr{&lock_mgr};
+      std::vector<Transaction *> txns;
+      for (int i = 0; i < num_threads; i++) {
+        txns.push_back(txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED));
+      }
+      auto task = [&](int i) {
+        std::mt19937 gen(i);
+        for (int j = 0; j < num_ops / num_threads; j++) {
+          int k = zipf(&gen);
+          RID rid{k / 64, static_cast<uint32_t>(k % 64)};
+          if (j % 5 == 0) {
+            lock_mgr.LockExclusive(txns[i], rid);
+          } else {
+            lock_mgr.LockShared(txns[i], rid);
+          }
+          lock_mgr.Unlock(txns[i], rid);
+        }
+      };
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(task, i);
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "BENCH lock distribution=" << (theta == 0 ? "uniform" : "zipf") << " threads=" << num_threads
+                << " ops_per_sec=" << num_ops * 1000000L / std::max<int64_t>(us, 1)
+                << " lock_table_size=" << lock_mgr.GetLockTableSize() << std::endl;
+      for (auto *txn : txns) {
+        txn_mgr.Commit(txn);
+        delete txn;
+      }
+    }
+  }
+}
+
+/*
+ * Transfer tail latency of each deadlock policy: 8 threads move money between 16 accounts, locking the
+ * two accounts in random order. An aborted transfer is retried, its latency counts from the first try.
+ */
+// NOLINTNEXTLINE
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const int num_accounts = 16;
+  const int num_threads = 8;
+  const int num_transfers = 2000;
+  cycle_detection_interval = std::chrono::milliseconds(50);
+  auto work = [] {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+  };
+  for (auto mode : {DeadlockMode::DETECTION, DeadlockMode::WOUND_WAIT, DeadlockMode::WAIT_DIE}) {
+    LockManager lock_mgr{mode};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::atomic<int> aborts{0};
+    std::vector<std::vector<int64_t>> latencies(num_threads);
+    auto task = [&](int i) {
+      std::mt19937 gen(i);
+      for (int j = 0; j < num_transfers / num_threads; j++) {
+        int from = gen() % num_accounts;
+        int to = (from + 1 + gen() % (num_accounts - 1)) % num_accounts;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+          auto *txn = txn_mgr.Begin();
+          try {
+            lock_mgr.LockExclusive(txn, RID{from, 0});
+            work();
+            lock_mgr.LockExclusive(txn, RID{to, 0});
+            work();
+            txn_mgr.Commit(txn);
+            txn_mgr.Recycle(txn);
+            break;
+          } catch (TransactionAbortException &e) {
+            txn_mgr.Abort(txn);
+            txn_mgr.Recycle(txn);
+            aborts++;
+            // 重试的事务更年轻，让出 CPU 给持有锁的事务
+            std::this_thread::yield();
+          }
+        }
+        latencies[i].push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::vector<int64_t> all;
+    for (auto &latency : latencies) {
+      all.insert(all.end(), latency.begin(), latency.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all[std::min<size_t>(all.size() * p, all.size() - 1)]; };
+    const char *name = mode == DeadlockMode::DETECTION ? "detection"
+                       : mode == DeadlockMode::WOUND_WAIT ? "wound_wait"
+                                                          : "wait_die";
+    std::cout << "BENCH deadlock policy=" << name << " transfers_per_sec=" << all.size() * 1000 / std::max<int64_t>(ms, 1)
+              << " aborts=" << aborts << " p50_us=" << percentile(0.5) << " p99_us=" << percentile(0.99)
+              << " p999_us=" << percentile(0.999) << " max_us=" << all.back() << std::endl;
+  }
+}
+
 }  // namespace bustub
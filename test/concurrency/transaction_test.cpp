@@ -3,10 +3,14 @@
  */
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <iostream>
+#include <map>
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -14,6 +18,7 @@
 #include "catalog/table_generator.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
+#include "concurrency/zipf_generator.h"  // NOLINT
 #include "execution/execution_engine.h"
 #include "execution/executor_context.h"
 #include "execution/executors/insert_executor.h"
@@ -21,6 +26,8 @@
 #include "execution/expressions/column_value_expression.h"
 #include "execution/expressions/comparison_expression.h"
 #include "execution/expressions/constant_value_expression.h"
+#include "execution/plans/delete_plan.h"
+#include "execution/plans/index_scan_plan.h"
 #include "execution/plans/limit_plan.h"
 #include "execution/plans/nested_index_join_plan.h"
 #include "execution/plans/seq_scan_plan.h"
@@ -324,4 +331,842 @@ TEST_F(TransactionTest, DirtyReadsTest) {
   delete key_schema;
 }
 
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, TableLockTest) {
+  // txn1: SELECT colA FROM test_1;  (REPEATABLE_READ)
+  // txn2: SELECT colA FROM test_1 WHERE colA < 500;  (READ_COMMITTED)
+  // txn3: DELETE FROM test_1;
+  auto table_info = GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto out_schema = MakeOutputSchema({{"colA", colA}});
+
+  // 全表扫描只加一个表级读锁
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  std::vector<Tuple> result_set;
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, txn1, exec_ctx1.get());
+  ASSERT_EQ(result_set.size(), TEST1_SIZE);
+  CheckTxnLockSize(txn1, 0, 0);
+  ASSERT_EQ(txn1->GetTableLockSet()->size(), 1);
+  EXPECT_EQ(txn1->GetTableLockSet()->at(table_info->oid_), LockMode::SHARED);
+  GetTxnManager()->Commit(txn1);
+  EXPECT_TRUE(txn1->GetTableLockSet()->empty());
+  delete txn1;
+
+  // 读已提交只在表上加意向锁，行锁读完就释放
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  auto predicate = MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(500)),
+                                            ComparisonType::LessThan);
+  SeqScanPlanNode range_plan{out_schema, predicate, table_info->oid_};
+  result_set.clear();
+  GetExecutionEngine()->Execute(&range_plan, &result_set, txn2, exec_ctx2.get());
+  ASSERT_EQ(result_set.size(), 500);
+  CheckTxnLockSize(txn2, 0, 0);
+  EXPECT_EQ(txn2->GetTableLockSet()->at(table_info->oid_), LockMode::INTENTION_SHARED);
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+
+  // 删除整张表只加一个表级写锁
+  auto txn3 = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+  auto exec_ctx3 = std::make_unique<ExecutorContext>(txn3, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode child_plan{out_schema, nullptr, table_info->oid_};
+  DeletePlanNode delete_plan{&child_plan, table_info->oid_};
+  GetExecutionEngine()->Execute(&delete_plan, nullptr, txn3, exec_ctx3.get());
+  CheckTxnLockSize(txn3, 0, 0);
+  ASSERT_EQ(txn3->GetTableLockSet()->size(), 1);
+  EXPECT_EQ(txn3->GetTableLockSet()->at(table_info->oid_), LockMode::EXCLUSIVE);
+  GetTxnManager()->Commit(txn3);
+  delete txn3;
+
+  auto txn4 = GetTxnManager()->Begin();
+  auto exec_ctx4 = std::make_unique<ExecutorContext>(txn4, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  result_set.clear();
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, txn4, exec_ctx4.get());
+  EXPECT_EQ(result_set.size(), 0);
+  GetTxnManager()->Commit(txn4);
+  delete txn4;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, LockEscalationTest) {
+  // txn1: DELETE FROM test_1 WHERE colA < 900;
+  GetLockManager()->SetEscalationThreshold(100);
+  auto table_info = GetCatalog()->GetTable("test_1");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto out_schema = MakeOutputSchema({{"colA", colA}});
+  auto predicate = MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(900)),
+                                            ComparisonType::LessThan);
+
+  // 有谓词的批量删除先锁行，行锁到阈值后升级为表锁，事务的锁集合不随删除的行数增长
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode scan_plan{out_schema, predicate, table_info->oid_};
+  DeletePlanNode delete_plan{&scan_plan, table_info->oid_};
+  GetExecutionEngine()->Execute(&delete_plan, nullptr, txn1, exec_ctx1.get());
+  EXPECT_EQ(1, GetLockManager()->GetEscalationNum());
+  EXPECT_TRUE(txn1->IsTableExclusiveLocked(table_info->oid_));
+  CheckTxnLockSize(txn1, 0, 0);
+  EXPECT_EQ(1, GetLockManager()->GetLockTableSize());
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  auto txn2 = GetTxnManager()->Begin();
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode count_plan{out_schema, nullptr, table_info->oid_};
+  std::vector<Tuple> result_set;
+  GetExecutionEngine()->Execute(&count_plan, &result_set, txn2, exec_ctx2.get());
+  EXPECT_EQ(result_set.size(), TEST1_SIZE - 900);
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotIsolationTest) {
+  // txn1: INSERT INTO empty_table2 VALUES (200, 20), (201, 21), (202, 22)
+  // snapshot1: SELECT * FROM empty_table2;
+  // txn2: DELETE FROM empty_table2 WHERE colA = 200; UPDATE empty_table2 SET colB = 99 WHERE colA = 201;
+  //       INSERT INTO empty_table2 VALUES (203, 23)
+  // snapshot1: UPDATE empty_table2 SET colB = 0 WHERE colA = 201;  (write conflict)
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto colB = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", colA}, {"colB", colB}});
+  auto make_equal = [&](int value) {
+    return MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(value)),
+                                    ComparisonType::Equal);
+  };
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan = [&](Transaction *txn) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx.get());
+    std::map<int, int> rows;
+    for (auto &tuple : result_set) {
+      rows[tuple.GetValue(out_schema, 0).GetAs<int>()] = tuple.GetValue(out_schema, 1).GetAs<int>();
+    }
+    return rows;
+  };
+
+  auto txn1 = GetTxnManager()->Begin();
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<std::vector<Value>> raw_vals{
+      {ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)},
+      {ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)},
+      {ValueFactory::GetIntegerValue(202), ValueFactory::GetIntegerValue(22)}};
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn1, exec_ctx1.get());
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+  // 夹具的事务装载的其它表还没有提交，它们的版本一直保留
+  size_t version_num = GetTxnManager()->GetVersionStore()->GetVersionNum();
+  std::map<int, int> before{{200, 20}, {201, 21}, {202, 22}};
+  std::map<int, int> after{{201, 99}, {202, 22}, {203, 23}};
+
+  // 快照读不加锁
+  auto snapshot1 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  EXPECT_EQ(scan(snapshot1), before);
+  CheckTxnLockSize(snapshot1, 0, 0);
+  EXPECT_TRUE(snapshot1->GetTableLockSet()->empty());
+
+  auto txn2 = GetTxnManager()->Begin();
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode delete_scan{out_schema, make_equal(200), table_info->oid_};
+  DeletePlanNode delete_plan{&delete_scan, table_info->oid_};
+  GetExecutionEngine()->Execute(&delete_plan, nullptr, txn2, exec_ctx2.get());
+  SeqScanPlanNode update_scan{out_schema, make_equal(201), table_info->oid_};
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs{{1, UpdateInfo{UpdateType::Set, 99}}};
+  UpdatePlanNode update_plan{&update_scan, table_info->oid_, update_attrs};
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn2, exec_ctx2.get());
+  InsertPlanNode insert_plan2{{{ValueFactory::GetIntegerValue(203), ValueFactory::GetIntegerValue(23)}},
+                              table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan2, nullptr, txn2, exec_ctx2.get());
+  EXPECT_EQ(scan(txn2), after);
+
+  // 未提交的和快照之后提交的写都看不到
+  EXPECT_EQ(scan(snapshot1), before);
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+  EXPECT_EQ(scan(snapshot1), before);
+  EXPECT_EQ(version_num + 3, GetTxnManager()->GetVersionStore()->GetVersionNum());
+
+  auto snapshot2 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  EXPECT_EQ(scan(snapshot2), after);
+
+  // 快照之后被别人改过的行不能再写
+  auto exec_ctx3 =
+      std::make_unique<ExecutorContext>(snapshot1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::unordered_map<uint32_t, UpdateInfo> conflict_attrs{{1, UpdateInfo{UpdateType::Set, 0}}};
+  UpdatePlanNode conflict_plan{&update_scan, table_info->oid_, conflict_attrs};
+  EXPECT_THROW(GetExecutionEngine()->Execute(&conflict_plan, nullptr, snapshot1, exec_ctx3.get()),
+               TransactionAbortException);
+  CheckAborted(snapshot1);
+  GetTxnManager()->Abort(snapshot1);
+  delete snapshot1;
+
+  // 没有快照需要旧版本，版本都被回收
+  EXPECT_EQ(version_num, GetTxnManager()->GetVersionStore()->GetVersionNum());
+  EXPECT_EQ(scan(snapshot2), after);
+  GetTxnManager()->Commit(snapshot2);
+  delete snapshot2;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotConcurrentCommitTest) {
+  // 写者在一个事务里把 colB 从 300 挪 1 到 301，两行可能在不同的版本分片，快照读到的和总是 100
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto colB = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", colA}, {"colB", colB}});
+  auto make_equal = [&](int value) {
+    return MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(value)),
+                                    ComparisonType::Equal);
+  };
+  auto txn = GetTxnManager()->Begin();
+  auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  InsertPlanNode insert_plan{{{ValueFactory::GetIntegerValue(300), ValueFactory::GetIntegerValue(50)},
+                              {ValueFactory::GetIntegerValue(301), ValueFactory::GetIntegerValue(50)}},
+                             table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn, exec_ctx.get());
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  const int transfer_num = 200;
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    SeqScanPlanNode from_scan{out_schema, make_equal(300), table_info->oid_};
+    SeqScanPlanNode to_scan{out_schema, make_equal(301), table_info->oid_};
+    std::unordered_map<uint32_t, UpdateInfo> from_attrs{{1, UpdateInfo{UpdateType::Add, -1}}};
+    std::unordered_map<uint32_t, UpdateInfo> to_attrs{{1, UpdateInfo{UpdateType::Add, 1}}};
+    UpdatePlanNode from_plan{&from_scan, table_info->oid_, from_attrs};
+    UpdatePlanNode to_plan{&to_scan, table_info->oid_, to_attrs};
+    for (int i = 0; i < transfer_num; i++) {
+      auto txn = GetTxnManager()->Begin();
+      auto exec_ctx =
+          std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+      GetExecutionEngine()->Execute(&from_plan, nullptr, txn, exec_ctx.get());
+      GetExecutionEngine()->Execute(&to_plan, nullptr, txn, exec_ctx.get());
+      GetTxnManager()->Commit(txn);
+      delete txn;
+    }
+    done = true;
+  });
+  std::atomic<int> torn{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; i++) {
+    readers.emplace_back([&] {
+      SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+      while (!done) {
+        auto txn = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT);
+        auto exec_ctx =
+            std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+        std::vector<Tuple> result_set;
+        GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx.get());
+        int sum = 0;
+        for (auto &tuple : result_set) {
+          sum += tuple.GetValue(out_schema, 1).GetAs<int>();
+        }
+        if (result_set.size() != 2 || sum != 100) {
+          torn++;
+        }
+        GetTxnManager()->Commit(txn);
+        delete txn;
+      }
+    });
+  }
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(torn, 0);
+
+  auto snapshot = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  auto snapshot_ctx =
+      std::make_unique<ExecutorContext>(snapshot, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  std::vector<Tuple> result_set;
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, snapshot, snapshot_ctx.get());
+  std::map<int, int> rows;
+  for (auto &tuple : result_set) {
+    rows[tuple.GetValue(out_schema, 0).GetAs<int>()] = tuple.GetValue(out_schema, 1).GetAs<int>();
+  }
+  EXPECT_EQ(rows, (std::map<int, int>{{300, 50 - transfer_num}, {301, 50 + transfer_num}}));
+  GetTxnManager()->Commit(snapshot);
+  delete snapshot;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, ReadOnlyTest) {
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto colB = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", colA}, {"colB", colB}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan = [&](Transaction *txn) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx.get());
+    std::map<int, int> rows;
+    for (auto &tuple : result_set) {
+      rows[tuple.GetValue(out_schema, 0).GetAs<int>()] = tuple.GetValue(out_schema, 1).GetAs<int>();
+    }
+    return rows;
+  };
+  auto insert = [&](Transaction *txn, int a, int b) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    InsertPlanNode insert_plan{{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}},
+                               table_info->oid_};
+    GetExecutionEngine()->Execute(&insert_plan, nullptr, txn, exec_ctx.get());
+  };
+
+  auto txn1 = GetTxnManager()->Begin();
+  insert(txn1, 200, 20);
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  // 只读事务读快照，不加锁，也不在事务表里
+  size_t running_num = GetTxnManager()->GetRunningTransactionNum();
+  auto read_only = GetTxnManager()->BeginReadOnly();
+  EXPECT_TRUE(read_only->IsReadOnly());
+  EXPECT_EQ(IsolationLevel::SNAPSHOT, read_only->GetIsolationLevel());
+  EXPECT_EQ(running_num, GetTxnManager()->GetRunningTransactionNum());
+  EXPECT_EQ(nullptr, GetTxnManager()->GetTransaction(read_only->GetTransactionId()));
+  std::map<int, int> before{{200, 20}};
+  EXPECT_EQ(scan(read_only), before);
+  CheckTxnLockSize(read_only, 0, 0);
+  EXPECT_TRUE(read_only->GetTableLockSet()->empty());
+
+  auto txn2 = GetTxnManager()->Begin();
+  insert(txn2, 201, 21);
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+  EXPECT_EQ(scan(read_only), before);
+  GetTxnManager()->Commit(read_only);
+  CheckCommitted(read_only);
+  GetTxnManager()->Recycle(read_only);
+
+  // 写会终止只读事务，不留下锁和写
+  read_only = GetTxnManager()->BeginReadOnly();
+  EXPECT_THROW(insert(read_only, 202, 22), TransactionAbortException);
+  CheckAborted(read_only);
+  EXPECT_TRUE(read_only->GetWriteSet()->empty());
+  GetTxnManager()->Abort(read_only);
+  EXPECT_TRUE(read_only->GetTableLockSet()->empty());
+  GetTxnManager()->Recycle(read_only);
+
+  // 复用的对象不再是只读的
+  auto txn3 = GetTxnManager()->Begin();
+  EXPECT_FALSE(txn3->IsReadOnly());
+  std::map<int, int> after{{200, 20}, {201, 21}};
+  EXPECT_EQ(scan(txn3), after);
+  Schema key_schema{std::vector<Column>{Column{"colA", TypeId::INTEGER}}};
+  auto *index_info = GetCatalog()->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+      txn3, "index_colA", "empty_table2", schema, key_schema, {0}, 8);
+  GetTxnManager()->Commit(txn3);
+  GetTxnManager()->Recycle(txn3);
+
+  // 索引没有多版本，只读事务不能用索引扫描，加锁的事务照常执行
+  IndexScanPlanNode index_plan{out_schema, nullptr, index_info->index_oid_};
+  auto index_scan = [&](Transaction *txn) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&index_plan, &result_set, txn, exec_ctx.get());
+    return result_set.size();
+  };
+  read_only = GetTxnManager()->BeginReadOnly();
+  EXPECT_THROW(index_scan(read_only), NotImplementedException);
+  GetTxnManager()->Commit(read_only);
+  GetTxnManager()->Recycle(read_only);
+  auto txn4 = GetTxnManager()->Begin();
+  EXPECT_EQ(2, index_scan(txn4));
+  GetTxnManager()->Commit(txn4);
+  GetTxnManager()->Recycle(txn4);
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticTest) {
+  // txn1: INSERT INTO empty_table2 VALUES (200, 20), (201, 21), (202, 22)
+  // optimistic1: UPDATE empty_table2 SET colB = 99 WHERE colA = 201;
+  // optimistic2: SELECT * FROM empty_table2; UPDATE empty_table2 SET colB = 0 WHERE colA = 200;
+  // optimistic3: UPDATE empty_table2 SET colB = 0 WHERE colA = 202;  (commits before optimistic2)
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto colB = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", colA}, {"colB", colB}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan = [&](Transaction *txn) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx.get());
+    std::map<int, int> rows;
+    for (auto &tuple : result_set) {
+      rows[tuple.GetValue(out_schema, 0).GetAs<int>()] = tuple.GetValue(out_schema, 1).GetAs<int>();
+    }
+    return rows;
+  };
+  auto update = [&](Transaction *txn, int key, int value) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    auto predicate = MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(key)),
+                                              ComparisonType::Equal);
+    SeqScanPlanNode update_scan{out_schema, predicate, table_info->oid_};
+    std::unordered_map<uint32_t, UpdateInfo> update_attrs{{1, UpdateInfo{UpdateType::Set, value}}};
+    UpdatePlanNode update_plan{&update_scan, table_info->oid_, update_attrs};
+    GetExecutionEngine()->Execute(&update_plan, nullptr, txn, exec_ctx.get());
+  };
+
+  auto txn1 = GetTxnManager()->Begin();
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<std::vector<Value>> raw_vals{
+      {ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)},
+      {ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)},
+      {ValueFactory::GetIntegerValue(202), ValueFactory::GetIntegerValue(22)}};
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn1, exec_ctx1.get());
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  // 乐观事务不加锁，写缓存到提交，只有自己看得到
+  auto optimistic1 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  update(optimistic1, 201, 99);
+  CheckTxnLockSize(optimistic1, 0, 0);
+  EXPECT_TRUE(optimistic1->GetTableLockSet()->empty());
+  EXPECT_EQ(1, optimistic1->GetOccWriteSet()->size());
+  EXPECT_EQ(scan(optimistic1), (std::map<int, int>{{200, 20}, {201, 99}, {202, 22}}));
+  auto reader = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  EXPECT_EQ(scan(reader), (std::map<int, int>{{200, 20}, {201, 21}, {202, 22}}));
+  GetTxnManager()->Commit(reader);
+  delete reader;
+  GetTxnManager()->Commit(optimistic1);
+  CheckCommitted(optimistic1);
+  delete optimistic1;
+
+  // 读过的行在提交前被别人改了，校验失败
+  auto optimistic2 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(scan(optimistic2), (std::map<int, int>{{200, 20}, {201, 99}, {202, 22}}));
+  auto optimistic3 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  update(optimistic3, 202, 0);
+  GetTxnManager()->Commit(optimistic3);
+  delete optimistic3;
+  update(optimistic2, 200, 0);
+  EXPECT_THROW(GetTxnManager()->Commit(optimistic2), TransactionAbortException);
+  CheckAborted(optimistic2);
+  GetTxnManager()->Abort(optimistic2);
+  delete optimistic2;
+
+  auto txn4 = GetTxnManager()->Begin();
+  EXPECT_EQ(scan(txn4), (std::map<int, int>{{200, 20}, {201, 99}, {202, 0}}));
+  GetTxnManager()->Commit(txn4);
+  delete txn4;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticCounterTest) {
+  // 4 个线程各给同一行加 100 次，校验失败就重试，不会丢失更新
+  const int num_threads = 4;
+  const int num_increments = 100;
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto *table = table_info->table_.get();
+  auto *schema = &table_info->schema_;
+  RID rid;
+  auto txn = GetTxnManager()->Begin();
+  ASSERT_TRUE(table->InsertTuple(
+      Tuple{{ValueFactory::GetIntegerValue(0), ValueFactory::GetIntegerValue(0)}, schema}, &rid, txn));
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  std::atomic<int> aborts{0};
+  auto task = [&] {
+    for (int i = 0; i < num_increments; i++) {
+      while (true) {
+        auto *txn = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+        Tuple tuple;
+        EXPECT_TRUE(table->GetTuple(rid, &tuple, txn));
+        int value = tuple.GetValue(schema, 1).GetAs<int>();
+        table->UpdateTuple(Tuple{{ValueFactory::GetIntegerValue(0), ValueFactory::GetIntegerValue(value + 1)}, schema},
+                           rid, txn);
+        try {
+          GetTxnManager()->Commit(txn);
+          delete txn;
+          break;
+        } catch (TransactionAbortException &e) {
+          GetTxnManager()->Abort(txn);
+          delete txn;
+          aborts++;
+          std::this_thread::yield();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(task);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  txn = GetTxnManager()->Begin();
+  Tuple tuple;
+  ASSERT_TRUE(table->GetTuple(rid, &tuple, txn));
+  EXPECT_EQ(num_threads * num_increments, tuple.GetValue(schema, 1).GetAs<int>());
+  EXPECT_EQ(0, GetTxnManager()->GetOccManager()->GetTidWord(rid) & OccManager::TID_LOCK_BIT);
+  GetTxnManager()->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticIndexTest) {
+  // 乐观事务的更新在校验通过之后才改索引，校验失败的事务不留下索引项
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto colA = MakeColumnValueExpression(schema, 0, "colA");
+  auto colB = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", colA}, {"colB", colB}});
+  auto txn1 = GetTxnManager()->Begin();
+  Schema key_schema{std::vector<Column>{Column{"colB", TypeId::INTEGER}}};
+  auto *index_info = GetCatalog()->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+      txn1, "index_colB", "empty_table2", schema, key_schema, {1}, 8);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  InsertPlanNode insert_plan{{{ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)},
+                              {ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)}},
+                             table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn1, exec_ctx1.get());
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  auto lookup = [&](int value) {
+    Tuple row{{ValueFactory::GetIntegerValue(0), ValueFactory::GetIntegerValue(value)}, &schema};
+    std::vector<RID> rids;
+    index_info->index_->ScanKey(row.KeyFromTuple(schema, index_info->key_schema_, index_info->index_->GetKeyAttrs()),
+                                &rids, nullptr);
+    return rids.size();
+  };
+  auto update = [&](Transaction *txn, int value) {
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    auto predicate = MakeComparisonExpression(colA, MakeConstantValueExpression(ValueFactory::GetIntegerValue(201)),
+                                              ComparisonType::Equal);
+    SeqScanPlanNode update_scan{out_schema, predicate, table_info->oid_};
+    std::unordered_map<uint32_t, UpdateInfo> update_attrs{{1, UpdateInfo{UpdateType::Set, value}}};
+    UpdatePlanNode update_plan{&update_scan, table_info->oid_, update_attrs};
+    GetExecutionEngine()->Execute(&update_plan, nullptr, txn, exec_ctx.get());
+  };
+
+  auto optimistic1 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  update(optimistic1, 99);
+  EXPECT_EQ(1, lookup(21));
+  EXPECT_EQ(0, lookup(99));
+  // optimistic2 先提交，optimistic1 读过的行变了
+  auto optimistic2 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  update(optimistic2, 50);
+  GetTxnManager()->Commit(optimistic2);
+  delete optimistic2;
+  EXPECT_THROW(GetTxnManager()->Commit(optimistic1), TransactionAbortException);
+  GetTxnManager()->Abort(optimistic1);
+  delete optimistic1;
+
+  EXPECT_EQ(0, lookup(21));
+  EXPECT_EQ(0, lookup(99));
+  EXPECT_EQ(1, lookup(50));
+  EXPECT_EQ(1, lookup(20));
+}
+
+// NOLINTNEXTLINE
+TEST(OccManagerTest, ReclaimTidWordTest) {
+  // 写过很多行之后 TID 表不会一直变大，丢掉的行也不会回到校验时读到的 TID
+  OccManager occ_manager;
+  Transaction writer(0, IsolationLevel::OPTIMISTIC);
+  Transaction reader(1, IsolationLevel::OPTIMISTIC);
+  RID fresh{0, 0};
+  occ_manager.RecordRead(&reader, fresh);
+  occ_manager.LockInsert(&writer, fresh);
+  occ_manager.Release(&writer, 1);
+
+  const int row_num = 2 * OccManager::TID_TABLE_SHARD_NUM * OccManager::TID_TABLE_SHARD_CAPACITY;
+  for (int i = 1; i < row_num; i++) {
+    occ_manager.LockInsert(&writer, RID{i / 100, static_cast<uint32_t>(i % 100)});
+    occ_manager.Release(&writer, i + 1);
+  }
+  EXPECT_LE(occ_manager.GetTidWordNum(), OccManager::TID_TABLE_SHARD_NUM * OccManager::TID_TABLE_SHARD_CAPACITY);
+  EXPECT_GE(occ_manager.GetTidWord(fresh), 1);
+  uint64_t commit_tid;
+  EXPECT_FALSE(occ_manager.ValidateAndInstall(&reader, &commit_tid));
+  occ_manager.Abort(&reader);
+}
+
+// Finished transactions leave the transaction table, recycled ones are reused unless someone pinned them
+// NOLINTNEXTLINE
+TEST(TransactionManagerTest, TransactionPoolTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto *txn0 = txn_mgr.Begin();
+  txn_id_t txn0_id = txn0->GetTransactionId();
+  EXPECT_EQ(txn0, txn_mgr.GetTransaction(txn0_id));
+  EXPECT_EQ(1, txn_mgr.GetRunningTransactionNum());
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, RID{0, 0}));
+  txn_mgr.Commit(txn0);
+  EXPECT_EQ(nullptr, txn_mgr.GetTransaction(txn0_id));
+  EXPECT_EQ(0, txn_mgr.GetRunningTransactionNum());
+  txn_mgr.Recycle(txn0);
+  EXPECT_EQ(1, txn_mgr.GetPooledTransactionNum());
+
+  // 复用的事务是一个全新的事务
+  auto *txn1 = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  EXPECT_EQ(txn0, txn1);
+  EXPECT_NE(txn0_id, txn1->GetTransactionId());
+  EXPECT_EQ(TransactionState::GROWING, txn1->GetState());
+  EXPECT_EQ(IsolationLevel::READ_COMMITTED, txn1->GetIsolationLevel());
+  EXPECT_TRUE(txn1->GetExclusiveLockSet()->empty());
+  EXPECT_TRUE(txn1->GetTableRowLockSet()->empty());
+  EXPECT_EQ(0, txn_mgr.GetPooledTransactionNum());
+
+  // pin 住的事务结束并回收后也不会被复用，直到 unpin
+  txn_id_t txn1_id = txn1->GetTransactionId();
+  auto *pinned = txn_mgr.PinTransaction(txn1_id);
+  EXPECT_EQ(txn1, pinned);
+  txn_mgr.Abort(txn1);
+  txn_mgr.Recycle(txn1);
+  EXPECT_EQ(nullptr, txn_mgr.PinTransaction(txn1_id));
+  auto *txn2 = txn_mgr.Begin();
+  EXPECT_NE(pinned, txn2);
+  EXPECT_EQ(txn1_id, pinned->GetTransactionId());
+  EXPECT_EQ(TransactionState::ABORTED, pinned->GetState());
+  txn_mgr.UnpinTransaction(pinned);
+  txn_mgr.Commit(txn2);
+  txn_mgr.Recycle(txn2);
+  EXPECT_EQ(2, txn_mgr.GetPooledTransactionNum());
+  auto *txn3 = txn_mgr.Begin();
+  auto *txn4 = txn_mgr.Begin();
+  EXPECT_EQ(txn2, txn3);
+  EXPECT_EQ(pinned, txn4);
+  txn_mgr.Commit(txn3);
+  txn_mgr.Commit(txn4);
+  txn_mgr.Recycle(txn3);
+  txn_mgr.Recycle(txn4);
+  EXPECT_EQ(0, txn_mgr.GetRunningTransactionNum());
+}
+
+// Read-only transactions write no log records and are not blocked by a checkpoint
+// NOLINTNEXTLINE
+TEST(TransactionManagerTest, ReadOnlyTransactionTest) {
+  auto disk_manager = std::make_unique<DiskManager>("read_only_test.db");
+  auto log_manager = std::make_unique<LogManager>(disk_manager.get());
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr, log_manager.get()};
+  log_manager->RunFlushThread();
+
+  // 检查点等待正在运行的读写事务，新的读写事务也会被挡住
+  auto *txn = txn_mgr.Begin();
+  std::atomic<bool> blocked{false};
+  std::thread checkpoint([&] {
+    txn_mgr.BlockAllTransactions();
+    blocked = true;
+    txn_mgr.ResumeTransactions();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(blocked);
+
+  lsn_t next_lsn = log_manager->GetNextLSN();
+  auto *read_only = txn_mgr.BeginReadOnly();
+  EXPECT_EQ(1, txn_mgr.GetRunningTransactionNum());
+  txn_mgr.Commit(read_only);
+  EXPECT_EQ(next_lsn, log_manager->GetNextLSN());
+  txn_mgr.Recycle(read_only);
+  EXPECT_FALSE(blocked);
+
+  txn_mgr.Commit(txn);
+  checkpoint.join();
+  EXPECT_TRUE(blocked);
+  txn_mgr.Recycle(txn);
+
+  log_manager->StopFlushThread();
+  disk_manager->ShutDown();
+  remove("read_only_test.db");
+  remove("read_only_test.log");
+}
+
+// Threads begin, look up and recycle transactions concurrently, the number of transaction objects stays bounded
+// NOLINTNEXTLINE
+TEST(TransactionManagerTest, ConcurrentTransactionTableTest) {
+  const int num_threads = 8;
+  const int num_txns = 20000;
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  std::atomic<bool> done{false};
+  // 不断按 id 查找并 pin 正在运行的事务
+  std::thread lookup([&] {
+    std::mt19937 gen(0);
+    while (!done) {
+      txn_id_t txn_id = gen() % num_txns;
+      auto *txn = txn_mgr.PinTransaction(txn_id);
+      if (txn != nullptr) {
+        // 事务可能已经结束，但对象不会被复用成别的事务
+        std::this_thread::yield();
+        EXPECT_EQ(txn_id, txn->GetTransactionId());
+        txn_mgr.UnpinTransaction(txn);
+      }
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i] {
+      for (int j = 0; j < num_txns / num_threads; j++) {
+        auto *txn = txn_mgr.Begin();
+        EXPECT_EQ(txn, txn_mgr.GetTransaction(txn->GetTransactionId()));
+        EXPECT_TRUE(lock_mgr.LockShared(txn, RID{i, 0}));
+        txn_mgr.Commit(txn);
+        txn_mgr.Recycle(txn);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  done = true;
+  lookup.join();
+  EXPECT_EQ(0, txn_mgr.GetRunningTransactionNum());
+  // 每个线程同一时间只有一个事务，加上可能被 pin 住的一个
+  EXPECT_LE(txn_mgr.GetPooledTransactionNum(), num_threads + 1);
+  EXPECT_EQ(0, lock_mgr.GetLockTableSize());
+}
+
+/*
+ * YCSB-A (half reads, half read-modify-writes, 10 operations per transaction) on 10000 rows with 8 threads,
+ * keys drawn from a zipfian distribution of growing skew. 2PL locks each row before touching it, OCC
+ * validates at commit; an aborted transaction is retried.
+ */
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, DISABLED_YcsbBenchmark) {
+  const int num_rows = 10000;
+  const int num_threads = 8;
+  const int num_txns = 20000;
+  const int ops_per_txn = 10;
+  Schema schema{{Column{"key", TypeId::INTEGER}, Column{"value", TypeId::INTEGER}}};
+  auto *table_info = GetCatalog()->CreateTable(GetTxn(), "ycsb", schema);
+  auto *table = table_info->table_.get();
+  std::vector<RID> rids(num_rows);
+  auto txn = GetTxnManager()->Begin();
+  for (int i = 0; i < num_rows; i++) {
+    table->InsertTuple(Tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema},
+                       &rids[i], txn);
+  }
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  for (double theta : {0.0, 0.6, 0.9, 0.99}) {
+    ZipfGenerator zipf(num_rows, theta);
+    for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::OPTIMISTIC}) {
+      bool optimistic = isolation_level == IsolationLevel::OPTIMISTIC;
+      std::atomic<int> aborts{0};
+      auto task = [&](int i) {
+        std::mt19937 gen(i);
+        for (int j = 0; j < num_txns / num_threads; j++) {
+          std::vector<std::pair<int, bool>> ops;
+          for (int k = 0; k < ops_per_txn; k++) {
+            ops.emplace_back(zipf(&gen), gen() % 2 == 0);
+          }
+          while (true) {
+            auto *txn = GetTxnManager()->Begin(nullptr, isolation_level);
+            try {
+              for (auto &op : ops) {
+                const RID &rid = rids[op.first];
+                if (!optimistic) {
+                  bool locked = txn->IsExclusiveLocked(rid) || (!op.second && txn->IsSharedLocked(rid));
+                  if (!locked && op.second) {
+                    locked = txn->IsSharedLocked(rid) ? GetLockManager()->LockUpgrade(txn, rid, table_info->oid_)
+                                                      : GetLockManager()->LockExclusive(txn, rid, table_info->oid_);
+                  } else if (!locked) {
+                    locked = GetLockManager()->LockShared(txn, rid, table_info->oid_);
+                  }
+                  if (!locked) {
+                    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+                  }
+                }
+                Tuple tuple;
+                table->GetTuple(rid, &tuple, txn);
+                if (op.second) {
+                  std::vector<Value> values{ValueFactory::GetIntegerValue(op.first),
+                                            ValueFactory::GetIntegerValue(tuple.GetValue(&schema, 1).GetAs<int>() + 1)};
+                  table->UpdateTuple(Tuple{values, &schema}, rid, txn);
+                }
+              }
+              GetTxnManager()->Commit(txn);
+              GetTxnManager()->Recycle(txn);
+              break;
+            } catch (TransactionAbortException &e) {
+              GetTxnManager()->Abort(txn);
+              GetTxnManager()->Recycle(txn);
+              aborts++;
+              std::this_thread::yield();  // 让冲突的事务先提交
+            }
+          }
+        }
+      };
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(task, i);
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "BENCH ycsb mode=" << (optimistic ? "occ" : "2pl") << " theta=" << theta
+                << " txns_per_sec=" << num_txns * 1000000L / std::max<int64_t>(us, 1) << " aborts=" << aborts
+                << std::endl;
+    }
+  }
+}
+
+/*
+ * Per-query cost of a point SELECT (begin, read one row, commit) on one thread: a REPEATABLE_READ transaction
+ * takes the global latch, a row lock and a transaction table entry, a SNAPSHOT one skips the row lock, a
+ * read-only one skips all of them.
+ */
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, DISABLED_PointSelectBenchmark) {
+  const int num_rows = 10000;
+  const int num_queries = 500000;
+  Schema schema{{Column{"key", TypeId::INTEGER}, Column{"value", TypeId::INTEGER}}};
+  auto *table = GetCatalog()->CreateTable(GetTxn(), "point", schema)->table_.get();
+  std::vector<RID> rids(num_rows);
+  auto txn = GetTxnManager()->Begin();
+  for (int i = 0; i < num_rows; i++) {
+    table->InsertTuple(Tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema},
+                       &rids[i], txn);
+  }
+  GetTxnManager()->Commit(txn);
+  delete txn;
+
+  for (const char *mode : {"repeatable_read", "snapshot", "read_only"}) {
+    std::string name = mode;
+    std::mt19937 gen(0);
+    int64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+      Transaction *txn;
+      if (name == "read_only") {
+        txn = GetTxnManager()->BeginReadOnly();
+      } else {
+        txn = GetTxnManager()->Begin(
+            nullptr, name == "snapshot" ? IsolationLevel::SNAPSHOT : IsolationLevel::REPEATABLE_READ);
+      }
+      Tuple tuple;
+      EXPECT_TRUE(table->GetTuple(rids[gen() % num_rows], &tuple, txn));
+      sum += tuple.GetValue(&schema, 0).GetAs<int>();
+      GetTxnManager()->Commit(txn);
+      GetTxnManager()->Recycle(txn);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BENCH point_select mode=" << name << " ns_per_query=" << ns / num_queries << " checksum=" << sum
+              << std::endl;
+  }
+}
+
 }  // namespace bustub
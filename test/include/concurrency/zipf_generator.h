@@ -0,0 +1,47 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// zipf_generator.h
+//
+// Identification: test/include/concurrency/zipf_generator.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace bustub {
+
+/*
+ * Draws ranks in [0, n) with P(k) proportional to 1 / (k + 1)^theta.
+ */
+class ZipfGenerator {
+ public:
+  ZipfGenerator(int n, double theta) : cdf_(n) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += 1.0 / std::pow(i + 1, theta);
+      cdf_[i] = sum;
+    }
+    for (auto &p : cdf_) {
+      p /= sum;
+    }
+  }
+
+  int operator()(std::mt19937 *gen) {
+    double p = std::uniform_real_distribution<double>(0, 1)(*gen);
+    return std::min<int>(std::lower_bound(cdf_.begin(), cdf_.end(), p) - cdf_.begin(), cdf_.size() - 1);
+  }
+
+ private:
+  std::vector<double> cdf_;
+};
+
+}  // namespace bustub
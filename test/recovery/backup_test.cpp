@@ -0,0 +1,156 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_test.cpp
+//
+// Identification: test/recovery/backup_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "gtest/gtest.h"
+#include "logging/common.h"
+#include "recovery/backup_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/table/table_heap.h"
+#include "storage/table/table_iterator.h"
+
+namespace bustub {
+
+static void RemoveBackup(const std::string &backup_dir) {
+  remove((backup_dir + "/manifest").c_str());
+  remove((backup_dir + "/pages").c_str());
+  remove((backup_dir + "/log").c_str());
+  rmdir(backup_dir.c_str());
+}
+
+class BackupTest : public ::testing::Test {
+ protected:
+  void SetUp() override { TearDown(); }
+
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+    remove("restore.db");
+    remove("restore.log");
+    RemoveBackup("backup_full");
+    RemoveBackup("backup_inc");
+  }
+};
+
+static int CountTuples(BustubInstance *instance, page_id_t first_page_id) {
+  Transaction *txn = instance->transaction_manager_->Begin();
+  TableHeap table(instance->buffer_pool_manager_, instance->lock_manager_, instance->log_manager_, first_page_id);
+  int tuple_num = 0;
+  for (auto it = table.Begin(txn); it != table.End(); ++it) {
+    tuple_num++;
+  }
+  instance->transaction_manager_->Commit(txn);
+  delete txn;
+  return tuple_num;
+}
+
+/*
+ * restore the backups to restore.db, recover it and count the tuples of the table
+ */
+static int RestoreAndCount(const std::vector<std::string> &backup_dirs, lsn_t target_lsn, page_id_t first_page_id) {
+  BackupManager::Restore(backup_dirs, "restore.db", target_lsn);
+  auto *restored = new BustubInstance("restore.db");
+  auto *log_recovery = new LogRecovery(restored->disk_manager_, restored->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  int tuple_num = CountTuples(restored, first_page_id);
+  delete restored;
+  return tuple_num;
+}
+
+static void InsertTuples(BustubInstance *instance, TableHeap *table, Schema *schema, int tuple_num) {
+  Transaction *txn = instance->transaction_manager_->Begin();
+  for (int i = 0; i < tuple_num; i++) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(ConstructTuple(schema), &rid, txn));
+  }
+  instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST_F(BackupTest, IncrementalBackupTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  InsertTuples(bustub_instance, test_table, &schema, 1000);
+
+  // 全量备份，限速的同时写入继续
+  BackupManager backup_manager(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                               bustub_instance->log_manager_);
+  const size_t bytes_per_sec = 512 * 1024;
+  backup_manager.SetThrottle(bytes_per_sec);
+  std::thread writer([&] {
+    for (int i = 0; i < 10; i++) {
+      InsertTuples(bustub_instance, test_table, &schema, 20);
+    }
+  });
+  auto start = std::chrono::steady_clock::now();
+  auto full = backup_manager.Backup("backup_full");
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  writer.join();
+  EXPECT_GE(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+            full.page_num_ * PAGE_SIZE * 1000 / bytes_per_sec);
+  EXPECT_EQ(full.log_begin_offset_, 0);
+
+  InsertTuples(bustub_instance, test_table, &schema, 100);
+  lsn_t middle_lsn = bustub_instance->log_manager_->GetNextLSN() - 1;
+  InsertTuples(bustub_instance, test_table, &schema, 100);
+  // 未提交的事务，恢复时要被撤销
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, loser));
+
+  backup_manager.SetThrottle(0);
+  auto inc = backup_manager.Backup("backup_inc", &full);
+  EXPECT_EQ(inc.log_begin_offset_, full.log_end_offset_);
+  EXPECT_EQ(inc.base_start_lsn_, full.start_lsn_);
+  // 只复制了新写入的页
+  EXPECT_LT(inc.page_num_, full.page_num_);
+  EXPECT_GT(inc.page_num_, 0);
+  EXPECT_GE(inc.end_lsn_, middle_lsn);
+
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  EXPECT_EQ(RestoreAndCount({"backup_full", "backup_inc"}, INVALID_LSN, first_page_id), 1400);
+  EXPECT_EQ(RestoreAndCount({"backup_full", "backup_inc"}, middle_lsn, first_page_id), 1300);
+  // 全量备份时写入还在继续，只能看到完整提交的事务
+  int tuple_num = RestoreAndCount({"backup_full"}, INVALID_LSN, first_page_id);
+  EXPECT_GE(tuple_num, 1000);
+  EXPECT_LE(tuple_num, 1200);
+  EXPECT_EQ(tuple_num % 20, 0);
+  EXPECT_THROW(BackupManager::Restore({"backup_inc"}, "restore.db"), Exception);
+  EXPECT_THROW(BackupManager::Restore({"backup_full", "backup_inc"}, "restore.db", full.start_lsn_ - 1), Exception);
+}
+
+}  // namespace bustub
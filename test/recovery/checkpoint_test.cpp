@@ -0,0 +1,255 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// checkpoint_test.cpp
+//
+// Identification: test/recovery/checkpoint_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "gtest/gtest.h"
+#include "logging/common.h"
+#include "recovery/checkpoint_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/table/table_heap.h"
+#include "storage/table/table_iterator.h"
+
+namespace bustub {
+
+class CheckpointSchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override { TearDown(); }
+
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+    remove("test.ckpt");
+  }
+};
+
+static void InsertTuples(BustubInstance *instance, TableHeap *table, Schema *schema, int tuple_num) {
+  Transaction *txn = instance->transaction_manager_->Begin();
+  for (int i = 0; i < tuple_num; i++) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(ConstructTuple(schema), &rid, txn));
+  }
+  instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST_F(CheckpointSchedulerTest, LogSizeTriggerTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  CheckpointPolicy policy;
+  policy.max_log_bytes_ = 32 * 1024;
+  policy.max_dirty_ratio_ = 1.1;
+  policy.max_recovery_time_ = std::chrono::hours(1);
+  policy.check_interval_ = std::chrono::milliseconds(10);
+  policy.flush_duration_ = std::chrono::milliseconds(50);
+  auto *checkpoint_manager = bustub_instance->checkpoint_manager_;
+  checkpoint_manager->StartScheduler(policy);
+
+  // 持续写入，日志超过 32KB 就做检查点
+  int tuple_num = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  while (checkpoint_manager->GetStats().checkpoint_num_ < 2 && std::chrono::steady_clock::now() < deadline) {
+    InsertTuples(bustub_instance, test_table, &schema, 20);
+    tuple_num += 20;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  checkpoint_manager->StopScheduler();
+  auto stats = checkpoint_manager->GetStats();
+  EXPECT_GE(stats.checkpoint_num_, 2);
+  EXPECT_GT(stats.total_pages_written_, 0);
+  EXPECT_GE(stats.total_pages_written_, stats.last_pages_written_);
+  EXPECT_GE(stats.last_duration_ms_, stats.last_block_ms_);
+  EXPECT_LT(stats.log_bytes_, 64 * 1024);
+
+  // 检查点之后的写入，以及一个未提交的事务
+  InsertTuples(bustub_instance, test_table, &schema, 100);
+  tuple_num += 100;
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, loser));
+  bustub_instance->log_manager_->WaitForFlush(loser->GetPrevLSN());
+  stats = checkpoint_manager->GetStats();
+  EXPECT_GT(stats.log_bytes_, 0);
+  EXPECT_GT(stats.dirty_ratio_, 0);
+  EXPECT_GE(stats.estimated_recovery_ms_, 0);
+
+  // 崩溃：脏页没有写回
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  int checkpoint_offset;
+  lsn_t checkpoint_lsn;
+  ASSERT_TRUE(bustub_instance->disk_manager_->ReadMasterRecord(&checkpoint_offset, &checkpoint_lsn));
+  EXPECT_GT(checkpoint_offset, 0);
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  // 恢复从检查点开始
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  EXPECT_GE(log_recovery->GetMaxLSN(), checkpoint_lsn);
+  delete log_recovery;
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  int count = 0;
+  for (auto it = test_table->Begin(txn); it != test_table->End(); ++it) {
+    count++;
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  EXPECT_EQ(count, tuple_num);
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(CheckpointSchedulerTest, DirtyRatioTriggerTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  // 每张表的最后一页是脏的，一半的缓冲池
+  std::vector<TableHeap *> tables;
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (size_t i = 0; i < bustub_instance->buffer_pool_manager_->GetPoolSize() / 2; i++) {
+    tables.push_back(new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  CheckpointPolicy policy;
+  policy.max_log_bytes_ = 1 << 30;
+  policy.max_dirty_ratio_ = 0.3;
+  policy.max_recovery_time_ = std::chrono::hours(1);
+  policy.check_interval_ = std::chrono::milliseconds(10);
+  policy.flush_duration_ = std::chrono::milliseconds(0);
+  auto *checkpoint_manager = bustub_instance->checkpoint_manager_;
+  checkpoint_manager->StartScheduler(policy);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  while (checkpoint_manager->GetStats().checkpoint_num_ < 1 && std::chrono::steady_clock::now() < deadline) {
+    for (auto *table : tables) {
+      InsertTuples(bustub_instance, table, &schema, 1);
+    }
+  }
+  checkpoint_manager->StopScheduler();
+  auto stats = checkpoint_manager->GetStats();
+  EXPECT_GE(stats.checkpoint_num_, 1);
+  EXPECT_GE(stats.last_pages_written_, tables.size());
+
+  // 脏页在 100ms 内均匀写回，事务只在最后被阻塞
+  for (auto *table : tables) {
+    InsertTuples(bustub_instance, table, &schema, 1);
+  }
+  EXPECT_GE(checkpoint_manager->GetStats().dirty_ratio_, policy.max_dirty_ratio_);
+  checkpoint_manager->Checkpoint(std::chrono::milliseconds(100));
+  stats = checkpoint_manager->GetStats();
+  EXPECT_GE(stats.last_pages_written_, tables.size());
+  EXPECT_GE(stats.last_duration_ms_, 90);
+  EXPECT_LT(stats.last_block_ms_, 90);
+  EXPECT_EQ(stats.dirty_ratio_, 0);
+  EXPECT_LT(stats.log_bytes_, 64);  // 只有检查点日志本身
+  for (auto *table : tables) {
+    delete table;
+  }
+  delete bustub_instance;
+}
+
+// A checkpoint taken while an instant restart still has pages to redo must not skip their log
+// NOLINTNEXTLINE
+TEST_F(CheckpointSchedulerTest, InstantRestartCheckpointTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  const int tuple_num = 500;
+  InsertTuples(bustub_instance, test_table, &schema, tuple_num);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  delete test_table;
+
+  // 崩溃：页都没有写回
+  delete bustub_instance;
+
+  // 即时恢复，后台重做还没开始
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Analyze();
+  log_recovery->Undo();
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_GT(log_recovery->GetPendingPageNum(), 0);
+
+  // 调度线程等重做完成
+  CheckpointPolicy policy;
+  policy.max_log_bytes_ = 1;
+  policy.check_interval_ = std::chrono::milliseconds(10);
+  policy.flush_duration_ = std::chrono::milliseconds(0);
+  auto *checkpoint_manager = bustub_instance->checkpoint_manager_;
+  checkpoint_manager->StartScheduler(policy);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  checkpoint_manager->StopScheduler();
+  EXPECT_EQ(checkpoint_manager->GetStats().checkpoint_num_, 0);
+
+  // 直接打检查点，先重做所有页
+  checkpoint_manager->Checkpoint();
+  EXPECT_EQ(log_recovery->GetPendingPageNum(), 0);
+  EXPECT_EQ(checkpoint_manager->GetStats().checkpoint_num_, 1);
+
+  // 再次崩溃，恢复从检查点开始
+  delete log_recovery;
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  int count = 0;
+  for (auto it = test_table->Begin(txn); it != test_table->End(); ++it) {
+    count++;
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  EXPECT_EQ(count, tuple_num);
+  delete test_table;
+  delete bustub_instance;
+}
+
+}  // namespace bustub
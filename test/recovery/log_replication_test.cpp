@@ -0,0 +1,211 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_replication_test.cpp
+//
+// Identification: test/recovery/log_replication_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "catalog/catalog.h"
+#include "common/bustub_instance.h"
+#include "gtest/gtest.h"
+#include "logging/common.h"
+#include "recovery/log_recovery.h"
+#include "recovery/log_replication.h"
+#include "storage/table/table_heap.h"
+#include "storage/table/table_iterator.h"
+
+namespace bustub {
+
+class LogReplicationTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    remove("test.db");
+    remove("test.log");
+    remove("standby.db");
+    remove("standby.log");
+  }
+
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+    remove("standby.db");
+    remove("standby.log");
+  }
+};
+
+/** primary -> standby */
+struct PrimaryInfo {
+  int port_;
+  lsn_t persistent_lsn_;
+};
+
+/** standby -> primary */
+struct StandbyReport {
+  int tuple_num_;
+  bool loser_table_found_;
+  lsn_t replayed_lsn_;
+  lsn_t lag_lsn_;
+};
+
+/*
+ * load the catalog replicated from the primary and count the rows of foo, in a snapshot like the read-only
+ * queries on a standby
+ */
+static void ReadStandby(BustubInstance *instance, Catalog *catalog, StandbyReport *report) {
+  Transaction *txn = instance->transaction_manager_->BeginReadOnly();
+  catalog->Open(txn);
+  TableMetadata *table = catalog->GetTable("foo");
+  report->tuple_num_ = 0;
+  for (auto it = table->table_->Begin(txn); it != table->table_->End(); ++it) {
+    report->tuple_num_++;
+  }
+  report->loser_table_found_ = true;
+  try {
+    catalog->GetTable("bar");
+  } catch (const std::out_of_range &e) {
+    report->loser_table_found_ = false;
+  }
+  instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+/*
+ * The standby process: replay the log of the primary, read, then fail over.
+ * @return: exit code of the process
+ */
+static int RunStandby(int in_fd, int out_fd) {
+  PrimaryInfo info;
+  if (read(in_fd, &info, sizeof(info)) != sizeof(info)) {
+    return 1;
+  }
+  auto *standby = new BustubInstance("standby.db");
+  auto *catalog = new Catalog(standby->buffer_pool_manager_, standby->lock_manager_, standby->log_manager_);
+  auto *log_recovery = new LogRecovery(standby->disk_manager_, standby->buffer_pool_manager_, standby->log_manager_);
+  log_recovery->SetVersionStore(standby->transaction_manager_->GetVersionStore());
+  log_recovery->Redo();
+  auto *receiver = new LogReceiver(standby->disk_manager_, standby->log_manager_, log_recovery);
+  receiver->Start("127.0.0.1", info.port_);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (receiver->GetStats().replayed_lsn_ < info.persistent_lsn_ && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // 页中有未提交事务的修改，快照读不到
+  auto stats = receiver->GetStats();
+  StandbyReport report{0, false, stats.replayed_lsn_, stats.lag_lsn_};
+  ReadStandby(standby, catalog, &report);
+  if (write(out_fd, &report, sizeof(report)) != sizeof(report)) {
+    return 2;
+  }
+
+  // 主库挂了，故障切换：撤销未提交的事务，之后可以写
+  char stop;
+  if (read(in_fd, &stop, 1) != 1) {
+    return 3;
+  }
+  receiver->Stop();
+  log_recovery->Undo();
+  standby->log_manager_->RunFlushThread();
+  ReadStandby(standby, catalog, &report);
+  if (write(out_fd, &report, sizeof(report)) != sizeof(report)) {
+    return 4;
+  }
+  delete receiver;
+  delete log_recovery;
+  delete catalog;
+  delete standby;
+  return 0;
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogReplicationTest, StandbyTest) {
+  int to_standby[2];
+  int to_primary[2];
+  ASSERT_EQ(pipe(to_standby), 0);
+  ASSERT_EQ(pipe(to_primary), 0);
+  // 先 fork，之后两个进程各自创建线程
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    close(to_standby[1]);
+    close(to_primary[0]);
+    _exit(RunStandby(to_standby[0], to_primary[1]));
+  }
+  close(to_standby[0]);
+  close(to_primary[1]);
+
+  auto *primary = new BustubInstance("test.db");
+  auto *catalog = new Catalog(primary->buffer_pool_manager_, primary->lock_manager_, primary->log_manager_);
+  catalog->Open();
+  primary->log_manager_->RunFlushThread();
+  auto *shipper = new LogShipper(primary->disk_manager_, primary->log_manager_);
+  int port = shipper->Start(0);
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Transaction *txn = primary->transaction_manager_->Begin();
+  TableHeap *test_table = catalog->CreateTable(txn, "foo", schema)->table_.get();
+  const int committed_num = 500;
+  for (int i = 0; i < committed_num; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  primary->transaction_manager_->Commit(txn);
+  delete txn;
+  // 未提交的插入、删除，以及未提交的建表
+  Transaction *loser = primary->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &loser_rid, loser));
+  auto it = test_table->Begin(loser);
+  for (int i = 0; i < 2; i++, ++it) {
+    ASSERT_TRUE(test_table->MarkDelete(it->GetRid(), loser));
+  }
+  catalog->CreateTable(loser, "bar", schema);
+  primary->log_manager_->WaitForFlush(loser->GetPrevLSN());
+
+  PrimaryInfo info{port, primary->log_manager_->GetPersistentLSN()};
+  ASSERT_EQ(write(to_standby[1], &info, sizeof(info)), sizeof(info));
+  StandbyReport report;
+  ASSERT_EQ(read(to_primary[0], &report, sizeof(report)), sizeof(report));
+  EXPECT_EQ(report.tuple_num_, committed_num);
+  EXPECT_FALSE(report.loser_table_found_);
+  EXPECT_EQ(report.replayed_lsn_, info.persistent_lsn_);
+  EXPECT_EQ(report.lag_lsn_, 0);
+  auto stats = shipper->GetStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].replayed_lsn_, info.persistent_lsn_);
+  EXPECT_EQ(stats[0].lag_bytes_, 0);
+
+  // 主库停止，standby 接管
+  delete loser;
+  delete shipper;
+  ASSERT_EQ(write(to_standby[1], "s", 1), 1);
+  ASSERT_EQ(read(to_primary[0], &report, sizeof(report)), sizeof(report));
+  EXPECT_EQ(report.tuple_num_, committed_num);
+  EXPECT_FALSE(report.loser_table_found_);
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  delete catalog;
+  delete primary;
+  close(to_standby[1]);
+  close(to_primary[0]);
+}
+
+}  // namespace bustub
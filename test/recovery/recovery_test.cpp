@@ -10,9 +10,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
+#include "catalog/catalog.h"
 #include "common/bustub_instance.h"
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
@@ -20,9 +27,12 @@
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "recovery/log_recovery.h"
+#include "storage/b_plus_tree_test_util.h"  // NOLINT
+#include "storage/index/b_plus_tree.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -210,6 +220,853 @@ TEST_F(RecoveryTest, UndoTest) {
   delete bustub_instance;
 }
 
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ParallelRedoTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  // 足够多的 tuple，让日志覆盖多个页，从而分散到不同的 worker
+  std::vector<RID> rids;
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < 500; i++) {
+    RID rid;
+    Tuple tuple = ConstructTuple(&schema);
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+    rids.push_back(rid);
+    tuples.push_back(tuple);
+  }
+  for (size_t i = 0; i < rids.size(); i += 3) {
+    Tuple tuple = ConstructTuple(&schema);
+    if (test_table->UpdateTuple(tuple, rids[i], txn)) {
+      tuples[i] = tuple;
+    }
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // 未提交的事务，恢复后应被撤销
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &loser_rid, loser));
+  delete loser;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_, 4);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (size_t i = 0; i < rids.size(); i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn));
+    ASSERT_EQ(tuple.GetLength(), tuples[i].GetLength());
+    ASSERT_EQ(memcmp(tuple.GetData(), tuples[i].GetData(), tuple.GetLength()), 0);
+  }
+  Tuple tuple;
+  ASSERT_FALSE(test_table->GetTuple(loser_rid, &tuple, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, InstantRecoveryTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  std::vector<RID> rids;
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < 500; i++) {
+    RID rid;
+    Tuple tuple = ConstructTuple(&schema);
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+    rids.push_back(rid);
+    tuples.push_back(tuple);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &loser_rid, loser));
+  delete loser;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Analyze();
+  ASSERT_GT(log_recovery->GetPendingPageNum(), 0);
+  log_recovery->Undo();
+  bustub_instance->log_manager_->RunFlushThread();
+  log_recovery->StartBackgroundRedo();
+
+  // 查询与后台重做并发，访问到的页按需重做
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (size_t i = rids.size(); i > 0; i--) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i - 1], &tuple, txn));
+    ASSERT_EQ(tuple.GetLength(), tuples[i - 1].GetLength());
+    ASSERT_EQ(memcmp(tuple.GetData(), tuples[i - 1].GetData(), tuple.GetLength()), 0);
+  }
+  Tuple tuple;
+  ASSERT_FALSE(test_table->GetTuple(loser_rid, &tuple, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  for (int i = 0; i < 100 && log_recovery->GetPendingPageNum() > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(log_recovery->GetPendingPageNum(), 0);
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// The first page of a table created by a loser is never fetched by undo, it stays deleted and the undo is logged
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, InstantRecoveryNewPageTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  delete test_table;
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  auto *loser_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                    bustub_instance->log_manager_, loser);
+  page_id_t loser_page_id = loser_table->GetFirstPageId();
+  delete loser_table;
+  delete loser;
+
+  // 提交时 loser 的日志一起落盘，页都没有落盘
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Analyze();
+  size_t pending_page_num = log_recovery->GetPendingPageNum();
+  log_recovery->Undo();
+  ASSERT_EQ(log_recovery->GetPendingPageNum(), pending_page_num - 1);
+  // 新页的补偿日志和 ABORT
+  ASSERT_EQ(bustub_instance->log_manager_->GetNextLSN(), next_lsn + 2);
+  log_recovery->StartBackgroundRedo();
+  for (int i = 0; i < 100 && log_recovery->GetPendingPageNum() > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(log_recovery->GetPendingPageNum(), 0);
+  // 删除的页没有被重做出来
+  auto *page = reinterpret_cast<TablePage *>(bustub_instance->buffer_pool_manager_->FetchPage(loser_page_id));
+  ASSERT_NE(page, nullptr);
+  ASSERT_NE(page->GetTablePageId(), loser_page_id);
+  bustub_instance->buffer_pool_manager_->UnpinPage(loser_page_id, false);
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CompensationTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  RID rid;
+  const Tuple tuple = ConstructTuple(&schema);
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // 未提交的事务修改已经落盘
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  test_table->UpdateTuple(ConstructTuple(&schema), rid, loser);
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &loser_rid, loser));
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete loser;
+  delete test_table;
+
+  LOG_INFO("System crash before commit");
+  delete bustub_instance;
+
+  auto check = [&](BustubInstance *instance) {
+    Transaction *check_txn = instance->transaction_manager_->Begin();
+    TableHeap table(instance->buffer_pool_manager_, instance->lock_manager_, instance->log_manager_, first_page_id);
+    Tuple old_tuple;
+    ASSERT_TRUE(table.GetTuple(rid, &old_tuple, check_txn));
+    ASSERT_EQ(old_tuple.GetLength(), tuple.GetLength());
+    ASSERT_EQ(memcmp(old_tuple.GetData(), tuple.GetData(), tuple.GetLength()), 0);
+    ASSERT_FALSE(table.GetTuple(loser_rid, &old_tuple, check_txn));
+    instance->transaction_manager_->Commit(check_txn);
+    delete check_txn;
+  };
+
+  LOG_INFO("Recovery writes compensation log records");
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  check(bustub_instance);
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+
+  LOG_INFO("System crash again, no page is flushed");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                 bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  check(bustub_instance);
+  // 补偿日志与 ABORT 已经在日志中，无需再次撤销
+  ASSERT_EQ(bustub_instance->log_manager_->GetNextLSN(), next_lsn);
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DeltaUpdateTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  Column col3{"c", TypeId::VARCHAR, 64};
+  std::vector<Column> cols{col1, col2, col3};
+  Schema schema{cols};
+  std::string padding(48, 'x');
+  auto make_tuple = [&](int32_t b) {
+    std::vector<Value> values{ValueFactory::GetIntegerValue(1), ValueFactory::GetIntegerValue(b),
+                              ValueFactory::GetVarcharValue(padding)};
+    return Tuple(values, &schema);
+  };
+
+  // 窄更新只记录变化的字节，新旧 tuple 大小不同则退回完整的 update 日志
+  std::string delta;
+  Tuple tuple0 = make_tuple(0);
+  Tuple tuple1 = make_tuple(1);
+  ASSERT_TRUE(LogRecord::EncodeDelta(tuple0, tuple1, &delta));
+  ASSERT_LT(delta.size(), tuple0.GetLength());
+  Tuple patched = tuple0;
+  LogRecord::ApplyDelta(delta, patched.GetData());
+  ASSERT_EQ(memcmp(patched.GetData(), tuple1.GetData(), tuple1.GetLength()), 0);
+  LogRecord::ApplyDelta(LogRecord::InvertDelta(delta), patched.GetData());
+  ASSERT_EQ(memcmp(patched.GetData(), tuple0.GetData(), tuple0.GetLength()), 0);
+  std::vector<Value> values{ValueFactory::GetIntegerValue(1), ValueFactory::GetIntegerValue(1),
+                            ValueFactory::GetVarcharValue("y")};
+  ASSERT_FALSE(LogRecord::EncodeDelta(tuple0, Tuple(values, &schema), &delta));
+
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple0, &rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // 已提交的增量更新需要重做，未提交的需要撤销
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(tuple1, rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(make_tuple(2), rid, loser));
+  bustub_instance->log_manager_->Flush(true);
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete loser;
+  delete test_table;
+
+  LOG_INFO("System crash before commit");
+  delete bustub_instance;
+
+  auto check = [&](BustubInstance *instance) {
+    Transaction *check_txn = instance->transaction_manager_->Begin();
+    TableHeap table(instance->buffer_pool_manager_, instance->lock_manager_, instance->log_manager_, first_page_id);
+    Tuple old_tuple;
+    ASSERT_TRUE(table.GetTuple(rid, &old_tuple, check_txn));
+    ASSERT_EQ(old_tuple.GetValue(&schema, 1).GetAs<int32_t>(), 1);
+    ASSERT_EQ(old_tuple.GetValue(&schema, 2).ToString(), padding);
+    instance->transaction_manager_->Commit(check_txn);
+    delete check_txn;
+  };
+
+  // 第二次恢复重做补偿日志中的增量
+  for (int i = 0; i < 2; i++) {
+    bustub_instance = new BustubInstance("test.db");
+    auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                         bustub_instance->log_manager_);
+    log_recovery->Redo();
+    log_recovery->Undo();
+    delete log_recovery;
+    check(bustub_instance);
+    delete bustub_instance;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, AsyncCommitTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  LogManager *log_manager = bustub_instance->log_manager_;
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+  log_manager->SetFlushTimeout(std::chrono::milliseconds(10000));
+  log_manager->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  RID rid;
+
+  // 异步提交，COMMIT 仍在日志缓冲中
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table =
+      new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, log_manager, txn);
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  txn->SetAsyncCommit(true);
+  txn_manager->Commit(txn);
+  ASSERT_LT(log_manager->GetPersistentLSN(), txn->GetPrevLSN());
+  delete txn;
+
+  // 同步提交等待落盘，之前的异步提交一起落盘
+  log_manager->SetFlushTimeout(std::chrono::milliseconds(50));
+  txn = txn_manager->Begin();
+  ASSERT_FALSE(txn->IsAsyncCommit());
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  txn_manager->Commit(txn);
+  ASSERT_GE(log_manager->GetPersistentLSN(), txn->GetPrevLSN());
+  delete txn;
+
+  // 异步提交在 flush timeout 内落盘
+  txn_manager->SetAsyncCommit(true);
+  txn = txn_manager->Begin();
+  ASSERT_TRUE(txn->IsAsyncCommit());
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  txn_manager->Commit(txn);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (log_manager->GetPersistentLSN() < txn->GetPrevLSN() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_GE(log_manager->GetPersistentLSN(), txn->GetPrevLSN());
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+static void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream src(from, std::ios::binary);
+  std::ofstream dst(to, std::ios::binary | std::ios::trunc);
+  dst << src.rdbuf();
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, IndexRecoveryTest) {
+  // 较小的节点，插入时会多次分裂
+  const int leaf_max_size = 4;
+  const int internal_max_size = 4;
+  const int64_t committed_keys = 200;
+  GenericKey<8> index_key;
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(50, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  ASSERT_EQ(header_page_id, HEADER_PAGE_ID);
+  bpm->UnpinPage(header_page_id, true);
+
+  auto *tree = new BPlusTree<GenericKey<8>, RID, GenericComparator<8>>("foo_pk", bpm, comparator, leaf_max_size,
+                                                                         internal_max_size, log_manager);
+  for (int64_t key = 0; key < committed_keys; key += 10) {
+    Transaction *txn = txn_manager->Begin();
+    for (int64_t i = key; i < key + 10; i++) {
+      index_key.SetFromInteger(i);
+      ASSERT_TRUE(tree->Insert(index_key, RID(i), txn));
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+  }
+  // 删除一部分，包含合并
+  Transaction *txn = txn_manager->Begin();
+  for (int64_t i = 0; i < committed_keys; i += 3) {
+    index_key.SetFromInteger(i);
+    tree->Remove(index_key, txn);
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // 未提交的插入和删除，部分页已经落盘
+  Transaction *loser = txn_manager->Begin();
+  for (int64_t i = committed_keys; i < committed_keys + 50; i++) {
+    index_key.SetFromInteger(i);
+    ASSERT_TRUE(tree->Insert(index_key, RID(i), loser));
+  }
+  for (int64_t i = 1; i < committed_keys; i += 3) {
+    index_key.SetFromInteger(i);
+    tree->Remove(index_key, loser);
+  }
+  for (page_id_t page_id = 0; page_id < 100; page_id += 2) {
+    bpm->FlushPage(page_id);
+  }
+  delete loser;
+  delete tree;
+
+  LOG_INFO("System crash before commit");
+  log_manager->StopFlushThread();
+  delete txn_manager;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManager(50, disk_manager, log_manager);
+  auto *log_recovery = new LogRecovery(disk_manager, bpm, log_manager);
+  log_recovery->Redo();
+  // 无需重建索引，从 header page 得到根节点
+  tree = new BPlusTree<GenericKey<8>, RID, GenericComparator<8>>("foo_pk", bpm, comparator, leaf_max_size,
+                                                                   internal_max_size, log_manager);
+  ASSERT_TRUE(tree->LoadRootPageId());
+  log_recovery->RegisterIndex("foo_pk", [tree](bool is_insert, const char *key, const char *value) {
+    tree->UndoEntry(is_insert, key, value);
+  });
+  log_recovery->Undo();
+  delete log_recovery;
+
+  std::vector<RID> result;
+  for (int64_t i = 0; i < committed_keys + 50; i++) {
+    index_key.SetFromInteger(i);
+    result.clear();
+    bool committed = i < committed_keys && i % 3 != 0;
+    ASSERT_EQ(tree->GetValue(index_key, &result), committed) << "key " << i;
+    if (committed) {
+      ASSERT_EQ(result[0].GetPageId(), 0);
+      ASSERT_EQ(result[0].GetSlotNum(), i);
+    }
+  }
+  // 叶子链表也是完整的
+  int64_t count = 0;
+  for (auto it = tree->begin(); it != tree->end(); ++it) {
+    count++;
+  }
+  ASSERT_EQ(count, committed_keys - (committed_keys + 2) / 3);
+
+  delete tree;
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+  delete key_schema;
+}
+
+/*
+ * Recover a catalog kept in the database file: tables and indexes are found again, and so are the indexes
+ * undo goes through, a table created by a loser is gone.
+ */
+static void RecoverCatalog(BustubInstance *bustub_instance, Catalog *catalog) {
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  catalog->Open();
+  for (auto *index_info : catalog->GetIndexes()) {
+    auto *index = index_info->index_.get();
+    log_recovery->RegisterIndex(index_info->name_, [index](bool is_insert, const char *key, const char *value) {
+      index->UndoEntry(is_insert, key, value);
+    });
+  }
+  log_recovery->Undo();
+  catalog->Open();
+  delete log_recovery;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CatalogRecoveryTest) {
+  const int committed_num = 100;
+  const int loser_num = 10;
+  auto *bustub_instance = new BustubInstance("test.db");
+  auto *catalog = new Catalog(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                              bustub_instance->log_manager_);
+  catalog->Open();
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 20}}};
+  std::vector<uint32_t> key_attrs{0};
+  Schema key_schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  auto make_tuple = [&](int i) {
+    return Tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue(std::to_string(i))}, &schema};
+  };
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  TableMetadata *table = catalog->CreateTable(txn, "foo", schema);
+  RID rid;
+  for (int i = 0; i < committed_num; i++) {
+    ASSERT_TRUE(table->table_->InsertTuple(make_tuple(i), &rid, txn));
+  }
+  IndexInfo *index_info = catalog->CreateIndex(txn, "foo_a", "foo", schema, key_schema, key_attrs);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // 未提交的插入，以及未提交的建表
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  for (int i = committed_num; i < committed_num + loser_num; i++) {
+    Tuple tuple = make_tuple(i);
+    ASSERT_TRUE(table->table_->InsertTuple(tuple, &rid, loser));
+    index_info->index_->InsertEntry(tuple.KeyFromTuple(schema, key_schema, key_attrs), rid, loser);
+  }
+  catalog->CreateTable(loser, "bar", schema);
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  delete loser;
+
+  LOG_INFO("System crash before commit");
+  delete catalog;
+  delete bustub_instance;
+
+  // 第二次恢复重做第一次恢复写的补偿日志
+  for (int round = 0; round < 2; round++) {
+    bustub_instance = new BustubInstance("test.db");
+    catalog = new Catalog(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                          bustub_instance->log_manager_);
+    RecoverCatalog(bustub_instance, catalog);
+
+    ASSERT_THROW(catalog->GetTable("bar"), std::out_of_range);
+    table = catalog->GetTable("foo");
+    index_info = catalog->GetIndex("foo_a", "foo");
+    ASSERT_EQ(catalog->GetTableIndexes("foo").size(), 1);
+    txn = bustub_instance->transaction_manager_->Begin();
+    int count = 0;
+    for (auto it = table->table_->Begin(txn); it != table->table_->End(); it++) {
+      ASSERT_LT(it->GetValue(&table->schema_, 0).GetAs<int32_t>(), committed_num);
+      count++;
+    }
+    ASSERT_EQ(count, committed_num);
+    std::vector<RID> result;
+    for (int i = 0; i < committed_num + loser_num; i++) {
+      result.clear();
+      index_info->index_->ScanKey(make_tuple(i).KeyFromTuple(schema, key_schema, key_attrs), &result, txn);
+      ASSERT_EQ(result.size(), i < committed_num ? 1 : 0) << "key " << i;
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    bustub_instance->buffer_pool_manager_->FlushAllPages();
+    delete catalog;
+    delete bustub_instance;
+  }
+}
+
+/*
+ * Crash image for the recovery benchmarks: a table of 4000 tuples followed by random in-place updates
+ * until the WAL reaches BUSTUB_REDO_BENCH_MB (8 by default), saved as test.db.crash/test.log.crash.
+ */
+static void MakeCrashImage(page_id_t *first_page_id, std::vector<RID> *rids, std::streamoff *log_size) {
+  const char *wal_mb = std::getenv("BUSTUB_REDO_BENCH_MB");
+  const std::streamoff wal_bytes = static_cast<std::streamoff>(wal_mb == nullptr ? 8 : std::atoi(wal_mb)) << 20;
+
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  *first_page_id = test_table->GetFirstPageId();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  for (int i = 0; i < 4000; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+    rids->push_back(rid);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  std::mt19937 generator(0);
+  *log_size = 0;
+  while (*log_size < wal_bytes) {
+    txn = bustub_instance->transaction_manager_->Begin();
+    for (int i = 0; i < 100; i++) {
+      // 定长 tuple，原地更新
+      Tuple tuple = ConstructTuple(&schema);
+      test_table->UpdateTuple(tuple, (*rids)[generator() % rids->size()], txn);
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    *log_size = std::ifstream("test.log", std::ios::binary | std::ios::ate).tellg();
+  }
+  delete test_table;
+  delete bustub_instance;
+  CopyFile("test.db", "test.db.crash");
+  CopyFile("test.log", "test.log.crash");
+}
+
+/*
+ * Redo benchmark: recover the same crash image with 1-16 redo workers.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_ParallelRedoBenchmark) {
+  page_id_t first_page_id;
+  std::vector<RID> rids;
+  std::streamoff log_size;
+  MakeCrashImage(&first_page_id, &rids, &log_size);
+
+  std::cout << "BENCH redo wal_bytes=" << log_size << std::endl;
+  for (size_t workers : {1, 2, 4, 8, 16}) {
+    CopyFile("test.db.crash", "test.db");
+    CopyFile("test.log.crash", "test.log");
+    auto *bustub_instance = new BustubInstance("test.db");
+    auto start = std::chrono::steady_clock::now();
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, nullptr, workers);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BENCH redo workers=" << workers << " recovery_ms=" << ms << std::endl;
+
+    Transaction *txn = bustub_instance->transaction_manager_->Begin();
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_id);
+    Tuple tuple;
+    ASSERT_TRUE(table.GetTuple(rids.back(), &tuple, txn));
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    delete bustub_instance;
+  }
+  remove("test.db.crash");
+  remove("test.log.crash");
+}
+
+/*
+ * Instant restart benchmark: time to first query and point read throughput per 100ms window after
+ * the crash, full Redo/Undo versus Analyze/Undo with on-demand and background redo.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_InstantRecoveryBenchmark) {
+  page_id_t first_page_id;
+  std::vector<RID> rids;
+  std::streamoff log_size;
+  MakeCrashImage(&first_page_id, &rids, &log_size);
+
+  std::cout << "BENCH instant wal_bytes=" << log_size << std::endl;
+  for (bool instant : {false, true}) {
+    const char *mode = instant ? "instant" : "full";
+    CopyFile("test.db.crash", "test.db");
+    CopyFile("test.log.crash", "test.log");
+    auto *bustub_instance = new BustubInstance("test.db");
+    auto start = std::chrono::steady_clock::now();
+    auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                         bustub_instance->log_manager_);
+    if (instant) {
+      log_recovery->Analyze();
+    } else {
+      log_recovery->Redo();
+    }
+    log_recovery->Undo();
+    bustub_instance->log_manager_->RunFlushThread();
+    if (instant) {
+      log_recovery->StartBackgroundRedo();
+    }
+
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_id);
+    std::mt19937 generator(1);
+    Tuple tuple;
+    Transaction *txn = bustub_instance->transaction_manager_->Begin();
+    ASSERT_TRUE(table.GetTuple(rids[generator() % rids.size()], &tuple, txn));
+    auto first_query_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BENCH instant mode=" << mode << " time_to_first_query_us=" << first_query_us << std::endl;
+
+    for (int window = 0; window < 10; window++) {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+      size_t ops = 0;
+      while (std::chrono::steady_clock::now() < deadline) {
+        ASSERT_TRUE(table.GetTuple(rids[generator() % rids.size()], &tuple, txn));
+        if (++ops % 100 == 0) {
+          bustub_instance->transaction_manager_->Commit(txn);
+          delete txn;
+          txn = bustub_instance->transaction_manager_->Begin();
+        }
+      }
+      std::cout << "BENCH instant mode=" << mode << " window=" << window << " ops=" << ops
+                << " pending_pages=" << log_recovery->GetPendingPageNum() << std::endl;
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    delete log_recovery;
+    delete bustub_instance;
+  }
+  remove("test.db.crash");
+  remove("test.log.crash");
+}
+
+/*
+ * Narrow update benchmark: update one INTEGER column of ~100 byte tuples and report the WAL bytes written
+ * per update, next to the size a full image UPDATE record of the same tuple would take.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_DeltaUpdateBenchmark) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  Column col3{"c", TypeId::VARCHAR, 128};
+  std::vector<Column> cols{col1, col2, col3};
+  Schema schema{cols};
+  std::string padding(76, 'x');
+  auto make_tuple = [&](int32_t a, int32_t b) {
+    std::vector<Value> values{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b),
+                              ValueFactory::GetVarcharValue(padding)};
+    return Tuple(values, &schema);
+  };
+
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  std::vector<RID> rids(1000);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i, 0), &rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  bustub_instance->log_manager_->Flush(true);
+  std::streamoff before = std::ifstream("test.log", std::ios::binary | std::ios::ate).tellg();
+
+  const int updates = 100000;
+  std::mt19937 generator(0);
+  for (int i = 0; i < updates / 100; i++) {
+    txn = bustub_instance->transaction_manager_->Begin();
+    for (int j = 0; j < 100; j++) {
+      int k = generator() % rids.size();
+      ASSERT_TRUE(test_table->UpdateTuple(make_tuple(k, i * 100 + j), rids[k], txn));
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+  }
+  bustub_instance->log_manager_->Flush(true);
+  std::streamoff after = std::ifstream("test.log", std::ios::binary | std::ios::ate).tellg();
+  delete test_table;
+  delete bustub_instance;
+
+  uint32_t tuple_size = make_tuple(0, 0).GetLength();
+  // header + rid + 2 * (tuple_size + tuple_data)
+  size_t full_record = 20 + sizeof(RID) + 2 * (sizeof(int32_t) + tuple_size);
+  std::cout << "BENCH delta_update tuple_bytes=" << tuple_size << " full_image_bytes_per_update=" << full_record
+            << " wal_bytes_per_update=" << static_cast<double>(after - before) / updates << std::endl;
+}
+
+/*
+ * Commit benchmark: single update transactions from 1-4 threads on their own rows, synchronous commit
+ * versus asynchronous commit with a 100ms flush timeout.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_AsyncCommitBenchmark) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  auto make_tuple = [&](int32_t a, int32_t b) {
+    std::vector<Value> values{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)};
+    return Tuple(values, &schema);
+  };
+  const int rows_per_thread = 100;
+  const int txns_per_thread = 20000;
+
+  for (bool async_commit : {false, true}) {
+    for (int thread_num : {1, 2, 4}) {
+      remove("test.db");
+      remove("test.log");
+      auto *bustub_instance = new BustubInstance("test.db");
+      bustub_instance->log_manager_->SetFlushTimeout(std::chrono::milliseconds(100));
+      bustub_instance->log_manager_->RunFlushThread();
+      bustub_instance->transaction_manager_->SetAsyncCommit(async_commit);
+      Transaction *txn = bustub_instance->transaction_manager_->Begin();
+      TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                      bustub_instance->log_manager_, txn);
+      std::vector<RID> rids(thread_num * rows_per_thread);
+      for (size_t i = 0; i < rids.size(); i++) {
+        ASSERT_TRUE(table.InsertTuple(make_tuple(i, 0), &rids[i], txn));
+      }
+      bustub_instance->transaction_manager_->Commit(txn);
+      delete txn;
+      int flushes = bustub_instance->disk_manager_->GetNumFlushes();
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < thread_num; i++) {
+        threads.emplace_back([&, i] {
+          for (int j = 0; j < txns_per_thread; j++) {
+            Transaction *update_txn = bustub_instance->transaction_manager_->Begin();
+            int k = i * rows_per_thread + j % rows_per_thread;
+            table.UpdateTuple(make_tuple(k, j), rids[k], update_txn);
+            bustub_instance->transaction_manager_->Commit(update_txn);
+            delete update_txn;
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "BENCH commit mode=" << (async_commit ? "async" : "sync") << " threads=" << thread_num
+                << " commits_per_sec=" << static_cast<int64_t>(thread_num) * txns_per_thread * 1000000 / us
+                << " log_flushes=" << bustub_instance->disk_manager_->GetNumFlushes() - flushes << std::endl;
+      delete bustub_instance;
+    }
+  }
+}
+
 // NOLINTNEXTLINE
 TEST_F(RecoveryTest, CheckpointTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
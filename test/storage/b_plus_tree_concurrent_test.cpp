@@ -2,9 +2,13 @@
  * b_plus_tree_test.cpp
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
+#include <iostream>
+#include <numeric>
 #include <random>
 #include <thread>                   // NOLINT
 #include "b_plus_tree_test_util.h"  // NOLINT
@@ -781,4 +785,177 @@ TEST(BPlusTreeConcurrentTest, MixTest3) {
   remove("test.log");
 }
 
+// Lookups never miss a key while concurrent inserts split the pages it is on, internal pages included
+// NOLINTNEXTLINE
+TEST(BPlusTreeConcurrentTest, LookupDuringSplitsTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  // 页很小，插入频繁分裂到根节点
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  // 偶数先插入，查找它们的同时插入奇数
+  const int64_t scale = 4000;
+  std::vector<int64_t> even_keys;
+  std::vector<int64_t> odd_keys;
+  for (int64_t i = 1; i <= scale; i++) {
+    (i % 2 == 0 ? even_keys : odd_keys).push_back(i);
+  }
+  InsertHelper(&tree, even_keys);
+  std::mt19937 g(2021);
+  std::shuffle(odd_keys.begin(), odd_keys.end(), g);
+  std::atomic<int> inserters{2};
+  std::thread reader([&] {
+    GenericKey<8> index_key;
+    std::vector<RID> rids;
+    do {
+      for (auto key : even_keys) {
+        rids.clear();
+        index_key.SetFromInteger(key);
+        ASSERT_TRUE(tree.GetValue(index_key, &rids)) << key;
+        EXPECT_EQ(key, rids[0].GetSlotNum());
+      }
+    } while (inserters > 0);
+  });
+  LaunchParallelTest(2, [&](uint64_t thread_itr) {
+    InsertHelperSplit(&tree, odd_keys, 2, thread_itr);
+    inserters--;
+  });
+  reader.join();
+
+  int64_t current_key = 1;
+  for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+    EXPECT_EQ(current_key, (*iterator).second.GetSlotNum());
+    current_key++;
+  }
+  EXPECT_EQ(scale + 1, current_key);
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Concurrent insert throughput of the optimistic descent against latch crabbing from the root, each
+ * thread inserts its own share of shuffled keys into a tree with small pages, so splits happen.
+ */
+// NOLINTNEXTLINE
+TEST(BPlusTreeConcurrentTest, DISABLED_InsertBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t scale = 200000;
+  std::vector<int64_t> keys;
+  for (int64_t i = 1; i <= scale; ++i) {
+    keys.push_back(i);
+  }
+  std::mt19937 g(2021);
+  std::shuffle(keys.begin(), keys.end(), g);
+
+  for (bool optimistic : {false, true}) {
+    for (uint64_t num_threads : {1, 2, 4, 8, 16}) {
+      DiskManager *disk_manager = new DiskManager("test.db");
+      BufferPoolManager *bpm = new BufferPoolManager(4096, disk_manager);
+      BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 64, 64);
+      tree.SetOptimisticDescent(optimistic);
+      page_id_t page_id;
+      bpm->NewPage(&page_id);
+      auto start = std::chrono::steady_clock::now();
+      LaunchParallelTest(num_threads, InsertHelperSplit, &tree, keys, num_threads);
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "BENCH btree_insert descent=" << (optimistic ? "optimistic" : "crabbing")
+                << " threads=" << num_threads << " inserts_per_sec=" << scale * 1000000 / std::max<int64_t>(us, 1)
+                << std::endl;
+
+      int64_t size = 0;
+      for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+        size++;
+      }
+      EXPECT_EQ(scale, size);
+      bpm->UnpinPage(HEADER_PAGE_ID, true);
+      delete bpm;
+      delete disk_manager;
+      remove("test.db");
+      remove("test.log");
+    }
+  }
+  delete key_schema;
+}
+
+/*
+ * Point lookup latency while other threads insert, against the same lookups on an idle tree: crabbing inserts write
+ * latch the root, B-link inserts never block the lookups on more than one page.
+ */
+// NOLINTNEXTLINE
+TEST(BPlusTreeConcurrentTest, DISABLED_LookupLatencyBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t scale = 100000;
+  const int num_lookups = 200000;
+  std::vector<int64_t> loaded_keys;
+  std::vector<int64_t> inserted_keys;
+  for (int64_t i = 1; i <= 2 * scale; i++) {
+    (i % 2 == 0 ? loaded_keys : inserted_keys).push_back(i);
+  }
+  std::mt19937 g(2021);
+  std::shuffle(loaded_keys.begin(), loaded_keys.end(), g);
+  std::shuffle(inserted_keys.begin(), inserted_keys.end(), g);
+
+  for (bool optimistic : {false, true}) {
+    for (int num_inserters : {0, 4}) {
+      DiskManager *disk_manager = new DiskManager("test.db");
+      BufferPoolManager *bpm = new BufferPoolManager(4096, disk_manager);
+      BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 64, 64);
+      tree.SetOptimisticDescent(optimistic);
+      page_id_t page_id;
+      bpm->NewPage(&page_id);
+      InsertHelper(&tree, loaded_keys);
+
+      std::atomic<bool> done{false};
+      std::vector<std::thread> inserters;
+      for (int i = 0; i < num_inserters; i++) {
+        inserters.emplace_back([&, i] {
+          GenericKey<8> index_key;
+          Transaction transaction(0);
+          for (size_t j = i; j < inserted_keys.size() && !done; j += num_inserters) {
+            index_key.SetFromInteger(inserted_keys[j]);
+            tree.Insert(index_key, RID(0, inserted_keys[j]), &transaction);
+          }
+        });
+      }
+      std::vector<int64_t> latencies;
+      GenericKey<8> index_key;
+      std::vector<RID> rids;
+      for (int i = 0; i < num_lookups; i++) {
+        rids.clear();
+        index_key.SetFromInteger(loaded_keys[i % loaded_keys.size()]);
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_TRUE(tree.GetValue(index_key, &rids));
+        latencies.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+      }
+      done = true;
+      for (auto &inserter : inserters) {
+        inserter.join();
+      }
+      std::sort(latencies.begin(), latencies.end());
+      int64_t total = std::accumulate(latencies.begin(), latencies.end(), int64_t{0});
+      std::cout << "BENCH btree_lookup inserts=" << (optimistic ? "blink" : "crabbing")
+                << " inserters=" << num_inserters << " avg_ns=" << total / num_lookups
+                << " p99_ns=" << latencies[num_lookups * 99 / 100] << " max_ns=" << latencies.back() << std::endl;
+
+      bpm->UnpinPage(HEADER_PAGE_ID, true);
+      delete bpm;
+      delete disk_manager;
+      remove("test.db");
+      remove("test.log");
+    }
+  }
+  delete key_schema;
+}
+
 }  // namespace bustub
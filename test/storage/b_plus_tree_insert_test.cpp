@@ -3,8 +3,14 @@
  */
 
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <iostream>
 #include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "b_plus_tree_test_util.h"  // NOLINT
 #include "buffer/buffer_pool_manager.h"
@@ -408,4 +414,174 @@ TEST(BPlusTreeInsertTests, InsertRandom) {
   remove("test.log");
 }
 
+// Walk the leaf chain, returning the number of leaves and the sizes of the smallest and the largest one
+static std::tuple<int, int, int> LeafStats(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree,
+                                           BufferPoolManager *bpm) {
+  GenericKey<8> index_key;
+  index_key.SetFromInteger(0);
+  Page *page = tree->FindLeafPage(index_key, true);
+  page->RUnlatch();
+  int num_leaves = 0;
+  int min_size = INT32_MAX;
+  int max_size = 0;
+  while (true) {
+    auto *leaf = reinterpret_cast<BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>> *>(page->GetData());
+    num_leaves++;
+    min_size = std::min(min_size, leaf->GetSize());
+    max_size = std::max(max_size, leaf->GetSize());
+    page_id_t next_page_id = leaf->GetNextPageId();
+    bpm->UnpinPage(page->GetPageId(), false);
+    if (next_page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    page = bpm->FetchPage(next_page_id);
+  }
+  return {num_leaves, min_size, max_size};
+}
+
+// Bulk loading sorts, drops duplicate keys and spreads the keys evenly over the leaves
+// NOLINTNEXTLINE
+TEST(BPlusTreeInsertTests, BulkLoadTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 8, 6);
+  GenericKey<8> index_key;
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t scale = 1000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= scale; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+  std::vector<std::pair<GenericKey<8>, RID>> entries;
+  for (auto key : keys) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(0, key));
+  }
+  // 重复的 key 保留先出现的
+  for (int64_t key = 1; key <= 100; key++) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(1, key));
+  }
+  tree.BulkLoad(&entries, 0.75, transaction);
+  EXPECT_EQ(scale, entries.size());
+
+  std::vector<RID> rids;
+  for (int64_t key = 1; key <= scale; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids);
+    ASSERT_EQ(1, rids.size());
+    EXPECT_EQ(RID(0, key), rids[0]);
+  }
+  int64_t current_key = 1;
+  for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+    EXPECT_EQ(current_key, (*iterator).second.GetSlotNum());
+    current_key++;
+  }
+  EXPECT_EQ(scale + 1, current_key);
+  // 8 * 0.75 = 6 个 key 一个叶子，平均分配
+  auto [num_leaves, min_size, max_size] = LeafStats(&tree, bpm);
+  EXPECT_EQ((scale + 5) / 6, num_leaves);
+  EXPECT_GE(min_size, 5);
+  EXPECT_LE(max_size, 6);
+
+  // 批量加载的树可以继续插入和删除
+  for (int64_t key = scale + 1; key <= 2 * scale; key++) {
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.Insert(index_key, RID(0, key), transaction));
+  }
+  for (int64_t key = 1; key <= scale; key += 2) {
+    index_key.SetFromInteger(key);
+    tree.Remove(index_key, transaction);
+  }
+  for (int64_t key = 1; key <= 2 * scale; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids);
+    EXPECT_EQ(key > scale || key % 2 == 0 ? 1 : 0, rids.size());
+  }
+
+  // 树不空时逐个插入
+  entries.clear();
+  for (int64_t key = 2 * scale + 1; key <= 2 * scale + 10; key++) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(0, key));
+  }
+  tree.BulkLoad(&entries, 1.0, transaction);
+  for (int64_t key = 2 * scale + 1; key <= 2 * scale + 10; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids);
+    EXPECT_EQ(1, rids.size());
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  delete key_schema;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Building an index of random keys by inserting them one by one against bulk loading them, the time and the number
+ * of leaves of the resulting tree.
+ */
+// NOLINTNEXTLINE
+TEST(BPlusTreeInsertTests, DISABLED_BulkLoadBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t scale = 1000000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= scale; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+
+  for (const char *method : {"insert", "bulk"}) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(1000, disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+    Transaction transaction(0);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+    GenericKey<8> index_key;
+    auto start = std::chrono::steady_clock::now();
+    if (std::string(method) == "insert") {
+      for (auto key : keys) {
+        index_key.SetFromInteger(key);
+        tree.Insert(index_key, RID(0, key), &transaction);
+      }
+    } else {
+      std::vector<std::pair<GenericKey<8>, RID>> entries;
+      entries.reserve(keys.size());
+      for (auto key : keys) {
+        index_key.SetFromInteger(key);
+        entries.emplace_back(index_key, RID(0, key));
+      }
+      tree.BulkLoad(&entries, 1.0, &transaction);
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    auto [num_leaves, min_size, max_size] = LeafStats(&tree, bpm);
+    std::cout << "BENCH btree_build method=" << method << " keys=" << scale << " ms=" << ms
+              << " leaves=" << num_leaves << " min_leaf_size=" << min_size << " max_leaf_size=" << max_size
+              << std::endl;
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+  delete key_schema;
+}
+
 }  // namespace bustub
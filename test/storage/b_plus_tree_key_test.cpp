@@ -0,0 +1,259 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// b_plus_tree_key_test.cpp
+//
+// Identification: test/storage/b_plus_tree_key_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+static int Sign(int cmp) { return static_cast<int>(cmp > 0) - static_cast<int>(cmp < 0); }
+
+// Normalized keys of every fixed-width type compare like their Values
+// NOLINTNEXTLINE
+TEST(BPlusTreeKeyTest, BinaryKeyOrderTest) {
+  Schema *key_schema = ParseCreateStatement("a boolean,b tinyint,c smallint,d integer,e bigint,f double");
+  GenericComparator<64> generic_comparator(key_schema);
+  BinaryComparator<64> binary_comparator(key_schema);
+
+  // 取值很少，让前面的列经常相等
+  std::mt19937 rng(7);
+  auto pick = [&](int n) { return static_cast<int>(rng() % n) - n / 2; };
+  const std::vector<double> doubles = {-1e300, -2.5, -0.0, 0.0, 1e-300, 3.0, 1e300};
+  std::vector<std::pair<GenericKey<64>, BinaryKey<64>>> keys;
+  for (int i = 0; i < 300; i++) {
+    Tuple tuple{{ValueFactory::GetBooleanValue(rng() % 2 == 0), ValueFactory::GetTinyIntValue(pick(4)),
+                 ValueFactory::GetSmallIntValue(pick(4) * 1000), ValueFactory::GetIntegerValue(pick(4) * 100000),
+                 ValueFactory::GetBigIntValue(int64_t{pick(4)} << 40),
+                 ValueFactory::GetDecimalValue(doubles[rng() % doubles.size()])},
+                key_schema};
+    GenericKey<64> generic_key;
+    generic_key.SetFromKey(tuple);
+    BinaryKey<64> binary_key;
+    binary_key.SetFromKey(tuple, key_schema);
+    keys.emplace_back(generic_key, binary_key);
+  }
+  for (const auto &lhs : keys) {
+    for (const auto &rhs : keys) {
+      ASSERT_EQ(Sign(generic_comparator(lhs.first, rhs.first)), Sign(binary_comparator(lhs.second, rhs.second)));
+    }
+  }
+
+  // 测试用的整数 key 也按整数排序
+  BinaryKey<8> small;
+  BinaryKey<8> large;
+  small.SetFromInteger(-5);
+  large.SetFromInteger(3);
+  EXPECT_LT(BinaryComparator<8>(key_schema)(small, large), 0);
+  EXPECT_EQ(-5, small.ToString());
+  delete key_schema;
+}
+
+// NOLINTNEXTLINE
+TEST(BPlusTreeKeyTest, IntegerKeyTest) {
+  Schema *key_schema = ParseCreateStatement("a integer");
+  IntegerComparator<int32_t> comparator(key_schema);
+  std::vector<int32_t> values = {INT32_MIN, -7, 0, 7, INT32_MAX};
+  for (auto lhs : values) {
+    for (auto rhs : values) {
+      IntegerKey<int32_t> lhs_key;
+      IntegerKey<int32_t> rhs_key;
+      lhs_key.SetFromKey(Tuple{{ValueFactory::GetIntegerValue(lhs)}, key_schema});
+      rhs_key.SetFromInteger(rhs);
+      EXPECT_EQ(static_cast<int>(lhs > rhs) - static_cast<int>(lhs < rhs), comparator(lhs_key, rhs_key));
+    }
+  }
+  delete key_schema;
+}
+
+/*
+ * Point lookups on a tree of random keys, per key type: the same keys as GenericKeys compared through Value, as
+ * IntegerKeys and as normalized BinaryKeys, for a single BIGINT column and for two INTEGER columns.
+ */
+template <typename KeyType, typename KeyComparator>
+static void LookupBenchmark(const char *name, const char *sql) {
+  const int num_keys = 200000;
+  const int num_lookups = 1000000;
+  Schema *key_schema = ParseCreateStatement(sql);
+  KeyComparator comparator(key_schema);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(2000, disk_manager);
+  BPlusTree<KeyType, RID, KeyComparator> tree("foo_pk", bpm, comparator);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  Transaction transaction(0);
+
+  std::mt19937 rng(7);
+  std::vector<KeyType> keys;
+  std::vector<std::pair<KeyType, RID>> entries;
+  for (int i = 0; i < num_keys; i++) {
+    auto value = static_cast<int32_t>(rng());
+    std::vector<Value> values;
+    for (uint32_t j = 0; j < key_schema->GetColumnCount(); j++) {
+      values.push_back(key_schema->GetColumn(j).GetType() == TypeId::BIGINT ? ValueFactory::GetBigIntValue(value)
+                                                                              : ValueFactory::GetIntegerValue(value));
+      value = static_cast<int32_t>(rng());
+    }
+    KeyType key;
+    key.SetFromKey(Tuple{values, key_schema}, key_schema);
+    keys.push_back(key);
+    entries.emplace_back(key, RID(0, i));
+  }
+  tree.BulkLoad(&entries, 1.0, &transaction);
+
+  std::vector<RID> result;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_lookups; i++) {
+    result.clear();
+    tree.GetValue(keys[rng() % keys.size()], &result);
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "BENCH btree_key_lookup key=" << name << " keys=" << num_keys
+            << " ns_per_lookup=" << ns / num_lookups << std::endl;
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete bpm;
+  delete disk_manager;
+  delete key_schema;
+  remove("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(BPlusTreeKeyTest, DISABLED_LookupBenchmark) {
+  LookupBenchmark<GenericKey<8>, GenericComparator<8>>("generic_bigint", "a bigint");
+  LookupBenchmark<IntegerKey<int64_t>, IntegerComparator<int64_t>>("integer_bigint", "a bigint");
+  LookupBenchmark<BinaryKey<8>, BinaryComparator<8>>("binary_bigint", "a bigint");
+  LookupBenchmark<GenericKey<8>, GenericComparator<8>>("generic_int_int", "a integer,b integer");
+  LookupBenchmark<BinaryKey<8>, BinaryComparator<8>>("binary_int_int", "a integer,b integer");
+}
+
+static const char *KERNEL_NAMES[] = {"scalar", "avx2", "avx512"};
+
+// Every kernel the CPU supports finds the same positions as std::lower_bound and std::upper_bound
+template <typename IntType, typename ValueType>
+static void CheckSearchIntegerKeys(SearchKernel kernel) {
+  std::mt19937 rng(7);
+  for (int count = 0; count <= 300; count += count < 80 ? 1 : 37) {
+    std::vector<std::pair<IntegerKey<IntType>, ValueType>> items(count);
+    std::vector<IntType> values;
+    for (int i = 0; i < count; i++) {
+      // 取值范围小，有重复的 key，也有最小和最大的整数
+      values.push_back(i == 0 ? std::numeric_limits<IntType>::min()
+                              : i == count - 1 ? std::numeric_limits<IntType>::max()
+                                               : static_cast<IntType>(static_cast<int>(rng() % 200) - 100));
+    }
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i < count; i++) {
+      items[i].first.SetFromInteger(values[i]);
+    }
+    std::vector<IntType> probes = {std::numeric_limits<IntType>::min(), std::numeric_limits<IntType>::max()};
+    for (int i = -101; i <= 101; i += 3) {
+      probes.push_back(static_cast<IntType>(i));
+    }
+    for (auto probe : probes) {
+      const char *first = reinterpret_cast<const char *>(items.data());
+      size_t stride = sizeof(items[0]);
+      ASSERT_EQ(std::lower_bound(values.begin(), values.end(), probe) - values.begin(),
+                SearchIntegerKeys(first, stride, count, probe, false))
+          << KERNEL_NAMES[static_cast<int>(kernel)] << " count " << count << " key " << probe;
+      ASSERT_EQ(std::upper_bound(values.begin(), values.end(), probe) - values.begin(),
+                SearchIntegerKeys(first, stride, count, probe, true))
+          << KERNEL_NAMES[static_cast<int>(kernel)] << " count " << count << " key " << probe;
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(BPlusTreeKeyTest, SearchIntegerKeysTest) {
+  SearchKernel best = GetSearchKernel();
+  for (auto kernel : {SearchKernel::SCALAR, SearchKernel::AVX2, SearchKernel::AVX512}) {
+    if (!SetSearchKernel(kernel)) {
+      continue;
+    }
+    // 叶子节点和内部节点的 (key, value) 大小
+    CheckSearchIntegerKeys<int32_t, RID>(kernel);
+    CheckSearchIntegerKeys<int32_t, page_id_t>(kernel);
+    CheckSearchIntegerKeys<int64_t, RID>(kernel);
+    CheckSearchIntegerKeys<int64_t, page_id_t>(kernel);
+  }
+  SetSearchKernel(best);
+}
+
+/*
+ * Point lookups on an in-memory tree of integer keys per search kernel and fan-out, the pages are filled to the
+ * fan-out by bulk loading.
+ */
+// NOLINTNEXTLINE
+TEST(BPlusTreeKeyTest, DISABLED_SearchKernelBenchmark) {
+  const int num_keys = 1000000;
+  const int num_lookups = 2000000;
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  IntegerComparator<int64_t> comparator(key_schema);
+  std::mt19937 rng(7);
+  std::vector<IntegerKey<int64_t>> keys(num_keys);
+  for (auto &key : keys) {
+    key.SetFromInteger(static_cast<int64_t>(rng()) << 16);
+  }
+  std::vector<size_t> probes(num_lookups);
+  for (auto &probe : probes) {
+    probe = rng() % num_keys;
+  }
+  SearchKernel best = GetSearchKernel();
+  for (int fanout : {16, 64, 128, 252}) {
+    auto *disk_manager = new DiskManager("test.db");
+    auto *bpm = new BufferPoolManager(2 * num_keys / (fanout - 1) + 100, disk_manager);
+    BPlusTree<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>> tree("foo_pk", bpm, comparator, fanout + 1,
+                                                                         fanout + 1);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+    Transaction transaction(0);
+    std::vector<std::pair<IntegerKey<int64_t>, RID>> entries;
+    for (int i = 0; i < num_keys; i++) {
+      entries.emplace_back(keys[i], RID(0, i));
+    }
+    tree.BulkLoad(&entries, 1.0, &transaction);
+    for (auto kernel : {SearchKernel::SCALAR, SearchKernel::AVX2, SearchKernel::AVX512}) {
+      if (!SetSearchKernel(kernel)) {
+        continue;
+      }
+      std::vector<RID> result;
+      auto start = std::chrono::steady_clock::now();
+      for (auto probe : probes) {
+        result.clear();
+        tree.GetValue(keys[probe], &result);
+      }
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      std::cout << "BENCH btree_search kernel=" << KERNEL_NAMES[static_cast<int>(kernel)] << " fanout=" << fanout
+                << " lookups_per_sec=" << num_lookups * 1000000000L / ns << std::endl;
+    }
+    SetSearchKernel(best);
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete bpm;
+    delete disk_manager;
+    remove("test.db");
+  }
+  delete key_schema;
+}
+
+}  // namespace bustub